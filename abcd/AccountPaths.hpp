@@ -27,6 +27,7 @@ public:
     const std::string &dir() const { return dir_; }
     std::string syncDir() const { return dir_ + "sync/"; }
     std::string walletsDir() const { return dir_ + "sync/Wallets/"; }
+    std::string pluginIndexDir() const { return dir_ + "PluginIndex/"; }
 
     // Files:
     std::string carePackagePath() const { return dir_ + "CarePackage.json"; }
@@ -13,6 +13,8 @@
 #include <stdlib.h>
 #include <inttypes.h>
 #include <time.h>
+#include <unistd.h>
+#include <errno.h>
 #include <string>
 #include <math.h>
 #include <boost/algorithm/string.hpp>
@@ -20,364 +22,301 @@
 namespace abcd {
 
 #define MAX_DATE_TIME_SIZE 20
-#define MAX_AMOUNT_STRING_SIZE 20 // 21 million + 8 decimals + padding. ~20 digits
 
-/* Maxium size of CSV record and fields in characters */
-#define ABC_CSV_MAX_REC_SZ  16384
+/* Maxium size of an address list field in characters */
 #define ABC_CSV_MAX_FLD_SZ  4096
 
-#define ABC_CSV_DFLT_DELIMITER "|"
 #define ABC_CSV_ALT1_DELIMITER ","
 
 #define ABC_CSV_REC_TERM_NAME "VER"
 #define ABC_CSV_REC_TERM_VALUE "1"
 
+ExportSink
+exportSinkFd(int fd)
+{
+    return [fd](const char *data, size_t size) -> Status
+    {
+        while (size)
+        {
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0)
+            {
+                if (EINTR == errno)
+                    continue;
+                return ABC_ERROR(ABC_CC_FileWriteError,
+                                 "Cannot write export data");
+            }
+            data += written;
+            size -= written;
+        }
+        return Status();
+    };
+}
 
-#define ABC_CSV(type)    struct { \
-                                      type ov[ABC_CSV_MAX_FLD_SZ]; \
-                                      type qv[ABC_CSV_MAX_FLD_SZ]; \
-                                      size_t os; \
-                                      size_t qs; \
-                                }
+ExportSink
+exportSinkString(std::string &result)
+{
+    return [&result](const char *data, size_t size) -> Status
+    {
+        result.append(data, size);
+        return Status();
+    };
+}
 
-#define ABC_CSV_INIT(fld, src)  { \
-                                  strncpy((fld).ov, src, ABC_CSV_MAX_FLD_SZ); \
-                                  memset((fld).qv, 0, sizeof((fld).qv)); \
-                                  (fld).os = strlen(src); \
-                                  (fld).qs = 0; \
-                                }
+ExportWriter::ExportWriter(ExportSink sink, size_t bufferSize):
+    sink_(sink),
+    buffer_(bufferSize),
+    used_(0)
+{
+}
 
-#define ABC_CSV_INIT2(fld, src, type) {\
-                                        char _tmpXform[ABC_CSV_MAX_FLD_SZ]; \
-                                        snprintf(_tmpXform,ABC_CSV_MAX_FLD_SZ,"%" type, src); \
-                                        ABC_CSV_INIT(fld, _tmpXform); \
-                                      }
+Status
+ExportWriter::write(const char *data, size_t size)
+{
+    // Writes that won't fit go straight to the sink:
+    if (buffer_.size() < used_ + size)
+    {
+        ABC_CHECK(flush());
+        if (buffer_.size() < size)
+            return sink_(data, size);
+    }
 
-#define ABC_CSV_FMT(v, d)       { \
-                                  size_t _sz = 0; \
-                                  _sz = csv_write(v.qv, sizeof(v.qv), v.ov, v.os); \
-                                  v.qs = _sz; \
-                                  ABC_STR_NEW(d, v.qs+1+1); \
-                                  snprintf(d, v.qs+1+1,"%s%s", v.qv, ABC_CSV_ALT1_DELIMITER); \
-                                }
+    memcpy(buffer_.data() + used_, data, size);
+    used_ += size;
+    return Status();
+}
 
+Status
+ExportWriter::write(const std::string &data)
+{
+    return write(data.data(), data.size());
+}
 
-typedef ABC_CSV(char) tABC_CSV;
+Status
+ExportWriter::flush()
+{
+    if (used_)
+    {
+        const auto size = used_;
+        used_ = 0;
+        ABC_CHECK(sink_(buffer_.data(), size));
+    }
+    return Status();
+}
 
-tABC_CC ABC_ExportGenerateHeader(char **szCsvRec, tABC_Error *pError)
+/**
+ * Formats a satoshi amount as bitcoins.
+ */
+static Status
+exportAmount(std::string &result, int64_t amount, unsigned decimalPlaces,
+             bool addSign)
 {
-    tABC_CC cc = ABC_CC_Ok;
-    char **out = szCsvRec;
-
-    /* header */
-    const char *szDateCreation = "DATE";
-    const char *szTimeCreation = "TIME";
-    const char *szName = "PAYEE_PAYER_NAME"; /* payee or payer */
-    const char *szAmtBTC = "AMT_BTC";
-    const char *szCurrency = "USD";
-    const char *szCategory = "CATEGORY";
-    const char *szNotes = "NOTES";
-    const char *szAmtAirbitzBTC = "AMT_BTC_FEES_AB";
-    const char *szAmtFeesMinersBTC = "AMT_BTC_FEES_MINERS";
-    const char *szInputAddresses = "IN_ADDRESSES";
-    const char *szOutputAddresses = "OUT_ADDRESSES";
-    const char *szCsvTxid = "TXID";
-
-    ABC_CHECK_NULL(szCsvRec);
-
-    /* Allocated enough space for the header descriptions */
-    ABC_STR_NEW(*szCsvRec, ABC_CSV_MAX_REC_SZ);
-
-    /* build the entire record */
-    snprintf(*out, ABC_CSV_MAX_FLD_SZ,
-             "%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s,%s\n",
-             szDateCreation,
-             szTimeCreation,
-             szName,
-             szAmtBTC,
-             szCurrency,
-             szCategory,
-             szNotes,
-             szAmtAirbitzBTC,
-             szAmtFeesMinersBTC,
-             szInputAddresses,
-             szOutputAddresses,
-             szCsvTxid,
-             ABC_CSV_REC_TERM_NAME);
-exit:
-    return cc;
+    AutoString formatted;
+    ABC_CHECK_OLD(ABC_FormatAmount(amount, &formatted.get(),
+                                   decimalPlaces, addSign, &error));
+    result = formatted.get();
+    return Status();
 }
 
-tABC_CC ABC_ExportGetAddresses(tABC_TxInfo *pData,
-                               char **szAddresses,
-                               bool bInputs,
-                               tABC_Error *pError)
+/**
+ * Quotes a CSV field and writes it out, followed by a delimiter.
+ * The scratch buffer is passed in so it can be re-used between fields.
+ */
+static Status
+exportCsvField(ExportWriter &out, std::string &scratch, const char *field)
 {
-    tABC_CC cc = ABC_CC_Ok;
+    if (!field)
+        field = "";
+    const size_t fieldSize = strlen(field);
+
+    scratch.resize(csv_write(nullptr, 0, field, fieldSize));
+    csv_write(&scratch[0], scratch.size(), field, fieldSize);
+    ABC_CHECK(out.write(scratch));
+    ABC_CHECK(out.write(ABC_CSV_ALT1_DELIMITER, 1));
+
+    return Status();
+}
 
-    unsigned i;
-    int numAddr = 0;
-    char *szAmount = NULL;
+static Status
+exportCsvField(ExportWriter &out, std::string &scratch,
+               const std::string &field)
+{
+    return exportCsvField(out, scratch, field.c_str());
+}
 
-    // Clear string if allocated
-    if (*szAddresses != NULL)
+/**
+ * Builds a space-separated list of "address:amount" pairs
+ * for either the inputs or the outputs of a transaction.
+ */
+static Status
+exportCsvAddresses(std::string &result, const tABC_TxInfo &info,
+                   bool inputs)
+{
+    result.clear();
+    for (unsigned i = 0; i < info.countOutputs; i++)
     {
-        strcpy(*szAddresses, "");
+        const auto *output = info.aOutputs[i];
+        if (output->input != inputs)
+            continue;
+
+        std::string amount;
+        ABC_CHECK(exportAmount(amount, output->value,
+                               ABC_BITCOIN_DECIMAL_PLACES, false));
+
+        const size_t lengthNeeded = result.size() +
+                                    ABC_STRLEN(output->szAddress) + amount.size() + 3;
+        if (lengthNeeded > ABC_CSV_MAX_FLD_SZ)
+            break;
+
+        if (!result.empty())
+            result += ' ';
+        if (output->szAddress)
+            result += output->szAddress;
+        result += ':';
+        result += amount;
     }
 
-    for (i = 0; i < pData->countOutputs; i++)
-    {
-        bool doCopy = false;
-        if (pData->aOutputs[i]->input)
-        {
-            if (bInputs)
-            {
-                // Found an input and want only inputs
-                doCopy = true;
-            }
-        }
-        else if (!bInputs)
-        {
-            // Found an output and want only outputs
-            doCopy = true;
-        }
+    return Status();
+}
 
-        if (doCopy)
-        {
-            int lengthNeeded;
+static Status
+exportCsvHeader(ExportWriter &out)
+{
+    return out.write("DATE,"
+                     "TIME,"
+                     "PAYEE_PAYER_NAME,"
+                     "AMT_BTC,"
+                     "USD,"
+                     "CATEGORY,"
+                     "NOTES,"
+                     "AMT_BTC_FEES_AB,"
+                     "AMT_BTC_FEES_MINERS,"
+                     "IN_ADDRESSES,"
+                     "OUT_ADDRESSES,"
+                     "TXID,"
+                     ABC_CSV_REC_TERM_NAME "\n");
+}
 
-            ABC_STR_NEW(szAmount, MAX_AMOUNT_STRING_SIZE)
+static Status
+exportCsvRecord(ExportWriter &out, std::string &scratch,
+                const tABC_TxInfo &info)
+{
+    const tABC_TxDetails *pDetails = info.pDetails;
+    if (!pDetails)
+        return ABC_ERROR(ABC_CC_NULLPtr, "Transaction has no details");
 
-            ABC_CHECK_RET(ABC_FormatAmount(pData->aOutputs[i]->value, &szAmount,
-                                           ABC_BITCOIN_DECIMAL_PLACES, false, pError));
+    char buff[MAX_DATE_TIME_SIZE];
+    time_t t = (time_t) info.timeCreation;
+    struct tm *tmptr = localtime(&t);
 
-            lengthNeeded = ABC_STRLEN(*szAddresses) + ABC_STRLEN(
-                               pData->aOutputs[i]->szAddress) + ABC_STRLEN(szAmount) + 3;
+    if (!strftime(buff, sizeof buff, "%Y-%m-%d", tmptr))
+        return ABC_ERROR(ABC_CC_Error, "Could not format date");
+    ABC_CHECK(exportCsvField(out, scratch, buff));
 
-            if (lengthNeeded > ABC_CSV_MAX_FLD_SZ) break;
+    if (!strftime(buff, sizeof buff, "%H:%M", tmptr))
+        return ABC_ERROR(ABC_CC_Error, "Could not format time");
+    ABC_CHECK(exportCsvField(out, scratch, buff));
 
-            ABC_ARRAY_RESIZE(*szAddresses, lengthNeeded, char);
+    ABC_CHECK(exportCsvField(out, scratch, pDetails->szName));
 
-            if (numAddr == 0)
-            {
-                snprintf(*szAddresses, lengthNeeded, "%s:%s", pData->aOutputs[i]->szAddress,
-                         szAmount);
-            }
-            else
-            {
-                snprintf(*szAddresses, lengthNeeded, "%s %s:%s", *szAddresses,
-                         pData->aOutputs[i]->szAddress, szAmount);
-            }
-            numAddr++;
-        }
-    }
+    std::string field;
+    ABC_CHECK(exportAmount(field, pDetails->amountSatoshi,
+                           ABC_BITCOIN_DECIMAL_PLACES, true));
+    ABC_CHECK(exportCsvField(out, scratch, field));
 
-exit:
-    ABC_FREE(szAmount);
-    return cc;
-}
+    char buffCurrency[64];
+    snprintf(buffCurrency, sizeof(buffCurrency), "%0.2f",
+             pDetails->amountCurrency);
+    ABC_CHECK(exportCsvField(out, scratch, buffCurrency));
 
-tABC_CC ABC_ExportGenerateRecord(tABC_TxInfo *data, char **szCsvRec,
-                                 tABC_Error *pError)
-{
-    tABC_CC cc = ABC_CC_Ok;
-
-    tABC_TxInfo *pData = data;
-    char **out = szCsvRec;
-
-    /* header */
-    char *szDateCreation;
-    char *szTimeCreation;
-    char *szName; /* payee or payer */
-    char *szAmtBTC;
-    char *szCurrency;
-    char *szCategory;
-    char *szNotes;
-    char *szAmtAirbitzBTC;
-    char *szAmtFeesMinersBTC;
-    char *szInputAddresses;
-    char *szOutputAddresses;
-    char *szCsvTxid;
+    ABC_CHECK(exportCsvField(out, scratch, pDetails->szCategory));
+    ABC_CHECK(exportCsvField(out, scratch, pDetails->szNotes));
 
-    char buff[MAX_DATE_TIME_SIZE];
-    char *pFormatted = NULL;
+    ABC_CHECK(exportAmount(field, pDetails->amountFeesAirbitzSatoshi,
+                           ABC_BITCOIN_DECIMAL_PLACES, true));
+    ABC_CHECK(exportCsvField(out, scratch, field));
 
-    time_t t = (time_t) pData->timeCreation;
-    struct tm *tmptr = localtime(&t);
+    ABC_CHECK(exportAmount(field, pDetails->amountFeesMinersSatoshi,
+                           ABC_BITCOIN_DECIMAL_PLACES, true));
+    ABC_CHECK(exportCsvField(out, scratch, field));
 
-    tABC_CSV tmpCsvVar;
+    ABC_CHECK(exportCsvAddresses(field, info, true));
+    ABC_CHECK(exportCsvField(out, scratch, field));
 
-    ABC_CHECK_NULL(data);
+    ABC_CHECK(exportCsvAddresses(field, info, false));
+    ABC_CHECK(exportCsvField(out, scratch, field));
 
-    if (!strftime(buff, sizeof buff, "%Y-%m-%d", tmptr))
-    {
-        cc = ABC_CC_Error;
-        goto exit;
-    }
-    ABC_CSV_INIT(tmpCsvVar, buff);
-    ABC_CSV_FMT(tmpCsvVar, szDateCreation);
+    ABC_CHECK(exportCsvField(out, scratch, info.szID));
 
-    if (!strftime(buff, sizeof buff, "%H:%M", tmptr))
-    {
-        cc = ABC_CC_Error;
-        goto exit;
-    }
-    ABC_CSV_INIT(tmpCsvVar, buff);
-    ABC_CSV_FMT(tmpCsvVar, szTimeCreation);
-
-    ABC_CSV_INIT(tmpCsvVar, pData->pDetails->szName);
-    ABC_CSV_FMT(tmpCsvVar, szName);
-
-    ABC_CHECK_RET(ABC_FormatAmount(pData->pDetails->amountSatoshi,&pFormatted,
-                                   ABC_BITCOIN_DECIMAL_PLACES, true, pError));
-    ABC_CSV_INIT(tmpCsvVar, pFormatted);
-    ABC_CSV_FMT(tmpCsvVar, szAmtBTC);
-
-    ABC_CSV_INIT2(tmpCsvVar, pData->pDetails->amountCurrency, "0.2f");
-    ABC_CSV_FMT(tmpCsvVar, szCurrency);
-
-    ABC_CSV_INIT(tmpCsvVar, pData->pDetails->szCategory);
-    ABC_CSV_FMT(tmpCsvVar, szCategory);
-
-    ABC_CSV_INIT(tmpCsvVar, pData->pDetails->szNotes);
-    ABC_CSV_FMT(tmpCsvVar, szNotes);
-
-    ABC_CHECK_RET(ABC_FormatAmount(pData->pDetails->amountFeesAirbitzSatoshi,
-                                   &pFormatted, ABC_BITCOIN_DECIMAL_PLACES, true, pError));
-    ABC_CSV_INIT(tmpCsvVar, pFormatted);
-    ABC_CSV_FMT(tmpCsvVar, szAmtAirbitzBTC);
-
-    ABC_CHECK_RET(ABC_FormatAmount(pData->pDetails->amountFeesMinersSatoshi,
-                                   &pFormatted, ABC_BITCOIN_DECIMAL_PLACES, true, pError));
-    ABC_CSV_INIT(tmpCsvVar, pFormatted);
-    ABC_CSV_FMT(tmpCsvVar, szAmtFeesMinersBTC);
-
-    ABC_CHECK_RET(ABC_ExportGetAddresses(pData, &pFormatted, true, pError));
-    ABC_CSV_INIT(tmpCsvVar, pFormatted);
-    ABC_CSV_FMT(tmpCsvVar, szInputAddresses);
-
-    ABC_CHECK_RET(ABC_ExportGetAddresses(pData, &pFormatted, false, pError));
-    ABC_CSV_INIT(tmpCsvVar, pFormatted);
-    ABC_CSV_FMT(tmpCsvVar, szOutputAddresses);
-
-    ABC_CSV_INIT(tmpCsvVar, data->szID);
-    ABC_CSV_FMT(tmpCsvVar, szCsvTxid);
-
-    /* Allocated enough space for one CSV REC - Determined by adding all field when quoted */
-    ABC_STR_NEW(*szCsvRec, ABC_CSV_MAX_REC_SZ+1);
-
-    /* build the entire record */
-    snprintf(*out, ABC_CSV_MAX_FLD_SZ,
-             "%s%s%s%s%s%s%s%s%s%s%s%s%s\n",
-             szDateCreation,
-             szTimeCreation,
-             szName,
-             szAmtBTC,
-             szCurrency,
-             szCategory,
-             szNotes,
-             szAmtAirbitzBTC,
-             szAmtFeesMinersBTC,
-             szInputAddresses,
-             szOutputAddresses,
-             szCsvTxid,
-             ABC_CSV_REC_TERM_VALUE);
-
-    ABC_FREE(szTimeCreation);
-    ABC_FREE(szDateCreation);
-    ABC_FREE(szName);
-    ABC_FREE(szAmtBTC);
-    ABC_FREE(szCurrency);
-    ABC_FREE(szCategory);
-    ABC_FREE(szNotes);
-    ABC_FREE(szAmtAirbitzBTC);
-    ABC_FREE(szAmtFeesMinersBTC);
-    ABC_FREE(szCsvTxid);
-    ABC_FREE(pFormatted);
-
-
-exit:
-    return cc;
+    ABC_CHECK(out.write(ABC_CSV_REC_TERM_VALUE "\n"));
+    return Status();
 }
 
-tABC_CC ABC_ExportFormatCsv(tABC_TxInfo **pTransactions,
-                            unsigned int iTransactionCount,
-                            char **szCsvData,
-                            tABC_Error *pError)
+Status
+exportCsv(ExportWriter &out, const ExportSource &source)
 {
-    tABC_CC cc = ABC_CC_Ok;
-
-    std::string out;
-    {
-        AutoString szCurrRec;
-        ABC_CHECK_RET(ABC_ExportGenerateHeader(&szCurrRec.get(), pError));
-        out += szCurrRec;
-    }
+    std::string scratch;
 
-    for (unsigned i=0; i < iTransactionCount; i++)
+    ABC_CHECK(exportCsvHeader(out));
+    ABC_CHECK(source([&](const tABC_TxInfo &info) -> Status
     {
-        AutoString szCurrRec;
-        ABC_CHECK_RET(ABC_ExportGenerateRecord(pTransactions[i], &szCurrRec.get(),
-                                               pError));
-        out += szCurrRec;
-    }
-
-    *szCsvData = stringCopy(out);
+        return exportCsvRecord(out, scratch, info);
+    }));
+    ABC_CHECK(out.flush());
 
-exit:
-    return cc;
+    return Status();
 }
 
-Status escapeOFXString(std::string &string)
+static void
+escapeOFXString(std::string &string)
 {
     boost::replace_all(string, "&", "&amp;");
     boost::replace_all(string, ">", "&gt;");
     boost::replace_all(string, "<", "&lt;");
-    return Status();
 }
+
 static Status
-exportQBOGenerateHeader(std::string &result, std::string date_today)
+exportQBOGenerateHeader(ExportWriter &out, const std::string &date_today)
 {
-
-    result = "OFXHEADER:100\n"
-             "DATA:OFXSGML\n"
-             "VERSION:102\n"
-             "SECURITY:NONE\n"
-             "ENCODING:USASCII\n"
-             "CHARSET:1252\n"
-             "COMPRESSION:NONE\n"
-             "OLDFILEUID:NONE\n"
-             "NEWFILEUID:NONE\n\n"
-             "<OFX>\n"
-             "<SIGNONMSGSRSV1>\n"
-             "<SONRS>\n"
-             "<STATUS>\n"
-             "<CODE>0\n"
-             "<SEVERITY>INFO\n"
-             "</STATUS>\n"
-             "<DTSERVER>" + date_today + "\n"
-             "<LANGUAGE>ENG\n"
-             "<INTU.BID>3000\n"
-             "</SONRS>\n"
-             "</SIGNONMSGSRSV1>\n"
-             "<BANKMSGSRSV1>\n"
-             "<STMTTRNRS>\n"
-             "<TRNUID>" + date_today + "\n"
-             "<STATUS>\n"
-             "<CODE>0\n"
-             "<SEVERITY>INFO\n"
-             "<MESSAGE>OK\n"
-             "</STATUS>\n"
-             "<STMTRS>\n"
-             "<CURDEF>USD\n"
-             "<BANKACCTFROM>\n"
-             "<BANKID>999999999\n"
-             "<ACCTID>999999999999\n"
-             "<ACCTTYPE>CHECKING\n"
-             "</BANKACCTFROM>\n\n"
-             "<BANKTRANLIST>\n"
-             "<DTSTART>" + date_today + "\n"
-             "<DTEND>" + date_today + "\n";
+    ABC_CHECK(out.write("OFXHEADER:100\n"
+                        "DATA:OFXSGML\n"
+                        "VERSION:102\n"
+                        "SECURITY:NONE\n"
+                        "ENCODING:USASCII\n"
+                        "CHARSET:1252\n"
+                        "COMPRESSION:NONE\n"
+                        "OLDFILEUID:NONE\n"
+                        "NEWFILEUID:NONE\n\n"
+                        "<OFX>\n"
+                        "<SIGNONMSGSRSV1>\n"
+                        "<SONRS>\n"
+                        "<STATUS>\n"
+                        "<CODE>0\n"
+                        "<SEVERITY>INFO\n"
+                        "</STATUS>\n"
+                        "<DTSERVER>" + date_today + "\n"
+                        "<LANGUAGE>ENG\n"
+                        "<INTU.BID>3000\n"
+                        "</SONRS>\n"
+                        "</SIGNONMSGSRSV1>\n"
+                        "<BANKMSGSRSV1>\n"
+                        "<STMTTRNRS>\n"
+                        "<TRNUID>" + date_today + "\n"
+                        "<STATUS>\n"
+                        "<CODE>0\n"
+                        "<SEVERITY>INFO\n"
+                        "<MESSAGE>OK\n"
+                        "</STATUS>\n"
+                        "<STMTRS>\n"
+                        "<CURDEF>USD\n"
+                        "<BANKACCTFROM>\n"
+                        "<BANKID>999999999\n"
+                        "<ACCTID>999999999999\n"
+                        "<ACCTTYPE>CHECKING\n"
+                        "</BANKACCTFROM>\n\n"
+                        "<BANKTRANLIST>\n"
+                        "<DTSTART>" + date_today + "\n"
+                        "<DTEND>" + date_today + "\n"));
 
     return Status();
 }
@@ -385,24 +324,23 @@ exportQBOGenerateHeader(std::string &result, std::string date_today)
 #define MAX_MEMO_SIZE 253
 
 static Status
-exportQBOGenerateRecord(std::string &result, tABC_TxInfo *data)
+exportQBOGenerateRecord(ExportWriter &out, const tABC_TxInfo &data)
 {
-    tABC_TxDetails *pDetails = data->pDetails;
+    const tABC_TxDetails *pDetails = data.pDetails;
+    if (!pDetails)
+        return ABC_ERROR(ABC_CC_NULLPtr, "Transaction has no details");
 
-    AutoString amountFormatted;
-    ABC_CHECK_OLD(ABC_FormatAmount(pDetails->amountSatoshi,
-                                   &amountFormatted.get(),
-                                   ABC_BITCOIN_DECIMAL_PLACES - (ABC_DENOMINATION_UBTC * 3),
-                                   true, &error));
+    std::string amount;
+    ABC_CHECK(exportAmount(amount, pDetails->amountSatoshi,
+                           ABC_BITCOIN_DECIMAL_PLACES - (ABC_DENOMINATION_UBTC * 3),
+                           true));
 
     char buff[MAX_DATE_TIME_SIZE];
     char buffMemo[MAX_MEMO_SIZE];
     char buffExRate[10];
-    std::string transaction;
     std::string trtype;
     std::string date_time;
-    std::string amount(amountFormatted.get());
-    std::string txid(data->szID);
+    std::string txid(data.szID);
     std::string payee(pDetails->szName);
     std::string trname;
     std::string exchangeRate;
@@ -414,7 +352,7 @@ exportQBOGenerateRecord(std::string &result, tABC_TxInfo *data)
         trtype = "DEBIT";
 
     // Transaction date/time
-    time_t t = (time_t) data->timeCreation;
+    time_t t = (time_t) data.timeCreation;
     struct tm *tmptr = localtime(&t);
 
     if (!strftime(buff, sizeof buff, "%Y%m%d%H%M%S.000", tmptr))
@@ -445,26 +383,24 @@ exportQBOGenerateRecord(std::string &result, tABC_TxInfo *data)
     std::string memo(buffMemo);
     escapeOFXString(memo);
 
-    transaction = "<STMTTRN>\n"
-                  "  <TRNTYPE>" + trtype + "\n"
-                  "  <DTPOSTED>" + date_time + "\n"
-                  "  <TRNAMT>" + amount + "\n"
-                  "  <FITID>" + txid + "\n"
-                  + trname +
-                  "  <MEMO>" + memo + "\n"
-                  "  <CURRENCY>" + "\n"
-                  "    <CURRATE>" + exchangeRate + "\n"
-                  "    <CURSYM>USD" + "\n"
-                  "  </CURRENCY>" + "\n"
-                  "</STMTTRN>\n";
-
-    result = transaction;
+    ABC_CHECK(out.write("<STMTTRN>\n"
+                        "  <TRNTYPE>" + trtype + "\n"
+                        "  <DTPOSTED>" + date_time + "\n"
+                        "  <TRNAMT>" + amount + "\n"
+                        "  <FITID>" + txid + "\n"
+                        + trname +
+                        "  <MEMO>" + memo + "\n"
+                        "  <CURRENCY>" + "\n"
+                        "    <CURRATE>" + exchangeRate + "\n"
+                        "    <CURSYM>USD" + "\n"
+                        "  </CURRENCY>" + "\n"
+                        "</STMTTRN>\n"));
+
     return Status();
 }
 
 Status
-exportFormatQBO(std::string &result, tABC_TxInfo **pTransactions,
-                unsigned int iTransactionCount)
+exportQbo(ExportWriter &out, const ExportSource &source)
 {
     time_t rawtime = time(nullptr);
     tm *timeinfo = localtime(&rawtime);
@@ -473,39 +409,29 @@ exportFormatQBO(std::string &result, tABC_TxInfo **pTransactions,
     strftime(buffer, 80, "%Y%m%d%H%M%S.000", timeinfo);
     std::string date_today = buffer;
 
-    std::string out;
-    {
-        std::string header;
-        ABC_CHECK(exportQBOGenerateHeader(header, date_today));
-        out += header;
-    }
-
-    for (unsigned i = 0; i < iTransactionCount; i++)
+    ABC_CHECK(exportQBOGenerateHeader(out, date_today));
+    ABC_CHECK(source([&](const tABC_TxInfo &info) -> Status
     {
-        std::string transactions;
-        ABC_CHECK(exportQBOGenerateRecord(transactions, pTransactions[i]));
-        out += transactions;
-    }
+        return exportQBOGenerateRecord(out, info);
+    }));
 
     // Write footer
-    out += "</BANKTRANLIST>\n"
-           "<LEDGERBAL>\n"
-           "<BALAMT>0.00\n"
-           "<DTASOF>" + date_today + "\n"
-           "</LEDGERBAL>\n"
-           "<AVAILBAL>\n"
-           "<BALAMT>0.00\n"
-           "<DTASOF>" +  date_today + "\n"
-           "</AVAILBAL>\n"
-           "</STMTRS>\n"
-           "</STMTTRNRS>\n"
-           "</BANKMSGSRSV1>\n"
-           "</OFX>\n";
-
-    result = out;
+    ABC_CHECK(out.write("</BANKTRANLIST>\n"
+                        "<LEDGERBAL>\n"
+                        "<BALAMT>0.00\n"
+                        "<DTASOF>" + date_today + "\n"
+                        "</LEDGERBAL>\n"
+                        "<AVAILBAL>\n"
+                        "<BALAMT>0.00\n"
+                        "<DTASOF>" +  date_today + "\n"
+                        "</AVAILBAL>\n"
+                        "</STMTRS>\n"
+                        "</STMTTRNRS>\n"
+                        "</BANKMSGSRSV1>\n"
+                        "</OFX>\n"));
+    ABC_CHECK(out.flush());
+
     return Status();
 }
 
-
-
 } // namespace abcd
@@ -13,17 +13,81 @@
 #define ABC_Export_h
 
 #include "util/Status.hpp"
+#include <functional>
+#include <vector>
 
 namespace abcd {
 
-tABC_CC ABC_ExportFormatCsv(tABC_TxInfo **pTransactions,
-                            unsigned int iTransactionCount,
-                            char **szCsvData,
-                            tABC_Error *pError);
+/**
+ * Receives exported data, one chunk at a time.
+ */
+typedef std::function<Status(const char *data, size_t size)> ExportSink;
+
+/**
+ * Creates a sink that writes to an open file descriptor.
+ * The caller retains ownership of the descriptor.
+ */
+ExportSink
+exportSinkFd(int fd);
+
+/**
+ * Creates a sink that appends to a string.
+ */
+ExportSink
+exportSinkString(std::string &result);
+
+/**
+ * Collects small writes into a fixed-size buffer,
+ * handing them to the sink in large chunks.
+ * The caller must call `flush` once everything has been written.
+ */
+class ExportWriter
+{
+public:
+    static constexpr size_t defaultBufferSize = 64 * 1024;
+
+    ExportWriter(ExportSink sink, size_t bufferSize=defaultBufferSize);
+
+    Status
+    write(const char *data, size_t size);
+
+    Status
+    write(const std::string &data);
 
+    /**
+     * Passes any buffered data on to the sink.
+     */
+    Status
+    flush();
+
+private:
+    ExportSink sink_;
+    std::vector<char> buffer_;
+    size_t used_;
+};
+
+/**
+ * Receives one transaction at a time.
+ */
+typedef std::function<Status(const tABC_TxInfo &info)> ExportVisitor;
+
+/**
+ * Feeds transactions, oldest first, to the visitor.
+ * This lets the exporters avoid holding the whole history in memory.
+ */
+typedef std::function<Status(const ExportVisitor &visitor)> ExportSource;
+
+/**
+ * Writes the transactions out in CSV format.
+ */
+Status
+exportCsv(ExportWriter &out, const ExportSource &source);
+
+/**
+ * Writes the transactions out in Quickbooks (QBO) format.
+ */
 Status
-exportFormatQBO(std::string &result, tABC_TxInfo **pTransactions,
-                unsigned int iTransactionCount);
+exportQbo(ExportWriter &out, const ExportSource &source);
 
 } // namespace abcd
 
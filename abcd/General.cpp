@@ -93,6 +93,22 @@ struct GeneralJson:
     ABC_JSON_VALUE(syncServers,    "syncServers", JsonArray)
 };
 
+// The current snapshot, and the file it was built from:
+static std::mutex gSnapshotMutex;
+static std::shared_ptr<const GeneralSnapshot> gSnapshot;
+static std::string gSnapshotPath;
+static unsigned long gSnapshotVersion = 0;
+
+// The server's fee table, kept so new estimates can be applied without
+// going back to disk:
+static BitcoinFeesJson gSnapshotBitcoinFees;
+
+static std::shared_ptr<const GeneralSnapshot>
+generalSnapshotRefresh();
+
+static void
+generalSnapshotFeesUpdate(EstimateFeesJson estimateFeesJson);
+
 /**
  * Attempts to load the general information from disk.
  */
@@ -104,7 +120,7 @@ generalLoad()
 
     const auto path = gContext->paths.generalPath();
     if (!fileExists(path))
-        generalUpdate().log();
+        return GeneralJson();
 
     GeneralJson out;
     out.load(path).log();
@@ -123,6 +139,7 @@ generalUpdate()
         JsonPtr infoJson;
         ABC_CHECK(loginServerGetGeneral(infoJson));
         ABC_CHECK(infoJson.save(path));
+        generalSnapshotRefresh();
     }
 
     return Status();
@@ -226,19 +243,18 @@ generalEstimateFeesUpdate(size_t blocks, double fee)
 
         const auto path = gContext->paths.feeCachePath();
 
-        ABC_CHECK(feesJson.save(path));
+        ABC_CHECK(feesJson.saveLater(path));
+        generalSnapshotFeesUpdate(feesJson);
     }
     return Status();
 }
 
 
-BitcoinFeeInfo
-generalBitcoinFeeInfo()
+static BitcoinFeeInfo
+generalBitcoinFeeInfoParse(BitcoinFeesJson feeJson,
+                           EstimateFeesJson estimateFeesJson)
 {
-    BitcoinFeesJson feeJson = generalLoad().bitcoinFees();
-    EstimateFeesJson estimateFeesJson = estimateFeesLoad();
-
-    BitcoinFeeInfo out;
+    BitcoinFeeInfo out = BitcoinFeeInfo();
 
     out.confirmFees[1] = estimateFeesJson.confirmFees1() ?
                          estimateFeesJson.confirmFees1() : feeJson.confirmFees1();
@@ -282,11 +298,10 @@ generalBitcoinFeeInfo()
     return out;
 }
 
-AirbitzFeeInfo
-generalAirbitzFeeInfo()
+static AirbitzFeeInfo
+generalAirbitzFeeInfoParse(AirbitzFeesJson feeJson)
 {
     AirbitzFeeInfo out;
-    auto feeJson = generalLoad().airbitzFees();
 
     auto arrayJson = feeJson.addresses();
     size_t size = arrayJson.size();
@@ -314,24 +329,11 @@ generalAirbitzFeeInfo()
     return out;
 }
 
-std::vector<std::string>
-generalBitcoinServers()
+static std::vector<std::string>
+generalBitcoinServersParse(JsonArray arrayJson)
 {
     std::vector<std::string> out;
 
-    if (isTestnet())
-    {
-        std::string serverlist[] = TESTNET_BITCOIN_SERVERS;
-
-        size_t size = sizeof(serverlist) / sizeof(*serverlist);
-        for (size_t i = 0; i < size; i++)
-            out.push_back(serverlist[i]);
-
-        return out;
-    }
-
-    auto arrayJson = generalLoad().bitcoinServers();
-
     size_t size = arrayJson.size();
     out.reserve(size);
     for (size_t i = 0; i < size; i++)
@@ -355,11 +357,9 @@ generalBitcoinServers()
     return out;
 }
 
-std::vector<std::string>
-generalSyncServers()
+static std::vector<std::string>
+generalSyncServersParse(JsonArray arrayJson)
 {
-    auto arrayJson = generalLoad().syncServers();
-
     std::vector<std::string> out;
     size_t size = arrayJson.size();
     out.reserve(size);
@@ -375,4 +375,118 @@ generalSyncServers()
     return out;
 }
 
+/**
+ * Re-reads the files from disk and publishes a new snapshot.
+ */
+static std::shared_ptr<const GeneralSnapshot>
+generalSnapshotRefresh()
+{
+    std::lock_guard<std::mutex> lock(gSnapshotMutex);
+
+    auto generalJson = generalLoad();
+    auto out = std::make_shared<GeneralSnapshot>();
+    out->version = ++gSnapshotVersion;
+    gSnapshotBitcoinFees = generalJson.bitcoinFees();
+    out->bitcoinFees = generalBitcoinFeeInfoParse(gSnapshotBitcoinFees,
+                       estimateFeesLoad());
+    out->airbitzFees = generalAirbitzFeeInfoParse(generalJson.airbitzFees());
+    out->bitcoinServers = generalBitcoinServersParse(
+                              generalJson.bitcoinServers());
+    out->syncServers = generalSyncServersParse(generalJson.syncServers());
+
+    gSnapshot = out;
+    gSnapshotPath = gContext ? gContext->paths.generalPath() : "";
+    return out;
+}
+
+/**
+ * Swaps new fee estimates into the current snapshot,
+ * re-using everything else it already holds.
+ */
+static void
+generalSnapshotFeesUpdate(EstimateFeesJson estimateFeesJson)
+{
+    std::lock_guard<std::mutex> lock(gSnapshotMutex);
+
+    // Without a snapshot, the next one will load the estimates from disk:
+    if (!gSnapshot)
+        return;
+
+    auto out = std::make_shared<GeneralSnapshot>(*gSnapshot);
+    out->version = ++gSnapshotVersion;
+    out->bitcoinFees = generalBitcoinFeeInfoParse(gSnapshotBitcoinFees,
+                       estimateFeesJson);
+    gSnapshot = out;
+}
+
+/**
+ * Returns the current snapshot, or null if there is none
+ * for the current general info file.
+ */
+static std::shared_ptr<const GeneralSnapshot>
+generalSnapshotCurrent()
+{
+    std::lock_guard<std::mutex> lock(gSnapshotMutex);
+    const auto path = gContext ? gContext->paths.generalPath() : "";
+    if (gSnapshot && gSnapshotPath == path)
+        return gSnapshot;
+    return nullptr;
+}
+
+std::shared_ptr<const GeneralSnapshot>
+generalSnapshot()
+{
+    auto out = generalSnapshotCurrent();
+    if (out)
+        return out;
+
+    // Try to fetch the general info if we have never done so.
+    // A successful download publishes its own snapshot:
+    if (gContext && !fileExists(gContext->paths.generalPath()))
+    {
+        generalUpdate().log();
+        out = generalSnapshotCurrent();
+        if (out)
+            return out;
+    }
+
+    return generalSnapshotRefresh();
+}
+
+BitcoinFeeInfo
+generalBitcoinFeeInfo()
+{
+    return generalSnapshot()->bitcoinFees;
+}
+
+AirbitzFeeInfo
+generalAirbitzFeeInfo()
+{
+    return generalSnapshot()->airbitzFees;
+}
+
+std::vector<std::string>
+generalBitcoinServers()
+{
+    if (isTestnet())
+    {
+        std::string serverlist[] = TESTNET_BITCOIN_SERVERS;
+
+        std::vector<std::string> out;
+        size_t size = sizeof(serverlist) / sizeof(*serverlist);
+        for (size_t i = 0; i < size; i++)
+            out.push_back(serverlist[i]);
+
+        return out;
+    }
+
+    return generalSnapshot()->bitcoinServers;
+}
+
+std::vector<std::string>
+generalSyncServers()
+{
+    return generalSnapshot()->syncServers;
+}
+
 } // namespace abcd
@@ -18,6 +18,7 @@
 
 #include "bitcoin/Typedefs.hpp"
 #include <map>
+#include <memory>
 #include <vector>
 
 #define MAX_FEES_BLOCKS 10
@@ -99,6 +100,33 @@ struct AirbitzFeeInfo
     std::string sendPayee;
 };
 
+/**
+ * Everything parsed out of the general info and estimated fee files.
+ * A snapshot never changes once it has been handed out,
+ * so callers can keep using one without any locking.
+ */
+struct GeneralSnapshot
+{
+    /**
+     * Increases each time the underlying files change.
+     */
+    unsigned long version;
+
+    BitcoinFeeInfo bitcoinFees;
+    AirbitzFeeInfo airbitzFees;
+    std::vector<std::string> bitcoinServers;
+    std::vector<std::string> syncServers;
+};
+
+/**
+ * Returns the current general information.
+ * This only reads from disk the first time it is called,
+ * or after `generalUpdate` changes the file.
+ * `generalEstimateFeesUpdate` updates the snapshot in memory.
+ */
+std::shared_ptr<const GeneralSnapshot>
+generalSnapshot();
+
 /**
  * Downloads general info from the server if the local file is out of date.
  */
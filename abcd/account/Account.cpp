@@ -31,7 +31,10 @@ Account::sync(bool &dirty)
 {
     ABC_CHECK(syncRepo(dir(), syncKey_, dirty));
     if (dirty)
+    {
+        pluginCache.clear();
         ABC_CHECK(load());
+    }
 
     return Status();
 }
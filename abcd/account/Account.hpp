@@ -8,6 +8,7 @@
 #ifndef ABCD_ACCOUNT_ACCOUNT_HPP
 #define ABCD_ACCOUNT_ACCOUNT_HPP
 
+#include "PluginData.hpp"
 #include "WalletList.hpp"
 #include <memory>
 
@@ -51,6 +52,9 @@ private:
 public:
     WalletList wallets;
 
+    // Decrypted plugin data, so plugins don't hit the disk on every read.
+    mutable PluginDataCache pluginCache;
+
     // Set to the current PIN when the settings are loaded.
     // Used to detect changes to the PIN.
     std::string pin;
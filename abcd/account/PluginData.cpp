@@ -8,10 +8,13 @@
 #include "PluginData.hpp"
 #include "Account.hpp"
 #include "../crypto/Crypto.hpp"
+#include "../json/JsonArray.hpp"
 #include "../json/JsonObject.hpp"
 #include "../login/Login.hpp"
 #include "../util/FileIO.hpp"
 #include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
 
 namespace abcd {
 
@@ -32,6 +35,36 @@ struct PluginDataFile:
     ABC_JSON_STRING(data, "data", nullptr)
 };
 
+struct PluginIndexEntryJson:
+    public JsonObject
+{
+    ABC_JSON_CONSTRUCTORS(PluginIndexEntryJson, JsonObject)
+
+    ABC_JSON_STRING(file, "file", nullptr)
+    ABC_JSON_STRING(key, "key", nullptr)
+    ABC_JSON_STRING(data, "data", nullptr)
+    ABC_JSON_INTEGER(time, "time", 0)
+    ABC_JSON_INTEGER(size, "size", 0)
+    ABC_JSON_INTEGER(inode, "inode", 0)
+};
+
+struct PluginIndexJson:
+    public JsonObject
+{
+    ABC_JSON_CONSTRUCTORS(PluginIndexJson, JsonObject)
+
+    ABC_JSON_VALUE(entries, "entries", JsonArray)
+};
+
+void
+PluginDataCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stores.clear();
+    pluginsOk = false;
+    plugins.clear();
+}
+
 static std::string
 pluginsDirectory(const Account &account)
 {
@@ -46,16 +79,160 @@ pluginDirectory(const Account &account, const std::string &plugin)
 }
 
 static std::string
-keyFilename(const Account &account, const std::string &plugin,
-            const std::string &key)
+keyFilename(const Account &account, const std::string &key)
+{
+    return cryptoFilename(account.dataKey(), key) + ".json";
+}
+
+static std::string
+indexFilename(const Account &account, const std::string &plugin)
+{
+    return account.login.paths.pluginIndexDir() +
+           cryptoFilename(account.dataKey(), plugin) + ".json";
+}
+
+/**
+ * Fills in the file signature used to detect changes behind our back.
+ */
+static bool
+entryStat(PluginDataCache::Entry &result, const std::string &path)
+{
+    struct stat statInfo;
+    if (stat(path.c_str(), &statInfo))
+        return false;
+
+    result.time = statInfo.st_mtime;
+    result.size = statInfo.st_size;
+    result.inode = statInfo.st_ino;
+    return true;
+}
+
+static bool
+entryMatches(const PluginDataCache::Entry &a, const PluginDataCache::Entry &b)
+{
+    return a.time == b.time && a.size == b.size && a.inode == b.inode;
+}
+
+static PluginDataCache::Store
+indexLoad(const Account &account, const std::string &plugin)
 {
-    return pluginDirectory(account, plugin) +
-           cryptoFilename(account.dataKey(), key) + ".json";
+    PluginDataCache::Store out;
+
+    PluginIndexJson json;
+    if (!json.load(indexFilename(account, plugin), account.dataKey()))
+        return out;
+
+    auto entriesJson = json.entries();
+    size_t size = entriesJson.size();
+    for (size_t i = 0; i < size; i++)
+    {
+        PluginIndexEntryJson entryJson(entriesJson[i]);
+        if (entryJson.fileOk() && entryJson.keyOk() && entryJson.dataOk())
+        {
+            PluginDataCache::Entry entry;
+            entry.key = entryJson.key();
+            entry.data = entryJson.data();
+            entry.time = entryJson.time();
+            entry.size = entryJson.size();
+            entry.inode = entryJson.inode();
+            out[entryJson.file()] = entry;
+        }
+    }
+
+    return out;
+}
+
+static Status
+indexSave(const Account &account, const std::string &plugin,
+          const PluginDataCache::Store &store)
+{
+    JsonArray entriesJson;
+    for (const auto &i: store)
+    {
+        PluginIndexEntryJson entryJson;
+        ABC_CHECK(entryJson.fileSet(i.first));
+        ABC_CHECK(entryJson.keySet(i.second.key));
+        ABC_CHECK(entryJson.dataSet(i.second.data));
+        ABC_CHECK(entryJson.timeSet(i.second.time));
+        ABC_CHECK(entryJson.sizeSet(i.second.size));
+        ABC_CHECK(entryJson.inodeSet(i.second.inode));
+        ABC_CHECK(entriesJson.append(entryJson));
+    }
+
+    PluginIndexJson json;
+    ABC_CHECK(json.entriesSet(entriesJson));
+    ABC_CHECK(fileEnsureDir(account.login.paths.pluginIndexDir()));
+    ABC_CHECK(json.save(indexFilename(account, plugin), account.dataKey()));
+
+    return Status();
+}
+
+/**
+ * Returns the cached contents of a plugin store,
+ * loading them if necessary. Call with the cache mutex held.
+ */
+static PluginDataCache::Store &
+storeLoad(const Account &account, const std::string &plugin)
+{
+    auto &cache = account.pluginCache;
+    auto i = cache.stores.find(plugin);
+    if (cache.stores.end() != i)
+        return i->second;
+    auto &out = cache.stores[plugin];
+
+    // Check the index against the directory,
+    // only decrypting the files that have changed:
+    const auto index = indexLoad(account, plugin);
+    bool changed = false;
+
+    std::string outer = pluginDirectory(account, plugin);
+    DIR *dir = opendir(outer.c_str());
+    if (!dir)
+        return out;
+
+    struct dirent *de;
+    while (nullptr != (de = readdir(dir)))
+    {
+        if (!fileIsJson(de->d_name) || !strcmp(de->d_name, nameFilename))
+            continue;
+
+        PluginDataCache::Entry entry;
+        if (!entryStat(entry, outer + de->d_name))
+            continue;
+
+        auto j = index.find(de->d_name);
+        if (index.end() != j && entryMatches(j->second, entry))
+        {
+            out[de->d_name] = j->second;
+            continue;
+        }
+
+        changed = true;
+        PluginDataFile json;
+        if (json.load(outer + de->d_name, account.dataKey())
+                && json.keyOk() && json.dataOk())
+        {
+            entry.key = json.key();
+            entry.data = json.data();
+            out[de->d_name] = entry;
+        }
+    }
+    closedir(dir);
+
+    if (changed || out.size() != index.size())
+        indexSave(account, plugin, out).log(); // Failure is fine
+
+    return out;
 }
 
 std::list<std::string>
 pluginDataList(const Account &account)
 {
+    auto &cache = account.pluginCache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    if (cache.pluginsOk)
+        return cache.plugins;
+
     std::list<std::string> out;
 
     std::string outer = pluginsDirectory(account);
@@ -75,47 +252,72 @@ pluginDataList(const Account &account)
     }
 
     closedir(dir);
+
+    cache.plugins = out;
+    cache.pluginsOk = true;
     return out;
 }
 
 std::list<std::string>
 pluginDataKeys(const Account &account, const std::string &plugin)
 {
+    auto &cache = account.pluginCache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
     std::list<std::string> out;
+    for (const auto &i: storeLoad(account, plugin))
+        out.push_back(i.second.key);
 
-    std::string outer = pluginDirectory(account, plugin);
-    DIR *dir = opendir(outer.c_str());
-    if (!dir)
-        return out;
+    return out;
+}
 
-    struct dirent *de;
-    while (nullptr != (de = readdir(dir)))
-    {
-        PluginDataFile json;
-        if (fileIsJson(de->d_name)
-                && json.load(outer + de->d_name, account.dataKey())
-                && json.keyOk())
-            out.push_back(json.key());
-    }
+/**
+ * Looks up a single key, with the cache mutex held.
+ */
+static Status
+storeGet(const Account &account, const PluginDataCache::Store &store,
+         const std::string &key, std::string &data)
+{
+    auto i = store.find(keyFilename(account, key));
+    if (store.end() == i)
+        return ABC_ERROR(ABC_CC_FileDoesNotExist, "No plugin data for " + key);
 
-    closedir(dir);
-    return out;
+    if (i->second.key != key)
+        return ABC_ERROR(ABC_CC_JSONError, "Plugin filename does not match contents");
+
+    data = i->second.data;
+    return Status();
 }
 
 Status
 pluginDataGet(const Account &account, const std::string &plugin,
               const std::string &key, std::string &data)
 {
-    PluginDataFile json;
-    ABC_CHECK(json.load(keyFilename(account, plugin, key),
-                        account.dataKey()));
-    ABC_CHECK(json.keyOk());
-    ABC_CHECK(json.dataOk());
+    auto &cache = account.pluginCache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
 
-    if (json.key() != key)
-        return ABC_ERROR(ABC_CC_JSONError, "Plugin filename does not match contents");
+    ABC_CHECK(storeGet(account, storeLoad(account, plugin), key, data));
+    return Status();
+}
+
+Status
+pluginDataGetMany(const Account &account, const std::string &plugin,
+                  const std::list<std::string> &keys,
+                  std::map<std::string, std::string> &result)
+{
+    auto &cache = account.pluginCache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
+    const auto &store = storeLoad(account, plugin);
+    std::map<std::string, std::string> out;
+    for (const auto &key: keys)
+    {
+        std::string data;
+        if (storeGet(account, store, key, data))
+            out[key] = data;
+    }
 
-    data = json.data();
+    result = std::move(out);
     return Status();
 }
 
@@ -123,22 +325,44 @@ Status
 pluginDataSet(const Account &account, const std::string &plugin,
               const std::string &key, const std::string &data)
 {
+    auto &cache = account.pluginCache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
     ABC_CHECK(fileEnsureDir(pluginsDirectory(account)));
     ABC_CHECK(fileEnsureDir(pluginDirectory(account, plugin)));
 
-    const auto namePath = pluginDirectory(account, plugin) + "Name.json";
+    const auto namePath = pluginDirectory(account, plugin) + nameFilename;
     if (!fileExists(namePath))
     {
         PluginNameJson json;
         ABC_CHECK(json.nameSet(plugin));
         json.save(namePath, account.dataKey());
+        cache.pluginsOk = false;
     }
 
+    const auto filename = keyFilename(account, key);
+    const auto path = pluginDirectory(account, plugin) + filename;
     PluginDataFile json;
     json.keySet(key);
     json.dataSet(data);
-    ABC_CHECK(json.save(keyFilename(account, plugin, key),
-                        account.dataKey()));
+    ABC_CHECK(json.save(path, account.dataKey()));
+
+    // Write through to the cache, if it is loaded:
+    auto i = cache.stores.find(plugin);
+    if (cache.stores.end() != i)
+    {
+        PluginDataCache::Entry entry;
+        if (entryStat(entry, path))
+        {
+            entry.key = key;
+            entry.data = data;
+            i->second[filename] = entry;
+        }
+        else
+        {
+            cache.stores.erase(i);
+        }
+    }
 
     return Status();
 }
@@ -147,10 +371,18 @@ Status
 pluginDataRemove(const Account &account, const std::string &plugin,
                  const std::string &key)
 {
-    std::string filename = keyFilename(account, plugin, key);
+    auto &cache = account.pluginCache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
+    const auto filename = keyFilename(account, key);
+    const auto path = pluginDirectory(account, plugin) + filename;
+
+    if (fileExists(path))
+        ABC_CHECK(fileDelete(path));
 
-    if (fileExists(filename))
-        ABC_CHECK(fileDelete(filename));
+    auto i = cache.stores.find(plugin);
+    if (cache.stores.end() != i)
+        i->second.erase(filename);
 
     return Status();
 }
@@ -158,8 +390,18 @@ pluginDataRemove(const Account &account, const std::string &plugin,
 Status
 pluginDataClear(const Account &account, const std::string &plugin)
 {
+    auto &cache = account.pluginCache;
+    std::lock_guard<std::mutex> lock(cache.mutex);
+
     std::string directory = pluginDirectory(account, plugin);
 
+    cache.stores.erase(plugin);
+    cache.pluginsOk = false;
+
+    const auto indexPath = indexFilename(account, plugin);
+    if (fileExists(indexPath))
+        ABC_CHECK(fileDelete(indexPath));
+
     if (fileExists(directory))
         ABC_CHECK(fileDelete(directory));
 
@@ -9,12 +9,49 @@
 #define ABCD_ACCOUNT_PLUGIN_DATA_HPP
 
 #include "../util/Status.hpp"
+#include <time.h>
 #include <list>
+#include <map>
+#include <mutex>
 
 namespace abcd {
 
 class Account;
 
+/**
+ * Remembers the decrypted contents of an account's plugin stores,
+ * so listing and reading keys doesn't need to decrypt files each time.
+ * Each plugin also gets an encrypted index file outside the sync directory,
+ * which lets a fresh login skip decrypting files that haven't changed.
+ */
+struct PluginDataCache
+{
+    struct Entry
+    {
+        std::string key;
+        std::string data;
+
+        // File signature, used to validate the on-disk index:
+        time_t time;
+        uint64_t size;
+        uint64_t inode;
+    };
+
+    /** Maps from filenames to the file contents. */
+    typedef std::map<std::string, Entry> Store;
+
+    std::mutex mutex;
+    std::map<std::string, Store> stores;
+    bool pluginsOk = false;
+    std::list<std::string> plugins;
+
+    /**
+     * Forgets everything, such as after a sync changes the files.
+     */
+    void
+    clear();
+};
+
 /**
  * Lists the plugin key/value stores in the account.
  * This mainly exists for diagnostics,
@@ -43,6 +80,15 @@ Status
 pluginDataGet(const Account &account, const std::string &plugin,
               const std::string &key, std::string &data);
 
+/**
+ * Retreives several items from the plugin key/value store at once.
+ * Keys that do not exist are left out of the result.
+ */
+Status
+pluginDataGetMany(const Account &account, const std::string &plugin,
+                  const std::list<std::string> &keys,
+                  std::map<std::string, std::string> &result);
+
 /**
  * Saves an item to the plugin key/value store.
  */
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Sighash.hpp"
+
+namespace abcd {
+
+/**
+ * Every input is a 36-byte outpoint, a script, and a 4-byte sequence.
+ */
+constexpr size_t outpointSize = 36;
+constexpr size_t sequenceSize = 4;
+
+SighashCache::SighashCache(const bc::transaction_type &tx)
+{
+    bc::transaction_type blank = tx;
+    for (auto &input: blank.inputs)
+        input.script = bc::script_type();
+
+    blank_.resize(satoshi_raw_size(blank) + 4);
+    auto serial = bc::make_serializer(bc::satoshi_save(blank, blank_.begin()));
+    serial.write_4_bytes(bc::sighash::all);
+
+    // With the scripts empty, the inputs are all the same size,
+    // so finding them is simple arithmetic:
+    const auto count = blank.inputs.size();
+    auto offset = 4 + bc::variable_uint_size(count) + outpointSize;
+    offsets_.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        offsets_.push_back(offset);
+        offset += outpointSize + 1 + sequenceSize;
+    }
+
+    // Save the hash state at each input, building on the previous one:
+    SHA256_CTX sha;
+    SHA256_Init(&sha);
+    size_t hashed = 0;
+    prefixes_.reserve(count);
+    for (auto offset: offsets_)
+    {
+        SHA256_Update(&sha, blank_.data() + hashed, offset - hashed);
+        hashed = offset;
+        prefixes_.push_back(sha);
+    }
+}
+
+bc::hash_digest
+SighashCache::hash(size_t index, const bc::script_type &script) const
+{
+    if (offsets_.size() <= index)
+        return bc::null_hash;
+
+    // Serialize the script the same way `satoshi_save` would:
+    const auto raw = bc::save_script(script);
+    bc::data_chunk chunk(bc::variable_uint_size(raw.size()) + raw.size());
+    auto serial = bc::make_serializer(chunk.begin());
+    serial.write_variable_uint(raw.size());
+    serial.write_data(raw);
+
+    // Pick up where the prefix left off, skipping the blank script's
+    // zero-length byte in favor of the real one:
+    SHA256_CTX sha = prefixes_[index];
+    SHA256_Update(&sha, chunk.data(), chunk.size());
+    const auto rest = offsets_[index] + 1;
+    SHA256_Update(&sha, blank_.data() + rest, blank_.size() - rest);
+
+    bc::hash_digest first;
+    SHA256_Final(first.data(), &sha);
+    return bc::sha256_hash(first);
+}
+
+} // namespace abcd
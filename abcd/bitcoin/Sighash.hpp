@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Signature hashes for transactions with many inputs.
+ */
+
+#ifndef ABCD_BITCOIN_SIGHASH_HPP
+#define ABCD_BITCOIN_SIGHASH_HPP
+
+#include <bitcoin/bitcoin.hpp>
+#include <openssl/sha.h>
+
+namespace abcd {
+
+/**
+ * Computes the `sighash::all` signature hash for each input
+ * of a transaction, giving the same results as
+ * `bc::script_type::generate_signature_hash`.
+ *
+ * The libbitcoin version copies and re-serializes the whole transaction
+ * for every input, which is quadratic in the number of inputs.
+ * Since the inputs differ only in which one carries the previous
+ * output script, this class serializes the transaction once,
+ * and keeps a SHA-256 midstate for everything before each input.
+ * Each hash then only needs to process the input itself
+ * and the bytes after it.
+ *
+ * Once constructed, this is safe to use from several threads.
+ */
+class SighashCache
+{
+public:
+    SighashCache(const bc::transaction_type &tx);
+
+    /**
+     * Returns the signature hash for the given input,
+     * or `bc::null_hash` if the index is out of range.
+     * @param script the script of the output being spent.
+     */
+    bc::hash_digest
+    hash(size_t index, const bc::script_type &script) const;
+
+private:
+    /** The transaction with blank input scripts, plus the hash type. */
+    bc::data_chunk blank_;
+    /** The position of each input's (empty) script in `blank_`. */
+    std::vector<size_t> offsets_;
+    /** The hash state after everything before each input's script. */
+    std::vector<SHA256_CTX> prefixes_;
+};
+
+} // namespace abcd
+
+#endif
@@ -18,6 +18,8 @@
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace abcd {
 
@@ -41,9 +43,136 @@ public:
 
     tABC_BitCoin_Event_Callback fCallback;
     void *pData;
+
+    /**
+     * What the GUI last heard about a transaction.
+     */
+    struct KnownTx
+    {
+        TxStatus status;
+        bool hasTime; // True once the block header has arrived.
+    };
+
+    // The wallet state as of the last `WalletChanges` event:
+    std::mutex changesMutex;
+    std::map<std::string, KnownTx> knownTxs;
+    int64_t knownBalance = 0;
+
+    /** Known transactions that a new header could still affect. */
+    TxidSet pendingTxs;
 };
 static std::map<std::string, std::unique_ptr<WatcherInfo>> watchers_;
 
+/**
+ * Compares the wallet's transactions against the state the GUI last saw,
+ * and sends a `WalletChanges` event describing any differences.
+ * @param notify false to just record the current state silently.
+ */
+static void
+bridgeSendChanges(WatcherInfo *watcherInfo, bool notify=true)
+{
+    auto &wallet = watcherInfo->wallet;
+
+    // Gather the current state outside the lock:
+    std::map<std::string, WatcherInfo::KnownTx> current;
+    const auto statuses =
+        wallet.cache.txs.statusMap(wallet.cache.addresses.txids());
+    for (const auto &i: statuses)
+    {
+        time_t unused;
+        WatcherInfo::KnownTx known;
+        known.status = i.second;
+        known.hasTime = i.second.height &&
+                        wallet.cache.blocks.headerTime(unused, i.second.height);
+        current[i.first] = known;
+    }
+    int64_t balance = 0;
+    wallet.balance(balance).log();
+
+    // Diff against the last state:
+    std::vector<std::string> added, changed, confirmed;
+    int64_t balanceDelta = 0;
+    {
+        std::lock_guard<std::mutex> lock(watcherInfo->changesMutex);
+
+        for (const auto &i: current)
+        {
+            auto old = watcherInfo->knownTxs.find(i.first);
+            if (watcherInfo->knownTxs.end() == old)
+            {
+                added.push_back(i.first);
+                continue;
+            }
+
+            const auto &a = old->second;
+            const auto &b = i.second;
+            if (!a.status.height && b.status.height)
+                confirmed.push_back(i.first);
+            else if (a.status.height != b.status.height ||
+                     a.status.isDoubleSpent != b.status.isDoubleSpent ||
+                     a.status.isReplaceByFee != b.status.isReplaceByFee ||
+                     a.hasTime != b.hasTime)
+                changed.push_back(i.first);
+        }
+
+        // Dropped transactions count as changed:
+        for (const auto &i: watcherInfo->knownTxs)
+            if (!current.count(i.first))
+                changed.push_back(i.first);
+
+        balanceDelta = balance - watcherInfo->knownBalance;
+        watcherInfo->pendingTxs.clear();
+        for (const auto &i: current)
+            if (!i.second.status.height || !i.second.hasTime)
+                watcherInfo->pendingTxs.insert(i.first);
+        watcherInfo->knownTxs = std::move(current);
+        watcherInfo->knownBalance = balance;
+    }
+
+    auto fCallback = watcherInfo->fCallback;
+    if (!notify || !fCallback)
+        return;
+    if (added.empty() && changed.empty() && confirmed.empty() && !balanceDelta)
+        return;
+
+    // Build the C structures, which borrow our strings:
+    auto toArray = [](const std::vector<std::string> &in)
+                   -> std::vector<const char *>
+    {
+        std::vector<const char *> out;
+        for (const auto &txid: in)
+            out.push_back(txid.c_str());
+        return out;
+    };
+    auto addedArray = toArray(added);
+    auto changedArray = toArray(changed);
+    auto confirmedArray = toArray(confirmed);
+
+    tABC_WalletChanges changes;
+    changes.aszAddedTxIDs = addedArray.data();
+    changes.addedCount = addedArray.size();
+    changes.aszChangedTxIDs = changedArray.data();
+    changes.changedCount = changedArray.size();
+    changes.aszConfirmedTxIDs = confirmedArray.data();
+    changes.confirmedCount = confirmedArray.size();
+    changes.balance = balance;
+    changes.balanceDelta = balanceDelta;
+
+    ABC_DebugLog("WalletChanges callback: wallet %s, "
+                 "%u added, %u changed, %u confirmed",
+                 wallet.id().c_str(), changes.addedCount,
+                 changes.changedCount, changes.confirmedCount);
+    tABC_AsyncBitCoinInfo info;
+    info.pData = watcherInfo->pData;
+    info.eventType = ABC_AsyncEventType_WalletChanges;
+    Status().toError(info.status, ABC_HERE());
+    info.szWalletUUID = wallet.id().c_str();
+    info.szTxID = nullptr;
+    info.sweepSatoshi = 0;
+    info.pChanges = &changes;
+    fCallback(&info);
+}
+
 /**
  * Tells all running watchers that height has changed.
  * This is a temporary hack until we gain support for app-wide callbacks.
@@ -64,39 +193,72 @@ onHeight(size_t height)
             info.szWalletUUID = watcher.second->wallet.id().c_str();
             info.szTxID = nullptr;
             info.sweepSatoshi = 0;
+            info.pChanges = nullptr;
             watcher.second->fCallback(&info);
         }
     }
 }
 
 /**
- * Tells all running watchers that a new header was found.
- * This is a temporary hack until we gain support for app-wide callbacks.
+ * Returns true if new headers have confirmed or timestamped
+ * any of the wallet's pending transactions.
+ * This only looks at the pending transactions,
+ * so wallets with nothing in flight cost almost nothing.
+ */
+static bool
+bridgePendingChanged(WatcherInfo *watcherInfo)
+{
+    auto &wallet = watcherInfo->wallet;
+
+    TxidSet pending;
+    {
+        std::lock_guard<std::mutex> lock(watcherInfo->changesMutex);
+        pending = watcherInfo->pendingTxs;
+    }
+    if (pending.empty())
+        return false;
+
+    const auto statuses = wallet.cache.txs.statusMap(pending);
+    if (statuses.size() != pending.size())
+        return true;
+
+    for (const auto &i: statuses)
+    {
+        time_t unused;
+        if (i.second.height &&
+                wallet.cache.blocks.headerTime(unused, i.second.height))
+            return true;
+    }
+    return false;
+}
+
+/**
+ * Tells the watchers whose pending transactions a new header affects.
+ * Wallets with nothing affected hear nothing, so the GUI does not
+ * reload every transaction list on every block.
  */
 static void
 onHeader(void)
 {
     for (auto &watcher: watchers_)
     {
-        if (watcher.second->fCallback)
-        {
-            ABC_DebugLog("BlockHeader callback: wallet %s",
-                         watcher.second->wallet.id().c_str());
-            tABC_AsyncBitCoinInfo info;
-            info.pData = watcher.second->pData;
-            info.eventType = ABC_AsyncEventType_TransactionUpdate;
-            Status().toError(info.status, ABC_HERE());
-            info.szWalletUUID = watcher.second->wallet.id().c_str();
+        if (!watcher.second->fCallback ||
+                !bridgePendingChanged(watcher.second.get()))
+            continue;
 
-            // XXX Todo: Look up TxIDs that actually have a matching height and
-            // send a notification for each one OR send one notification with all
-            // affected TxIDs in a std::set.
-            info.szTxID = nullptr;
-            info.sweepSatoshi = 0;
-            watcher.second->fCallback(&info);
+        ABC_DebugLog("BlockHeader callback: wallet %s",
+                     watcher.second->wallet.id().c_str());
+        tABC_AsyncBitCoinInfo info;
+        info.pData = watcher.second->pData;
+        info.eventType = ABC_AsyncEventType_TransactionUpdate;
+        Status().toError(info.status, ABC_HERE());
+        info.szWalletUUID = watcher.second->wallet.id().c_str();
+        info.szTxID = nullptr;
+        info.sweepSatoshi = 0;
+        info.pChanges = nullptr;
+        watcher.second->fCallback(&info);
 
-            break;
-        }
+        bridgeSendChanges(watcher.second.get());
     }
 }
 
@@ -134,6 +296,7 @@ bridgeOnComplete(WatcherInfo *watcherInfo, const std::string &address,
         info.szWalletUUID = wallet.id().c_str();
         info.szTxID = nullptr;
         info.sweepSatoshi = 0;
+        info.pChanges = nullptr;
         wallet.cache.addressCheckDoneSet();
         wallet.cache.save();
         fCallback(&info);
@@ -199,6 +362,7 @@ bridgeWatcherLoop(Wallet &self,
     // Set up new-block callback:
     watcherInfo->fCallback = fCallback;
     watcherInfo->pData = pData;
+    bridgeSendChanges(watcherInfo, false);
     gContext->blockCache.onHeightSet(onHeight);
     gContext->blockCache.onHeaderSet(onHeader);
 
@@ -220,6 +384,7 @@ bridgeWatcherLoop(Wallet &self,
         TxInfo info;
         if (watcherInfo->wallet.cache.txs.info(info, txid).log())
             onReceive(watcherInfo->wallet, info, fCallback, pData).log();
+        bridgeSendChanges(watcherInfo);
     };
     self.cache.addresses.onTxSet(onTx);
 
@@ -6,9 +6,8 @@
  */
 
 #include "AddressCache.hpp"
+#include "CacheJson.hpp"
 #include "TxCache.hpp"
-#include "../../json/JsonArray.hpp"
-#include "../../json/JsonObject.hpp"
 #include "../../util/Debug.hpp"
 
 namespace abcd {
@@ -16,26 +15,6 @@ namespace abcd {
 constexpr auto periodDefault = 20;
 constexpr auto periodPriority = 4;
 
-struct CacheJson:
-    public JsonObject
-{
-    ABC_JSON_CONSTRUCTORS(CacheJson, JsonObject)
-
-    ABC_JSON_VALUE(addresses, "addresses", JsonArray)
-};
-
-struct AddressJson:
-    public JsonObject
-{
-    ABC_JSON_CONSTRUCTORS(AddressJson, JsonObject)
-
-    ABC_JSON_STRING(address, "address", 0)
-    ABC_JSON_BOOLEAN(dirty, "dirty", false)
-    ABC_JSON_VALUE(txids, "txids", JsonArray)
-    ABC_JSON_INTEGER(lastCheck, "lastCheck", 0)
-    ABC_JSON_STRING(stratumHash, "stratumHash", 0)
-};
-
 bool
 operator <(const AddressStatus &a, const AddressStatus &b)
 {
@@ -68,38 +47,27 @@ AddressCache::clear()
 }
 
 Status
-AddressCache::load(JsonObject &json)
+AddressCache::load(const CacheJson &json)
 {
     std::lock_guard<std::recursive_mutex> lock(mutex_);
-    CacheJson cacheJson(json);
     const auto now = time(nullptr);
 
-    auto arrayJson = cacheJson.addresses();
-    size_t size = arrayJson.size();
-    for (size_t i = 0; i < size; i++)
+    for (const auto &addressJson: json.addresses)
     {
-        AddressJson addressJson(arrayJson[i]);
-        if (addressJson.addressOk())
+        if (!addressJson.address.empty())
         {
-            auto address = addressJson.address();
+            const auto &address = addressJson.address;
             AddressRow row;
 
-            auto arrayJson = addressJson.txids();
-            size_t size = arrayJson.size();
-            for (size_t i = 0; i < size; i++)
-            {
-                auto stringJson = arrayJson[i];
-                if (json_is_string(stringJson.get()))
-                    row.insertTxid(json_string_value(stringJson.get()));
-            }
+            for (const auto &txid: addressJson.txids)
+                row.insertTxid(txid);
 
-            row.dirty = addressJson.dirty();
-            row.lastCheck = addressJson.lastCheck();
+            row.dirty = addressJson.dirty;
+            row.lastCheck = addressJson.lastCheck;
             if (now < nextCheck(address, row))
                 row.checkedOnce = true;
 
-            if (addressJson.stratumHashOk())
-                row.stratumHash = addressJson.stratumHash();
+            row.stratumHash = addressJson.stratumHash;
 
             rows_[address] = row;
         }
@@ -110,32 +78,25 @@ AddressCache::load(JsonObject &json)
 }
 
 Status
-AddressCache::save(JsonObject &json)
+AddressCache::save(CacheJson &json)
 {
     std::lock_guard<std::recursive_mutex> lock(mutex_);
-    CacheJson cacheJson(json);
 
-    JsonArray addressesJson;
+    json.addresses.clear();
+    json.addresses.reserve(rows_.size());
     for (const auto &row: rows_)
     {
         if (row.second.sweep)
             continue;
 
-        JsonArray txidsJson;
-        for (const auto &txid: row.second.txids)
-            ABC_CHECK(txidsJson.append(json_string(txid.c_str())));
-
-        AddressJson address;
-        ABC_CHECK(address.addressSet(row.first));
-        if (row.second.dirty)
-            ABC_CHECK(address.dirtySet(row.second.dirty));
-        ABC_CHECK(address.txidsSet(txidsJson));
-        ABC_CHECK(address.lastCheckSet(row.second.lastCheck));
-        if (!row.second.stratumHash.empty())
-            ABC_CHECK(address.stratumHashSet(row.second.stratumHash));
-        ABC_CHECK(addressesJson.append(address));
+        CacheAddressJson address;
+        address.address = row.first;
+        address.dirty = row.second.dirty;
+        address.txids.assign(row.second.txids.begin(), row.second.txids.end());
+        address.lastCheck = row.second.lastCheck;
+        address.stratumHash = row.second.stratumHash;
+        json.addresses.push_back(std::move(address));
     }
-    cacheJson.addressesSet(addressesJson);
 
     return Status();
 }
@@ -208,6 +169,25 @@ AddressCache::insert(const std::string &address, bool sweep)
     }
 }
 
+void
+AddressCache::insert(const AddressSet &addresses)
+{
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+    bool added = false;
+    for (const auto &address: addresses)
+    {
+        if (rows_.end() == rows_.find(address))
+        {
+            rows_[address];
+            added = true;
+        }
+    }
+
+    if (added && wakeupCallback_)
+        wakeupCallback_();
+}
+
 void
 AddressCache::prioritize(const std::string &address)
 {
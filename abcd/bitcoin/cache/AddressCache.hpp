@@ -16,7 +16,7 @@
 
 namespace abcd {
 
-class JsonObject;
+struct CacheJson;
 class TxCache;
 struct TxInfo;
 
@@ -80,16 +80,16 @@ public:
     clear();
 
     /**
-     * Reads the database contents from the provided cache JSON object.
+     * Reads the database contents from the provided cache file contents.
      */
     Status
-    load(JsonObject &json);
+    load(const CacheJson &json);
 
     /**
-     * Saves the database contents to the provided cache JSON object.
+     * Saves the database contents to the provided cache file contents.
      */
     Status
-    save(JsonObject &json);
+    save(CacheJson &json);
 
     // Queries -------------------------------------------------------------
 
@@ -121,6 +121,13 @@ public:
     void
     insert(const std::string &address, bool sweep=false);
 
+    /**
+     * Begins watching several addresses at once,
+     * waking the updater just one time.
+     */
+    void
+    insert(const AddressSet &addresses);
+
     /**
      * Begins checking the provided address at high speed.
      * Pass a blank address to cancel the priority polling.
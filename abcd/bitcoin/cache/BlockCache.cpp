@@ -101,7 +101,7 @@ BlockCache::save()
         }
         ABC_CHECK(json.headersSet(headersJson));
 
-        ABC_CHECK(json.save(path_));
+        ABC_CHECK(json.saveLater(path_));
         dirty_ = false;
     }
 
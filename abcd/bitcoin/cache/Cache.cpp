@@ -6,7 +6,7 @@
  */
 
 #include "Cache.hpp"
-#include "../../json/JsonObject.hpp"
+#include "CacheJson.hpp"
 #include "../../util/FileIO.hpp"
 
 namespace abcd {
@@ -35,9 +35,9 @@ Cache::clear()
 Status
 Cache::load()
 {
-    JsonObject cacheJson;
+    CacheJson cacheJson;
     servers.load();
-    ABC_CHECK(cacheJson.load(path_));
+    ABC_CHECK(jsonLoad(cacheJson, path_));
     ABC_CHECK(txs.load(cacheJson));
     ABC_CHECK(addresses.load(cacheJson));
     addressCheckDoneLoad(cacheJson);
@@ -57,15 +57,15 @@ Cache::addressCheckDoneGet()
 }
 
 void
-Cache::addressCheckDoneLoad(JsonObject &json)
+Cache::addressCheckDoneLoad(const CacheJson &json)
 {
-    addressCheckDone_ = json.getBoolean("addressCheckDone", false);
+    addressCheckDone_ = json.addressCheckDone;
 }
 
-Status
-Cache::addressCheckDoneSave(JsonObject &json)
+void
+Cache::addressCheckDoneSave(CacheJson &json)
 {
-    return json.set("addressCheckDone", addressCheckDone_);
+    json.addressCheckDone = addressCheckDone_;
 }
 
 Status
@@ -148,11 +148,11 @@ Cache::loadLegacy(const std::string &path)
 Status
 Cache::save()
 {
-    JsonObject cacheJson;
+    CacheJson cacheJson;
     ABC_CHECK(txs.save(cacheJson));
     ABC_CHECK(addresses.save(cacheJson));
-    ABC_CHECK(addressCheckDoneSave(cacheJson));
-    ABC_CHECK(cacheJson.save(path_));
+    addressCheckDoneSave(cacheJson);
+    ABC_CHECK(fileSaveLater(jsonEncode(cacheJson), path_));
     return Status();
 }
 
@@ -71,14 +71,14 @@ private:
     /**
      * Save the status of addressCheckDone in the cache
      */
-    Status
-    addressCheckDoneSave(JsonObject &json);
+    void
+    addressCheckDoneSave(CacheJson &json);
 
     /**
      * Load the status of addressCheckDone from the cache
      */
     void
-    addressCheckDoneLoad(JsonObject &json);
+    addressCheckDoneLoad(const CacheJson &json);
 
     const std::string path_;
     bool addressCheckDone_;
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "CacheJson.hpp"
+
+namespace abcd {
+
+ABC_JSON_SCHEMA(CacheTxJson,
+                ABC_JSON_FIELD(CacheTxJson, data, "data"),
+                ABC_JSON_FIELD(CacheTxJson, txid, "txid"));
+
+ABC_JSON_SCHEMA(CacheHeightJson,
+                ABC_JSON_FIELD(CacheHeightJson, firstSeen, "firstSeen"),
+                ABC_JSON_FIELD_OPTIONAL(CacheHeightJson, height, "height"),
+                ABC_JSON_FIELD(CacheHeightJson, txid, "txid"));
+
+ABC_JSON_SCHEMA(CacheAddressJson,
+                ABC_JSON_FIELD(CacheAddressJson, address, "address"),
+                ABC_JSON_FIELD_OPTIONAL(CacheAddressJson, dirty, "dirty"),
+                ABC_JSON_FIELD(CacheAddressJson, lastCheck, "lastCheck"),
+                ABC_JSON_FIELD_OPTIONAL(CacheAddressJson, stratumHash,
+                                        "stratumHash"),
+                ABC_JSON_FIELD(CacheAddressJson, txids, "txids"));
+
+ABC_JSON_SCHEMA(CacheJson,
+                ABC_JSON_FIELD(CacheJson, addressCheckDone, "addressCheckDone"),
+                ABC_JSON_FIELD(CacheJson, addresses, "addresses"),
+                ABC_JSON_FIELD(CacheJson, heights, "heights"),
+                ABC_JSON_FIELD(CacheJson, txs, "txs"));
+
+} // namespace abcd
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * The on-disk format of the wallet cache file.
+ */
+
+#ifndef ABCD_BITCOIN_CACHE_CACHE_JSON_HPP
+#define ABCD_BITCOIN_CACHE_CACHE_JSON_HPP
+
+#include "../../json/JsonCodec.hpp"
+
+namespace abcd {
+
+struct CacheTxJson
+{
+    std::string data;
+    std::string txid;
+
+    static const JsonSchema<CacheTxJson> schema;
+};
+
+struct CacheHeightJson
+{
+    int64_t firstSeen = 0;
+    int64_t height = 0;
+    std::string txid;
+
+    static const JsonSchema<CacheHeightJson> schema;
+};
+
+struct CacheAddressJson
+{
+    std::string address;
+    bool dirty = false;
+    int64_t lastCheck = 0;
+    std::string stratumHash;
+    std::vector<std::string> txids;
+
+    static const JsonSchema<CacheAddressJson> schema;
+};
+
+/**
+ * The whole cache file.
+ * This is saved often, so it uses the `JsonCodec` rather than `JsonObject`.
+ */
+struct CacheJson
+{
+    bool addressCheckDone = false;
+    std::vector<CacheAddressJson> addresses;
+    std::vector<CacheHeightJson> heights;
+    std::vector<CacheTxJson> txs;
+
+    static const JsonSchema<CacheJson> schema;
+};
+
+} // namespace abcd
+
+#endif
@@ -196,7 +196,7 @@ ServerCache::save_nolock()
                 ABC_DebugLevel(2, "ServerCache::save %d %d ms %s",
                                serverInfo.score, serverInfo.responseTime, serverInfo.serverUrl.c_str())
             }
-            ABC_CHECK(serverScoresJsonArray.save(path_));
+            ABC_CHECK(serverScoresJsonArray.saveLater(path_));
             dirty_ = false;
         }
         else
@@ -7,10 +7,9 @@
 
 #include "TxCache.hpp"
 #include "BlockCache.hpp"
+#include "CacheJson.hpp"
 #include "../Utility.hpp"
 #include "../../crypto/Encoding.hpp"
-#include "../../json/JsonArray.hpp"
-#include "../../json/JsonObject.hpp"
 #include "../../util/Debug.hpp"
 #include <unordered_set>
 
@@ -134,35 +133,6 @@ private:
     std::map<std::string, unsigned> visited_;
 };
 
-struct CacheJson:
-    public JsonObject
-{
-    ABC_JSON_CONSTRUCTORS(CacheJson, JsonObject)
-
-    ABC_JSON_VALUE(txs, "txs", JsonArray)
-    ABC_JSON_VALUE(heights, "heights", JsonArray)
-};
-
-struct TxJson:
-    public JsonObject
-{
-    ABC_JSON_CONSTRUCTORS(TxJson, JsonObject)
-
-    ABC_JSON_STRING(txid, "txid", 0)
-    ABC_JSON_STRING(data, "data", 0)
-};
-
-struct HeightJson:
-    public JsonObject
-{
-    ABC_JSON_CONSTRUCTORS(HeightJson, JsonObject)
-
-    ABC_JSON_STRING(txid, "txid", 0)
-    ABC_JSON_INTEGER(height, "height", 0)
-    ABC_JSON_INTEGER(firstSeen, "firstSeen", 0)
-};
-
-
 TxCache::TxCache(BlockCache &blockCache):
     blocks_(blockCache)
 {
@@ -177,40 +147,33 @@ TxCache::clear()
 }
 
 Status
-TxCache::load(JsonObject &json)
+TxCache::load(const CacheJson &json)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    CacheJson cacheJson(json);
 
     // Tx data:
-    auto txsJson = cacheJson.txs();
-    size_t txsSize = txsJson.size();
-    for (size_t i = 0; i < txsSize; i++)
+    for (const auto &txJson: json.txs)
     {
-        TxJson txJson(txsJson[i]);
-        if (txJson.txidOk() && txJson.dataOk())
+        if (!txJson.txid.empty() && !txJson.data.empty())
         {
             DataChunk rawTx;
-            ABC_CHECK(base64Decode(rawTx, txJson.data()));
+            ABC_CHECK(base64Decode(rawTx, txJson.data));
             bc::transaction_type tx;
             ABC_CHECK(decodeTx(tx, rawTx));
 
-            txs_[txJson.txid()] = std::move(tx);
+            txs_[txJson.txid] = std::move(tx);
         }
     }
 
     // Heights:
-    auto heightsJson = cacheJson.heights();
-    size_t heightsSize = heightsJson.size();
-    for (size_t i = 0; i < heightsSize; i++)
+    for (const auto &heightJson: json.heights)
     {
-        HeightJson heightJson(heightsJson[i]);
-        if (heightJson.txidOk())
+        if (!heightJson.txid.empty())
         {
             HeightInfo info;
-            info.height = heightJson.height();
-            info.firstSeen = heightJson.firstSeen();
-            heights_[heightJson.txid()] = info;
+            info.height = heightJson.height;
+            info.firstSeen = heightJson.firstSeen;
+            heights_[heightJson.txid] = info;
             blocks_.headerNeededAdd(info.height);
         }
     }
@@ -219,37 +182,35 @@ TxCache::load(JsonObject &json)
 }
 
 Status
-TxCache::save(JsonObject &json)
+TxCache::save(CacheJson &json)
 {
     std::lock_guard<std::mutex> lock(mutex_);
-    CacheJson cacheJson(json);
 
     // Tx data:
-    JsonArray txsJson;
+    json.txs.clear();
+    json.txs.reserve(txs_.size());
     for (const auto &tx: txs_)
     {
         bc::data_chunk rawTx(satoshi_raw_size(tx.second));
         bc::satoshi_save(tx.second, rawTx.begin());
 
-        TxJson txJson;
-        ABC_CHECK(txJson.txidSet(tx.first));
-        ABC_CHECK(txJson.dataSet(base64Encode(rawTx)));
-        ABC_CHECK(txsJson.append(txJson));
+        CacheTxJson txJson;
+        txJson.txid = tx.first;
+        txJson.data = base64Encode(rawTx);
+        json.txs.push_back(std::move(txJson));
     }
-    cacheJson.txsSet(txsJson);
 
     // Heights:
-    JsonArray heightsJson;
+    json.heights.clear();
+    json.heights.reserve(heights_.size());
     for (const auto &height: heights_)
     {
-        HeightJson heightJson;
-        ABC_CHECK(heightJson.txidSet(height.first));
-        if (height.second.height)
-            ABC_CHECK(heightJson.heightSet(height.second.height));
-        ABC_CHECK(heightJson.firstSeenSet(height.second.firstSeen));
-        ABC_CHECK(heightsJson.append(heightJson));
+        CacheHeightJson heightJson;
+        heightJson.txid = height.first;
+        heightJson.height = height.second.height;
+        heightJson.firstSeen = height.second.firstSeen;
+        json.heights.push_back(std::move(heightJson));
     }
-    cacheJson.heightsSet(heightsJson);
 
     return Status();
 }
@@ -267,6 +228,22 @@ TxCache::get(bc::transaction_type &result, const std::string &txid) const
     return Status();
 }
 
+Status
+TxCache::output(bc::transaction_output_type &result,
+                const bc::output_point &point) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto i = txs_.find(bc::encode_hash(point.hash));
+    if (txs_.end() == i)
+        return ABC_ERROR(ABC_CC_Synchronizing, "Cannot find transaction");
+    if (i->second.outputs.size() <= point.index)
+        return ABC_ERROR(ABC_CC_Error, "Output index out of range");
+
+    result = i->second.outputs[point.index];
+    return Status();
+}
+
 Status
 TxCache::info(TxInfo &result, const bc::transaction_type &tx) const
 {
@@ -284,6 +261,19 @@ TxCache::info(TxInfo &result, const std::string &txid) const
     return Status();
 }
 
+Status
+TxCache::ntxid(std::string &result, const std::string &txid) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto i = txs_.find(txid);
+    if (txs_.end() == i)
+        return ABC_ERROR(ABC_CC_Synchronizing, "Cannot find transaction");
+
+    result = bc::encode_hash(makeNtxid(i->second));
+    return Status();
+}
+
 Status
 TxCache::infoInternal(TxInfo &result, const bc::transaction_type &tx) const
 {
@@ -415,6 +405,29 @@ TxCache::statuses(const TxidSet &txids) const
     return out;
 }
 
+std::map<std::string, TxStatus>
+TxCache::statusMap(const TxidSet &txids) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, TxStatus> out;
+
+    TxGraph graph(*this);
+    for (const auto &txid: txids)
+    {
+        if (!txs_.count(txid))
+            continue;
+
+        TxStatus status;
+        status.height = txidHeight(txid);
+        const auto problems = graph.problems(txid);
+        status.isDoubleSpent = problems & TxGraph::doubleSpent;
+        status.isReplaceByFee = problems & TxGraph::replaceByFee;
+        out[txid] = status;
+    }
+
+    return out;
+}
+
 TxOutputList
 TxCache::utxos(const AddressSet &addresses) const
 {
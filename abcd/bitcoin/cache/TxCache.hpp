@@ -16,7 +16,7 @@
 namespace abcd {
 
 class BlockCache;
-class JsonObject;
+struct CacheJson;
 
 /**
  * An input or an output of a transaction.
@@ -93,16 +93,16 @@ public:
     clear();
 
     /**
-     * Reads the database contents from the provided cache JSON object.
+     * Reads the database contents from the provided cache file contents.
      */
     Status
-    load(JsonObject &json);
+    load(const CacheJson &json);
 
     /**
-     * Saves the database contents to the provided cache JSON object.
+     * Saves the database contents to the provided cache file contents.
      */
     Status
-    save(JsonObject &json);
+    save(CacheJson &json);
 
     // Queries ------------------------------------------------------------
 
@@ -112,6 +112,14 @@ public:
     Status
     get(bc::transaction_type &result, const std::string &txid) const;
 
+    /**
+     * Obtains a single output from the database,
+     * without copying the rest of its transaction.
+     */
+    Status
+    output(bc::transaction_output_type &result,
+           const bc::output_point &point) const;
+
     /**
      * Returns the input & output information for a loose transaction.
      */
@@ -124,6 +132,13 @@ public:
     Status
     info(TxInfo &result, const std::string &txid) const;
 
+    /**
+     * Looks up a transaction's normalized txid,
+     * without building its input & output information.
+     */
+    Status
+    ntxid(std::string &result, const std::string &txid) const;
+
     /**
      * Returns true if the transaction or its inputs
      * are missing from the cache.
@@ -152,6 +167,13 @@ public:
     std::list<std::pair<TxInfo, TxStatus> >
     statuses(const TxidSet &txids) const;
 
+    /**
+     * Like `statuses`, but skips building the input & output information.
+     * Skips missing txids.
+     */
+    std::map<std::string, TxStatus>
+    statusMap(const TxidSet &txids) const;
+
     /**
      * Get just the utxos corresponding to a set of addresses.
      */
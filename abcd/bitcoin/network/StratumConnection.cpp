@@ -10,6 +10,7 @@
 #include "../../crypto/Encoding.hpp"
 #include "../../http/Uri.hpp"
 #include "../../json/JsonArray.hpp"
+#include "../../json/JsonCodec.hpp"
 #include "../../json/JsonObject.hpp"
 #include "../../util/Debug.hpp"
 #include <algorithm>
@@ -27,31 +28,62 @@ struct RequestJson:
     ABC_JSON_VALUE(params, "params", JsonArray);
 };
 
-struct HeaderJson:
-    public JsonObject
+struct HeaderJson
 {
-    ABC_JSON_CONSTRUCTORS(HeaderJson, JsonObject)
-
-    ABC_JSON_INTEGER(nonce, "nonce", 0);
-    ABC_JSON_STRING(prev_block_hash, "prev_block_hash", "");
-    ABC_JSON_INTEGER(timestamp, "timestamp", 0);
-    ABC_JSON_STRING(merkle_root, "merkle_root", "");
-    ABC_JSON_INTEGER(block_height, "block_height", 0);
-    ABC_JSON_INTEGER(version, "version", 0);
-    ABC_JSON_INTEGER(bits, "bits", 0);
+    int64_t bits = 0;
+    int64_t block_height = 0;
+    std::string merkle_root;
+    int64_t nonce = 0;
+    std::string prev_block_hash;
+    int64_t timestamp = 0;
+    int64_t version = 0;
+
+    static const JsonSchema<HeaderJson> schema;
 };
 
-struct ReplyJson:
-    public JsonObject
+ABC_JSON_SCHEMA(HeaderJson,
+                ABC_JSON_FIELD(HeaderJson, bits, "bits"),
+                ABC_JSON_FIELD(HeaderJson, block_height, "block_height"),
+                ABC_JSON_FIELD(HeaderJson, merkle_root, "merkle_root"),
+                ABC_JSON_FIELD(HeaderJson, nonce, "nonce"),
+                ABC_JSON_FIELD(HeaderJson, prev_block_hash, "prev_block_hash"),
+                ABC_JSON_FIELD(HeaderJson, timestamp, "timestamp"),
+                ABC_JSON_FIELD(HeaderJson, version, "version"));
+
+struct HistoryJson
 {
-    ABC_JSON_INTEGER(id, "id", 0)
-    ABC_JSON_VALUE(result, "result", JsonPtr);
+    int64_t height = 0;
+    std::string txid;
+
+    static const JsonSchema<HistoryJson> schema;
+};
+
+ABC_JSON_SCHEMA(HistoryJson,
+                ABC_JSON_FIELD(HistoryJson, height, "height"),
+                ABC_JSON_FIELD(HistoryJson, txid, "tx_hash"));
+
+/**
+ * Every message from the server.
+ * The result stays as raw text until we know which decoder it belongs to.
+ */
+struct ReplyJson
+{
+    int64_t id = -1; // Our ids count up from 0, so this means "no id"
+    JsonRaw result;
 
     // Only used on subscription updates:
-    ABC_JSON_STRING(method, "method", "");
-    ABC_JSON_VALUE(params, "params", JsonArray);
+    std::string method;
+    JsonRaw params;
+
+    static const JsonSchema<ReplyJson> schema;
 };
 
+ABC_JSON_SCHEMA(ReplyJson,
+                ABC_JSON_FIELD(ReplyJson, id, "id"),
+                ABC_JSON_FIELD(ReplyJson, method, "method"),
+                ABC_JSON_FIELD(ReplyJson, params, "params"),
+                ABC_JSON_FIELD(ReplyJson, result, "result"));
+
 StratumConnection::~StratumConnection()
 {
     for (auto &i: pending_)
@@ -66,12 +98,13 @@ StratumConnection::version(const StatusCallback &onError,
     params.append(json_string("2.5.4")); // Our version
     params.append(json_string("0.10")); // Protocol version
 
-    auto decoder = [onReply](JsonPtr payload) -> Status
+    auto decoder = [onReply](JsonRaw payload) -> Status
     {
-        if (!json_is_string(payload.get()))
+        std::string version;
+        if (!jsonDecode(version, payload))
             return ABC_ERROR(ABC_CC_JSONError, "Bad reply format");
 
-        onReply(json_string_value(payload.get()));
+        onReply(version);
         return Status();
     };
 
@@ -86,12 +119,13 @@ StratumConnection::feeEstimateFetch(const StatusCallback &onError,
     JsonArray params;
     params.append(json_integer(blocks));
 
-    auto decoder = [onReply](JsonPtr payload) -> Status
+    auto decoder = [onReply](JsonRaw payload) -> Status
     {
-        if (!json_is_number(payload.get()))
+        double fee;
+        if (!jsonDecode(fee, payload))
             return ABC_ERROR(ABC_CC_JSONError, "Bad reply format");
 
-        onReply(json_number_value(payload.get()));
+        onReply(fee);
         return Status();
     };
 
@@ -105,12 +139,12 @@ StratumConnection::sendTx(const StatusCallback &onDone, DataSlice tx)
     params.append(json_string(base16Encode(tx).c_str()));
 
     const auto hash = bc::encode_hash(bc::bitcoin_hash(tx));
-    auto decoder = [onDone, hash](JsonPtr payload) -> Status
+    auto decoder = [onDone, hash](JsonRaw payload) -> Status
     {
-        if (!json_is_string(payload.get()))
+        std::string message;
+        if (!jsonDecode(message, payload))
             return ABC_ERROR(ABC_CC_Error, "Bad reply format");
 
-        const auto message = json_string_value(payload.get());
         if (message != hash)
             return ABC_ERROR(ABC_CC_Error, message);
 
@@ -215,12 +249,13 @@ StratumConnection::heightSubscribe(const StatusCallback &onError,
     JsonPtr params;
     heightCallback_ = onReply;
 
-    auto decoder = [onReply](JsonPtr payload) -> Status
+    auto decoder = [onReply](JsonRaw payload) -> Status
     {
-        if (!json_is_number(payload.get()))
+        double height;
+        if (!jsonDecode(height, payload))
             return ABC_ERROR(ABC_CC_Error, "Bad reply format");
 
-        onReply(json_number_value(payload.get()));
+        onReply(height);
         return Status();
     };
 
@@ -246,11 +281,12 @@ StratumConnection::addressSubscribe(const StatusCallback &onError,
         onError(s);
     };
 
-    auto decoder = [onReply](JsonPtr payload) -> Status
+    auto decoder = [onReply](JsonRaw payload) -> Status
     {
+        // A null hash means the address has no history:
         std::string stateHash;
-        if (json_is_string(payload.get()))
-            stateHash = json_string_value(payload.get());
+        if (!jsonDecode(stateHash, payload))
+            stateHash.clear();
 
         onReply(stateHash);
         return Status();
@@ -273,33 +309,25 @@ StratumConnection::addressHistoryFetch(const StatusCallback &onError,
     JsonArray params;
     params.append(json_string(address.c_str()));
 
-    auto decoder = [onReply](JsonPtr payload) -> Status
+    auto decoder = [onReply](JsonRaw payload) -> Status
     {
-        JsonArray arrayJson(payload);
+        std::vector<HistoryJson> arrayJson;
+        if (!jsonDecode(arrayJson, payload))
+            return ABC_ERROR(ABC_CC_Error, "Bad reply format");
 
         AddressHistory history;
-        size_t size = arrayJson.size();
-        for (size_t i = 0; i < size; i++)
+        for (const auto &json: arrayJson)
         {
-            struct HistoryJson:
-                public JsonObject
-            {
-                ABC_JSON_CONSTRUCTORS(HistoryJson, JsonObject)
-                ABC_JSON_STRING(txid, "tx_hash", nullptr)
-                ABC_JSON_INTEGER(height, "height", 0)
-            };
-            HistoryJson json(arrayJson[i]);
-
-            if (!json.txidOk())
+            if (json.txid.empty())
                 return ABC_ERROR(ABC_CC_Error, "Missing txid");
 
-            if (json.heightOk() && json.height() >= 0)
+            if (json.height >= 0)
             {
-                history[json.txid()] = json.height();
+                history[json.txid] = json.height;
             }
             else
             {
-                history[json.txid()] = 0;
+                history[json.txid] = 0;
             }
         }
 
@@ -318,13 +346,14 @@ StratumConnection::txDataFetch(const StatusCallback &onError,
     JsonArray params;
     params.append(json_string(txid.c_str()));
 
-    auto decoder = [onReply](JsonPtr payload) -> Status
+    auto decoder = [onReply](JsonRaw payload) -> Status
     {
-        if (!json_is_string(payload.get()))
+        std::string hex;
+        if (!jsonDecode(hex, payload))
             return ABC_ERROR(ABC_CC_JSONError, "Bad reply format");
 
         DataChunk rawTx;
-        if (!base16Decode(rawTx, json_string_value(payload.get())))
+        if (!base16Decode(rawTx, hex))
             return ABC_ERROR(ABC_CC_ParseError, "Bad transaction format");
         bc::transaction_type tx;
         ABC_CHECK(decodeTx(tx, rawTx));
@@ -344,24 +373,26 @@ StratumConnection::blockHeaderFetch(const StatusCallback &onError,
     JsonArray params;
     params.append(json_integer(height));
 
-    auto decoder = [onReply](JsonPtr payload) -> Status
+    auto decoder = [onReply](JsonRaw payload) -> Status
     {
-        HeaderJson headerJson(payload);
+        HeaderJson headerJson;
+        if (!jsonDecode(headerJson, payload))
+            return ABC_ERROR(ABC_CC_JSONError, "Bad reply format");
 
         bc::hash_digest previous_block_hash;
         bc::hash_digest merkle;
-        if (!bc::decode_hash(previous_block_hash, headerJson.prev_block_hash()))
+        if (!bc::decode_hash(previous_block_hash, headerJson.prev_block_hash))
             return ABC_ERROR(ABC_CC_ParseError, "Bad hash");
-        if (!bc::decode_hash(merkle, headerJson.merkle_root()))
+        if (!bc::decode_hash(merkle, headerJson.merkle_root))
             return ABC_ERROR(ABC_CC_ParseError, "Bad hash");
 
         bc::block_header_type header;
         header.previous_block_hash = previous_block_hash;
         header.merkle = merkle;
-        header.version = headerJson.version();
-        header.timestamp = headerJson.timestamp();
-        header.bits = headerJson.bits();
-        header.nonce = headerJson.nonce();
+        header.version = headerJson.version;
+        header.timestamp = headerJson.timestamp;
+        header.bits = headerJson.bits;
+        header.nonce = headerJson.nonce;
 
         onReply(header);
         return Status();
@@ -398,13 +429,13 @@ Status
 StratumConnection::handleMessage(const std::string &message)
 {
     ReplyJson json;
-    ABC_CHECK(json.decode(message));
-    if (json.idOk())
+    ABC_CHECK(jsonDecode(json, message));
+    if (0 <= json.id)
     {
-        auto i = pending_.find(json.id());
+        auto i = pending_.find(json.id);
         if (pending_.end() != i)
         {
-            auto s = i->second.decoder(json.result());
+            auto s = i->second.decoder(json.result);
             if (!s)
                 i->second.onError(s);
             pending_.erase(i);
@@ -418,25 +449,18 @@ StratumConnection::handleMessage(const std::string &message)
     else
     {
         // Handle subscription updates:
-        std::string method = json.method();
-        auto params = json.params();
+        const auto &method = json.method;
+        std::vector<JsonRaw> params;
+        if (!jsonDecode(params, json.params))
+            params.clear();
 
         if ("blockchain.numblocks.subscribe" == method)
         {
-            size_t height;
-            if (params.ok() && 1 <= params.size()
-                    && json_is_number(params[0].get()))
-            {
-                height = json_integer_value(params[0].get());
-            }
-            else if (json_is_number(params.get()))
+            int64_t height;
+            if (!(1 <= params.size() && jsonDecode(height, params[0])) &&
+                    !jsonDecode(height, json.params))
             {
-                height = json_integer_value(params.get());
-            }
-            else
-            {
-                return ABC_ERROR(ABC_CC_Error,
-                                 "Bad reply format" + json.encode());
+                return ABC_ERROR(ABC_CC_Error, "Bad reply format" + message);
             }
 
             if (heightCallback_)
@@ -446,17 +470,10 @@ StratumConnection::handleMessage(const std::string &message)
         {
             std::string address;
             std::string stateHash;
-            if (params.ok() && 2 <= params.size()
-                    && json_is_string(params[0].get())
-                    && json_is_string(params[1].get()))
-            {
-                address = json_string_value(params[0].get());
-                stateHash = json_string_value(params[1].get());
-            }
-            else
+            if (!(2 <= params.size() && jsonDecode(address, params[0]) &&
+                    jsonDecode(stateHash, params[1])))
             {
-                return ABC_ERROR(ABC_CC_Error,
-                                 "Bad reply format" + json.encode());
+                return ABC_ERROR(ABC_CC_Error, "Bad reply format" + message);
             }
 
             const auto i = addressCallbacks_.find(address);
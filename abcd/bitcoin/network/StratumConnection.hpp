@@ -16,6 +16,7 @@
 namespace abcd {
 
 class JsonPtr;
+struct JsonRaw;
 typedef std::chrono::milliseconds SleepTime;
 
 // Scheme used for stratum URI's:
@@ -106,7 +107,7 @@ public:
                      size_t height) override;
 
 private:
-    typedef std::function<Status (JsonPtr payload)> Decoder;
+    typedef std::function<Status (JsonRaw payload)> Decoder;
 
     // Socket:
     std::string uri_;
@@ -11,9 +11,12 @@
 #include "../json/JsonPtr.hpp"
 #include "../util/Util.hpp"
 #include <bitcoin/bitcoin.hpp> // wow! such slow, very compile time
+#include <openssl/crypto.h>
 #include <openssl/evp.h>
 #include <openssl/err.h>
 #include <openssl/sha.h>
+#include <string.h>
+#include <algorithm>
 
 namespace abcd {
 
@@ -21,18 +24,8 @@ namespace abcd {
 #define JSON_ENC_IV_FIELD       "iv_hex"
 #define JSON_ENC_DATA_FIELD     "data_base64"
 
-static
-tABC_CC ABC_CryptoEncryptAES256(const tABC_U08Buf Data,
-                                const tABC_U08Buf Key,
-                                const tABC_U08Buf IV,
-                                tABC_U08Buf       *pEncData,
-                                tABC_Error        *pError);
-static
-tABC_CC ABC_CryptoDecryptAES256(const tABC_U08Buf EncData,
-                                const tABC_U08Buf Key,
-                                const tABC_U08Buf IV,
-                                tABC_U08Buf       *pData,
-                                tABC_Error        *pError);
+// Small enough for each chunk to stay in cache between hashing and AES:
+constexpr size_t cryptoChunkSize = 64 * 1024;
 
 /**
  * A constant-time alternative to memcmp.
@@ -62,120 +55,40 @@ cryptoFilename(DataSlice key, const std::string &name)
 }
 
 /**
- * Creates an encrypted aes256 package that includes data, random header/footer and sha256
- * Package format:
- *   1 byte:     h (the number of random header bytes)
- *   h bytes:    h random header bytes
- *   4 bytes:    length of data (big endian)
- *   x bytes:    data (x bytes)
- *   1 byte:     f (the number of random footer bytes)
- *   f bytes:    f random header bytes
- *   32 bytes:   32 bytes SHA256 of all data up to this point
+ * Owns an OpenSSL cipher context.
  */
-tABC_CC ABC_CryptoEncryptAES256Package(DataSlice         Data,
-                                       DataSlice         Key,
-                                       tABC_U08Buf       *pEncData,
-                                       DataChunk         &IV,
-                                       tABC_Error        *pError)
+struct CipherContext
 {
-    tABC_CC cc = ABC_CC_Ok;
-    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
+    EVP_CIPHER_CTX *ctx;
 
-    DataChunk headerData;
-    DataChunk footerData;
-    AutoU08Buf UnencryptedData;
-    unsigned char nRandomHeaderBytes;
-    unsigned char nRandomFooterBytes;
-    unsigned long totalSizeUnencrypted = 0;
-    unsigned char *pCurUnencryptedData = NULL;
-    unsigned char nSizeByte = 0;
-    unsigned char sha256Output[SHA256_DIGEST_LENGTH];
-
-    ABC_CHECK_NULL(pEncData);
-
-    // create a random IV
-    ABC_CHECK_NEW(randomData(IV, AES_256_IV_LENGTH));
+    CipherContext(): ctx(EVP_CIPHER_CTX_new()) {}
+    ~CipherContext() { EVP_CIPHER_CTX_free(ctx); }
+};
 
-    // create a random number of header bytes 0-255
-    {
-        DataChunk r;
-        ABC_CHECK_NEW(randomData(r, 1));
-        nRandomHeaderBytes = r[0] & 0x0f;
-    }
-    //printf("rand header count: %d\n", nRandomHeaderBytes);
-    ABC_CHECK_NEW(randomData(headerData, nRandomHeaderBytes));
-
-    // create a random number of footer bytes 0-255
-    {
-        DataChunk r;
-        ABC_CHECK_NEW(randomData(r, 1));
-        nRandomFooterBytes = r[0] & 0x0f;
-    }
-    //printf("rand footer count: %d\n", nRandomFooterBytes);
-    ABC_CHECK_NEW(randomData(footerData, nRandomFooterBytes));
-
-    // calculate the size of our unencrypted buffer
-    totalSizeUnencrypted += 1; // header count
-    totalSizeUnencrypted += nRandomHeaderBytes; // header
-    totalSizeUnencrypted += 4; // space to hold data size
-    totalSizeUnencrypted += Data.size(); // data
-    totalSizeUnencrypted += 1; // footer count
-    totalSizeUnencrypted += nRandomFooterBytes; // footer
-    totalSizeUnencrypted += SHA256_DIGEST_LENGTH; // sha256
-    //printf("total size unencrypted: %lu\n", (unsigned long) totalSizeUnencrypted);
-
-    // allocate the unencrypted buffer
-    ABC_BUF_NEW(UnencryptedData, totalSizeUnencrypted);
-    pCurUnencryptedData = UnencryptedData.data();
-
-    // add the random header count and bytes
-    memcpy(pCurUnencryptedData, &nRandomHeaderBytes, 1);
-    pCurUnencryptedData += 1;
-    memcpy(pCurUnencryptedData, headerData.data(), headerData.size());
-    pCurUnencryptedData += nRandomHeaderBytes;
-
-    // add the size of the data
-    nSizeByte = (Data.size() >> 24) & 0xff;
-    memcpy(pCurUnencryptedData, &nSizeByte, 1);
-    pCurUnencryptedData += 1;
-    nSizeByte = (Data.size() >> 16) & 0xff;
-    memcpy(pCurUnencryptedData, &nSizeByte, 1);
-    pCurUnencryptedData += 1;
-    nSizeByte = (Data.size() >> 8) & 0xff;
-    memcpy(pCurUnencryptedData, &nSizeByte, 1);
-    pCurUnencryptedData += 1;
-    nSizeByte = (Data.size() >> 0) & 0xff;
-    memcpy(pCurUnencryptedData, &nSizeByte, 1);
-    pCurUnencryptedData += 1;
-
-    // add the data
-    memcpy(pCurUnencryptedData, Data.data(), Data.size());
-    pCurUnencryptedData += Data.size();
-
-    // add the random footer count and bytes
-    memcpy(pCurUnencryptedData, &nRandomFooterBytes, 1);
-    pCurUnencryptedData += 1;
-    memcpy(pCurUnencryptedData, footerData.data(), footerData.size());
-    pCurUnencryptedData += nRandomFooterBytes;
-
-    // add the sha256
-    SHA256(UnencryptedData.data(), totalSizeUnencrypted - SHA256_DIGEST_LENGTH,
-           sha256Output);
-    memcpy(pCurUnencryptedData, sha256Output, SHA256_DIGEST_LENGTH);
-    pCurUnencryptedData += SHA256_DIGEST_LENGTH;
-
-    // encrypted our new unencrypted package
-    ABC_CHECK_RET(ABC_CryptoEncryptAES256(UnencryptedData, Key, U08Buf(IV),
-                                          pEncData, pError));
-
-exit:
-    return cc;
+/**
+ * Zero-pads or truncates the key and IV to their AES256 sizes,
+ * then sets up the context.
+ */
+static Status
+cryptoCipherInit(CipherContext &c, DataSlice key, DataSlice iv, bool encrypt)
+{
+    unsigned char aKey[AES_256_KEY_LENGTH] = {0};
+    unsigned char aIV[AES_256_IV_LENGTH] = {0};
+    memcpy(aKey, key.data(), std::min(key.size(), sizeof(aKey)));
+    memcpy(aIV, iv.data(), std::min(iv.size(), sizeof(aIV)));
+
+    int ok = c.ctx && EVP_CipherInit_ex(c.ctx, EVP_aes_256_cbc(), nullptr,
+                                        aKey, aIV, encrypt);
+    OPENSSL_cleanse(aKey, sizeof(aKey));
+    if (!ok)
+        return ABC_ERROR(encrypt ? ABC_CC_EncryptError : ABC_CC_DecryptFailure,
+                         "Cannot set up AES256");
+
+    return Status();
 }
 
 /**
- * Decrypts an encrypted aes256 package which includes data, random header/footer and sha256
- * Note: it is critical that this function returns ABC_CC_DecryptFailure if there is an issue
- *       because code is counting on this specific error to know a key is bad
+ * Creates an encrypted aes256 package that includes data, random header/footer and sha256
  * Package format:
  *   1 byte:     h (the number of random header bytes)
  *   h bytes:    h random header bytes
@@ -184,232 +97,194 @@ exit:
  *   1 byte:     f (the number of random footer bytes)
  *   f bytes:    f random header bytes
  *   32 bytes:   32 bytes SHA256 of all data up to this point
+ *
+ * The package is never assembled in memory.
+ * Instead, each piece is hashed and encrypted as it goes by,
+ * with the data itself fed through in cache-sized chunks.
  */
-tABC_CC ABC_CryptoDecryptAES256Package(DataChunk &result,
-                                       DataSlice EncData,
-                                       DataSlice Key,
-                                       DataSlice IV,
-                                       tABC_Error *pError)
+Status
+cryptoEncryptPackage(DataChunk &result, DataChunk &iv,
+                     DataSlice data, DataSlice key)
 {
-    tABC_CC cc = ABC_CC_Ok;
-    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
-
-    AutoU08Buf Data;
-    unsigned char headerLength;
-    unsigned int minSize;
-    unsigned char *pDataLengthPos;
-    unsigned int dataSecLength;
-    unsigned char footerLength;
-    unsigned int shaCheckLength;
-    unsigned char *pSHALoc;
-    unsigned char sha256Output[SHA256_DIGEST_LENGTH];
-    unsigned char *pFinalDataPos;
+    if (0xffffffff < data.size())
+        return ABC_ERROR(ABC_CC_EncryptError, "Data is too large to encrypt");
 
-    // start by decrypting the pacakge
-    if (ABC_CC_Ok != ABC_CryptoDecryptAES256(EncData, Key, IV, &Data, pError))
+    // create a random IV
+    DataChunk newIv;
+    ABC_CHECK(randomData(newIv, AES_256_IV_LENGTH));
+
+    // create random header and footer bytes, 0-15 of each
+    DataChunk lengths;
+    ABC_CHECK(randomData(lengths, 2));
+    const unsigned char nRandomHeaderBytes = lengths[0] & 0x0f;
+    const unsigned char nRandomFooterBytes = lengths[1] & 0x0f;
+    DataChunk headerData;
+    DataChunk footerData;
+    ABC_CHECK(randomData(headerData, nRandomHeaderBytes));
+    ABC_CHECK(randomData(footerData, nRandomFooterBytes));
+
+    // the pieces before and after the data
+    DataChunk prefix;
+    prefix.push_back(nRandomHeaderBytes);
+    prefix.insert(prefix.end(), headerData.begin(), headerData.end());
+    prefix.push_back((data.size() >> 24) & 0xff);
+    prefix.push_back((data.size() >> 16) & 0xff);
+    prefix.push_back((data.size() >> 8) & 0xff);
+    prefix.push_back((data.size() >> 0) & 0xff);
+    DataChunk suffix;
+    suffix.push_back(nRandomFooterBytes);
+    suffix.insert(suffix.end(), footerData.begin(), footerData.end());
+
+    // the output is the padded package size, known up front
+    const size_t totalSize = prefix.size() + data.size() + suffix.size() +
+                             SHA256_DIGEST_LENGTH;
+    DataChunk out((totalSize / AES_256_BLOCK_LENGTH + 1) *
+                  AES_256_BLOCK_LENGTH);
+    size_t used = 0;
+
+    CipherContext c;
+    ABC_CHECK(cryptoCipherInit(c, key, newIv, true));
+    SHA256_CTX sha;
+    SHA256_Init(&sha);
+
+    auto feed = [&](const unsigned char *p, size_t size, bool hash) -> Status
     {
-        cc = ABC_CC_DecryptFailure;
-        if (pError)
+        while (size)
         {
-            pError->code = cc;
+            const int chunk = std::min<size_t>(size, cryptoChunkSize);
+            if (hash)
+                SHA256_Update(&sha, p, chunk);
+
+            int written = 0;
+            if (!EVP_EncryptUpdate(c.ctx, out.data() + used, &written, p, chunk))
+                return ABC_ERROR(ABC_CC_EncryptError, "AES256 encryption failed");
+            used += written;
+            p += chunk;
+            size -= chunk;
         }
-        goto exit;
-    }
-
-    // get the size of the random header section
-    headerLength = *Data.data();
-
-    // check that we have enough data based upon this info
-    minSize = 1 + headerLength + 4 + 1 + 1 +
-              SHA256_DIGEST_LENGTH; // decrypted package must be at least this big
-    ABC_CHECK_ASSERT(Data.size() >= minSize, ABC_CC_DecryptFailure,
-                     "Decrypted data is not long enough");
-
-    // get the size of the data section
-    pDataLengthPos = Data.data() + (1 + headerLength);
-    dataSecLength = ((unsigned int) *pDataLengthPos) << 24;
-    pDataLengthPos++;
-    dataSecLength += ((unsigned int) *pDataLengthPos) << 16;
-    pDataLengthPos++;
-    dataSecLength += ((unsigned int) *pDataLengthPos) << 8;
-    pDataLengthPos++;
-    dataSecLength += ((unsigned int) *pDataLengthPos);
-
-    // check that we have enough data based upon this info
-    minSize = 1 + headerLength + 4 + dataSecLength + 1 +
-              SHA256_DIGEST_LENGTH; // decrypted package must be at least this big
-    ABC_CHECK_ASSERT(Data.size() >= minSize, ABC_CC_DecryptFailure,
-                     "Decrypted data is not long enough");
-
-    // get the size of the random footer section
-    footerLength = *(Data.data() + 1 + headerLength + 4 + dataSecLength);
-
-    // check that we have enough data based upon this info
-    minSize = 1 + headerLength + 4 + dataSecLength + 1 + footerLength +
-              SHA256_DIGEST_LENGTH; // decrypted package must be at least this big
-    ABC_CHECK_ASSERT(Data.size() >= minSize, ABC_CC_DecryptFailure,
-                     "Decrypted data is not long enough");
-
-    // set up for the SHA check
-    shaCheckLength = 1 + headerLength + 4 + dataSecLength + 1 +
-                     footerLength; // all but the sha
-    pSHALoc = Data.data() + shaCheckLength;
-
-    // calc the sha256
-    SHA256(Data.data(), shaCheckLength, sha256Output);
+        return Status();
+    };
+    ABC_CHECK(feed(prefix.data(), prefix.size(), true));
+    ABC_CHECK(feed(data.data(), data.size(), true));
+    ABC_CHECK(feed(suffix.data(), suffix.size(), true));
 
-    // check the sha256
-    if (!cryptoCompare(pSHALoc, sha256Output, SHA256_DIGEST_LENGTH))
-    {
-        // this can be specifically used by the caller to possibly determine whether the key was incorrect
-        ABC_RET_ERROR(ABC_CC_DecryptFailure,
-                      "Decrypted data failed checksum (SHA) check");
-    }
-
-    // all is good, so create the final data
-    pFinalDataPos = Data.data() + 1 + headerLength + 4;
-    result = DataChunk(pFinalDataPos, pFinalDataPos + dataSecLength);
-
-exit:
-    return cc;
+    unsigned char sha256Output[SHA256_DIGEST_LENGTH];
+    SHA256_Final(sha256Output, &sha);
+    ABC_CHECK(feed(sha256Output, sizeof(sha256Output), false));
+
+    int written = 0;
+    if (!EVP_EncryptFinal_ex(c.ctx, out.data() + used, &written))
+        return ABC_ERROR(ABC_CC_EncryptError, "AES256 encryption failed");
+    used += written;
+    out.resize(used);
+
+    result = std::move(out);
+    iv = std::move(newIv);
+    return Status();
 }
 
 /**
- * Encrypts the given data with AES256
+ * Decrypts an encrypted aes256 package which includes data, random header/footer and sha256
+ * Note: it is critical that this function returns ABC_CC_DecryptFailure if there is an issue
+ *       because code is counting on this specific error to know a key is bad
+ * Package format: see `cryptoEncryptPackage`.
+ *
+ * The package is decrypted straight into the result buffer,
+ * with the checksum calculated over each chunk as it comes out.
+ * Once the checksum passes, the data is moved down over the header.
  */
-static
-tABC_CC ABC_CryptoEncryptAES256(const tABC_U08Buf Data,
-                                const tABC_U08Buf Key,
-                                const tABC_U08Buf IV,
-                                tABC_U08Buf       *pEncData,
-                                tABC_Error        *pError)
+Status
+cryptoDecryptPackage(DataChunk &result, DataSlice data,
+                     DataSlice key, DataSlice iv)
 {
-    tABC_CC cc = ABC_CC_Ok;
-    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
-
-    unsigned char aKey[AES_256_KEY_LENGTH];
-    unsigned int keyLength = Key.size();
-    unsigned char aIV[AES_256_IV_LENGTH];
-    unsigned int IVLength;
-    int c_len;
-    int f_len = 0;
-    unsigned char *pTmpEncData = NULL;
-
-    ABC_CHECK_NULL_BUF(Data);
-    ABC_CHECK_NULL_BUF(Key);
-    ABC_CHECK_NULL_BUF(IV);
-    ABC_CHECK_NULL(pEncData);
-
-    // create the final key
-    memset(aKey, 0, AES_256_KEY_LENGTH);
-    if (keyLength > AES_256_KEY_LENGTH)
-    {
-        keyLength = AES_256_KEY_LENGTH;
-    }
-    memcpy(aKey, Key.data(), keyLength);
-
-    // create the IV
-    memset(aIV, 0, AES_256_IV_LENGTH);
-    IVLength = IV.size();
-    if (IVLength > AES_256_IV_LENGTH)
+    if (data.empty())
+        return ABC_ERROR(ABC_CC_DecryptFailure, "No data to decrypt");
+
+    // because we have padding ON, we must allocate an extra cipher block
+    DataChunk out(data.size() + AES_256_BLOCK_LENGTH);
+    size_t used = 0;
+
+    CipherContext c;
+    ABC_CHECK(cryptoCipherInit(c, key, iv, false));
+    SHA256_CTX sha;
+    SHA256_Init(&sha);
+
+    // The checksum covers everything up to `shaEnd`,
+    // which is only known once the length fields have been decrypted:
+    size_t hashed = 0;
+    size_t headerLength = 0;
+    size_t dataLength = 0;
+    size_t shaEnd = 0;
+    bool knowData = false;
+    bool knowEnd = false;
+    auto advance = [&]()
     {
-        IVLength = AES_256_IV_LENGTH;
-    }
-    memcpy(aIV, IV.data(), IVLength);
-
-    // init our cipher text struct
-    EVP_CIPHER_CTX e_ctx;
-    EVP_CIPHER_CTX_init(&e_ctx);
-    EVP_EncryptInit_ex(&e_ctx, EVP_aes_256_cbc(), NULL, aKey, aIV);
-
-    // max ciphertext len for a n bytes of plaintext is n + AES_256_BLOCK_LENGTH -1 bytes
-    c_len = Data.size() + AES_256_BLOCK_LENGTH;
-    ABC_ARRAY_NEW(pTmpEncData, c_len, unsigned char);
-
-    // allows reusing of 'e' for multiple encryption cycles
-    EVP_EncryptInit_ex(&e_ctx, NULL, NULL, NULL, NULL);
-
-    // update pTmpEncData, c_len is filled with the length of pTmpEncData generated, dataLength is the size of plaintext in bytes
-    EVP_EncryptUpdate(&e_ctx, pTmpEncData, &c_len, Data.data(), Data.size());
-
-    // update pTmpEncData with the final remaining bytes
-    EVP_EncryptFinal_ex(&e_ctx, pTmpEncData + c_len, &f_len);
-
-    // set final values
-    *pEncData = U08Buf(pTmpEncData, c_len + f_len);
-
-    EVP_CIPHER_CTX_cleanup(&e_ctx);
-
-exit:
+        if (!knowData && 1 <= used && 1 + size_t(out[0]) + 4 <= used)
+        {
+            headerLength = out[0];
+            const unsigned char *p = out.data() + 1 + headerLength;
+            dataLength = (size_t(p[0]) << 24) | (size_t(p[1]) << 16) |
+                         (size_t(p[2]) << 8) | size_t(p[3]);
+            knowData = true;
+        }
+        if (knowData && !knowEnd &&
+                1 + headerLength + 4 + dataLength + 1 <= used)
+        {
+            const size_t footerAt = 1 + headerLength + 4 + dataLength;
+            shaEnd = footerAt + 1 + out[footerAt];
+            knowEnd = true;
+        }
 
-    return cc;
-}
+        const size_t limit = knowEnd ? std::min(used, shaEnd) : used;
+        if (hashed < limit)
+        {
+            SHA256_Update(&sha, out.data() + hashed, limit - hashed);
+            hashed = limit;
+        }
+    };
 
-/**
- * Decrypts the given data with AES256
- */
-static
-tABC_CC ABC_CryptoDecryptAES256(const tABC_U08Buf EncData,
-                                const tABC_U08Buf Key,
-                                const tABC_U08Buf IV,
-                                tABC_U08Buf       *pData,
-                                tABC_Error        *pError)
-{
-    tABC_CC cc = ABC_CC_Ok;
-    ABC_SET_ERR_CODE(pError, ABC_CC_Ok);
-
-    unsigned char *pTmpData = NULL;
-    int p_len, f_len;
-    unsigned int IVLength;
-    unsigned int keyLength;
-
-    ABC_CHECK_NULL_BUF(EncData);
-    ABC_CHECK_NULL_BUF(Key);
-    ABC_CHECK_NULL_BUF(IV);
-    ABC_CHECK_NULL(pData);
-
-    // create the final key
-    unsigned char aKey[AES_256_KEY_LENGTH];
-    memset(aKey, 0, AES_256_KEY_LENGTH);
-    keyLength = Key.size();
-    if (keyLength > AES_256_KEY_LENGTH)
+    const unsigned char *p = data.data();
+    size_t left = data.size();
+    while (left)
     {
-        keyLength = AES_256_KEY_LENGTH;
+        const int chunk = std::min<size_t>(left, cryptoChunkSize);
+        int written = 0;
+        if (!EVP_DecryptUpdate(c.ctx, out.data() + used, &written, p, chunk))
+            return ABC_ERROR(ABC_CC_DecryptFailure, "AES256 decryption failed");
+        used += written;
+        p += chunk;
+        left -= chunk;
+        advance();
     }
-    memcpy(aKey, Key.data(), keyLength);
+    int written = 0;
+    if (!EVP_DecryptFinal_ex(c.ctx, out.data() + used, &written))
+        return ABC_ERROR(ABC_CC_DecryptFailure, "AES256 decryption failed");
+    used += written;
+    advance();
+
+    // check that we have enough data based upon the lengths
+    if (!knowEnd || used < shaEnd + SHA256_DIGEST_LENGTH)
+        return ABC_ERROR(ABC_CC_DecryptFailure,
+                         "Decrypted data is not long enough");
 
-    // create the IV
-    unsigned char aIV[AES_256_IV_LENGTH];
-    memset(aIV, 0, AES_256_IV_LENGTH);
-    IVLength = IV.size();
-    if (IVLength > AES_256_IV_LENGTH)
+    // check the sha256
+    unsigned char sha256Output[SHA256_DIGEST_LENGTH];
+    SHA256_Final(sha256Output, &sha);
+    if (!cryptoCompare(out.data() + shaEnd, sha256Output, SHA256_DIGEST_LENGTH))
     {
-        IVLength = AES_256_IV_LENGTH;
+        // this can be specifically used by the caller to possibly determine whether the key was incorrect
+        return ABC_ERROR(ABC_CC_DecryptFailure,
+                         "Decrypted data failed checksum (SHA) check");
     }
-    memcpy(aIV, IV.data(), IVLength);
-
-    // init our cipher text struct
-    EVP_CIPHER_CTX d_ctx;
-    EVP_CIPHER_CTX_init(&d_ctx);
-    EVP_DecryptInit_ex(&d_ctx, EVP_aes_256_cbc(), NULL, aKey, aIV);
-
-    /* because we have padding ON, we must allocate an extra cipher block size of memory */
-    p_len = EncData.size();
-    f_len = 0;
-    ABC_ARRAY_NEW(pTmpData, p_len + AES_256_BLOCK_LENGTH, unsigned char);
-
-    // decrypt
-    EVP_DecryptInit_ex(&d_ctx, NULL, NULL, NULL, NULL);
-    EVP_DecryptUpdate(&d_ctx, pTmpData, &p_len, EncData.data(), EncData.size());
-    EVP_DecryptFinal_ex(&d_ctx, pTmpData + p_len, &f_len);
-
-    EVP_CIPHER_CTX_cleanup(&d_ctx);
 
-    // set final values
-    *pData = U08Buf(pTmpData, p_len + f_len);
+    // all is good, so slide the data down into place
+    const size_t dataStart = 1 + headerLength + 4;
+    memmove(out.data(), out.data() + dataStart, dataLength);
+    OPENSSL_cleanse(out.data() + dataLength, out.size() - dataLength);
+    out.resize(dataLength);
 
-exit:
-    return cc;
+    result = std::move(out);
+    return Status();
 }
 
 } // namespace abcd
@@ -12,6 +12,7 @@
 #ifndef ABCD_CRYPTO_CRYPTO_HPP
 #define ABCD_CRYPTO_CRYPTO_HPP
 
+#include "../util/Status.hpp"
 #include "../util/U08Buf.hpp"
 #include "../../src/ABC.h"
 #include <jansson.h>
@@ -34,17 +35,21 @@ hmacSha256(DataSlice data, DataSlice key);
 std::string
 cryptoFilename(DataSlice key, const std::string &name);
 
-tABC_CC ABC_CryptoEncryptAES256Package(DataSlice         Data,
-                                       DataSlice         Key,
-                                       tABC_U08Buf       *pEncData,
-                                       DataChunk         &IV,
-                                       tABC_Error        *pError);
-
-tABC_CC ABC_CryptoDecryptAES256Package(DataChunk &result,
-                                       DataSlice EncData,
-                                       DataSlice Key,
-                                       DataSlice IV,
-                                       tABC_Error *pError);
+/**
+ * Encrypts data into an Airbitz AES256 package, using a fresh random IV.
+ * Works in a single pass, without copying the data.
+ */
+Status
+cryptoEncryptPackage(DataChunk &result, DataChunk &iv,
+                     DataSlice data, DataSlice key);
+
+/**
+ * Decrypts and verifies an Airbitz AES256 package.
+ * Fails with ABC_CC_DecryptFailure if the key is wrong.
+ */
+Status
+cryptoDecryptPackage(DataChunk &result, DataSlice data,
+                     DataSlice key, DataSlice iv);
 
 } // namespace abcd
 
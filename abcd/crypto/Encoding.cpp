@@ -8,6 +8,10 @@
 #include "Encoding.hpp"
 #include <bitcoin/bitcoin.hpp>
 #include <algorithm>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace abcd {
 
@@ -107,18 +111,6 @@ chunkDecode(DataChunk &result, const std::string &in)
     return Status();
 }
 
-static int
-base16Decode(char c)
-{
-    if ('0' <= c && c <= '9')
-        return c - '0';
-    if ('A' <= c && c <= 'F')
-        return 10 + c - 'A';
-    if ('a' <= c && c <= 'f')
-        return 10 + c - 'a';
-    return -1;
-}
-
 static int
 base32Decode(char c)
 {
@@ -129,32 +121,234 @@ base32Decode(char c)
     return -1;
 }
 
-static int
-base64Decode(char c)
+static const char base16Alphabet[] = "0123456789abcdef";
+static const char base64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/**
+ * Lookup tables for the fast base16 & base64 codecs.
+ * Decoding tables hold 0xff for characters outside the alphabet.
+ */
+struct EncodingTables
 {
-    if ('A' <= c && c <= 'Z')
-        return c - 'A';
-    if ('a' <= c && c <= 'z')
-        return 26 + c - 'a';
-    if ('0' <= c && c <= '9')
-        return 52 + c - '0';
-    if ('+' == c)
-        return 62;
-    if ('/' == c)
-        return 63;
-    return -1;
+    char base16Pairs[256][2];
+    uint8_t base16Values[256];
+    uint8_t base64Values[256];
+
+    EncodingTables()
+    {
+        for (unsigned i = 0; i < 256; ++i)
+        {
+            base16Pairs[i][0] = base16Alphabet[i >> 4];
+            base16Pairs[i][1] = base16Alphabet[i & 0x0f];
+        }
+
+        memset(base16Values, 0xff, sizeof(base16Values));
+        for (unsigned i = 0; i < 16; ++i)
+        {
+            base16Values[static_cast<uint8_t>(base16Alphabet[i])] = i;
+            base16Values[toupper(base16Alphabet[i])] = i;
+        }
+
+        memset(base64Values, 0xff, sizeof(base64Values));
+        for (unsigned i = 0; i < 64; ++i)
+            base64Values[static_cast<uint8_t>(base64Alphabet[i])] = i;
+    }
+};
+
+static const EncodingTables &
+encodingTables()
+{
+    static const EncodingTables tables;
+    return tables;
+}
+
+#if defined(__SSE2__)
+/**
+ * Converts each nibble-sized byte to its lower-case hex digit.
+ */
+static inline __m128i
+base16Digits(__m128i nibbles)
+{
+    const __m128i letters = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')),
+                        _mm_and_si128(letters, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+/**
+ * Converts each hex digit to its value.
+ * Sets `valid` to 0xff in each lane that held a hex digit.
+ */
+static inline __m128i
+base16Values(__m128i chars, __m128i &valid)
+{
+    const __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+    const __m128i letter = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)),
+                                        _mm_set1_epi8('a'));
+    const __m128i isDigit = _mm_and_si128(
+                                _mm_cmpgt_epi8(digit, _mm_set1_epi8(-1)),
+                                _mm_cmplt_epi8(digit, _mm_set1_epi8(10)));
+    const __m128i isLetter = _mm_and_si128(
+                                 _mm_cmpgt_epi8(letter, _mm_set1_epi8(-1)),
+                                 _mm_cmplt_epi8(letter, _mm_set1_epi8(6)));
+    valid = _mm_or_si128(isDigit, isLetter);
+    return _mm_or_si128(_mm_and_si128(isDigit, digit),
+                        _mm_and_si128(isLetter,
+                                      _mm_add_epi8(letter, _mm_set1_epi8(10))));
+}
+#endif
+
+size_t
+base16DecodeSize(const std::string &in)
+{
+    return in.size() / 2;
+}
+
+Status
+base16Decode(uint8_t *result, size_t size, const std::string &in)
+{
+    if (in.size() % 2 || in.size() / 2 != size)
+        return ABC_ERROR(ABC_CC_ParseError, "Bad encoding");
+
+    const auto &tables = encodingTables();
+    auto i = reinterpret_cast<const uint8_t *>(in.data());
+    auto out = result;
+    auto end = result + size;
+
+#if defined(__SSE2__)
+    // Handle 8 bytes (16 characters) at a time:
+    for (; 8 <= end - out; out += 8, i += 16)
+    {
+        __m128i valid;
+        const __m128i values = base16Values(
+                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(i)), valid);
+        if (0xffff != _mm_movemask_epi8(valid))
+            return ABC_ERROR(ABC_CC_ParseError, "Bad encoding");
+
+        // Each 16-bit lane holds the high nibble in its low byte:
+        const __m128i bytes = _mm_or_si128(
+                                  _mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0xff)), 4),
+                                  _mm_srli_epi16(values, 8));
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(out),
+                         _mm_packus_epi16(bytes, _mm_setzero_si128()));
+    }
+#endif
+
+    for (; out < end; ++out, i += 2)
+    {
+        const uint8_t high = tables.base16Values[i[0]];
+        const uint8_t low = tables.base16Values[i[1]];
+        if (0x80 & (high | low))
+            return ABC_ERROR(ABC_CC_ParseError, "Bad encoding");
+        *out = high << 4 | low;
+    }
+
+    return Status();
+}
+
+size_t
+base64DecodeSize(const std::string &in)
+{
+    if (in.size() % 4)
+        return 0;
+
+    size_t padding = 0;
+    if (in.size() && '=' == in[in.size() - 1])
+        ++padding;
+    if (padding && '=' == in[in.size() - 2])
+        ++padding;
+    return 3 * (in.size() / 4) - padding;
+}
+
+Status
+base64Decode(uint8_t *result, size_t size, const std::string &in)
+{
+    // The string must be a multiple of the chunk size,
+    // with no more than two padding characters:
+    if (in.size() % 4 || base64DecodeSize(in) != size)
+        return ABC_ERROR(ABC_CC_ParseError, "Bad encoding");
+    if (in.empty())
+        return Status();
+
+    const auto &tables = encodingTables();
+    const uint8_t *values = tables.base64Values;
+    auto i = reinterpret_cast<const uint8_t *>(in.data());
+    auto out = result;
+
+    // Decode all the complete chunks, leaving the padded one:
+    const size_t chunks = in.size() / 4 - 1;
+    for (size_t n = 0; n < chunks; ++n, i += 4, out += 3)
+    {
+        const uint8_t a = values[i[0]];
+        const uint8_t b = values[i[1]];
+        const uint8_t c = values[i[2]];
+        const uint8_t d = values[i[3]];
+        if (0x80 & (a | b | c | d))
+            return ABC_ERROR(ABC_CC_ParseError, "Bad encoding");
+
+        const uint32_t bits = a << 18 | b << 12 | c << 6 | d;
+        out[0] = bits >> 16;
+        out[1] = bits >> 8;
+        out[2] = bits;
+    }
+
+    // The final chunk may end in padding:
+    const size_t left = size - 3 * chunks;
+    const uint8_t a = values[i[0]];
+    const uint8_t b = values[i[1]];
+    const uint8_t c = 2 <= left ? values[i[2]] : 0;
+    const uint8_t d = 3 <= left ? values[i[3]] : 0;
+    if (0x80 & (a | b | c | d))
+        return ABC_ERROR(ABC_CC_ParseError, "Bad encoding");
+
+    // Any extra bits must be 0 (but rfc4648 decoders can be liberal here):
+    const uint32_t bits = a << 18 | b << 12 | c << 6 | d;
+    out[0] = bits >> 16;
+    if (2 <= left)
+        out[1] = bits >> 8;
+    if (3 <= left)
+        out[2] = bits;
+
+    return Status();
 }
 
 std::string
 base16Encode(DataSlice data)
 {
-    return chunkEncode<1, 2>(data, "0123456789abcdef");
+    std::string out(2 * data.size(), 0);
+    auto i = data.begin();
+    auto o = &out[0];
+
+#if defined(__SSE2__)
+    // Handle 16 bytes (32 characters) at a time:
+    for (; 16 <= data.end() - i; i += 16, o += 32)
+    {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(i));
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        const __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+        const __m128i low = _mm_and_si128(bytes, mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(o),
+                         base16Digits(_mm_unpacklo_epi8(high, low)));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(o + 16),
+                         base16Digits(_mm_unpackhi_epi8(high, low)));
+    }
+#endif
+
+    const auto &pairs = encodingTables().base16Pairs;
+    for (; i < data.end(); ++i, o += 2)
+        memcpy(o, pairs[*i], 2);
+
+    return out;
 }
 
 Status
 base16Decode(DataChunk &result, const std::string &in)
 {
-    return chunkDecode<1, 2, base16Decode>(result, in);
+    DataChunk out(base16DecodeSize(in));
+    ABC_CHECK(base16Decode(out.data(), out.size(), in));
+
+    result = std::move(out);
+    return Status();
 }
 
 std::string
@@ -187,14 +381,41 @@ base58Decode(DataChunk &result, const std::string &in)
 std::string
 base64Encode(DataSlice data)
 {
-    return chunkEncode<3, 4>(data,
-                             "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/");
+    std::string out(4 * ((data.size() + 2) / 3), '=');
+    auto i = data.begin();
+    auto o = &out[0];
+
+    for (; 3 <= data.end() - i; i += 3, o += 4)
+    {
+        const uint32_t bits = i[0] << 16 | i[1] << 8 | i[2];
+        o[0] = base64Alphabet[bits >> 18];
+        o[1] = base64Alphabet[bits >> 12 & 0x3f];
+        o[2] = base64Alphabet[bits >> 6 & 0x3f];
+        o[3] = base64Alphabet[bits & 0x3f];
+    }
+
+    // The final chunk keeps its padding:
+    const auto left = data.end() - i;
+    if (left)
+    {
+        const uint32_t bits = i[0] << 16 | (2 == left ? i[1] << 8 : 0);
+        o[0] = base64Alphabet[bits >> 18];
+        o[1] = base64Alphabet[bits >> 12 & 0x3f];
+        if (2 == left)
+            o[2] = base64Alphabet[bits >> 6 & 0x3f];
+    }
+
+    return out;
 }
 
 Status
 base64Decode(DataChunk &result, const std::string &in)
 {
-    return chunkDecode<3, 4, base64Decode>(result, in);
+    DataChunk out(base64DecodeSize(in));
+    ABC_CHECK(base64Decode(out.data(), out.size(), in));
+
+    result = std::move(out);
+    return Status();
 }
 
 } // namespace abcd
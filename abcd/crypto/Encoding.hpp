@@ -25,6 +25,19 @@ base16Encode(DataSlice data);
 Status
 base16Decode(DataChunk &result, const std::string &in);
 
+/**
+ * Returns the number of bytes in a decoded hex string.
+ */
+size_t
+base16DecodeSize(const std::string &in);
+
+/**
+ * Decodes a hex string into an existing buffer,
+ * which must be exactly `base16DecodeSize` bytes long.
+ */
+Status
+base16Decode(uint8_t *result, size_t size, const std::string &in);
+
 /**
  * Encodes data into a base-32 string according to rfc4648.
  */
@@ -61,6 +74,20 @@ base64Encode(DataSlice data);
 Status
 base64Decode(DataChunk &result, const std::string &in);
 
+/**
+ * Returns the number of bytes in a decoded base-64 string,
+ * or 0 if the string length is invalid.
+ */
+size_t
+base64DecodeSize(const std::string &in);
+
+/**
+ * Decodes a base-64 string into an existing buffer,
+ * which must be exactly `base64DecodeSize` bytes long.
+ */
+Status
+base64Decode(uint8_t *result, size_t size, const std::string &in);
+
 } // namespace abcd
 
 #endif
@@ -7,11 +7,15 @@
 
 #include "Scrypt.hpp"
 #include "Random.hpp"
+#include "ScryptCache.hpp"
 #include "../util/Debug.hpp"
 #include "../bitcoin/Testnet.hpp"
 #include "../../minilibs/scrypt/crypto_scrypt.h"
+#include <openssl/crypto.h>
+#include <memory>
 #include <sys/time.h>
 #include <math.h>
+#include <stdint.h>
 
 namespace abcd {
 
@@ -29,6 +33,23 @@ namespace abcd {
 
 #define SCRYPT_DEFAULT_SALT_LENGTH 32
 
+#define SCRYPT_MAX_MEMORY               (512 * 1024 * 1024) // Across all derivations
+#define SCRYPT_RETAIN_MEMORY            (64 * 1024 * 1024)  // Kept between derivations
+
+/**
+ * Scratch memory shared by every derivation in the process.
+ * Repeated logins reuse the same pages instead of faulting in fresh ones,
+ * and derivations running at the same time stay under the memory cap.
+ */
+static crypto_scrypt_ctx *
+scryptContext()
+{
+    static crypto_scrypt_ctx *ctx =
+        crypto_scrypt_ctx_new(SCRYPT_MAX_MEMORY, SCRYPT_RETAIN_MEMORY,
+                              CRYPTO_SCRYPT_HUGEPAGES);
+    return ctx;
+}
+
 void
 ScryptSnrp::createSnrpFromTime(unsigned long totalTime)
 {
@@ -68,6 +89,10 @@ ScryptSnrp::createSnrpFromTime(unsigned long totalTime)
             fEstTargetTimeElapsed *= maxNShift;
 
             fP = ((double) SCRYPT_TARGET_USECONDS / fEstTargetTimeElapsed);
+
+            // The p lanes run in parallel, so more of them fit in the budget:
+            fP *= crypto_scrypt_parallelism(SCRYPT_MAX_CLIENT_N,
+                                            SCRYPT_MIN_CLIENT_R, UINT32_MAX);
         }
     }
     else
@@ -167,13 +192,19 @@ Status
 ScryptSnrp::hash(DataChunk &result, DataSlice data, unsigned long *time,
                  size_t size) const
 {
+    // Benchmark runs need real timings, so they skip the cache:
+    if (!time && scryptCacheFind(result, *this, data, size))
+        return Status();
+
     DataChunk out(size);
 
     struct timeval timerStart;
     struct timeval timerEnd;
     gettimeofday(&timerStart, nullptr);
-    int rc = crypto_scrypt(data.data(), data.size(),
-                           salt.data(), salt.size(), n, r, p, out.data(), size);
+    int rc = crypto_scrypt_ctx_run(scryptContext(), CRYPTO_SCRYPT_AUTO,
+                                   data.data(), data.size(),
+                                   salt.data(), salt.size(), n, r, p,
+                                   out.data(), size);
     gettimeofday(&timerEnd, nullptr);
 
     // Find the time in microseconds:
@@ -190,10 +221,45 @@ ScryptSnrp::hash(DataChunk &result, DataSlice data, unsigned long *time,
     if (rc)
         return ABC_ERROR(ABC_CC_ScryptError, "Error calculating Scrypt hash");
 
+    if (!time)
+        scryptCacheInsert(*this, data, out);
     result = std::move(out);
     return Status();
 }
 
+ScryptFuture::ScryptFuture(const ScryptSnrp &snrp, DataSlice data,
+                           size_t size)
+{
+    // The task gets copied around, so share one copy of the password
+    // between those copies and wipe it once the last one is gone:
+    std::shared_ptr<DataChunk> copy(new DataChunk(data.begin(), data.end()),
+                                    [](DataChunk *p)
+    {
+        OPENSSL_cleanse(p->data(), p->size());
+        delete p;
+    });
+    auto task = [snrp, copy, size]() -> Result
+    {
+        Result out;
+        out.status = snrp.hash(out.data, *copy, nullptr, size);
+        return out;
+    };
+
+    // Allowing a deferred launch lets this run on the calling thread
+    // if a new one cannot be created:
+    future_ = std::async(std::launch::async | std::launch::deferred, task);
+}
+
+Status
+ScryptFuture::get(DataChunk &result)
+{
+    auto out = future_.get();
+    ABC_CHECK(out.status);
+
+    result = std::move(out.data);
+    return Status();
+}
+
 const ScryptSnrp &
 usernameSnrp()
 {
@@ -10,6 +10,7 @@
 
 #include "../util/Data.hpp"
 #include "../util/Status.hpp"
+#include <future>
 
 namespace abcd {
 
@@ -41,12 +42,40 @@ struct ScryptSnrp
 
     /**
      * The scrypt hash function.
+     * Recent results are cached for a few minutes,
+     * unless the caller asks for the time taken.
      */
     Status
     hash(DataChunk &result, DataSlice data, unsigned long *time=nullptr,
          size_t size=scryptDefaultSize) const;
 };
 
+/**
+ * Runs a scrypt hash on a background thread,
+ * so independent derivations can use separate cores.
+ */
+class ScryptFuture
+{
+public:
+    ScryptFuture(const ScryptSnrp &snrp, DataSlice data,
+                 size_t size=scryptDefaultSize);
+
+    /**
+     * Waits for the hash to finish and returns its result.
+     * Can only be called once.
+     */
+    Status
+    get(DataChunk &result);
+
+private:
+    struct Result
+    {
+        Status status;
+        DataChunk data;
+    };
+    std::future<Result> future_;
+};
+
 /**
  * Returns the fixed SNRP value used for the username.
  */
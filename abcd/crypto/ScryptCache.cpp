@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "ScryptCache.hpp"
+#include "Random.hpp"
+#include "Scrypt.hpp"
+#include "../util/Debug.hpp"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <time.h>
+#include <mutex>
+
+namespace abcd {
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+constexpr size_t cacheEntries = 16;
+constexpr size_t cacheValueSize = 64;
+constexpr time_t cacheLifetime = 5 * 60; // Seconds
+
+struct ScryptCacheEntry
+{
+    uint8_t key[32];
+    uint8_t value[cacheValueSize];
+    size_t size;
+    time_t expires;
+};
+
+/**
+ * Everything secret lives in this structure,
+ * which sits in its own page of memory that cannot be swapped out.
+ */
+struct ScryptCacheStore
+{
+    uint8_t secret[32];
+    ScryptCacheEntry entries[cacheEntries];
+};
+
+static std::mutex gCacheMutex;
+static ScryptCacheStore *gCacheStore = nullptr;
+static bool gCacheFailed = false;
+
+/**
+ * Maps and locks the store on first use.
+ * The caller must hold the mutex.
+ */
+static ScryptCacheStore *
+cacheStore()
+{
+    if (gCacheStore || gCacheFailed)
+        return gCacheStore;
+
+    void *page = mmap(nullptr, sizeof(ScryptCacheStore),
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == page)
+    {
+        ABC_DebugLog("Scrypt cache disabled: cannot map memory");
+        gCacheFailed = true;
+        return nullptr;
+    }
+
+    // Without locked memory, the cache would leak keys to swap:
+    if (mlock(page, sizeof(ScryptCacheStore)))
+    {
+        ABC_DebugLog("Scrypt cache disabled: cannot lock memory");
+        munmap(page, sizeof(ScryptCacheStore));
+        gCacheFailed = true;
+        return nullptr;
+    }
+#ifdef MADV_DONTDUMP
+    madvise(page, sizeof(ScryptCacheStore), MADV_DONTDUMP);
+#endif
+
+    auto store = static_cast<ScryptCacheStore *>(page);
+    memset(store, 0, sizeof(ScryptCacheStore));
+    DataChunk secret;
+    if (!randomData(secret, sizeof(store->secret)).log())
+    {
+        munlock(page, sizeof(ScryptCacheStore));
+        munmap(page, sizeof(ScryptCacheStore));
+        gCacheFailed = true;
+        return nullptr;
+    }
+    memcpy(store->secret, secret.data(), sizeof(store->secret));
+    OPENSSL_cleanse(secret.data(), secret.size());
+
+    gCacheStore = store;
+    return gCacheStore;
+}
+
+/**
+ * Builds the lookup key, a keyed hash of the parameters and the input.
+ * Keying the hash with a per-process secret means the cache cannot be
+ * used to test password guesses without running scrypt.
+ */
+static void
+cacheKey(uint8_t key[32], const ScryptCacheStore &store,
+         const ScryptSnrp &snrp, DataSlice data, size_t size)
+{
+    unsigned int length = 32;
+    uint8_t inner[32];
+    HMAC(EVP_sha256(), store.secret, sizeof(store.secret),
+         data.data(), data.size(), inner, &length);
+
+    const uint64_t numbers[] =
+    {
+        snrp.n, snrp.r, snrp.p, size, snrp.salt.size()
+    };
+    DataChunk message;
+    message.insert(message.end(), inner, inner + sizeof(inner));
+    message.insert(message.end(),
+                   reinterpret_cast<const uint8_t *>(numbers),
+                   reinterpret_cast<const uint8_t *>(numbers) + sizeof(numbers));
+    message.insert(message.end(), snrp.salt.begin(), snrp.salt.end());
+    HMAC(EVP_sha256(), store.secret, sizeof(store.secret),
+         message.data(), message.size(), key, &length);
+
+    OPENSSL_cleanse(inner, sizeof(inner));
+    OPENSSL_cleanse(message.data(), message.size());
+}
+
+/**
+ * Wipes entries that have outlived their lifetime.
+ */
+static void
+cacheExpire(ScryptCacheStore &store, time_t now)
+{
+    for (auto &entry: store.entries)
+        if (entry.expires && entry.expires <= now)
+            OPENSSL_cleanse(&entry, sizeof(entry));
+}
+
+bool
+scryptCacheFind(DataChunk &result, const ScryptSnrp &snrp,
+                DataSlice data, size_t size)
+{
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+    auto store = cacheStore();
+    if (!store)
+        return false;
+    cacheExpire(*store, time(nullptr));
+
+    uint8_t key[32];
+    cacheKey(key, *store, snrp, data, size);
+    for (const auto &entry: store->entries)
+    {
+        if (entry.expires && size == entry.size &&
+                !CRYPTO_memcmp(key, entry.key, sizeof(key)))
+        {
+            result = DataChunk(entry.value, entry.value + entry.size);
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+scryptCacheInsert(const ScryptSnrp &snrp, DataSlice data, DataSlice result)
+{
+    if (cacheValueSize < result.size())
+        return;
+
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+    auto store = cacheStore();
+    if (!store)
+        return;
+    const auto now = time(nullptr);
+    cacheExpire(*store, now);
+
+    // Replace an empty slot, or else the one closest to expiring:
+    auto *slot = &store->entries[0];
+    for (auto &entry: store->entries)
+        if (entry.expires < slot->expires)
+            slot = &entry;
+
+    OPENSSL_cleanse(slot, sizeof(*slot));
+    cacheKey(slot->key, *store, snrp, data, result.size());
+    memcpy(slot->value, result.data(), result.size());
+    slot->size = result.size();
+    slot->expires = now + cacheLifetime;
+}
+
+void
+scryptCacheClear()
+{
+    std::lock_guard<std::mutex> lock(gCacheMutex);
+    if (gCacheStore)
+        OPENSSL_cleanse(gCacheStore->entries, sizeof(gCacheStore->entries));
+}
+
+} // namespace abcd
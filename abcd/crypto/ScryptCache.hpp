@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Short-lived cache of scrypt results, held in locked memory.
+ */
+
+#ifndef ABCD_CRYPTO_SCRYPT_CACHE_HPP
+#define ABCD_CRYPTO_SCRYPT_CACHE_HPP
+
+#include "../util/Data.hpp"
+
+namespace abcd {
+
+struct ScryptSnrp;
+
+/**
+ * Looks for a recent result with matching parameters and input.
+ * @return true if the result was found.
+ */
+bool
+scryptCacheFind(DataChunk &result, const ScryptSnrp &snrp,
+                DataSlice data, size_t size);
+
+/**
+ * Remembers a result for a while.
+ * The input itself is never stored, only a keyed hash of it.
+ */
+void
+scryptCacheInsert(const ScryptSnrp &snrp, DataSlice data, DataSlice result);
+
+/**
+ * Wipes every cached result.
+ */
+void
+scryptCacheClear();
+
+} // namespace abcd
+
+#endif
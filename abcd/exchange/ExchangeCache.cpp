@@ -10,11 +10,21 @@
 #include "../json/JsonArray.hpp"
 #include "../json/JsonObject.hpp"
 #include "../util/Debug.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <set>
 
 namespace abcd {
 
 #define SATOSHI_PER_BITCOIN 100000000
 
+/**
+ * How long each source has to answer, in seconds.
+ */
+constexpr long sourceTimeout = 10;
+
 struct CacheJson:
     public JsonObject
 {
@@ -30,12 +40,92 @@ struct CacheJsonRow:
     ABC_JSON_INTEGER(timestamp, "timestamp", 0)
 };
 
-ExchangeCache::ExchangeCache(const std::string &path):
-    path_(path)
+ExchangeCache::ExchangeCache(const std::string &path,
+                             const ExchangeMirrors &mirrors):
+    path_(path),
+    mirrors_(mirrors),
+    snapshot_(std::make_shared<const RateSnapshot>())
 {
     load(); // Nothing bad happens if this fails
 }
 
+/**
+ * The results of fetching several sources at once.
+ * The HTTP thread may still be filling this in after `update` returns,
+ * so the cache keeps it around to collect any late replies.
+ */
+struct ExchangeFetch
+{
+    std::condition_variable cv;
+    std::mutex mutex;
+    time_t time;
+
+    // Protected by the mutex:
+    std::set<std::string> pending;
+    std::map<std::string, ExchangeRates> results;
+};
+
+/**
+ * Combines the source tables, giving each currency the rate from
+ * the first source in the list that has it.
+ * @return true if every wanted currency has a rate.
+ */
+static bool
+exchangeMerge(ExchangeRates &result, const Currencies &currencies,
+              const ExchangeSources &sources,
+              const std::map<std::string, ExchangeRates> &tables)
+{
+    ExchangeRates out;
+    for (const auto &source: sources)
+    {
+        auto table = tables.find(source);
+        if (tables.end() == table)
+            continue;
+
+        for (auto currency: currencies)
+        {
+            auto rate = table->second.find(currency);
+            if (table->second.end() != rate)
+                out.insert(*rate); // Does nothing if already present
+        }
+    }
+
+    const bool complete = out.size() == currencies.size();
+    result = std::move(out);
+    return complete;
+}
+
+/**
+ * Returns true if every currency already has its final rate,
+ * meaning no source still pending could take priority over the one
+ * that supplied it.
+ */
+static bool
+exchangeSettled(const Currencies &currencies, const ExchangeSources &sources,
+                const std::map<std::string, ExchangeRates> &tables,
+                const std::set<std::string> &pending)
+{
+    for (auto currency: currencies)
+    {
+        bool found = false;
+        for (const auto &source: sources)
+        {
+            if (pending.count(source))
+                return false;
+
+            auto table = tables.find(source);
+            if (tables.end() != table && table->second.count(currency))
+            {
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return false;
+    }
+    return true;
+}
+
 Status
 ExchangeCache::update(Currencies currencies, const ExchangeSources &sources)
 {
@@ -46,45 +136,72 @@ ExchangeCache::update(Currencies currencies, const ExchangeSources &sources)
     if (fresh(currencies, now))
         return Status();
 
+    // Another currency from a recent fetch needs no network call:
+    auto tables = freshSources(now);
     ExchangeRates allRates;
-    for (auto source: sources)
+    if (!exchangeMerge(allRates, currencies, sources, tables))
     {
-        // Stop if the todo list is empty:
-        if (currencies.empty())
-            break;
-
-        ABC_DebugLevel(1, "ExchangeCache::update() %s", source.c_str());
+        // Fetch all the stale sources at once:
+        auto fetch = std::make_shared<ExchangeFetch>();
+        fetch->time = now;
+        for (const auto &source: sources)
+        {
+            if (tables.count(source))
+                continue;
 
-        // Grab the rates from the server:
-        ExchangeRates rates;
-        ExchangeRates ratesWanted;
-        if (!exchangeSourceFetch(rates, source))
-            continue; // Just skip the failed ones
+            ABC_DebugLevel(1, "ExchangeCache::update() %s", source.c_str());
+            auto callback = [fetch, source](Status s, ExchangeRates &rates)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(fetch->mutex);
+                    fetch->pending.erase(source);
+                    if (s)
+                        fetch->results[source] = std::move(rates);
+                    else
+                        s.log(); // Just skip the failed ones
+                }
+                fetch->cv.notify_all();
+            };
+
+            auto mirror = mirrors_.find(source);
+            const auto url = mirrors_.end() == mirror ? "" : mirror->second;
+
+            std::lock_guard<std::mutex> lock(fetch->mutex);
+            if (exchangeSourceFetchAsync(source, sourceTimeout, callback,
+                                         url).log())
+                fetch->pending.insert(source);
+        }
 
-        // Remove any new rates from the todo list:
-        for (auto rate: rates)
+        // Stop once no slower, higher-priority source could still change
+        // the answer. The predicate runs one last time on timeout, too:
         {
-            auto i = currencies.find(rate.first);
-            if (currencies.end() != i)
+            std::unique_lock<std::mutex> lock(fetch->mutex);
+            fetch->cv.wait_for(lock, std::chrono::seconds(sourceTimeout + 1),
+                               [&]()
             {
-                currencies.erase(i);
-                ratesWanted.insert(rate);
-
-                std::string code;
-                ABC_CHECK(currencyCode(code, rate.first));
-                ABC_DebugLevel(1, "ExchangeCache::update() %s %s %.2f", source.c_str(),
-                               code.c_str(), rate.second);
-            }
+                for (const auto &result: fetch->results)
+                    tables[result.first] = result.second;
+                exchangeMerge(allRates, currencies, sources, tables);
+                return fetch->pending.empty() ||
+                       exchangeSettled(currencies, sources, tables,
+                                       fetch->pending);
+            });
         }
 
-        // Add any new rates to the allRates list:
-        ratesWanted.insert(allRates.begin(), allRates.end());
-        allRates = std::move(ratesWanted);
+        // Keep the source tables, including any that arrive later:
+        watchFetch(fetch);
+    }
+
+    for (const auto &rate: allRates)
+    {
+        std::string code;
+        ABC_CHECK(currencyCode(code, rate.first));
+        ABC_DebugLevel(1, "ExchangeCache::update() %s %.2f",
+                       code.c_str(), rate.second);
     }
 
     // Add the rates to the cache:
-    for (auto rate: allRates)
-        ABC_CHECK(update(rate.first, rate.second, now));
+    ABC_CHECK(update(allRates, now));
     ABC_CHECK(save());
 
     return Status();
@@ -96,7 +213,7 @@ ExchangeCache::satoshiToCurrency(double &result, int64_t in, Currency currency)
     result = 0.0;
 
     double r;
-    ABC_CHECK(rate(r, currency));
+    ABC_CHECK(rate(r, currency, time(nullptr)));
 
     result = in * (r / SATOSHI_PER_BITCOIN);
     return Status();
@@ -108,12 +225,27 @@ ExchangeCache::currencyToSatoshi(int64_t &result, double in, Currency currency)
     result = 0;
 
     double r;
-    ABC_CHECK(rate(r, currency));
+    ABC_CHECK(rate(r, currency, time(nullptr)));
 
     result = static_cast<int64_t>(in * (SATOSHI_PER_BITCOIN / r));
     return Status();
 }
 
+Status
+ExchangeCache::satoshiToCurrency(double *result, const int64_t *in,
+                                 size_t count, Currency currency)
+{
+    std::fill(result, result + count, 0.0);
+
+    double r;
+    ABC_CHECK(rate(r, currency, time(nullptr)));
+
+    const double scale = r / SATOSHI_PER_BITCOIN;
+    for (size_t i = 0; i < count; ++i)
+        result[i] = in[i] * scale;
+    return Status();
+}
+
 Status
 ExchangeCache::load()
 {
@@ -136,6 +268,7 @@ ExchangeCache::load()
         cache_[currency] =
             CacheRow{row.rate(), static_cast<time_t>(row.timestamp())};
     }
+    publish();
 
     return Status();
 }
@@ -160,7 +293,7 @@ ExchangeCache::save()
 
     CacheJson json;
     ABC_CHECK(json.ratesSet(rates));
-    ABC_CHECK(json.save(path_));
+    ABC_CHECK(json.saveLater(path_));
 
     return Status();
 }
@@ -169,15 +302,29 @@ ExchangeCache::save()
 // number of seconds
 #define ABC_EXCHANGE_RATE_EXPIRE_INTERVAL_SECONDS 86400 // 24 hours
 
-Status
-ExchangeCache::rate(double &result, Currency currency)
+void
+ExchangeCache::publish()
 {
-    std::lock_guard<std::mutex> lock(mutex_);
+    // The map is already sorted, so the snapshot is too:
+    auto snapshot = std::make_shared<RateSnapshot>(cache_.begin(),
+                    cache_.end());
+    std::atomic_store(&snapshot_,
+                      std::shared_ptr<const RateSnapshot>(std::move(snapshot)));
+}
 
-    time_t now = time(nullptr);
+Status
+ExchangeCache::rate(double &result, Currency currency, time_t now) const
+{
+    const auto snapshot = std::atomic_load(&snapshot_);
 
-    const auto &i = cache_.find(currency);
-    if (cache_.end() == i)
+    auto compare = [](const std::pair<Currency, CacheRow> &row,
+                      Currency currency)
+    {
+        return row.first < currency;
+    };
+    auto i = std::lower_bound(snapshot->begin(), snapshot->end(), currency,
+                              compare);
+    if (snapshot->end() == i || currency != i->first)
         return ABC_ERROR(ABC_CC_Error, "Currency not in cache");
     if (i->second.timestamp + ABC_EXCHANGE_RATE_EXPIRE_INTERVAL_SECONDS < now)
         return ABC_ERROR(ABC_CC_Error, "Currency expired. Need to update");
@@ -187,11 +334,13 @@ ExchangeCache::rate(double &result, Currency currency)
 }
 
 Status
-ExchangeCache::update(Currency currency, double rate, time_t now)
+ExchangeCache::update(const ExchangeRates &rates, time_t now)
 {
     std::lock_guard<std::mutex> lock(mutex_);
 
-    cache_[currency] = CacheRow{rate, now};
+    for (const auto &rate: rates)
+        cache_[rate.first] = CacheRow{rate.second, now};
+    publish();
     return Status();
 }
 
@@ -211,4 +360,49 @@ ExchangeCache::fresh(const Currencies &currencies, time_t now)
     return true;
 }
 
+std::map<std::string, ExchangeRates>
+ExchangeCache::freshSources(time_t now)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    harvestFetches();
+
+    std::map<std::string, ExchangeRates> out;
+    for (const auto &i: sources_)
+        if (now <= i.second.timestamp + ABC_EXCHANGE_RATE_REFRESH_INTERVAL_SECONDS)
+            out[i.first] = i.second.rates;
+    return out;
+}
+
+void
+ExchangeCache::watchFetch(std::shared_ptr<ExchangeFetch> fetch)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    fetches_.push_back(fetch);
+    harvestFetches();
+}
+
+void
+ExchangeCache::harvestFetches()
+{
+    for (auto i = fetches_.begin(); i != fetches_.end(); )
+    {
+        auto &fetch = **i;
+        bool done;
+        {
+            std::lock_guard<std::mutex> lock(fetch.mutex);
+            for (auto &result: fetch.results)
+                sources_[result.first] = SourceRow{std::move(result.second),
+                                                   fetch.time};
+            fetch.results.clear();
+            done = fetch.pending.empty();
+        }
+
+        if (done)
+            i = fetches_.erase(i);
+        else
+            ++i;
+    }
+}
+
 } // namespace abcd
@@ -11,21 +11,39 @@
 #include "Currency.hpp"
 #include "ExchangeSource.hpp"
 #include <time.h>
+#include <list>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <vector>
 
 namespace abcd {
 
+struct ExchangeFetch;
+
+/**
+ * Urls to fetch particular sources from, such as mirrors,
+ * instead of their usual ones.
+ */
+typedef std::map<std::string, std::string> ExchangeMirrors;
+
 /**
  * A cache for Bitcoin rates.
+ *
+ * Conversions read from an immutable snapshot of the rates,
+ * which updates replace as a whole, so readers never take the mutex.
  */
 class ExchangeCache
 {
 public:
-    ExchangeCache(const std::string &path);
+    ExchangeCache(const std::string &path,
+                  const ExchangeMirrors &mirrors=ExchangeMirrors());
 
     /**
-     * Updates the exchange rates, trying the sources in the given order.
+     * Updates the exchange rates, fetching from all the sources at once.
+     * Where sources disagree, the ones earlier in the list win,
+     * so this waits for a slow source until every currency it could
+     * supply has arrived, or the source times out.
      */
     Status
     update(Currencies currencies, const ExchangeSources &sources);
@@ -36,9 +54,18 @@ public:
     Status
     currencyToSatoshi(int64_t &result, double in, Currency currency);
 
+    /**
+     * Converts many amounts at once, all at the same rate.
+     * @param result an array with room for `count` amounts.
+     */
+    Status
+    satoshiToCurrency(double *result, const int64_t *in, size_t count,
+                      Currency currency);
+
 private:
     mutable std::mutex mutex_;
     const std::string path_;
+    const ExchangeMirrors mirrors_;
 
     struct CacheRow
     {
@@ -47,6 +74,25 @@ private:
     };
     std::map<Currency, CacheRow> cache_;
 
+    /**
+     * The rates as of the last change, sorted by currency.
+     * Only accessed through `std::atomic_load` and `std::atomic_store`.
+     */
+    typedef std::vector<std::pair<Currency, CacheRow> > RateSnapshot;
+    std::shared_ptr<const RateSnapshot> snapshot_;
+
+    struct SourceRow
+    {
+        ExchangeRates rates;
+        time_t timestamp;
+    };
+    std::map<std::string, SourceRow> sources_;
+
+    /**
+     * Fetches that still have sources outstanding.
+     */
+    std::list<std::shared_ptr<ExchangeFetch> > fetches_;
+
     /**
      * Loads the cache from disk.
      */
@@ -60,22 +106,50 @@ private:
     save();
 
     /**
-     * Obtains a rate from the cache.
+     * Publishes a fresh snapshot of the cache.
+     * Call this with the mutex held.
+     */
+    void
+    publish();
+
+    /**
+     * Obtains a rate from the snapshot, without locking.
      */
     Status
-    rate(double &result, Currency currency);
+    rate(double &result, Currency currency, time_t now) const;
 
     /**
-     * Adds a rate to the cache.
+     * Adds rates to the cache.
      */
     Status
-    update(Currency currency, double rate, time_t now);
+    update(const ExchangeRates &rates, time_t now);
 
     /**
      * Returns true if all the listed rates are fresh in the cache.
      */
     bool
     fresh(const Currencies &currencies, time_t now);
+
+    /**
+     * Returns the rate tables for the sources that are still fresh.
+     */
+    std::map<std::string, ExchangeRates>
+    freshSources(time_t now);
+
+    /**
+     * Tracks a fetch, so its source tables reach the cache
+     * even if they arrive after `update` has returned.
+     */
+    void
+    watchFetch(std::shared_ptr<ExchangeFetch> fetch);
+
+    /**
+     * Moves any finished source tables into the cache,
+     * and forgets fetches that have nothing left to deliver.
+     * Call this with the mutex held.
+     */
+    void
+    harvestFetches();
 };
 
 } // namespace abcd
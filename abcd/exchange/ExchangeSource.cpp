@@ -59,17 +59,13 @@ doubleDecode(double &result, const char *in)
 }
 
 /**
- * Fetches exchange rates from the Bitstamp source.
+ * Decodes exchange rates from the Bitstamp source.
  */
 static Status
-fetchBitstamp(ExchangeRates &result)
+decodeBitstamp(ExchangeRates &result, const std::string &body)
 {
-    HttpReply reply;
-    ABC_CHECK(HttpRequest().get(reply, "https://www.bitstamp.net/api/ticker/"));
-    ABC_CHECK(reply.codeOk());
-
     BitstampJson json;
-    ABC_CHECK(json.decode(reply.body));
+    ABC_CHECK(json.decode(body));
     ABC_CHECK(json.rateOk());
 
     double rate;
@@ -82,18 +78,13 @@ fetchBitstamp(ExchangeRates &result)
 }
 
 /**
- * Fetches exchange rates from the Bitfinex source.
+ * Decodes exchange rates from the Bitfinex source.
  */
 static Status
-fetchBitfinex(ExchangeRates &result)
+decodeBitfinex(ExchangeRates &result, const std::string &body)
 {
-    HttpReply reply;
-    ABC_CHECK(HttpRequest().get(reply,
-                                "https://api.bitfinex.com/v1/pubticker/btcusd"));
-    ABC_CHECK(reply.codeOk());
-
     BitfinexJson json;
-    ABC_CHECK(json.decode(reply.body));
+    ABC_CHECK(json.decode(body));
     ABC_CHECK(json.rateOk());
 
     double rate;
@@ -106,17 +97,13 @@ fetchBitfinex(ExchangeRates &result)
 }
 
 /**
- * Fetches and decodes exchange rates from the BraveNewCoin source.
+ * Decodes exchange rates from the BraveNewCoin source.
  */
 static Status
-fetchBraveNewCoin(ExchangeRates &result)
+decodeBraveNewCoin(ExchangeRates &result, const std::string &body)
 {
-    HttpReply reply;
-    ABC_CHECK(HttpRequest().get(reply, "http://api.bravenewcoin.com/rates.json"));
-    ABC_CHECK(reply.codeOk());
-
     BraveNewCoinJson json;
-    ABC_CHECK(json.decode(reply.body));
+    ABC_CHECK(json.decode(body));
     auto rates = json.rates();
 
     // Break apart the array:
@@ -157,18 +144,13 @@ fetchBraveNewCoin(ExchangeRates &result)
 }
 
 /**
- * Fetches and decodes exchange rates from the Coinbase source.
+ * Decodes exchange rates from the Coinbase source.
  */
 static Status
-fetchCoinbase(ExchangeRates &result)
+decodeCoinbase(ExchangeRates &result, const std::string &body)
 {
-    HttpReply reply;
-    ABC_CHECK(HttpRequest().get(reply,
-                                "https://coinbase.com/api/v1/currencies/exchange_rates"));
-    ABC_CHECK(reply.codeOk());
-
     JsonObject json;
-    ABC_CHECK(json.decode(reply.body));
+    ABC_CHECK(json.decode(body));
 
     // Check for usable rates:
     ExchangeRates out;
@@ -204,18 +186,13 @@ fetchCoinbase(ExchangeRates &result)
 }
 
 /**
- * Fetches and decodes exchange rates from the BitcoinAverage source.
+ * Decodes exchange rates from the BitcoinAverage source.
  */
 static Status
-fetchBitcoinAverage(ExchangeRates &result)
+decodeBitcoinAverage(ExchangeRates &result, const std::string &body)
 {
-    HttpReply reply;
-    ABC_CHECK(HttpRequest().get(reply,
-                                "https://api.bitcoinaverage.com/ticker/global/all"));
-    ABC_CHECK(reply.codeOk());
-
     JsonObject json;
-    ABC_CHECK(json.decode(reply.body));
+    ABC_CHECK(json.decode(body));
 
     // Check for usable rates:
     ExchangeRates out;
@@ -254,16 +231,82 @@ fetchBitcoinAverage(ExchangeRates &result)
     return Status();
 }
 
+/**
+ * Where to find a source, and how to read its reply.
+ */
+struct SourceInfo
+{
+    const char *name;
+    const char *url;
+    Status (*decode)(ExchangeRates &result, const std::string &body);
+};
 
-Status
-exchangeSourceFetch(ExchangeRates &result, const std::string &source)
+static const SourceInfo sourceInfos[] =
+{
+    {"Bitstamp", "https://www.bitstamp.net/api/ticker/", decodeBitstamp},
+    {"Bitfinex", "https://api.bitfinex.com/v1/pubticker/btcusd", decodeBitfinex},
+    {
+        "BitcoinAverage", "https://api.bitcoinaverage.com/ticker/global/all",
+        decodeBitcoinAverage
+    },
+    {"BraveNewCoin", "http://api.bravenewcoin.com/rates.json", decodeBraveNewCoin},
+    {
+        "Coinbase", "https://coinbase.com/api/v1/currencies/exchange_rates",
+        decodeCoinbase
+    }
+};
+
+static Status
+sourceFind(const SourceInfo *&result, const std::string &source)
 {
-    if (source == "Bitstamp")       return fetchBitstamp(result);
-    if (source == "Bitfinex")       return fetchBitfinex(result);
-    if (source == "BitcoinAverage") return fetchBitcoinAverage(result);
-    if (source == "BraveNewCoin")   return fetchBraveNewCoin(result);
-    if (source == "Coinbase")       return fetchCoinbase(result);
+    for (const auto &info: sourceInfos)
+    {
+        if (source == info.name)
+        {
+            result = &info;
+            return Status();
+        }
+    }
     return ABC_ERROR(ABC_CC_ParseError, "No exchange-rate source " + source);
 }
 
+Status
+exchangeSourceFetch(ExchangeRates &result, const std::string &source,
+                    const std::string &url)
+{
+    const SourceInfo *info;
+    ABC_CHECK(sourceFind(info, source));
+
+    HttpReply reply;
+    ABC_CHECK(HttpRequest().get(reply, url.empty() ? info->url : url));
+    ABC_CHECK(reply.codeOk());
+    ABC_CHECK(info->decode(result, reply.body));
+
+    return Status();
+}
+
+Status
+exchangeSourceFetchAsync(const std::string &source, long timeout,
+                         ExchangeCallback callback, const std::string &url)
+{
+    const SourceInfo *info;
+    ABC_CHECK(sourceFind(info, source));
+
+    auto decode = info->decode;
+    auto done = [decode, callback](Status s, HttpReply &reply)
+    {
+        ExchangeRates rates;
+        if (s)
+            s = reply.codeOk();
+        if (s)
+            s = decode(rates, reply.body);
+        callback(s, rates);
+    };
+    ABC_CHECK(HttpRequest().
+              timeout(timeout).
+              getAsync(url.empty() ? info->url : url, done));
+
+    return Status();
+}
+
 } // namespace abcd
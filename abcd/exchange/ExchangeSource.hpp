@@ -9,6 +9,7 @@
 #define ABCD_EXCHANGE_EXCHANGE_SOURCE_HPP
 
 #include "Currency.hpp"
+#include <functional>
 #include <list>
 #include <map>
 
@@ -22,11 +23,32 @@ typedef std::map<Currency, double> ExchangeRates;
  */
 extern const ExchangeSources exchangeSources;
 
+/**
+ * Receives the rates from a source, or the reason they are missing.
+ * This runs on the shared HTTP thread, so it should not block.
+ */
+typedef std::function<void (Status status, ExchangeRates &rates)>
+ExchangeCallback;
+
 /**
  * Fetches the exchange rates from a particular source.
+ * @param url fetches from somewhere else, such as a mirror,
+ * instead of the source's usual url.
+ */
+Status
+exchangeSourceFetch(ExchangeRates &result, const std::string &source,
+                    const std::string &url="");
+
+/**
+ * Starts fetching the exchange rates from a particular source
+ * without waiting for them to arrive.
+ * The callback only runs if this returns success.
+ * @param timeout the longest the request may take, in seconds.
  */
 Status
-exchangeSourceFetch(ExchangeRates &result, const std::string &source);
+exchangeSourceFetchAsync(const std::string &source, long timeout,
+                         ExchangeCallback callback,
+                         const std::string &url="");
 
 } // namespace abcd
 
@@ -6,14 +6,20 @@
  */
 
 #include "Http.hpp"
-#include <curl/curl.h>
 #include <openssl/ssl.h>
 #include <pthread.h>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 namespace abcd {
 
+/**
+ * Enough idle handles to cover the usual burst of parallel requests.
+ * Anything beyond this gets cleaned up rather than pooled.
+ */
+constexpr size_t poolMaxIdle = 8;
+
 /**
  * Manages the cURL library global memory lifetime.
  */
@@ -24,6 +30,15 @@ struct HttpSingleton
 
     std::unique_ptr<std::mutex[]> mutexes;
     Status status;
+
+    // Shared between all pooled handles:
+    CURLSH *share = nullptr;
+    std::mutex shareMutexes[CURL_LOCK_DATA_LAST];
+    bool http2 = false;
+
+    // Idle handles, protected by the mutex:
+    std::mutex poolMutex;
+    std::vector<CURL *> pool;
 };
 
 // Global variables:
@@ -48,8 +63,25 @@ sslThreadIdCallback(CRYPTO_THREADID *id)
 #endif
 }
 
+static void
+shareLockCallback(CURL *handle, curl_lock_data data,
+                  curl_lock_access access, void *userp)
+{
+    gSingleton.shareMutexes[data].lock();
+}
+
+static void
+shareUnlockCallback(CURL *handle, curl_lock_data data, void *userp)
+{
+    gSingleton.shareMutexes[data].unlock();
+}
+
 HttpSingleton::~HttpSingleton()
 {
+    for (auto handle: pool)
+        curl_easy_cleanup(handle);
+    if (share)
+        curl_share_cleanup(share);
     curl_global_cleanup();
 }
 
@@ -62,7 +94,25 @@ HttpSingleton::HttpSingleton()
 
     // Initialize cURL:
     if (curl_global_init(CURL_GLOBAL_DEFAULT))
+    {
         status = ABC_ERROR(ABC_CC_Error, "Cannot initialize cURL");
+        return;
+    }
+
+    // Share DNS results and TLS sessions between handles.
+    // Our libcurl is too old to share connections, but each pooled
+    // handle keeps its own connections open, which covers most reuse:
+    share = curl_share_init();
+    if (share)
+    {
+        curl_share_setopt(share, CURLSHOPT_LOCKFUNC, shareLockCallback);
+        curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, shareUnlockCallback);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
+
+    const auto version = curl_version_info(CURLVERSION_NOW);
+    http2 = version && (version->features & CURL_VERSION_HTTP2);
 }
 
 Status
@@ -71,4 +121,57 @@ httpInit()
     return gSingleton.status;
 }
 
+CURL *
+httpHandleTake()
+{
+    {
+        std::lock_guard<std::mutex> lock(gSingleton.poolMutex);
+        if (!gSingleton.pool.empty())
+        {
+            auto out = gSingleton.pool.back();
+            gSingleton.pool.pop_back();
+            return out;
+        }
+    }
+    return curl_easy_init();
+}
+
+void
+httpHandleGive(CURL *handle)
+{
+    if (!handle)
+        return;
+
+    // Drop any pointers into the finished request:
+    curl_easy_reset(handle);
+
+    {
+        std::lock_guard<std::mutex> lock(gSingleton.poolMutex);
+        if (gSingleton.pool.size() < poolMaxIdle)
+        {
+            gSingleton.pool.push_back(handle);
+            return;
+        }
+    }
+    curl_easy_cleanup(handle);
+}
+
+Status
+httpHandleSetup(CURL *handle)
+{
+    curl_easy_reset(handle);
+
+    if (gSingleton.share &&
+            curl_easy_setopt(handle, CURLOPT_SHARE, gSingleton.share))
+        return ABC_ERROR(ABC_CC_Error, "cURL failed to set share handle");
+
+    // Negotiated through ALPN, so servers without HTTP/2 are unaffected:
+    if (gSingleton.http2 &&
+            curl_easy_setopt(handle, CURLOPT_HTTP_VERSION,
+                             CURL_HTTP_VERSION_2TLS))
+        return ABC_ERROR(ABC_CC_Error, "cURL failed to enable HTTP/2");
+
+    return Status();
+}
+
 } // namespace abcd
@@ -9,6 +9,7 @@
 #define ABCD_HTTP_HTTP_HPP
 
 #include "../util/Status.hpp"
+#include <curl/curl.h>
 
 namespace abcd {
 
@@ -18,6 +19,30 @@ namespace abcd {
 Status
 httpInit();
 
+/**
+ * Takes a cURL handle from the process-wide pool,
+ * or creates a new one if the pool is empty.
+ * Pooled handles keep their connections open between requests,
+ * and share DNS results and TLS sessions with each other.
+ * Use `httpHandleSetup` to prepare the handle before each request.
+ */
+CURL *
+httpHandleTake();
+
+/**
+ * Returns a handle to the pool once its request is done.
+ */
+void
+httpHandleGive(CURL *handle);
+
+/**
+ * Clears any options left over from a previous request,
+ * then connects the handle to the shared cache and
+ * enables HTTP/2 if libcurl supports it.
+ */
+Status
+httpHandleSetup(CURL *handle);
+
 } // namespace abcd
 
 #endif
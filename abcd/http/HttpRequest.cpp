@@ -6,8 +6,17 @@
  */
 
 #include "HttpRequest.hpp"
+#include "Http.hpp"
 #include "../Context.hpp"
 #include "../util/Debug.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace abcd {
 
@@ -53,6 +62,14 @@ curlDebugCallback(CURL *handle, curl_infotype type, char *data, size_t size,
     }
 }
 
+static int
+curlCancelCallback(void *userData, curl_off_t, curl_off_t,
+                   curl_off_t, curl_off_t)
+{
+    auto cancelled = static_cast<const std::atomic<bool> *>(userData);
+    return *cancelled ? 1 : 0;
+}
+
 static size_t
 curlDataCallback(void *data, size_t memberSize, size_t numMembers,
                  void *userData)
@@ -65,6 +82,259 @@ curlDataCallback(void *data, size_t memberSize, size_t numMembers,
     return size;
 }
 
+static size_t
+curlHeaderCallback(char *data, size_t memberSize, size_t numMembers,
+                   void *userData)
+{
+    auto size = numMembers * memberSize;
+    auto headers = static_cast<std::map<std::string, std::string> *>(userData);
+
+    // A new status line means we are following a redirect:
+    std::string line(data, size);
+    if (0 == line.compare(0, 5, "HTTP/"))
+    {
+        headers->clear();
+        return size;
+    }
+
+    auto colon = line.find(':');
+    if (std::string::npos == colon)
+        return size;
+
+    std::string key = line.substr(0, colon);
+    std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+    auto start = line.find_first_not_of(" \t", colon + 1);
+    auto end = line.find_last_not_of(" \t\r\n");
+    if (std::string::npos != start && start <= end)
+        (*headers)[key] = line.substr(start, end + 1 - start);
+    else
+        (*headers)[key] = "";
+
+    return size;
+}
+
+/**
+ * Reads the response code and logs the outcome of a finished request.
+ */
+static Status
+curlReply(HttpReply &result, CURL *handle, const std::string &url,
+          CURLcode code)
+{
+    ABC_CHECK_CURL(code);
+    long responseCode = 0;
+    ABC_CHECK_CURL(curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE,
+                                     &responseCode));
+    result.code = responseCode;
+    if (result.codeOk())
+        ABC_DebugLog("%s (%d)", url.c_str(), result.code);
+    else
+        ABC_DebugLog("%s (%d)\n%s", url.c_str(), result.code,
+                     result.body.c_str());
+
+    return Status();
+}
+
+/**
+ * An asynchronous request, owned by the HTTP thread while it runs.
+ */
+struct HttpTransfer
+{
+    ~HttpTransfer()
+    {
+        if (handle) httpHandleGive(handle);
+        if (headers) curl_slist_free_all(headers);
+    }
+
+    CURL *handle = nullptr;
+    struct curl_slist *headers = nullptr;
+    std::string url;
+    HttpReply reply;
+    HttpCallback callback;
+};
+
+// The shared HTTP thread's state:
+static std::mutex gLoopMutex;
+static std::vector<std::unique_ptr<HttpTransfer> > gLoopPending;
+static CURLM *gLoopMulti = nullptr;
+static int gLoopWake[2] = {-1, -1};
+static bool gLoopStop = false;
+static std::thread gLoopThread;
+
+static void
+httpLoopFinish(std::unique_ptr<HttpTransfer> transfer, CURLcode code)
+{
+    Status s = curlReply(transfer->reply, transfer->handle, transfer->url,
+                         code);
+    auto callback = std::move(transfer->callback);
+    auto reply = std::move(transfer->reply);
+
+    // Free the handle for reuse before anything else happens:
+    transfer.reset();
+    callback(s, reply);
+}
+
+/**
+ * Runs every asynchronous request through one cURL multi handle.
+ * The thread sleeps in `curl_multi_wait`, and a pipe wakes it
+ * when new requests arrive.
+ */
+static void
+httpLoopThread()
+{
+    std::map<CURL *, std::unique_ptr<HttpTransfer> > active;
+
+    while (true)
+    {
+        // Pick up new requests:
+        std::vector<std::unique_ptr<HttpTransfer> > pending;
+        bool stop;
+        {
+            std::lock_guard<std::mutex> lock(gLoopMutex);
+            pending.swap(gLoopPending);
+            stop = gLoopStop;
+        }
+        if (stop)
+        {
+            // Fail everything still outstanding, so no caller waits forever:
+            for (auto &transfer: pending)
+                httpLoopFinish(std::move(transfer), CURLE_ABORTED_BY_CALLBACK);
+            for (auto &i: active)
+            {
+                curl_multi_remove_handle(gLoopMulti, i.first);
+                httpLoopFinish(std::move(i.second), CURLE_ABORTED_BY_CALLBACK);
+            }
+            return;
+        }
+
+        for (auto &transfer: pending)
+        {
+            const auto handle = transfer->handle;
+            const auto code = curl_multi_add_handle(gLoopMulti, handle);
+            if (code)
+                httpLoopFinish(std::move(transfer), CURLE_FAILED_INIT);
+            else
+                active[handle] = std::move(transfer);
+        }
+
+        int running = 0;
+        curl_multi_perform(gLoopMulti, &running);
+
+        // Deliver finished requests:
+        CURLMsg *message;
+        int left = 0;
+        while ((message = curl_multi_info_read(gLoopMulti, &left)))
+        {
+            if (CURLMSG_DONE != message->msg)
+                continue;
+
+            const auto handle = message->easy_handle;
+            const auto code = message->data.result;
+            curl_multi_remove_handle(gLoopMulti, handle);
+
+            auto i = active.find(handle);
+            if (active.end() == i)
+                continue;
+            auto transfer = std::move(i->second);
+            active.erase(i);
+            httpLoopFinish(std::move(transfer), code);
+        }
+
+        // Sleep until there is something to do:
+        curl_waitfd wake = {gLoopWake[0], CURL_WAIT_POLLIN, 0};
+        curl_multi_wait(gLoopMulti, &wake, 1, 1000, nullptr);
+        char buffer[64];
+        while (0 < read(gLoopWake[0], buffer, sizeof(buffer)))
+            ;
+    }
+}
+
+/**
+ * Hands a ready-to-go request to the HTTP thread,
+ * starting the thread if needed.
+ */
+static Status
+httpLoopAdd(std::unique_ptr<HttpTransfer> transfer)
+{
+    std::lock_guard<std::mutex> lock(gLoopMutex);
+
+    if (gLoopStop)
+        return ABC_ERROR(ABC_CC_Error, "The HTTP thread is shutting down");
+
+    if (!gLoopMulti)
+    {
+        if (pipe(gLoopWake))
+            return ABC_ERROR(ABC_CC_SysError, "Cannot create HTTP wake pipe");
+        fcntl(gLoopWake[0], F_SETFL, O_NONBLOCK);
+        fcntl(gLoopWake[1], F_SETFL, O_NONBLOCK);
+
+        gLoopMulti = curl_multi_init();
+        if (!gLoopMulti)
+        {
+            // Leave things as they were, so the next call can try again:
+            close(gLoopWake[0]);
+            close(gLoopWake[1]);
+            gLoopWake[0] = gLoopWake[1] = -1;
+            return ABC_ERROR(ABC_CC_Error, "cURL failed create multi handle");
+        }
+        curl_multi_setopt(gLoopMulti, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+        gLoopThread = std::thread(httpLoopThread);
+    }
+
+    gLoopPending.push_back(std::move(transfer));
+    if (write(gLoopWake[1], "", 1) < 0)
+        ABC_DebugLog("HTTP wake pipe is full");
+
+    return Status();
+}
+
+/**
+ * Stops the HTTP thread, failing any requests still in flight,
+ * and frees the multi handle and wake pipe.
+ * The next asynchronous request starts everything up again.
+ */
+static void
+httpLoopStop()
+{
+    {
+        std::lock_guard<std::mutex> lock(gLoopMutex);
+        if (!gLoopMulti)
+            return;
+        gLoopStop = true;
+        if (write(gLoopWake[1], "", 1) < 0)
+            ABC_DebugLog("HTTP wake pipe is full");
+    }
+    if (gLoopThread.joinable())
+        gLoopThread.join();
+
+    std::lock_guard<std::mutex> lock(gLoopMutex);
+    curl_multi_cleanup(gLoopMulti);
+    gLoopMulti = nullptr;
+    close(gLoopWake[0]);
+    close(gLoopWake[1]);
+    gLoopWake[0] = gLoopWake[1] = -1;
+    gLoopStop = false;
+}
+
+/**
+ * Stops the HTTP thread if the program exits without calling
+ * `httpTerminate`, while the state it uses still exists.
+ */
+struct LoopGuard
+{
+    ~LoopGuard()
+    {
+        httpLoopStop();
+    }
+};
+static LoopGuard gLoopGuard;
+
+void
+httpTerminate()
+{
+    httpLoopStop();
+}
+
 Status
 HttpReply::codeOk() const
 {
@@ -76,7 +346,7 @@ HttpReply::codeOk() const
 
 HttpRequest::~HttpRequest()
 {
-    if (handle_) curl_easy_cleanup(handle_);
+    if (handle_) httpHandleGive(handle_);
     if (headers_) curl_slist_free_all(headers_);
 }
 
@@ -114,29 +384,37 @@ HttpRequest::header(const std::string &key, const std::string &value)
     return *this;
 }
 
+HttpRequest &
+HttpRequest::timeout(long seconds)
+{
+    if (status_)
+        status_ = curlOk(curl_easy_setopt(handle_, CURLOPT_TIMEOUT, seconds));
+    return *this;
+}
+
+HttpRequest &
+HttpRequest::cancelOn(const std::atomic<bool> &cancelled)
+{
+    if (status_)
+        status_ = curlOk(curl_easy_setopt(handle_, CURLOPT_XFERINFOFUNCTION,
+                                          curlCancelCallback));
+    if (status_)
+        status_ = curlOk(curl_easy_setopt(handle_, CURLOPT_XFERINFODATA,
+                                          &cancelled));
+    if (status_)
+        status_ = curlOk(curl_easy_setopt(handle_, CURLOPT_NOPROGRESS, 0L));
+    return *this;
+}
+
 Status
 HttpRequest::get(HttpReply &result, const std::string &url)
 {
     if (!status_)
         return status_;
 
-    // Final options:
-    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_WRITEDATA, &result.body));
-    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_WRITEFUNCTION,
-                                    curlDataCallback));
-    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_URL, url.c_str()));
-    if (headers_)
-        ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_HTTPHEADER, headers_));
-
     // Make the request:
-    ABC_CHECK_CURL(curl_easy_perform(handle_));
-    ABC_CHECK_CURL(curl_easy_getinfo(handle_, CURLINFO_RESPONSE_CODE,
-                                     &result.code));
-    if (result.codeOk())
-        ABC_DebugLog("%s (%d)", url.c_str(), result.code);
-    else
-        ABC_DebugLog("%s (%d)\n%s", url.c_str(), result.code,
-                     result.body.c_str());
+    ABC_CHECK(setup(result, url));
+    ABC_CHECK(curlReply(result, handle_, url, curl_easy_perform(handle_)));
 
     return Status();
 }
@@ -164,18 +442,85 @@ HttpRequest::request(HttpReply &result, const std::string &url,
     return post(result, url, body);
 }
 
+Status
+HttpRequest::getAsync(const std::string &url, HttpCallback callback)
+{
+    if (!status_)
+        return status_;
+
+    std::unique_ptr<HttpTransfer> transfer(new HttpTransfer());
+    transfer->url = url;
+    transfer->callback = std::move(callback);
+    ABC_CHECK(setup(transfer->reply, transfer->url));
+    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_PIPEWAIT, 1L));
+
+    // The transfer takes over our resources:
+    transfer->handle = handle_;
+    transfer->headers = headers_;
+    handle_ = nullptr;
+    headers_ = nullptr;
+    status_ = ABC_ERROR(ABC_CC_Error, "HTTP request already sent");
+
+    ABC_CHECK(httpLoopAdd(std::move(transfer)));
+    return Status();
+}
+
+Status
+HttpRequest::postAsync(const std::string &url, const std::string &body,
+                       HttpCallback callback)
+{
+    if (!status_)
+        return status_;
+
+    // The body must outlive this call, so let cURL copy it:
+    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_POSTFIELDSIZE, body.size()));
+    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_COPYPOSTFIELDS,
+                                    body.c_str()));
+    return getAsync(url, std::move(callback));
+}
+
+Status
+HttpRequest::requestAsync(const std::string &url, const char *method,
+                          const std::string &body, HttpCallback callback)
+{
+    if (!status_)
+        return status_;
+
+    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_CUSTOMREQUEST, method));
+    return postAsync(url, body, std::move(callback));
+}
+
+Status
+HttpRequest::setup(HttpReply &result, const std::string &url)
+{
+    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_WRITEDATA, &result.body));
+    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_WRITEFUNCTION,
+                                    curlDataCallback));
+    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_HEADERDATA,
+                                    &result.headers));
+    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_HEADERFUNCTION,
+                                    curlHeaderCallback));
+    ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_URL, url.c_str()));
+    if (headers_)
+        ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_HTTPHEADER, headers_));
+
+    return Status();
+}
+
 Status
 HttpRequest::init()
 {
-    handle_ = curl_easy_init();
+    // Pooled handles keep their connections, but not their old options:
+    handle_ = httpHandleTake();
     if (!handle_)
         return ABC_ERROR(ABC_CC_Error, "cURL failed create handle");
+    ABC_CHECK(httpHandleSetup(handle_));
 
     // Basic options:
     ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_NOSIGNAL, 1));
     ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_CONNECTTIMEOUT, TIMEOUT));
 
-    const auto certPath = gContext->paths.certPath();
+    const auto certPath = gContext ? gContext->paths.certPath() : "";
     if (!certPath.empty())
         ABC_CHECK_CURL(curl_easy_setopt(handle_, CURLOPT_CAINFO,
                                         certPath.c_str()));
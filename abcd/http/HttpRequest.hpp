@@ -10,6 +10,9 @@
 
 #include "../util/Status.hpp"
 #include <curl/curl.h>
+#include <atomic>
+#include <functional>
+#include <map>
 
 namespace abcd {
 
@@ -19,6 +22,8 @@ struct HttpReply
     int code;
     /** The returned message body. */
     std::string body;
+    /** The response headers, with lower-case names. */
+    std::map<std::string, std::string> headers;
 
     /**
      * Verifies that the response code is in the 200 range.
@@ -27,6 +32,12 @@ struct HttpReply
     codeOk() const;
 };
 
+/**
+ * Receives the reply once an asynchronous request is done.
+ * This runs on the shared HTTP thread, so it should not block.
+ */
+typedef std::function<void (Status status, HttpReply &reply)> HttpCallback;
+
 /**
  * A class for building up and making HTTP requests.
  */
@@ -48,6 +59,19 @@ public:
     HttpRequest &
     header(const std::string &key, const std::string &value);
 
+    /**
+     * Limits the total time the request may take, in seconds.
+     */
+    HttpRequest &
+    timeout(long seconds);
+
+    /**
+     * Aborts the request once the flag becomes true.
+     * The flag must outlive the request.
+     */
+    HttpRequest &
+    cancelOn(const std::atomic<bool> &cancelled);
+
     /**
      * Performs an HTTP GET operation.
      */
@@ -68,6 +92,29 @@ public:
     request(HttpReply &result, const std::string &url,
             const char *method, const std::string body="");
 
+    /**
+     * Starts an HTTP GET operation on the shared HTTP thread,
+     * which can have many requests in flight at once.
+     * The request object is used up, and can be destroyed right away.
+     * The callback only runs if this returns success.
+     */
+    Status
+    getAsync(const std::string &url, HttpCallback callback);
+
+    /**
+     * Starts an HTTP POST operation on the shared HTTP thread.
+     */
+    Status
+    postAsync(const std::string &url, const std::string &body,
+              HttpCallback callback);
+
+    /**
+     * Starts an arbitrary HTTP operation on the shared HTTP thread.
+     */
+    Status
+    requestAsync(const std::string &url, const char *method,
+                 const std::string &body, HttpCallback callback);
+
 protected:
     Status status_;
     CURL *handle_;
@@ -76,8 +123,21 @@ private:
     struct curl_slist *headers_;
 
     Status init();
+
+    /**
+     * Sets the options that depend on the url and reply.
+     */
+    Status
+    setup(HttpReply &result, const std::string &url);
 };
 
+/**
+ * Stops the shared HTTP thread, failing any requests still in flight.
+ * Should be called when the program exits.
+ */
+void
+httpTerminate();
+
 } // namespace abcd
 
 #endif
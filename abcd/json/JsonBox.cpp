@@ -20,9 +20,8 @@ Status
 JsonBox::encrypt(DataSlice data, DataSlice key)
 {
     DataChunk nonce;
-    AutoU08Buf cyphertext;
-    ABC_CHECK_OLD(ABC_CryptoEncryptAES256Package(data, key,
-                  &cyphertext, nonce, &error));
+    DataChunk cyphertext;
+    ABC_CHECK(cryptoEncryptPackage(cyphertext, nonce, data, key));
 
     ABC_CHECK(typeSet(AES256_CBC_AIRBITZ));
     ABC_CHECK(nonceSet(base16Encode(nonce)));
@@ -46,9 +45,7 @@ JsonBox::decrypt(DataChunk &result, DataSlice key)
     {
     case AES256_CBC_AIRBITZ:
     {
-        ABC_CHECK_OLD(ABC_CryptoDecryptAES256Package(result,
-                      cyphertext, key, nonce,
-                      &error));
+        ABC_CHECK(cryptoDecryptPackage(result, cyphertext, key, nonce));
         return Status();
     }
 
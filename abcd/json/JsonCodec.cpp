@@ -0,0 +1,931 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "JsonCodec.hpp"
+#include "../util/FileIO.hpp"
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace abcd {
+
+// Matches jansson's nesting limit, which keeps `skip` off the stack's edge:
+constexpr unsigned jsonMaxDepth = 2048;
+
+static bool
+jsonIsSpace(char c)
+{
+    return ' ' == c || '\t' == c || '\n' == c || '\r' == c;
+}
+
+static bool
+jsonIsDigit(char c)
+{
+    return '0' <= c && c <= '9';
+}
+
+static int
+jsonHexValue(char c)
+{
+    if ('0' <= c && c <= '9')
+        return c - '0';
+    if ('a' <= c && c <= 'f')
+        return c - 'a' + 10;
+    if ('A' <= c && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Measures a well-formed UTF-8 sequence,
+ * rejecting overlong forms, surrogates, and out-of-range code points.
+ * @return the sequence length, or 0 if it is invalid.
+ */
+static size_t
+jsonUtf8Size(const unsigned char *p, const unsigned char *end)
+{
+    size_t size;
+    unsigned min;
+    unsigned codepoint;
+    if (0xc2 <= p[0] && p[0] <= 0xdf)
+    {
+        size = 2;
+        min = 0x80;
+        codepoint = p[0] & 0x1f;
+    }
+    else if (0xe0 <= p[0] && p[0] <= 0xef)
+    {
+        size = 3;
+        min = 0x800;
+        codepoint = p[0] & 0x0f;
+    }
+    else if (0xf0 <= p[0] && p[0] <= 0xf4)
+    {
+        size = 4;
+        min = 0x10000;
+        codepoint = p[0] & 0x07;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (end - p < static_cast<ptrdiff_t>(size))
+        return 0;
+    for (size_t i = 1; i < size; ++i)
+    {
+        if (0x80 != (p[i] & 0xc0))
+            return 0;
+        codepoint = codepoint << 6 | (p[i] & 0x3f);
+    }
+    if (codepoint < min || 0x10ffff < codepoint ||
+            (0xd800 <= codepoint && codepoint <= 0xdfff))
+        return 0;
+    return size;
+}
+
+/**
+ * Appends a code point to a string as UTF-8.
+ */
+static void
+jsonUtf8Append(std::string &out, unsigned codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        out += static_cast<char>(codepoint);
+    }
+    else if (codepoint < 0x800)
+    {
+        out += static_cast<char>(0xc0 | codepoint >> 6);
+        out += static_cast<char>(0x80 | (codepoint & 0x3f));
+    }
+    else if (codepoint < 0x10000)
+    {
+        out += static_cast<char>(0xe0 | codepoint >> 12);
+        out += static_cast<char>(0x80 | (codepoint >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (codepoint & 0x3f));
+    }
+    else
+    {
+        out += static_cast<char>(0xf0 | codepoint >> 18);
+        out += static_cast<char>(0x80 | (codepoint >> 12 & 0x3f));
+        out += static_cast<char>(0x80 | (codepoint >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (codepoint & 0x3f));
+    }
+}
+
+/**
+ * Returns true if the text starts with the given literal.
+ */
+static bool
+jsonMatch(const char *p, const char *end, const char *literal)
+{
+    const size_t size = strlen(literal);
+    return size <= static_cast<size_t>(end - p) && !memcmp(p, literal, size);
+}
+
+JsonReader::JsonReader(const char *begin, const char *end):
+    begin_(begin),
+    p_(begin),
+    end_(end),
+    depth_(0),
+    first_(false)
+{
+}
+
+JsonReader::JsonReader(JsonRaw text):
+    JsonReader(text.begin, text.end)
+{
+}
+
+JsonReader::Type
+JsonReader::type()
+{
+    skipSpace();
+    if (end_ == p_)
+        return Type::invalid;
+
+    switch (*p_)
+    {
+    case '{':
+        return Type::object;
+    case '[':
+        return Type::array;
+    case '"':
+        return Type::string;
+    case 't':
+    case 'f':
+        return Type::boolean;
+    case 'n':
+        return Type::null;
+    default:
+        const char *end;
+        bool real;
+        if (!scanNumber(end, real))
+            return Type::invalid;
+        return real ? Type::real : Type::integer;
+    }
+}
+
+Status
+JsonReader::objectBegin()
+{
+    ABC_CHECK(enter());
+    ABC_CHECK(expect('{'));
+    first_ = true;
+    return Status();
+}
+
+Status
+JsonReader::objectNext(bool &more)
+{
+    skipSpace();
+    if (p_ < end_ && '}' == *p_)
+    {
+        ++p_;
+        --depth_;
+        first_ = false;
+        more = false;
+        return Status();
+    }
+
+    if (!first_)
+    {
+        ABC_CHECK(expect(','));
+        skipSpace();
+    }
+    first_ = false;
+
+    if (end_ == p_ || '"' != *p_)
+        return error("Expected an object key");
+    ABC_CHECK(readStringRaw(key_));
+    skipSpace();
+    ABC_CHECK(expect(':'));
+
+    more = true;
+    return Status();
+}
+
+Status
+JsonReader::arrayBegin()
+{
+    ABC_CHECK(enter());
+    ABC_CHECK(expect('['));
+    first_ = true;
+    return Status();
+}
+
+Status
+JsonReader::arrayNext(bool &more)
+{
+    skipSpace();
+    if (p_ < end_ && ']' == *p_)
+    {
+        ++p_;
+        --depth_;
+        first_ = false;
+        more = false;
+        return Status();
+    }
+
+    if (!first_)
+        ABC_CHECK(expect(','));
+    first_ = false;
+
+    more = true;
+    return Status();
+}
+
+Status
+JsonReader::readString(std::string &result)
+{
+    skipSpace();
+    if (end_ == p_ || '"' != *p_)
+        return error("Expected a string");
+    return readStringRaw(result);
+}
+
+Status
+JsonReader::readInteger(int64_t &result)
+{
+    skipSpace();
+    const char *end;
+    bool real;
+    ABC_CHECK(scanNumber(end, real));
+    if (real)
+        return error("Expected an integer");
+
+    // Accumulate negatively, since that range is larger:
+    const bool negative = '-' == *p_;
+    int64_t out = 0;
+    for (const char *p = p_ + negative; p < end; ++p)
+    {
+        const int digit = *p - '0';
+        if (out < (INT64_MIN + digit) / 10)
+            return error("Integer out of range");
+        out = out * 10 - digit;
+    }
+    if (!negative)
+    {
+        if (INT64_MIN == out)
+            return error("Integer out of range");
+        out = -out;
+    }
+
+    p_ = end;
+    result = out;
+    return Status();
+}
+
+Status
+JsonReader::readReal(double &result)
+{
+    skipSpace();
+    const char *end;
+    bool real;
+    ABC_CHECK(scanNumber(end, real));
+
+    // `strtod` needs a terminated string:
+    char buffer[64];
+    std::string big;
+    const size_t size = end - p_;
+    const char *text = buffer;
+    if (size < sizeof(buffer))
+    {
+        memcpy(buffer, p_, size);
+        buffer[size] = 0;
+    }
+    else
+    {
+        big.assign(p_, end);
+        text = big.c_str();
+    }
+
+    const double out = strtod(text, nullptr);
+    if (HUGE_VAL == out || -HUGE_VAL == out)
+        return error("Real number out of range");
+
+    p_ = end;
+    result = out;
+    return Status();
+}
+
+Status
+JsonReader::readBoolean(bool &result)
+{
+    skipSpace();
+    if (jsonMatch(p_, end_, "true"))
+    {
+        p_ += 4;
+        result = true;
+        return Status();
+    }
+    if (jsonMatch(p_, end_, "false"))
+    {
+        p_ += 5;
+        result = false;
+        return Status();
+    }
+    return error("Expected a boolean");
+}
+
+Status
+JsonReader::skip(JsonRaw *raw)
+{
+    skipSpace();
+    const char *start = p_;
+
+    switch (type())
+    {
+    case Type::object:
+    {
+        ABC_CHECK(objectBegin());
+        bool more;
+        while (true)
+        {
+            ABC_CHECK(objectNext(more));
+            if (!more)
+                break;
+            ABC_CHECK(skip());
+        }
+        break;
+    }
+    case Type::array:
+    {
+        ABC_CHECK(arrayBegin());
+        bool more;
+        while (true)
+        {
+            ABC_CHECK(arrayNext(more));
+            if (!more)
+                break;
+            ABC_CHECK(skip());
+        }
+        break;
+    }
+    case Type::string:
+    {
+        std::string ignored;
+        ABC_CHECK(readStringRaw(ignored));
+        break;
+    }
+    case Type::integer:
+    case Type::real:
+    {
+        const char *end;
+        bool real;
+        ABC_CHECK(scanNumber(end, real));
+        p_ = end;
+        break;
+    }
+    case Type::boolean:
+    {
+        bool ignored;
+        ABC_CHECK(readBoolean(ignored));
+        break;
+    }
+    case Type::null:
+        if (!jsonMatch(p_, end_, "null"))
+            return error("Invalid literal");
+        p_ += 4;
+        break;
+    default:
+        return error("Expected a value");
+    }
+
+    if (raw)
+        *raw = JsonRaw(start, p_);
+    return Status();
+}
+
+Status
+JsonReader::end()
+{
+    skipSpace();
+    if (end_ != p_)
+        return error("Unexpected text after the end");
+    return Status();
+}
+
+void
+JsonReader::skipSpace()
+{
+    while (p_ < end_ && jsonIsSpace(*p_))
+        ++p_;
+}
+
+Status
+JsonReader::expect(char c)
+{
+    if (end_ == p_ || c != *p_)
+        return error(std::string("Expected '") + c + "'");
+    ++p_;
+    return Status();
+}
+
+Status
+JsonReader::error(const std::string &message) const
+{
+    return ABC_ERROR(ABC_CC_JSONError, message + " at offset " +
+                     std::to_string(p_ - begin_));
+}
+
+Status
+JsonReader::scanNumber(const char *&end, bool &real) const
+{
+    const char *p = p_;
+    real = false;
+
+    if (p < end_ && '-' == *p)
+        ++p;
+    if (end_ == p || !jsonIsDigit(*p))
+        return error("Invalid number");
+    if ('0' == *p)
+    {
+        ++p;
+        if (p < end_ && jsonIsDigit(*p))
+            return error("Invalid number");
+    }
+    while (p < end_ && jsonIsDigit(*p))
+        ++p;
+
+    if (p < end_ && '.' == *p)
+    {
+        real = true;
+        ++p;
+        if (end_ == p || !jsonIsDigit(*p))
+            return error("Invalid number");
+        while (p < end_ && jsonIsDigit(*p))
+            ++p;
+    }
+
+    if (p < end_ && ('e' == *p || 'E' == *p))
+    {
+        real = true;
+        ++p;
+        if (p < end_ && ('+' == *p || '-' == *p))
+            ++p;
+        if (end_ == p || !jsonIsDigit(*p))
+            return error("Invalid number");
+        while (p < end_ && jsonIsDigit(*p))
+            ++p;
+    }
+
+    end = p;
+    return Status();
+}
+
+Status
+JsonReader::readStringRaw(std::string &result)
+{
+    ++p_; // Opening quote
+    result.clear();
+
+    while (true)
+    {
+        // Copy plain runs in bulk:
+        const char *run = p_;
+        while (p_ < end_ && '"' != *p_ && '\\' != *p_ &&
+                0x20 <= static_cast<unsigned char>(*p_))
+        {
+            if (0x80 <= static_cast<unsigned char>(*p_))
+            {
+                const size_t size = jsonUtf8Size(
+                                        reinterpret_cast<const unsigned char *>(p_),
+                                        reinterpret_cast<const unsigned char *>(end_));
+                if (!size)
+                    return error("Invalid UTF-8");
+                p_ += size;
+            }
+            else
+            {
+                ++p_;
+            }
+        }
+        result.append(run, p_);
+
+        if (end_ == p_)
+            return error("Unterminated string");
+        if ('"' == *p_)
+        {
+            ++p_;
+            return Status();
+        }
+        if ('\\' != *p_)
+            return error("Control character in string");
+
+        // Escape sequences:
+        ++p_;
+        if (end_ == p_)
+            return error("Unterminated string");
+        switch (*p_++)
+        {
+        case '"':
+            result += '"';
+            break;
+        case '\\':
+            result += '\\';
+            break;
+        case '/':
+            result += '/';
+            break;
+        case 'b':
+            result += '\b';
+            break;
+        case 'f':
+            result += '\f';
+            break;
+        case 'n':
+            result += '\n';
+            break;
+        case 'r':
+            result += '\r';
+            break;
+        case 't':
+            result += '\t';
+            break;
+        case 'u':
+        {
+            auto hex4 = [this](unsigned &out) -> bool
+            {
+                if (end_ - p_ < 4)
+                    return false;
+                out = 0;
+                for (int i = 0; i < 4; ++i)
+                {
+                    const int value = jsonHexValue(p_[i]);
+                    if (value < 0)
+                        return false;
+                    out = out << 4 | value;
+                }
+                p_ += 4;
+                return true;
+            };
+
+            unsigned codepoint;
+            if (!hex4(codepoint))
+                return error("Invalid \\u escape");
+            if (0xd800 <= codepoint && codepoint <= 0xdbff)
+            {
+                unsigned low;
+                if (!jsonMatch(p_, end_, "\\u"))
+                    return error("Unpaired surrogate");
+                p_ += 2;
+                if (!hex4(low) || low < 0xdc00 || 0xdfff < low)
+                    return error("Unpaired surrogate");
+                codepoint = 0x10000 + ((codepoint - 0xd800) << 10) +
+                            (low - 0xdc00);
+            }
+            else if (0xdc00 <= codepoint && codepoint <= 0xdfff)
+            {
+                return error("Unpaired surrogate");
+            }
+            if (!codepoint)
+                return error("\\u0000 is not allowed");
+            jsonUtf8Append(result, codepoint);
+            break;
+        }
+        default:
+            return error("Invalid escape");
+        }
+    }
+}
+
+Status
+JsonReader::enter()
+{
+    if (jsonMaxDepth <= depth_)
+        return error("Too deeply nested");
+    ++depth_;
+    return Status();
+}
+
+JsonWriter::JsonWriter(std::string &out, bool compact):
+    out_(out),
+    compact_(compact),
+    depth_(0),
+    first_(false),
+    afterKey_(false)
+{
+}
+
+void
+JsonWriter::objectBegin()
+{
+    element();
+    out_ += '{';
+    ++depth_;
+    first_ = true;
+}
+
+void
+JsonWriter::key(const char *key)
+{
+    element();
+    quote(key, key + strlen(key));
+    out_ += compact_ ? ":" : ": ";
+    afterKey_ = true;
+}
+
+void
+JsonWriter::objectEnd()
+{
+    --depth_;
+    if (!first_)
+        indent();
+    out_ += '}';
+    first_ = false;
+}
+
+void
+JsonWriter::arrayBegin()
+{
+    element();
+    out_ += '[';
+    ++depth_;
+    first_ = true;
+}
+
+void
+JsonWriter::arrayEnd()
+{
+    --depth_;
+    if (!first_)
+        indent();
+    out_ += ']';
+    first_ = false;
+}
+
+void
+JsonWriter::string(const std::string &value)
+{
+    element();
+    quote(value.data(), value.data() + value.size());
+}
+
+void
+JsonWriter::integer(int64_t value)
+{
+    element();
+
+    // Format backwards, working with negative numbers to cover INT64_MIN:
+    char buffer[24];
+    char *p = buffer + sizeof(buffer);
+    int64_t n = 0 < value ? -value : value;
+    do
+    {
+        *--p = static_cast<char>('0' - n % 10);
+        n /= 10;
+    }
+    while (n);
+    if (value < 0)
+        *--p = '-';
+    out_.append(p, buffer + sizeof(buffer));
+}
+
+void
+JsonWriter::real(double value)
+{
+    element();
+
+    // This matches jansson's formatting exactly:
+    char buffer[32];
+    int size = snprintf(buffer, sizeof(buffer), "%.17g", value);
+    if (!strchr(buffer, '.') && !strchr(buffer, 'e'))
+    {
+        buffer[size++] = '.';
+        buffer[size++] = '0';
+        buffer[size] = 0;
+    }
+
+    // Drop any '+' or leading zeros from the exponent:
+    char *start = strchr(buffer, 'e');
+    if (start)
+    {
+        ++start;
+        char *end = start + 1;
+        if ('-' == *start)
+            ++start;
+        while ('0' == *end)
+            ++end;
+        if (end != start)
+        {
+            memmove(start, end, size - (end - buffer) + 1);
+            size -= end - start;
+        }
+    }
+    out_.append(buffer, size);
+}
+
+void
+JsonWriter::boolean(bool value)
+{
+    element();
+    out_ += value ? "true" : "false";
+}
+
+void
+JsonWriter::null()
+{
+    element();
+    out_ += "null";
+}
+
+void
+JsonWriter::raw(JsonRaw value)
+{
+    if (value.empty())
+        return null();
+
+    element();
+    out_.append(value.begin, value.end);
+}
+
+void
+JsonWriter::element()
+{
+    if (afterKey_)
+    {
+        afterKey_ = false;
+        return;
+    }
+    if (!depth_)
+        return;
+
+    if (!first_)
+        out_ += ',';
+    indent();
+    first_ = false;
+}
+
+void
+JsonWriter::indent()
+{
+    if (!compact_)
+    {
+        out_ += '\n';
+        out_.append(depth_, ' ');
+    }
+}
+
+void
+JsonWriter::quote(const char *begin, const char *end)
+{
+    out_ += '"';
+    while (begin < end)
+    {
+        const char *run = begin;
+        while (begin < end && '"' != *begin && '\\' != *begin &&
+                0x20 <= static_cast<unsigned char>(*begin))
+            ++begin;
+        out_.append(run, begin);
+        if (end == begin)
+            break;
+
+        const char c = *begin++;
+        switch (c)
+        {
+        case '"':
+            out_ += "\\\"";
+            break;
+        case '\\':
+            out_ += "\\\\";
+            break;
+        case '\b':
+            out_ += "\\b";
+            break;
+        case '\f':
+            out_ += "\\f";
+            break;
+        case '\n':
+            out_ += "\\n";
+            break;
+        case '\r':
+            out_ += "\\r";
+            break;
+        case '\t':
+            out_ += "\\t";
+            break;
+        default:
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04X", c);
+            out_ += escape;
+            break;
+        }
+    }
+    out_ += '"';
+}
+
+bool
+jsonAccepts(JsonReader::Type type, const std::string *)
+{
+    return JsonReader::Type::string == type;
+}
+
+bool
+jsonAccepts(JsonReader::Type type, const int64_t *)
+{
+    return JsonReader::Type::integer == type;
+}
+
+bool
+jsonAccepts(JsonReader::Type type, const double *)
+{
+    return JsonReader::Type::integer == type || JsonReader::Type::real == type;
+}
+
+bool
+jsonAccepts(JsonReader::Type type, const bool *)
+{
+    return JsonReader::Type::boolean == type;
+}
+
+bool
+jsonAccepts(JsonReader::Type type, const JsonRaw *)
+{
+    return JsonReader::Type::invalid != type;
+}
+
+Status
+jsonRead(std::string &out, JsonReader &in)
+{
+    return in.readString(out);
+}
+
+Status
+jsonRead(int64_t &out, JsonReader &in)
+{
+    return in.readInteger(out);
+}
+
+Status
+jsonRead(double &out, JsonReader &in)
+{
+    return in.readReal(out);
+}
+
+Status
+jsonRead(bool &out, JsonReader &in)
+{
+    return in.readBoolean(out);
+}
+
+Status
+jsonRead(JsonRaw &out, JsonReader &in)
+{
+    return in.skip(&out);
+}
+
+void
+jsonWrite(JsonWriter &out, const std::string &in)
+{
+    out.string(in);
+}
+
+void
+jsonWrite(JsonWriter &out, int64_t in)
+{
+    out.integer(in);
+}
+
+void
+jsonWrite(JsonWriter &out, double in)
+{
+    out.real(in);
+}
+
+void
+jsonWrite(JsonWriter &out, bool in)
+{
+    out.boolean(in);
+}
+
+void
+jsonWrite(JsonWriter &out, const JsonRaw &in)
+{
+    out.raw(in);
+}
+
+Status
+jsonLoadText(std::string &result, const std::string &path)
+{
+    DataChunk data;
+    ABC_CHECK(fileLoad(data, path));
+    result.assign(data.begin(), data.end());
+    return Status();
+}
+
+Status
+jsonSaveText(const std::string &text, const std::string &path)
+{
+    ABC_CHECK(fileSave(text, path));
+    return Status();
+}
+
+} // namespace abcd
@@ -0,0 +1,519 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * A schema-driven JSON codec for frequently-used record types.
+ *
+ * The `JsonObject` accessors build a full jansson tree,
+ * and then look up each key by hash every time it is accessed.
+ * This codec parses text directly into plain C++ structs instead,
+ * and writes them directly back out again.
+ *
+ * Each record lists its fields in a constexpr table,
+ * sorted the same way jansson sorts keys when saving,
+ * so the output is byte-for-byte identical to `JsonPtr::encode`.
+ * Unknown keys are skipped, and keys with the wrong type
+ * leave the field at its default, just like the `JsonObject` fallbacks.
+ *
+ * Unlike jansson, this does not wipe its buffers when freeing them,
+ * so it should only be used for public data.
+ */
+
+#ifndef ABCD_JSON_JSON_CODEC_HPP
+#define ABCD_JSON_JSON_CODEC_HPP
+
+#include "../util/Status.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace abcd {
+
+/**
+ * The unparsed text of a single JSON value.
+ * This points into the decoded text, so it is only valid as long as that is.
+ */
+struct JsonRaw
+{
+    const char *begin;
+    const char *end;
+
+    JsonRaw(): begin(nullptr), end(nullptr) {}
+    JsonRaw(const char *begin, const char *end): begin(begin), end(end) {}
+
+    bool empty() const { return begin == end; }
+    std::string str() const { return std::string(begin, end); }
+};
+
+/**
+ * A streaming JSON parser.
+ * The caller pulls one value at a time, in document order,
+ * without ever building a tree.
+ */
+class JsonReader
+{
+public:
+    enum class Type
+    {
+        invalid,
+        object,
+        array,
+        string,
+        integer,
+        real,
+        boolean,
+        null
+    };
+
+    JsonReader(const char *begin, const char *end);
+    JsonReader(JsonRaw text);
+
+    /**
+     * Identifies the next value without consuming it.
+     */
+    Type
+    type();
+
+    /**
+     * Consumes the opening brace of an object.
+     */
+    Status
+    objectBegin();
+
+    /**
+     * Advances to the next key in an object, which `key` then returns.
+     * @param more set to false once the closing brace has been consumed.
+     */
+    Status
+    objectNext(bool &more);
+
+    /**
+     * The key found by the last `objectNext` call.
+     */
+    const std::string &key() const { return key_; }
+
+    /**
+     * Consumes the opening bracket of an array.
+     */
+    Status
+    arrayBegin();
+
+    /**
+     * Advances to the next item in an array.
+     * @param more set to false once the closing bracket has been consumed.
+     */
+    Status
+    arrayNext(bool &more);
+
+    // Scalar values:
+    Status readString(std::string &result);
+    Status readInteger(int64_t &result);
+    Status readReal(double &result);
+    Status readBoolean(bool &result);
+
+    /**
+     * Consumes the next value, whatever it happens to be.
+     * @param raw if provided, receives the text of the skipped value.
+     */
+    Status
+    skip(JsonRaw *raw=nullptr);
+
+    /**
+     * Verifies that nothing but whitespace remains.
+     */
+    Status
+    end();
+
+private:
+    const char *begin_;
+    const char *p_;
+    const char *end_;
+    unsigned depth_;
+    bool first_;
+    std::string key_;
+
+    void skipSpace();
+    Status expect(char c);
+    Status error(const std::string &message) const;
+    Status scanNumber(const char *&end, bool &real) const;
+    Status readStringRaw(std::string &result);
+    Status enter();
+};
+
+/**
+ * A streaming JSON writer, producing the same formatting as jansson.
+ */
+class JsonWriter
+{
+public:
+    /**
+     * @param compact matches the `compact` flag of `JsonPtr::encode`.
+     */
+    JsonWriter(std::string &out, bool compact=false);
+
+    void objectBegin();
+    void key(const char *key);
+    void objectEnd();
+
+    void arrayBegin();
+    void arrayEnd();
+
+    void string(const std::string &value);
+    void integer(int64_t value);
+    void real(double value);
+    void boolean(bool value);
+    void null();
+
+    /**
+     * Copies an already-encoded value through unchanged,
+     * including its original whitespace.
+     * An empty value is written as null.
+     */
+    void raw(JsonRaw value);
+
+private:
+    std::string &out_;
+    bool compact_;
+    unsigned depth_;
+    bool first_;
+    bool afterKey_;
+
+    void element();
+    void indent();
+    void quote(const char *begin, const char *end);
+};
+
+/**
+ * Describes how one member of a record maps to a JSON key.
+ * Build these with the `ABC_JSON_FIELD` macros.
+ */
+template<typename T>
+struct JsonField
+{
+    const char *key;
+    Status (*read)(T &out, JsonReader &in);
+    void (*write)(JsonWriter &out, const T &in);
+    bool (*omit)(const T &in);
+};
+
+/**
+ * A record's complete field table.
+ * Records provide this as a static `schema` member.
+ */
+template<typename T>
+struct JsonSchema
+{
+    const JsonField<T> *fields;
+    size_t size;
+
+    template<size_t N>
+    constexpr JsonSchema(const JsonField<T> (&fields)[N]):
+        fields(fields), size(N)
+    {}
+};
+
+/**
+ * Compares keys the same way as the `strcmp` jansson uses for sorting.
+ */
+constexpr bool
+jsonKeyLess(const char *a, const char *b)
+{
+    return *a != *b ?
+           static_cast<unsigned char>(*a) < static_cast<unsigned char>(*b) :
+           *a && jsonKeyLess(a + 1, b + 1);
+}
+
+/**
+ * Returns true if a field table is in jansson's output order.
+ */
+template<typename T, size_t N>
+constexpr bool
+jsonSorted(const JsonField<T> (&fields)[N], size_t i=1)
+{
+    return N <= i ||
+           (jsonKeyLess(fields[i - 1].key, fields[i].key) &&
+            jsonSorted(fields, i + 1));
+}
+
+// Scalar and container support:
+
+bool jsonAccepts(JsonReader::Type type, const std::string *);
+bool jsonAccepts(JsonReader::Type type, const int64_t *);
+bool jsonAccepts(JsonReader::Type type, const double *);
+bool jsonAccepts(JsonReader::Type type, const bool *);
+bool jsonAccepts(JsonReader::Type type, const JsonRaw *);
+template<typename R>
+bool jsonAccepts(JsonReader::Type type, const std::vector<R> *);
+template<typename T>
+auto jsonAccepts(JsonReader::Type type, const T *) ->
+decltype(T::schema, bool());
+
+Status jsonRead(std::string &out, JsonReader &in);
+Status jsonRead(int64_t &out, JsonReader &in);
+Status jsonRead(double &out, JsonReader &in);
+Status jsonRead(bool &out, JsonReader &in);
+Status jsonRead(JsonRaw &out, JsonReader &in);
+template<typename R>
+Status jsonRead(std::vector<R> &out, JsonReader &in);
+template<typename T>
+auto jsonRead(T &out, JsonReader &in) -> decltype(T::schema, Status());
+
+void jsonWrite(JsonWriter &out, const std::string &in);
+void jsonWrite(JsonWriter &out, int64_t in);
+void jsonWrite(JsonWriter &out, double in);
+void jsonWrite(JsonWriter &out, bool in);
+void jsonWrite(JsonWriter &out, const JsonRaw &in);
+template<typename R>
+void jsonWrite(JsonWriter &out, const std::vector<R> &in);
+template<typename T>
+auto jsonWrite(JsonWriter &out, const T &in) -> decltype(T::schema, void());
+
+template<typename R>
+bool
+jsonAccepts(JsonReader::Type type, const std::vector<R> *)
+{
+    return JsonReader::Type::array == type;
+}
+
+template<typename T>
+auto
+jsonAccepts(JsonReader::Type type, const T *) -> decltype(T::schema, bool())
+{
+    return JsonReader::Type::object == type;
+}
+
+/**
+ * Reads a value if it has the right type, or skips it otherwise.
+ */
+template<typename M>
+Status
+jsonReadLenient(M &out, JsonReader &in)
+{
+    if (!jsonAccepts(in.type(), &out))
+        return in.skip();
+    return jsonRead(out, in);
+}
+
+template<typename R>
+Status
+jsonRead(std::vector<R> &out, JsonReader &in)
+{
+    out.clear();
+    ABC_CHECK(in.arrayBegin());
+    while (true)
+    {
+        bool more;
+        ABC_CHECK(in.arrayNext(more));
+        if (!more)
+            break;
+
+        // Items with the wrong type are left out:
+        if (!jsonAccepts(in.type(), static_cast<const R *>(nullptr)))
+        {
+            ABC_CHECK(in.skip());
+            continue;
+        }
+        out.emplace_back();
+        ABC_CHECK(jsonRead(out.back(), in));
+    }
+    return Status();
+}
+
+template<typename T>
+auto
+jsonRead(T &out, JsonReader &in) -> decltype(T::schema, Status())
+{
+    const auto &schema = T::schema;
+    out = T();
+
+    // Keys usually arrive in sorted order,
+    // so try the one after the last match first:
+    size_t hint = 0;
+    ABC_CHECK(in.objectBegin());
+    while (true)
+    {
+        bool more;
+        ABC_CHECK(in.objectNext(more));
+        if (!more)
+            break;
+
+        const JsonField<T> *field = nullptr;
+        for (size_t i = 0; i < schema.size; ++i)
+        {
+            const auto &candidate = schema.fields[(hint + i) % schema.size];
+            if (in.key() == candidate.key)
+            {
+                field = &candidate;
+                break;
+            }
+        }
+
+        if (field)
+        {
+            ABC_CHECK(field->read(out, in));
+            hint = field - schema.fields + 1;
+        }
+        else
+        {
+            ABC_CHECK(in.skip());
+        }
+    }
+    return Status();
+}
+
+template<typename R>
+void
+jsonWrite(JsonWriter &out, const std::vector<R> &in)
+{
+    out.arrayBegin();
+    for (const auto &item: in)
+        jsonWrite(out, item);
+    out.arrayEnd();
+}
+
+template<typename T>
+auto
+jsonWrite(JsonWriter &out, const T &in) -> decltype(T::schema, void())
+{
+    const auto &schema = T::schema;
+
+    out.objectBegin();
+    for (size_t i = 0; i < schema.size; ++i)
+    {
+        const auto &field = schema.fields[i];
+        if (field.omit && field.omit(in))
+            continue;
+        out.key(field.key);
+        field.write(out, in);
+    }
+    out.objectEnd();
+}
+
+// Member accessors for the field tables:
+
+template<typename T, typename M, M T::*member>
+Status
+jsonReadMember(T &out, JsonReader &in)
+{
+    return jsonReadLenient(out.*member, in);
+}
+
+template<typename T, typename M, M T::*member>
+void
+jsonWriteMember(JsonWriter &out, const T &in)
+{
+    jsonWrite(out, in.*member);
+}
+
+template<typename T, typename M, M T::*member>
+bool
+jsonOmitMember(const T &in)
+{
+    static const T defaults = T();
+    return defaults.*member == in.*member;
+}
+
+/**
+ * A field that is always written.
+ */
+#define ABC_JSON_FIELD(Type, member, key) \
+    { key, \
+      &abcd::jsonReadMember<Type, decltype(Type::member), &Type::member>, \
+      &abcd::jsonWriteMember<Type, decltype(Type::member), &Type::member>, \
+      nullptr }
+
+/**
+ * A field that is left out when it holds its default value.
+ */
+#define ABC_JSON_FIELD_OPTIONAL(Type, member, key) \
+    { key, \
+      &abcd::jsonReadMember<Type, decltype(Type::member), &Type::member>, \
+      &abcd::jsonWriteMember<Type, decltype(Type::member), &Type::member>, \
+      &abcd::jsonOmitMember<Type, decltype(Type::member), &Type::member> }
+
+/**
+ * Defines the `schema` member of a record.
+ * The record needs a matching `static const JsonSchema<Type> schema;`
+ * declaration, and the fields must be listed in sorted order.
+ */
+#define ABC_JSON_SCHEMA(Type, ...) \
+    constexpr abcd::JsonField<Type> Type##Fields[] = { __VA_ARGS__ }; \
+    static_assert(abcd::jsonSorted(Type##Fields), \
+                  #Type " fields must be sorted by key"); \
+    const abcd::JsonSchema<Type> Type::schema(Type##Fields)
+
+// Whole documents:
+
+/**
+ * Decodes a complete JSON document, which can be any type of value.
+ * Fails if the top-level value has the wrong type.
+ */
+template<typename T>
+Status
+jsonDecode(T &result, JsonRaw text)
+{
+    JsonReader in(text);
+    if (!jsonAccepts(in.type(), &result))
+        return ABC_ERROR(ABC_CC_JSONError, "Wrong JSON type");
+    ABC_CHECK(jsonRead(result, in));
+    ABC_CHECK(in.end());
+    return Status();
+}
+
+template<typename T>
+Status
+jsonDecode(T &result, const std::string &text)
+{
+    return jsonDecode(result, JsonRaw(text.data(), text.data() + text.size()));
+}
+
+/**
+ * Encodes a value, formatted the same way as `JsonPtr::encode`.
+ */
+template<typename T>
+std::string
+jsonEncode(const T &value, bool compact=false)
+{
+    std::string out;
+    JsonWriter writer(out, compact);
+    jsonWrite(writer, value);
+    return out;
+}
+
+/**
+ * Loads a value from disk.
+ */
+Status
+jsonLoadText(std::string &result, const std::string &path);
+
+template<typename T>
+Status
+jsonLoad(T &result, const std::string &path)
+{
+    std::string text;
+    ABC_CHECK(jsonLoadText(text, path));
+    ABC_CHECK(jsonDecode(result, text));
+    return Status();
+}
+
+/**
+ * Saves a value to disk, formatted the same way as `JsonPtr::save`.
+ */
+Status
+jsonSaveText(const std::string &text, const std::string &path);
+
+template<typename T>
+Status
+jsonSave(const T &value, const std::string &path)
+{
+    ABC_CHECK(jsonSaveText(jsonEncode(value), path));
+    return Status();
+}
+
+} // namespace abcd
+
+#endif
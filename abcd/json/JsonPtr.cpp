@@ -8,7 +8,6 @@
 #include "JsonPtr.hpp"
 #include "JsonBox.hpp"
 #include "../crypto/Crypto.hpp"
-#include "../util/Debug.hpp"
 #include "../util/FileIO.hpp"
 #include "../util/Util.hpp"
 #include <new>
@@ -112,8 +111,14 @@ JsonPtr::clone() const
 Status
 JsonPtr::load(const std::string &path)
 {
+    // This goes through `fileLoad` to pick up any queued saves:
+    DataChunk data;
+    ABC_CHECK(fileLoad(data, path));
+
     json_error_t error;
-    json_t *root = json_load_file(path.c_str(), loadFlags, &error);
+    json_t *root = json_loadb(reinterpret_cast<char *>(data.data()),
+                              data.size(), loadFlags, &error);
+    ABC_UtilGuaranteedMemset(data.data(), 0, data.size());
     if (!root)
         return ABC_ERROR(ABC_CC_JSONError, error.text);
     reset(root);
@@ -147,16 +152,7 @@ JsonPtr::decode(const std::string &data)
 Status
 JsonPtr::save(const std::string &path) const
 {
-    ABC_DebugLog("Writing JSON file %s", path.c_str());
-
-    const auto pathTmp = path + ".tmp";
-    if (json_dump_file(root_, pathTmp.c_str(), saveFlags))
-        return ABC_ERROR(ABC_CC_FileWriteError, "Cannot write " + pathTmp);
-
-    if (rename(pathTmp.c_str(), path.c_str()))
-        return ABC_ERROR(ABC_CC_FileWriteError,
-                         "Cannot rename " + pathTmp + " to " + path);
-
+    ABC_CHECK(fileSave(encode(), path));
     return Status();
 }
 
@@ -176,6 +172,26 @@ JsonPtr::save(const std::string &path, DataSlice dataKey) const
     return Status();
 }
 
+Status
+JsonPtr::saveLater(const std::string &path) const
+{
+    ABC_CHECK(fileSaveLater(encode(), path));
+    return Status();
+}
+
+Status
+JsonPtr::saveLater(const std::string &path, DataSlice dataKey) const
+{
+    auto data = encode();
+    data.push_back(0); // See `save` above
+
+    JsonBox box;
+    ABC_CHECK(box.encrypt(data, dataKey));
+    ABC_CHECK(box.saveLater(path));
+
+    return Status();
+}
+
 std::string
 JsonPtr::encode(bool compact) const
 {
@@ -81,6 +81,19 @@ public:
     Status
     save(const std::string &path, DataSlice dataKey) const;
 
+    /**
+     * Queues the JSON object to be saved by the background writer.
+     * See `fileSaveLater` for when this is appropriate.
+     */
+    Status
+    saveLater(const std::string &path) const;
+
+    /**
+     * Queues the JSON object to be saved using encryption.
+     */
+    Status
+    saveLater(const std::string &path, DataSlice dataKey) const;
+
     /**
      * Saves the JSON object to an in-memory string.
      */
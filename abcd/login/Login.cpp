@@ -177,8 +177,8 @@ Login::createNew(const char *password)
     {
         std::string LP = store.username() + password;
 
-        // Generate passwordAuth:
-        ABC_CHECK(usernameSnrp().hash(passwordAuth_, LP));
+        // Generate passwordAuth, in parallel with passwordKey:
+        ScryptFuture passwordAuthFuture(usernameSnrp(), LP);
 
         // We have a password, so use it to encrypt dataKey:
         DataChunk passwordKey;
@@ -186,6 +186,7 @@ Login::createNew(const char *password)
         ABC_CHECK(carePackage.passwordKeySnrp().hash(passwordKey, LP));
         ABC_CHECK(passwordBox.encrypt(dataKey_, passwordKey));
         ABC_CHECK(loginPackage.passwordBoxSet(passwordBox));
+        ABC_CHECK(passwordAuthFuture.get(passwordAuth_));
     }
     else
     {
@@ -90,18 +90,22 @@ loginPasswordSet(Login &login, const std::string &password)
 {
     std::string LP = login.store.username() + password;
 
-    // Create passwordBox:
+    // Create passwordBox.
+    // The snrp timing must run alone, so it sees the real hash speed:
     JsonSnrp passwordKeySnrp;
     DataChunk passwordKey;
     JsonBox passwordBox;
     ABC_CHECK(passwordKeySnrp.create());
+
+    // Generate passwordAuth, in parallel with passwordKey:
+    ScryptFuture passwordAuthFuture(usernameSnrp(), LP);
     ABC_CHECK(passwordKeySnrp.hash(passwordKey, LP));
     ABC_CHECK(passwordBox.encrypt(login.dataKey(), passwordKey));
 
     // Create passwordAuth:
     DataChunk passwordAuth;
     JsonBox passwordAuthBox;
-    ABC_CHECK(usernameSnrp().hash(passwordAuth, LP));
+    ABC_CHECK(passwordAuthFuture.get(passwordAuth));
     ABC_CHECK(passwordAuthBox.encrypt(passwordAuth, login.dataKey()));
 
     // Change the server login:
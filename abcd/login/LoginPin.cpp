@@ -81,6 +81,11 @@ loginPin(std::shared_ptr<Login> &result,
     DataChunk pinAuthId;
     ABC_CHECK(local.pinAuthIdDecode(pinAuthId));
 
+    // Start pinKeyKey, which can run while we talk to the server:
+    ScryptSnrp pinKeyKeySnrp;
+    ABC_CHECK(carePackage.passwordKeySnrp().snrpGet(pinKeyKeySnrp));
+    ScryptFuture pinKeyKeyFuture(pinKeyKeySnrp, LPIN);
+
     // Get EPINK from the server:
     std::string EPINK;
     DataChunk pinAuthKey;       // Unlocks the server
@@ -94,7 +99,7 @@ loginPin(std::shared_ptr<Login> &result,
     DataChunk pinKeyKey;        // Unlocks pinKey
     DataChunk pinKey;           // Unlocks dataKey
     DataChunk dataKey;          // Unlocks the account
-    ABC_CHECK(carePackage.passwordKeySnrp().hash(pinKeyKey, LPIN));
+    ABC_CHECK(pinKeyKeyFuture.get(pinKeyKey));
     ABC_CHECK(pinKeyBox.decrypt(pinKey, pinKeyKey));
     ABC_CHECK(local.pinBox().decrypt(dataKey, pinKey));
 
@@ -90,6 +90,9 @@ loginRecoverySet(Login &login,
     ABC_CHECK(snrp.create());
     ABC_CHECK(carePackage.questionKeySnrpSet(snrp));
 
+    // Start recoveryAuth, which only depends on the answers:
+    ScryptFuture recoveryAuthFuture(usernameSnrp(), LRA);
+
     // Make questionKey (unlocks questions):
     DataChunk questionKey;
     ABC_CHECK(carePackage.questionKeySnrp().hash(questionKey,
@@ -111,7 +114,7 @@ loginRecoverySet(Login &login,
 
     // Make recoveryAuth (unlocks the server):
     DataChunk recoveryAuth;
-    ABC_CHECK(usernameSnrp().hash(recoveryAuth, LRA));
+    ABC_CHECK(recoveryAuthFuture.get(recoveryAuth));
 
     // Change the server login:
     ABC_CHECK(loginServerChangePassword(login, passwordAuth, recoveryAuth,
@@ -13,15 +13,22 @@
 #include "../http/HttpRequest.hpp"
 #include "../json/JsonObject.hpp"
 #include "../util/Debug.hpp"
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <memory>
 #include <mutex>
-#include <thread>
 
 namespace abcd {
 
+/**
+ * The longest an HTTP broadcast can take, in seconds,
+ * so slow servers cannot hold up the caller.
+ */
+constexpr long broadcastTimeout = 30;
+
 static Status
-insightPostTx(DataSlice tx)
+insightPostTx(HttpRequest &request, DataSlice tx, HttpCallback callback)
 {
     std::string body = "rawtx=" + base16Encode(tx);
 
@@ -29,121 +36,178 @@ insightPostTx(DataSlice tx)
                       "https://test-insight.bitpay.com/api/tx/send":
                       "https://insight.bitpay.com/api/tx/send";
 
-    HttpReply reply;
-    ABC_CHECK(HttpRequest().
-              post(reply, url, body));
-    ABC_CHECK(reply.codeOk());
+    ABC_CHECK(request.
+              postAsync(url, body, callback));
 
     return Status();
 }
 
 static Status
-blockchainPostTx(DataSlice tx)
+blockchainPostTx(HttpRequest &request, DataSlice tx, HttpCallback callback)
 {
     std::string body = "tx=" + base16Encode(tx);
     if (isTestnet())
         return ABC_ERROR(ABC_CC_Error, "No blockchain.info testnet");
 
-    HttpReply reply;
-    ABC_CHECK(HttpRequest().
+    ABC_CHECK(request.
               header("Content-Type", "application/x-www-form-urlencoded").
-              post(reply, "https://blockchain.info/pushtx", body));
-    ABC_CHECK(reply.codeOk());
+              postAsync("https://blockchain.info/pushtx", body, callback));
 
     return Status();
 }
 
 /**
- * Contains a condition variable and its associated mutex.
- * The mutex protects access to some piece of shared data,
- * and the condition variable triggers a wakeup when the data is modified.
+ * The state of one broadcast, shared between the caller
+ * and everything sending the transaction out.
  */
-struct Syncer
+struct BroadcastAttempt
 {
     std::condition_variable cv;
     std::mutex mutex;
+
+    /** Set on the first success, so the other attempts can stop. */
+    std::atomic<bool> cancelled{false};
+
+    // Protected by the mutex:
+    size_t pending = 0;
+    bool success = false;
+    Status error;
 };
 
 /**
- * Holds the return value from a long-running background task,
- * and a flag indicating if the task is done yet.
+ * One place to send transactions,
+ * along with its track record.
  */
-struct DelayedStatus
+struct BroadcastEndpoint
 {
-    bool done = false;
-    Status status;
+    typedef Status (*Post)(HttpRequest &request, DataSlice tx,
+                           HttpCallback callback);
+
+    const char *name;
+    Post post;
+
+    // Protected by the mutex:
+    std::mutex mutex;
+    unsigned successes = 0;
+    unsigned failures = 0;
+    std::chrono::milliseconds latency{0};
+
+    BroadcastEndpoint(const char *name, Post post):
+        name(name), post(post)
+    {}
 };
 
+static BroadcastEndpoint gBlockchain{"blockchain.info", blockchainPostTx};
+static BroadcastEndpoint gInsight{"insight", insightPostTx};
+static BroadcastEndpoint gStratum{"stratum", nullptr};
+
 /**
- * A long-running broadcast task.
- * @param condition Guards access to the status,
- * and signals when the task is done.
- * @param status Holds the status of the task.
+ * Records the outcome of one broadcast attempt,
+ * waking the caller if the broadcast is now decided.
  */
-template<Status (*f)(DataSlice tx)> static void
-broadcastTask(std::shared_ptr<Syncer> syncer,
-              std::shared_ptr<DelayedStatus> status, DataChunk tx)
+static void
+broadcastDone(BroadcastEndpoint &endpoint,
+              std::shared_ptr<BroadcastAttempt> attempt, Status s,
+              std::chrono::steady_clock::time_point start)
 {
-    auto result = f(tx);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - start);
+
+    // Attempts cut short by another endpoint's success don't count:
+    if (s || !attempt->cancelled)
+    {
+        std::lock_guard<std::mutex> lock(endpoint.mutex);
+        if (s)
+        {
+            // Keep a moving average of the successful round trips:
+            endpoint.latency = endpoint.successes ?
+                               (3 * endpoint.latency + elapsed) / 4 : elapsed;
+            ++endpoint.successes;
+            ABC_DebugLog("Broadcast to %s OK in %dms (average %dms)",
+                         endpoint.name, static_cast<int>(elapsed.count()),
+                         static_cast<int>(endpoint.latency.count()));
+        }
+        else
+        {
+            ++endpoint.failures;
+            ABC_DebugLog("Broadcast to %s failed (%u of %u attempts)",
+                         endpoint.name, endpoint.failures,
+                         endpoint.failures + endpoint.successes);
+        }
+    }
 
     {
-        std::lock_guard<std::mutex> lock(syncer->mutex);
-        status->status = result;
-        status->done = true;
+        std::lock_guard<std::mutex> lock(attempt->mutex);
+        --attempt->pending;
+        if (s)
+        {
+            attempt->success = true;
+            attempt->cancelled = true;
+        }
+        else if (attempt->error)
+        {
+            // Only the first failure is worth reporting:
+            attempt->error = s;
+        }
     }
-    syncer->cv.notify_all();
+    attempt->cv.notify_all();
+}
+
+/**
+ * Starts an HTTP broadcast on the shared HTTP thread.
+ * The HTTP thread keeps connections open between broadcasts,
+ * so later ones can skip the TLS handshake.
+ */
+static void
+broadcastStart(BroadcastEndpoint &endpoint,
+               std::shared_ptr<BroadcastAttempt> attempt, DataSlice rawTx)
+{
+    const auto start = std::chrono::steady_clock::now();
+    auto callback = [&endpoint, attempt, start](Status s, HttpReply &reply)
+    {
+        if (s)
+            s = reply.codeOk();
+        broadcastDone(endpoint, attempt, s, start);
+    };
+
+    HttpRequest request;
+    request.timeout(broadcastTimeout).cancelOn(attempt->cancelled);
+    Status s = endpoint.post(request, rawTx, callback);
+    if (!s)
+        broadcastDone(endpoint, attempt, s, start);
 }
 
 Status
 broadcastTx(Wallet &self, DataSlice rawTx)
 {
-    // Create communication resources:
-    auto syncer = std::make_shared<Syncer>();
-    auto s1 = std::make_shared<DelayedStatus>();
-    auto s2 = std::make_shared<DelayedStatus>();
-    auto s3 = std::make_shared<DelayedStatus>();
+    auto attempt = std::make_shared<BroadcastAttempt>();
+    attempt->pending = 3;
 
     // Launch the broadcasts:
-    DataChunk tx(rawTx.begin(), rawTx.end());
-    std::thread(broadcastTask<blockchainPostTx>, syncer, s1, tx).detach();
-    std::thread(broadcastTask<insightPostTx>, syncer, s2, tx).detach();
+    broadcastStart(gBlockchain, attempt, rawTx);
+    broadcastStart(gInsight, attempt, rawTx);
 
     // Queue up an async broadcast over the TxUpdater:
-    auto updaterDone = [syncer, s3](Status s)
+    const auto start = std::chrono::steady_clock::now();
+    auto updaterDone = [attempt, start](Status s)
     {
-        {
-            std::lock_guard<std::mutex> lock(syncer->mutex);
-            s3->status = s;
-            s3->done = true;
-            if (s)
-                ABC_DebugLog("Stratum broadcast OK");
-            else
-                s.log();
-        }
-        syncer->cv.notify_all();
+        if (!s)
+            s.log();
+        broadcastDone(gStratum, attempt, s, start);
     };
-    watcherSend(self, updaterDone, rawTx).log();
+    Status s = watcherSend(self, updaterDone, rawTx);
+    if (!s)
+        broadcastDone(gStratum, attempt, s.log(), start);
 
-    // Loop as long as any thread is still running:
-    while (true)
+    // Wait for the first success, or for everything to fail:
+    std::unique_lock<std::mutex> lock(attempt->mutex);
+    attempt->cv.wait(lock, [&attempt]()
     {
-        // Wait for the condition variable, which also acquires the lock:
-        std::unique_lock<std::mutex> lock(syncer->mutex);
-        syncer->cv.wait(lock);
-
-        // Stop waiting if any broadcast has succeeded:
-        if (s1->done && s1->status)
-            break;
-        if (s2->done && s2->status)
-            break;
-        if (s3->done && s3->status)
-            break;
-
-        // If they are all done, we have an error:
-        if (s1->done && s2->done && s3->done)
-            return s1->status;
-    }
+        return attempt->success || !attempt->pending;
+    });
 
+    if (!attempt->success)
+        return attempt->error;
     return Status();
 }
 
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "CoinSelection.hpp"
+#include <algorithm>
+
+namespace abcd {
+
+/**
+ * Nodes will not relay transactions larger than this.
+ */
+constexpr size_t maxTxSize = 100000;
+
+/**
+ * The exact-match search gives up after visiting this many branches.
+ */
+constexpr unsigned long maxTries = 100000;
+
+CoinIndex::CoinIndex(const std::vector<uint64_t> &values)
+{
+    coins_.reserve(values.size());
+    for (size_t i = 0; i < values.size(); ++i)
+        coins_.push_back(Coin{values[i], i});
+
+    auto compare = [](const Coin &a, const Coin &b)
+    {
+        return a.value > b.value ||
+               (a.value == b.value && a.position < b.position);
+    };
+    std::sort(coins_.begin(), coins_.end(), compare);
+
+    remaining_.resize(coins_.size() + 1);
+    remaining_[coins_.size()] = 0;
+    for (size_t i = coins_.size(); i--; )
+        remaining_[i] = remaining_[i + 1] + coins_[i].value;
+}
+
+size_t
+CoinIndex::countAbove(uint64_t value) const
+{
+    auto compare = [](const Coin &coin, uint64_t value)
+    {
+        return value < coin.value;
+    };
+    return std::lower_bound(coins_.begin(), coins_.end(), value, compare) -
+           coins_.begin();
+}
+
+/**
+ * The fee for every possible input count, worked out up front
+ * so the search never needs to call the fee function.
+ */
+struct SelectionCosts
+{
+    size_t maxInputs;
+    std::vector<uint64_t> bare;     // Fee with n inputs and no change
+    std::vector<uint64_t> change;   // Fee with n inputs and a change output
+    uint64_t inputCost;             // Most that one more input adds
+    uint64_t changeCost;            // Most that a change output adds
+
+    SelectionCosts(const CoinIndex &coins, const CoinSelectionParams &params):
+        maxInputs(0), inputCost(0), changeCost(0)
+    {
+        const auto fixedSize = params.baseSize + params.changeSize;
+        if (fixedSize < maxTxSize)
+            maxInputs = std::min((maxTxSize - fixedSize) / params.inputSize,
+                                 coins.size());
+
+        bare.resize(maxInputs + 1);
+        change.resize(maxInputs + 1);
+        for (size_t n = 0; n <= maxInputs; ++n)
+        {
+            const auto size = params.baseSize + n * params.inputSize;
+            bare[n] = params.fee(size);
+            change[n] = std::max(bare[n], params.fee(size + params.changeSize));
+
+            changeCost = std::max(changeCost, change[n] - bare[n]);
+            if (n && bare[n - 1] < bare[n])
+                inputCost = std::max(inputCost, bare[n] - bare[n - 1]);
+        }
+    }
+};
+
+/**
+ * Works out the fee and change for a set of coins,
+ * returning false if they are not enough.
+ * @param picks indices into the sorted coin list.
+ */
+static bool
+coinFinish(CoinSelection &result, const std::vector<size_t> &picks,
+           uint64_t sum, const CoinIndex &coins,
+           const CoinSelectionParams &params, const SelectionCosts &costs)
+{
+    const auto n = picks.size();
+    if (costs.maxInputs < n)
+        return false;
+
+    CoinSelection out;
+    if (params.target + costs.change[n] + params.dustLimit <= sum)
+    {
+        out.fee = costs.change[n];
+        out.change = sum - params.target - out.fee;
+    }
+    else if (params.target + costs.bare[n] <= sum)
+    {
+        // Anything left over is too small to be worth a change output:
+        out.fee = sum - params.target;
+        out.change = 0;
+    }
+    else
+    {
+        return false;
+    }
+
+    out.chosen.reserve(n);
+    for (auto i: picks)
+        out.chosen.push_back(coins.position(i));
+    std::sort(out.chosen.begin(), out.chosen.end());
+
+    result = std::move(out);
+    return true;
+}
+
+/**
+ * Depth-first branch-and-bound search for a set of coins
+ * that pays the target without needing a change output.
+ * Coins are tried largest-first, so the search reaches
+ * small input counts early and can prune overshooting branches.
+ */
+static bool
+coinSelectExact(CoinSelection &result, const CoinIndex &coins,
+                const CoinSelectionParams &params, const SelectionCosts &costs)
+{
+    const auto deadline = std::chrono::steady_clock::now() + params.budget;
+
+    // Coins worth less than the fee to spend them only add to the excess.
+    // Leaving them out means every added coin raises the total,
+    // which is what makes the overshoot pruning below correct:
+    const auto usable = coins.countAbove(costs.inputCost);
+    const auto window = costs.changeCost + params.dustLimit;
+
+    std::vector<size_t> picks;
+    std::vector<size_t> best;
+    uint64_t sum = 0;
+    uint64_t bestSum = 0;
+    bool found = false;
+
+    size_t i = 0;
+    for (unsigned long tries = 0; tries < maxTries; ++tries)
+    {
+        if (!(tries % 1024) && deadline < std::chrono::steady_clock::now())
+            break;
+
+        const auto n = picks.size();
+        const auto need = params.target + costs.bare[n];
+        const auto available = coins.remaining(i) - coins.remaining(usable);
+
+        bool backtrack = false;
+        if (sum + available < need || need + window <= sum)
+        {
+            backtrack = true;
+        }
+        else if (need <= sum)
+        {
+            bool better = !found;
+            if (found && CoinPolicy::privacy == params.policy)
+                better = n < best.size() || (n == best.size() && sum < bestSum);
+            else if (found)
+                better = sum < bestSum || (sum == bestSum && n < best.size());
+
+            if (better)
+            {
+                best = picks;
+                bestSum = sum;
+                found = true;
+            }
+
+            // Nothing can beat a perfect match on fees:
+            if (sum == need && CoinPolicy::minimizeFee == params.policy)
+                break;
+            backtrack = true;
+        }
+        else if (usable <= i || costs.maxInputs <= n)
+        {
+            backtrack = true;
+        }
+
+        if (backtrack)
+        {
+            if (picks.empty())
+                break;
+
+            // Drop the last coin, and skip any identical ones after it,
+            // since they would only repeat the same sums:
+            const auto last = picks.back();
+            picks.pop_back();
+            sum -= coins.value(last);
+            i = last + 1;
+            while (i < usable && coins.value(i) == coins.value(last))
+                ++i;
+        }
+        else
+        {
+            picks.push_back(i);
+            sum += coins.value(i);
+            ++i;
+        }
+    }
+
+    return found && coinFinish(result, best, bestSum, coins, params, costs);
+}
+
+/**
+ * Picks coins with change, following the policy.
+ */
+static bool
+coinSelectFallback(CoinSelection &result, const CoinIndex &coins,
+                   const CoinSelectionParams &params,
+                   const SelectionCosts &costs)
+{
+    std::vector<size_t> picks;
+    uint64_t sum = 0;
+
+    // Consolidation sweeps up the smallest coins that are worth spending:
+    if (CoinPolicy::consolidate == params.policy)
+    {
+        for (size_t i = coins.countAbove(costs.inputCost); i--; )
+        {
+            picks.push_back(i);
+            sum += coins.value(i);
+            if (coinFinish(result, picks, sum, coins, params, costs))
+                return true;
+            if (costs.maxInputs <= picks.size())
+                break;
+        }
+        picks.clear();
+        sum = 0;
+    }
+
+    // The smallest single coin that covers everything, if there is one:
+    if (costs.maxInputs)
+    {
+        const auto need = params.target + costs.change[1] + params.dustLimit;
+        const auto count = need ? coins.countAbove(need - 1) : coins.size();
+        if (count)
+        {
+            picks.push_back(count - 1);
+            return coinFinish(result, picks, coins.value(count - 1),
+                              coins, params, costs);
+        }
+    }
+
+    // Otherwise, use the fewest coins possible:
+    for (size_t i = 0; i < coins.size() && i < costs.maxInputs; ++i)
+    {
+        picks.push_back(i);
+        sum += coins.value(i);
+        if (coinFinish(result, picks, sum, coins, params, costs))
+            return true;
+    }
+
+    return false;
+}
+
+Status
+coinSelect(CoinSelection &result, const CoinIndex &coins,
+           const CoinSelectionParams &params)
+{
+    if (!params.inputSize || !params.fee)
+        return ABC_ERROR(ABC_CC_Error, "Bad coin selection parameters");
+
+    const SelectionCosts costs(coins, params);
+
+    CoinSelection fallback;
+    bool fallbackOk = coinSelectFallback(fallback, coins, params, costs);
+
+    CoinSelection exact;
+    bool exactOk = CoinPolicy::consolidate != params.policy &&
+                   params.budget.count() &&
+                   coinSelectExact(exact, coins, params, costs);
+
+    if (!exactOk && !fallbackOk)
+        return ABC_ERROR(ABC_CC_InsufficientFunds, "Insufficient funds");
+
+    if (exactOk && fallbackOk)
+    {
+        if (CoinPolicy::privacy == params.policy)
+        {
+            exactOk = exact.chosen.size() <= fallback.chosen.size();
+        }
+        else
+        {
+            // Change costs a bit more to spend later, so count that too:
+            const auto fallbackCost = fallback.fee +
+                                      (fallback.change ? costs.inputCost : 0);
+            exactOk = exact.fee <= fallbackCost;
+        }
+    }
+
+    result = std::move(exactOk ? exact : fallback);
+    return Status();
+}
+
+} // namespace abcd
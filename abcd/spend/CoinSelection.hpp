@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+/**
+ * @file
+ * Chooses which unspent outputs pay for a transaction.
+ */
+
+#ifndef ABCD_SPEND_COIN_SELECTION_HPP
+#define ABCD_SPEND_COIN_SELECTION_HPP
+
+#include "../util/Status.hpp"
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace abcd {
+
+/**
+ * What the selection should optimize for, beyond paying the outputs.
+ */
+enum class CoinPolicy
+{
+    /**
+     * Pay as little as possible, avoiding change where an exact match exists.
+     */
+    minimizeFee,
+
+    /**
+     * Spend as few coins as possible, linking as few addresses as possible.
+     */
+    privacy,
+
+    /**
+     * Use up small coins, which is best done while fees are low.
+     */
+    consolidate
+};
+
+/**
+ * Everything the selection needs to know about the transaction.
+ */
+struct CoinSelectionParams
+{
+    /** The total amount being sent, not counting fees. */
+    uint64_t target;
+
+    /** The size of the transaction before adding inputs or change. */
+    size_t baseSize;
+    /** The size each signed input adds. */
+    size_t inputSize;
+    /** The size a change output adds. */
+    size_t changeSize;
+
+    /** Change smaller than this goes to the miners instead. */
+    uint64_t dustLimit;
+
+    /** Gives the mining fee for a transaction of the given size. */
+    std::function<uint64_t (size_t size)> fee;
+
+    CoinPolicy policy;
+
+    /**
+     * How long the exact-match search may run before giving up.
+     * Zero skips the search entirely.
+     */
+    std::chrono::steady_clock::duration budget;
+};
+
+/**
+ * The result of a coin selection.
+ */
+struct CoinSelection
+{
+    /** Positions of the chosen coins in the original value list. */
+    std::vector<size_t> chosen;
+
+    uint64_t fee;
+
+    /** The change amount, or zero if no change output is needed. */
+    uint64_t change;
+};
+
+/**
+ * A set of coin values sorted from largest to smallest,
+ * with running totals for pruning the search.
+ */
+class CoinIndex
+{
+public:
+    CoinIndex(const std::vector<uint64_t> &values);
+
+    size_t size() const { return coins_.size(); }
+
+    /**
+     * The value of the i'th largest coin.
+     */
+    uint64_t value(size_t i) const { return coins_[i].value; }
+
+    /**
+     * The position the i'th largest coin had in the original list.
+     */
+    size_t position(size_t i) const { return coins_[i].position; }
+
+    /**
+     * The total value of the i'th largest coin and everything smaller.
+     */
+    uint64_t remaining(size_t i) const { return remaining_[i]; }
+
+    /**
+     * The number of coins worth more than the given amount.
+     */
+    size_t countAbove(uint64_t value) const;
+
+private:
+    struct Coin
+    {
+        uint64_t value;
+        size_t position;
+    };
+
+    std::vector<Coin> coins_;
+    std::vector<uint64_t> remaining_;
+};
+
+/**
+ * Picks coins to pay for a transaction.
+ *
+ * First, a branch-and-bound search looks for a set of coins that covers
+ * the target and fee closely enough to leave out the change output.
+ * If that fails or runs out of time, a simpler strategy picks
+ * a set of coins with change, according to the policy.
+ */
+Status
+coinSelect(CoinSelection &result, const CoinIndex &coins,
+           const CoinSelectionParams &params);
+
+} // namespace abcd
+
+#endif
@@ -9,30 +9,112 @@
 #include "Outputs.hpp"
 #include "../General.hpp"
 #include "../bitcoin/cache/TxCache.hpp"
+#include "../bitcoin/Sighash.hpp"
 #include "../bitcoin/Utility.hpp"
 #include "../wallet/Wallet.hpp"
-#include <unistd.h>
 #include <bitcoin/bitcoin.hpp>
+#include <openssl/crypto.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
 
 namespace abcd {
 
 static std::map<bc::data_chunk, std::string> address_map;
 
+/**
+ * Below this many inputs per thread,
+ * starting threads costs more than it saves.
+ */
+constexpr size_t signMinBatch = 8;
+
+void
+keyTableWipe(KeyTable &keys)
+{
+    for (auto &key: keys)
+        OPENSSL_cleanse(&key.second[0], key.second.size());
+    keys.clear();
+}
+
+Status
+inputsAddresses(AddressSet &result, const bc::transaction_type &tx,
+                const TxCache &txCache)
+{
+    AddressSet out;
+    for (const auto &input: tx.inputs)
+    {
+        bc::transaction_output_type prev;
+        ABC_CHECK(txCache.output(prev, input.previous_output));
+
+        bc::payment_address pa;
+        if (bc::extract(pa, prev.script))
+            out.insert(pa.encoded());
+    }
+
+    result = std::move(out);
+    return Status();
+}
+
+/**
+ * Everything needed to sign one input.
+ */
+struct SigningJob
+{
+    bc::script_type script;
+    const std::string *wif;
+};
+
+/**
+ * Generates the signature script for one input.
+ */
+static Status
+signInput(bc::script_type &result, const SighashCache &sighashes,
+          size_t index, const SigningJob &job)
+{
+    bc::ec_secret secret = bc::wif_to_secret(*job.wif);
+    bc::ec_point pubkey = bc::secret_to_public_key(secret,
+                          bc::is_wif_compressed(*job.wif));
+
+    // Generate the signature for this input:
+    auto sig_hash = sighashes.hash(index, job.script);
+    if (sig_hash == bc::null_hash)
+    {
+        OPENSSL_cleanse(secret.data(), secret.size());
+        return ABC_ERROR(ABC_CC_Error, "Unable to sign");
+    }
+    bc::data_chunk signature = bc::sign(secret, sig_hash,
+                                        bc::create_nonce(secret, sig_hash));
+    signature.push_back(0x01);
+    OPENSSL_cleanse(secret.data(), secret.size());
+
+    // Create out scriptsig:
+    bc::script_type scriptsig;
+    scriptsig.push_operation(makePushOperation(signature));
+    scriptsig.push_operation(makePushOperation(pubkey));
+    result = scriptsig;
+    return Status();
+}
+
 Status
 signTx(bc::transaction_type &result, const TxCache &txCache,
        const KeyTable &keys)
 {
-    for (size_t i = 0; i < result.inputs.size(); ++i)
+    const auto count = result.inputs.size();
+    if (!count)
+        return Status();
+
+    // Gather the scripts and keys up front, since the cache is locked:
+    std::vector<SigningJob> jobs(count);
+    for (size_t i = 0; i < count; ++i)
     {
         // Find the utxo this input refers to:
-        bc::input_point &point = result.inputs[i].previous_output;
-        bc::transaction_type tx;
-        ABC_CHECK(txCache.get(tx, bc::encode_hash(point.hash)));
+        bc::transaction_output_type prev;
+        ABC_CHECK(txCache.output(prev, result.inputs[i].previous_output));
+        jobs[i].script = prev.script;
 
         // Find the address for that utxo:
         bc::payment_address pa;
-        bc::script_type &script = tx.outputs[point.index].script;
-        bc::extract(pa, script);
+        bc::extract(pa, jobs[i].script);
         if (bc::payment_address::invalid_version == pa.version())
             return ABC_ERROR(ABC_CC_Error, "Invalid address");
 
@@ -40,33 +122,66 @@ signTx(bc::transaction_type &result, const TxCache &txCache,
         auto key = keys.find(pa.encoded());
         if (key == keys.end())
             return ABC_ERROR(ABC_CC_Error, "Missing signing key");
-        bc::ec_secret secret = bc::wif_to_secret(key->second);
-        bc::ec_point pubkey = bc::secret_to_public_key(secret,
-                              bc::is_wif_compressed(key->second));
-
-        // Generate the signature for this input:
-        auto sig_hash = bc::script_type::generate_signature_hash(
-                            result, i, script, bc::sighash::all);
-        if (sig_hash == bc::null_hash)
-            return ABC_ERROR(ABC_CC_Error, "Unable to sign");
-        bc::data_chunk signature = bc::sign(secret, sig_hash,
-                                            bc::create_nonce(secret, sig_hash));
-        signature.push_back(0x01);
-
-        // Create out scriptsig:
-        bc::script_type scriptsig;
-        scriptsig.push_operation(makePushOperation(signature));
-        scriptsig.push_operation(makePushOperation(pubkey));
-        result.inputs[i].script = scriptsig;
+        jobs[i].wif = &key->second;
+    }
+
+    const SighashCache sighashes(result);
+    std::vector<bc::script_type> scripts(count);
+    std::vector<Status> statuses(count);
+
+    // The first input goes by itself, since libbitcoin
+    // sets up its secp256k1 context on first use:
+    statuses[0] = signInput(scripts[0], sighashes, 0, jobs[0]);
+
+    std::atomic<size_t> next(1);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < count; i = next++)
+            statuses[i] = signInput(scripts[i], sighashes, i, jobs[i]);
+    };
+
+    // The calling thread does its share of the work, too:
+    const size_t threadCount = std::min<size_t>(
+                                   std::thread::hardware_concurrency(),
+                                   (count - 1) / signMinBatch);
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread: threads)
+        thread.join();
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        ABC_CHECK(statuses[i]);
+        result.inputs[i].script = std::move(scripts[i]);
     }
 
     return Status();
 }
 
-static uint64_t
-minerFee(const bc::transaction_type &tx, uint64_t amountSatoshi,
-         const BitcoinFeeInfo &feeInfo,
-         tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi)
+/**
+ * Signature scripts have a 72-byte signature plus a 32-byte pubkey,
+ * on top of the 41 bytes for the outpoint, script length, and sequence.
+ */
+constexpr size_t inputSize = 41 + 104;
+
+/**
+ * The size of one extra output for change.
+ */
+constexpr size_t changeSize = 35;
+
+/**
+ * How long coin selection can spend looking for a change-free match.
+ */
+constexpr auto selectionBudget = std::chrono::milliseconds(50);
+
+/**
+ * Returns the mining fee rate, in satoshis per KB.
+ */
+static double
+minerFeeRate(uint64_t amountSatoshi, const BitcoinFeeInfo &feeInfo,
+             tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi)
 {
     double rate;
 
@@ -95,11 +210,15 @@ minerFee(const bc::transaction_type &tx, uint64_t amountSatoshi,
         break;
     }
 
-    // Signature scripts have a 72-byte signature plus a 32-byte pubkey:
-    size_t size = satoshi_raw_size(tx);
-    size += (104 * tx.inputs.size());
-    size += 35; // For one extra output for change.
+    return rate;
+}
 
+/**
+ * Returns the mining fee for a transaction of the given size.
+ */
+static uint64_t
+minerFeeForSize(size_t size, double rate)
+{
     // Scale the rate by the size of the transaction:
     auto out = static_cast<uint64_t>(size * (rate / 1000));
 
@@ -113,39 +232,100 @@ minerFee(const bc::transaction_type &tx, uint64_t amountSatoshi,
     return out;
 }
 
+static uint64_t
+minerFee(const bc::transaction_type &tx, uint64_t amountSatoshi,
+         const BitcoinFeeInfo &feeInfo,
+         tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi)
+{
+    size_t size = satoshi_raw_size(tx);
+    size += ((inputSize - 41) * tx.inputs.size());
+    size += changeSize;
+
+    return minerFeeForSize(size, minerFeeRate(amountSatoshi, feeInfo,
+                           feeLevel, customFeeSatoshi));
+}
+
+/**
+ * Sorts the utxo values for coin selection.
+ */
+static CoinIndex
+inputsCoinIndex(const bc::output_info_list &utxos)
+{
+    std::vector<uint64_t> values;
+    values.reserve(utxos.size());
+    for (const auto &utxo: utxos)
+        values.push_back(utxo.value);
+    return CoinIndex(values);
+}
+
+/**
+ * Does the work of `inputsPickOptimal` and `inputsPickQuick`.
+ */
+static Status
+inputsPick(uint64_t &resultFee, uint64_t &resultChange,
+           bc::transaction_type &tx, const bc::output_info_list &utxos,
+           const CoinIndex &coins,
+           tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi,
+           CoinPolicy policy, std::chrono::steady_clock::duration budget)
+{
+    const auto totalOut = outputsTotal(tx.outputs);
+    const auto rate = minerFeeRate(totalOut, generalBitcoinFeeInfo(),
+                                   feeLevel, customFeeSatoshi);
+
+    tx.inputs.clear();
+    CoinSelectionParams params;
+    params.target = totalOut;
+    params.baseSize = satoshi_raw_size(tx);
+    params.inputSize = inputSize;
+    params.changeSize = changeSize;
+    params.dustLimit = outputDustThreshold;
+    params.fee = [rate](size_t size)
+    {
+        return minerFeeForSize(size, rate);
+    };
+    params.policy = policy;
+    params.budget = budget;
+
+    CoinSelection selection;
+    ABC_CHECK(coinSelect(selection, coins, params));
+
+    for (auto i: selection.chosen)
+    {
+        bc::transaction_input_type input;
+        input.sequence = 0xffffffff;
+        input.previous_output = utxos[i].point;
+        tx.inputs.push_back(input);
+    }
+
+    resultFee = selection.fee;
+    resultChange = selection.change;
+    return Status();
+}
+
 Status
 inputsPickOptimal(uint64_t &resultFee, uint64_t &resultChange,
                   bc::transaction_type &tx, const bc::output_info_list &utxos,
-                  tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi)
+                  tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi,
+                  CoinPolicy policy)
 {
-    auto totalOut = outputsTotal(tx.outputs);
+    ABC_CHECK(inputsPick(resultFee, resultChange, tx, utxos,
+                         inputsCoinIndex(utxos), feeLevel, customFeeSatoshi,
+                         policy, selectionBudget));
+    return Status();
+}
 
-    const auto feeInfo = generalBitcoinFeeInfo();
-    uint64_t sourced = 0;
-    uint64_t fee = 0;
-    do
-    {
-        // Select a collection of outputs that satisfies our requirements:
-        auto chosen = select_outputs(utxos, totalOut + fee);
-        if (!chosen.points.size())
-            return ABC_ERROR(ABC_CC_InsufficientFunds, "Insufficient funds");
-        sourced = totalOut + fee + chosen.change;
-
-        // Calculate the fees for this input combination:
-        tx.inputs.clear();
-        for (auto &point: chosen.points)
-        {
-            bc::transaction_input_type input;
-            input.sequence = 0xffffffff;
-            input.previous_output = point;
-            tx.inputs.push_back(input);
-        }
-        fee = minerFee(tx, totalOut, feeInfo, feeLevel, customFeeSatoshi);
-    }
-    while (sourced < totalOut + fee);
+Status
+inputsPickQuick(uint64_t &resultFee, uint64_t &resultChange,
+                bc::transaction_type &tx, const bc::output_info_list &utxos,
+                const CoinIndex &coins,
+                tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi)
+{
+    if (coins.size() != utxos.size())
+        return ABC_ERROR(ABC_CC_Error, "Coin index does not match the utxos");
 
-    resultFee = fee;
-    resultChange = sourced - (totalOut + fee);
+    ABC_CHECK(inputsPick(resultFee, resultChange, tx, utxos, coins,
+                         feeLevel, customFeeSatoshi, CoinPolicy::minimizeFee,
+                         std::chrono::steady_clock::duration::zero()));
     return Status();
 }
 
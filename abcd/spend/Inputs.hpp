@@ -8,6 +8,8 @@
 #ifndef ABCD_BITCOIN_INPUTS_HPP
 #define ABCD_BITCOIN_INPUTS_HPP
 
+#include "CoinSelection.hpp"
+#include "../bitcoin/Typedefs.hpp"
 #include "../util/Status.hpp"
 #include <bitcoin/bitcoin.hpp>
 #include <map>
@@ -22,6 +24,20 @@ class TxCache;
  */
 typedef std::map<const std::string, std::string> KeyTable;
 
+/**
+ * Overwrites the private keys in the table and empties it.
+ */
+void
+keyTableWipe(KeyTable &keys);
+
+/**
+ * Finds the addresses that the transaction's inputs spend from,
+ * so the caller only needs to look up those keys.
+ */
+Status
+inputsAddresses(AddressSet &result, const bc::transaction_type &tx,
+                const TxCache &txCache);
+
 /**
  * Fills the transaction's inputs with signatures.
  */
@@ -32,11 +48,24 @@ signTx(bc::transaction_type &result, const TxCache &txCache,
 /**
  * Select a utxo collection that will satisfy the outputs as best possible
  * and calculate the resulting fees.
+ * The change is zero if the selection does not need a change output.
  */
 Status
 inputsPickOptimal(uint64_t &resultFee, uint64_t &resultChange,
                   bc::transaction_type &tx, const bc::output_info_list &utxos,
-                  tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi);
+                  tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi,
+                  CoinPolicy policy=CoinPolicy::minimizeFee);
+
+/**
+ * Like `inputsPickOptimal`, but skips the search for a change-free match,
+ * and reuses coins already sorted from the same utxo list.
+ * This is much faster, so it suits searches that try many amounts.
+ */
+Status
+inputsPickQuick(uint64_t &resultFee, uint64_t &resultChange,
+                bc::transaction_type &tx, const bc::output_info_list &utxos,
+                const CoinIndex &coins,
+                tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi);
 
 /**
  * Populate the transaction's input list with all the utxo's in the wallet,
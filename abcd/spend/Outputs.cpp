@@ -11,7 +11,6 @@
 #include "../bitcoin/Testnet.hpp"
 #include <iterator>
 
-#define MINIMUM_DUST_THRESHOLD 4000 // was 546
 
 namespace abcd {
 
@@ -57,7 +56,7 @@ outputScriptForAddress(bc::script_type &result, const std::string &address)
 bool
 outputIsDust(uint64_t amount)
 {
-    return amount < MINIMUM_DUST_THRESHOLD;
+    return amount < outputDustThreshold;
 }
 
 Status
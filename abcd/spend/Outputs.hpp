@@ -13,6 +13,11 @@
 
 namespace abcd {
 
+/**
+ * Outputs smaller than this are considered dust.
+ */
+constexpr uint64_t outputDustThreshold = 4000; // was 546
+
 /**
  * Creates an output script for sending money to an address.
  */
@@ -24,7 +24,8 @@ namespace abcd {
 Spend::Spend(Wallet &wallet):
     wallet_(wallet),
     airbitzFeePending_(wallet_.txs.airbitzFeePending()),
-    feeLevel_(ABC_SpendFeeLevelStandard)
+    feeLevel_(ABC_SpendFeeLevelStandard),
+    coinPolicy_(CoinPolicy::minimizeFee)
 {
 }
 
@@ -77,6 +78,30 @@ Spend::feeSet(tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi)
     return Status();
 }
 
+Status
+Spend::coinPolicySet(tABC_SpendCoinPolicy policy)
+{
+    switch (policy)
+    {
+    case ABC_SpendCoinPolicyMinimizeFee:
+        coinPolicy_ = CoinPolicy::minimizeFee;
+        break;
+
+    case ABC_SpendCoinPolicyPrivacy:
+        coinPolicy_ = CoinPolicy::privacy;
+        break;
+
+    case ABC_SpendCoinPolicyConsolidate:
+        coinPolicy_ = CoinPolicy::consolidate;
+        break;
+
+    default:
+        return ABC_ERROR(ABC_CC_Error, "Unknown coin selection policy");
+    }
+
+    return Status();
+}
+
 Status
 Spend::calculateFees(uint64_t &totalFees)
 {
@@ -120,6 +145,13 @@ Spend::calculateMax(uint64_t &maxSatoshi)
         return Status();
     }
 
+    // Every guess draws from the same coins, so sort them just once:
+    const auto usable = filterOutputs(utxos);
+    std::vector<uint64_t> values;
+    for (const auto &utxo: usable)
+        values.push_back(utxo.value);
+    const CoinIndex coins(values);
+
     // The range for our binary search (min <= result < max)
     int64_t min = 0;
     int64_t max = 0;
@@ -140,9 +172,11 @@ Spend::calculateMax(uint64_t &maxSatoshi)
         tx.outputs[0].value = guess;
         ABC_CHECK(addAirbitzFeeOutput(tx.outputs, info));
 
+        // Spending everything leaves no change anyhow,
+        // so the slow search for a change-free match cannot help here:
         uint64_t fee, change;
-        if (inputsPickOptimal(fee, change, tx, filterOutputs(utxos),
-                              feeLevel_, customFeeSatoshi_))
+        if (inputsPickQuick(fee, change, tx, usable, coins,
+                            feeLevel_, customFeeSatoshi_))
             min = guess;
         else
             max = guess;
@@ -161,9 +195,13 @@ Spend::signTx(DataChunk &result)
     bc::transaction_type tx;
     ABC_CHECK(makeTx(tx, changeAddress.address));
 
-    // Sign the transaction:
-    KeyTable keys = wallet_.addresses.keyTable();
-    ABC_CHECK(abcd::signTx(tx, wallet_.cache.txs, keys));
+    // Sign the transaction, deriving only the keys we need:
+    AddressSet addresses;
+    ABC_CHECK(inputsAddresses(addresses, tx, wallet_.cache.txs));
+    KeyTable keys = wallet_.addresses.keyTable(addresses);
+    Status s = abcd::signTx(tx, wallet_.cache.txs, keys);
+    keyTableWipe(keys);
+    ABC_CHECK(s);
     result.resize(satoshi_raw_size(tx));
     bc::satoshi_save(tx, result.begin());
 
@@ -340,10 +378,10 @@ Spend::makeTx(libbitcoin::transaction_type &result,
     uint64_t fee, change;
     auto utxos = wallet_.cache.txs.utxos(wallet_.addresses.list());
     if (!inputsPickOptimal(fee, change, tx, filterOutputs(utxos, true),
-                           feeLevel_, customFeeSatoshi_))
+                           feeLevel_, customFeeSatoshi_, coinPolicy_))
     {
         ABC_CHECK(inputsPickOptimal(fee, change, tx, filterOutputs(utxos),
-                                    feeLevel_, customFeeSatoshi_));
+                                    feeLevel_, customFeeSatoshi_, coinPolicy_));
     }
 
     ABC_CHECK(outputsFinalize(tx.outputs, change, changeAddress));
@@ -8,6 +8,7 @@
 #ifndef ABCD_SPEND_SPEND_HPP
 #define ABCD_SPEND_SPEND_HPP
 
+#include "CoinSelection.hpp"
 #include "../util/Data.hpp"
 #include "../util/Status.hpp"
 #include "../wallet/Metadata.hpp"
@@ -60,6 +61,12 @@ public:
     Status
     feeSet(tABC_SpendFeeLevel feeLevel, uint64_t customFeeSatoshi);
 
+    /**
+     * Change what the coin selection optimizes for.
+     */
+    Status
+    coinPolicySet(tABC_SpendCoinPolicy policy);
+
     /**
      * Calculate the fees that will be required to perform this send.
      */
@@ -104,6 +111,7 @@ private:
     Metadata metadata_;
     tABC_SpendFeeLevel feeLevel_;
     uint64_t customFeeSatoshi_;
+    CoinPolicy coinPolicy_;
 
     Status
     makeOutputs(bc::transaction_output_list &result);
@@ -42,6 +42,7 @@ sweepSend(Wallet &wallet,
         info.szWalletUUID = wallet.id().c_str();
         info.szTxID = nullptr;
         info.sweepSatoshi = 0;
+        info.pChanges = nullptr;
         fCallback(&info);
 
         return Status();
@@ -69,7 +70,9 @@ sweepSend(Wallet &wallet,
     // Now sign that:
     KeyTable keys;
     keys[address] = wif;
-    ABC_CHECK(signTx(tx, wallet.cache.txs, keys));
+    Status s = signTx(tx, wallet.cache.txs, keys);
+    keyTableWipe(keys);
+    ABC_CHECK(s);
 
     // Send:
     bc::data_chunk raw_tx(satoshi_raw_size(tx));
@@ -109,6 +112,7 @@ sweepSend(Wallet &wallet,
     async.szWalletUUID = wallet.id().c_str();
     async.szTxID = info.txid.c_str();
     async.sweepSatoshi = balance;
+    async.pChanges = nullptr;
     fCallback(&async);
 
     return Status();
@@ -131,6 +135,7 @@ sweepOnComplete(Wallet &wallet,
         info.szWalletUUID = wallet.id().c_str();
         info.szTxID = nullptr;
         info.sweepSatoshi = 0;
+        info.pChanges = nullptr;
         fCallback(&info);
     }
 }
@@ -7,15 +7,85 @@
 
 #include "FileIO.hpp"
 #include "Debug.hpp"
+#include "Sync.hpp"
 #include <dirent.h>
+#include <fcntl.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <set>
 #include <mutex>
+#include <thread>
 
 namespace abcd {
 
+/**
+ * How long queued saves wait for further changes before being written.
+ */
+constexpr auto queueDelay = std::chrono::seconds(1);
+
+/**
+ * Failed writes back off exponentially, up to this many doublings
+ * of the queue delay, until the next save or flush.
+ */
+constexpr unsigned queueMaxBackoff = 6;
+
+struct QueuedFile
+{
+    std::shared_ptr<const DataChunk> data;
+    unsigned long serial;
+    time_t time; // When the save happened
+    unsigned failures;
+    std::chrono::steady_clock::time_point retry;
+};
+
+// Saves waiting for the background writer:
+static std::mutex gQueueMutex;
+static std::condition_variable gQueueWake;
+static std::map<std::string, QueuedFile> gQueue;
+static unsigned long gQueueSerial = 0;
+static bool gQueueWriter = false;
+static bool gQueueStop = false;
+static std::thread gQueueThread;
+
+// Held while writing files, so direct saves and deletes
+// cannot interleave with a batch. Take this before `gQueueMutex`.
+static std::mutex gWriteMutex;
+
+/**
+ * Stops the background writer, leaving anything queued in place.
+ */
+static void
+fileQueueStop()
+{
+    {
+        std::lock_guard<std::mutex> lock(gQueueMutex);
+        gQueueStop = true;
+    }
+    gQueueWake.notify_all();
+    if (gQueueThread.joinable())
+        gQueueThread.join();
+}
+
+/**
+ * Stops the writer if the program exits without calling `fileTerminate`,
+ * while the queue it uses still exists.
+ */
+struct QueueGuard
+{
+    ~QueueGuard()
+    {
+        fileQueueStop();
+    }
+};
+static QueueGuard gQueueGuard;
+
 std::string
 fileSlashify(const std::string &path)
 {
@@ -51,12 +121,28 @@ fileEnsureDir(const std::string &dir)
 bool
 fileExists(const std::string &path)
 {
+    {
+        std::lock_guard<std::mutex> lock(gQueueMutex);
+        if (gQueue.count(path))
+            return true;
+    }
+
     return 0 == access(path.c_str(), F_OK);
 }
 
 Status
 fileLoad(DataChunk &result, const std::string &path)
 {
+    {
+        std::lock_guard<std::mutex> lock(gQueueMutex);
+        auto i = gQueue.find(path);
+        if (gQueue.end() != i)
+        {
+            result = *i->second.data;
+            return Status();
+        }
+    }
+
     FILE *fp = fopen(path.c_str(), "rb");
     if (!fp)
         return ABC_ERROR(ABC_CC_FileOpenError,
@@ -78,12 +164,13 @@ fileLoad(DataChunk &result, const std::string &path)
     return Status();
 }
 
-Status
-fileSave(DataSlice data, const std::string &path)
+/**
+ * Writes data to a temporary file, ready to be renamed into place.
+ * @param durable true to wait for the data to reach stable storage.
+ */
+static Status
+fileWriteTemp(DataSlice data, const std::string &pathTmp, bool durable)
 {
-    ABC_DebugLog("Writing file %s", path.c_str());
-
-    const auto pathTmp = path + ".tmp";
     FILE *fp = fopen(pathTmp.c_str(), "wb");
     if (!fp)
         return ABC_ERROR(ABC_CC_FileOpenError,
@@ -94,15 +181,243 @@ fileSave(DataSlice data, const std::string &path)
         fclose(fp);
         return ABC_ERROR(ABC_CC_FileWriteError, "Cannot write " + pathTmp);
     }
-    fclose(fp);
 
+    if (durable && (fflush(fp) || fsync(fileno(fp))))
+    {
+        fclose(fp);
+        return ABC_ERROR(ABC_CC_FileWriteError, "Cannot flush " + pathTmp);
+    }
+
+    if (fclose(fp))
+        return ABC_ERROR(ABC_CC_FileWriteError, "Cannot write " + pathTmp);
+
+    return Status();
+}
+
+/**
+ * Moves a finished temporary file into place.
+ */
+static Status
+fileRename(const std::string &pathTmp, const std::string &path)
+{
     if (rename(pathTmp.c_str(), path.c_str()))
         return ABC_ERROR(ABC_CC_FileWriteError,
                          "Cannot rename " + pathTmp + " to " + path);
+    syncJournalTouch(path);
+
+    return Status();
+}
+
+/**
+ * Flushes a directory's entries to stable storage,
+ * so renames inside it survive a crash.
+ */
+static Status
+fileSyncDir(const std::string &dir)
+{
+    int fd = open(dir.c_str(), O_RDONLY);
+    if (fd < 0)
+        return ABC_ERROR(ABC_CC_FileOpenError, "Cannot open " + dir);
+
+    int e = fsync(fd);
+    close(fd);
+    if (e)
+        return ABC_ERROR(ABC_CC_FileWriteError, "Cannot flush " + dir);
+
+    return Status();
+}
+
+/**
+ * Returns the directory part of a path, or "." if there is none.
+ */
+static std::string
+fileDirName(const std::string &path)
+{
+    const auto slash = path.rfind('/');
+    return std::string::npos == slash ? "." : path.substr(0, slash + 1);
+}
+
+/**
+ * Drops any queued saves at or inside the given path.
+ * The caller must hold `gQueueMutex`.
+ */
+static void
+fileQueueCancel(const std::string &path)
+{
+    if (path.empty())
+        return;
+
+    auto i = gQueue.lower_bound(path);
+    while (gQueue.end() != i && !i->first.compare(0, path.size(), path))
+    {
+        const auto &name = i->first;
+        if (name.size() == path.size() || '/' == path.back() ||
+                '/' == name[path.size()])
+            i = gQueue.erase(i);
+        else
+            ++i;
+    }
+}
+
+/**
+ * Writes out everything that is currently queued.
+ * Every file reaches stable storage before any of them is renamed,
+ * and each affected directory is flushed once at the end,
+ * so a whole batch costs a single durability barrier.
+ * Files that fail to write stay queued for another try.
+ * @param all false to skip files still backing off from a failure.
+ */
+static Status
+fileQueueWrite(bool all)
+{
+    std::lock_guard<std::mutex> writeLock(gWriteMutex);
+
+    const auto now = std::chrono::steady_clock::now();
+    std::map<std::string, QueuedFile> batch;
+    {
+        std::lock_guard<std::mutex> lock(gQueueMutex);
+        for (const auto &file: gQueue)
+            if (all || file.second.retry <= now)
+                batch.insert(file);
+    }
+    if (batch.empty())
+        return Status();
+
+    ABC_DebugLog("Writing %d queued files", static_cast<int>(batch.size()));
+    Status result;
+    std::set<std::string> written;
+    for (const auto &file: batch)
+    {
+        Status s = fileWriteTemp(*file.second.data, file.first + ".tmp", true);
+        if (s)
+            written.insert(file.first);
+        else
+            result = s.log();
+    }
+
+    std::set<std::string> renamed;
+    std::set<std::string> dirs;
+    for (const auto &path: written)
+    {
+        Status s = fileRename(path + ".tmp", path);
+        if (s)
+        {
+            renamed.insert(path);
+            dirs.insert(fileDirName(path));
+        }
+        else
+        {
+            result = s.log();
+        }
+    }
+    for (const auto &dir: dirs)
+    {
+        Status s = fileSyncDir(dir);
+        if (!s)
+            result = s.log();
+    }
+
+    // Files saved again during the write stay queued,
+    // as do files that failed to write:
+    std::lock_guard<std::mutex> lock(gQueueMutex);
+    for (const auto &file: batch)
+    {
+        auto i = gQueue.find(file.first);
+        if (gQueue.end() == i || i->second.serial != file.second.serial)
+            continue;
+
+        if (renamed.count(file.first))
+        {
+            gQueue.erase(i);
+        }
+        else
+        {
+            auto &failed = i->second;
+            failed.failures = std::min(failed.failures + 1, queueMaxBackoff);
+            failed.retry = now + queueDelay * (1 << failed.failures);
+        }
+    }
+
+    return result;
+}
+
+static void
+fileQueueThread()
+{
+    auto stop = []()
+    {
+        return gQueueStop;
+    };
+
+    std::unique_lock<std::mutex> lock(gQueueMutex);
+    while (!gQueue.empty() && !gQueueWake.wait_for(lock, queueDelay, stop))
+    {
+        lock.unlock();
+        fileQueueWrite(false); // Failures are logged as they happen
+        lock.lock();
+    }
+    gQueueWriter = false;
+}
+
+Status
+fileSave(DataSlice data, const std::string &path)
+{
+    ABC_DebugLog("Writing file %s", path.c_str());
+
+    std::lock_guard<std::mutex> writeLock(gWriteMutex);
+    {
+        std::lock_guard<std::mutex> lock(gQueueMutex);
+        gQueue.erase(path);
+    }
+
+    const auto pathTmp = path + ".tmp";
+    ABC_CHECK(fileWriteTemp(data, pathTmp, false));
+    ABC_CHECK(fileRename(pathTmp, path));
+
+    return Status();
+}
+
+Status
+fileSaveLater(DataSlice data, const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(gQueueMutex);
+
+    auto &file = gQueue[path];
+    file.data = std::make_shared<const DataChunk>(data.begin(), data.end());
+    file.serial = ++gQueueSerial;
+    file.time = time(nullptr);
+    file.failures = 0;
+    file.retry = std::chrono::steady_clock::time_point();
+
+    if (!gQueueWriter && !gQueueStop)
+    {
+        // The last writer has given up the lock, so it is about to exit:
+        if (gQueueThread.joinable())
+            gQueueThread.join();
+        gQueueThread = std::thread(fileQueueThread);
+        gQueueWriter = true;
+    }
 
     return Status();
 }
 
+Status
+fileFlush()
+{
+    return fileQueueWrite(true);
+}
+
+Status
+fileTerminate()
+{
+    fileQueueStop();
+    Status s = fileQueueWrite(true);
+
+    std::lock_guard<std::mutex> lock(gQueueMutex);
+    gQueueStop = false;
+    return s;
+}
+
 static Status
 fileDeleteRecursive(const std::string &path)
 {
@@ -149,12 +464,31 @@ Status
 fileDelete(const std::string &path)
 {
     ABC_DebugLog("Deleting %s", path.c_str());
-    return fileDeleteRecursive(path);
+
+    std::lock_guard<std::mutex> writeLock(gWriteMutex);
+    {
+        std::lock_guard<std::mutex> lock(gQueueMutex);
+        fileQueueCancel(path);
+    }
+
+    Status s = fileDeleteRecursive(path);
+    syncJournalTouch(path);
+    return s;
 }
 
 Status
 fileTime(time_t &result, const std::string &path)
 {
+    {
+        std::lock_guard<std::mutex> lock(gQueueMutex);
+        auto i = gQueue.find(path);
+        if (gQueue.end() != i)
+        {
+            result = i->second.time;
+            return Status();
+        }
+    }
+
     struct stat statInfo;
     if (0 != stat(path.c_str(), &statInfo))
         return ABC_ERROR(ABC_CC_Error, "Could not stat file " + path);
@@ -44,24 +44,53 @@ fileExists(const std::string &path);
 
 /**
  * Reads a file from disk.
+ * Sees the contents of any queued saves that have not been written yet.
  */
 Status
 fileLoad(DataChunk &result, const std::string &path);
 
 /**
  * Writes a file to disk.
+ * Replaces any queued saves of the same path.
  */
 Status
 fileSave(DataSlice data, const std::string &path);
 
+/**
+ * Queues a file to be written to disk by a background thread.
+ * Saving the same path again before the write happens
+ * replaces the queued contents, so frequent saves cost one write.
+ * Use this for files that are rewritten often and can be rebuilt
+ * if a crash loses the last few seconds of changes.
+ */
+Status
+fileSaveLater(DataSlice data, const std::string &path);
+
+/**
+ * Writes all queued files to disk,
+ * returning once they have been flushed to stable storage.
+ * Files that fail to write stay queued, and the error is returned.
+ */
+Status
+fileFlush();
+
+/**
+ * Stops the background writer and flushes anything still queued.
+ * Should be called when the program exits.
+ */
+Status
+fileTerminate();
+
 /**
  * Deletes a file recursively.
+ * Also cancels any queued saves inside the deleted path.
  */
 Status
 fileDelete(const std::string &path);
 
 /**
  * Determines a file's last-modification time.
+ * Queued saves count as modifications.
  */
 Status
 fileTime(time_t &result, const std::string &path);
@@ -11,19 +11,103 @@
 #include "FileIO.hpp"
 #include "../Context.hpp"
 #include "../General.hpp"
+#include "../http/HttpRequest.hpp"
 #include "../../minilibs/git-sync/sync.h"
 #include <assert.h>
+#include <dirent.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 
 namespace abcd {
 
-std::recursive_mutex gSyncMutex;
+// Enough parallel syncs to hide network latency,
+// without flooding the servers:
+constexpr size_t syncMaxThreads = 4;
+
+static std::mutex gLibraryMutex;
 static bool gbInitialized = false;
+
+static std::mutex gServerMutex;
 static int syncServerIndex;
 static std::string syncServerName;
 
-typedef std::lock_guard<std::recursive_mutex> AutoSyncLock;
+static std::atomic<unsigned long> gSyncSkipped(0);
+static std::atomic<unsigned long> gSyncFull(0);
+
+// Repack once enough loose objects or packs pile up,
+// but only check each repo once a day:
+constexpr size_t syncLooseLimit = 512;
+constexpr size_t syncPackLimit = 4;
+constexpr time_t syncMaintainInterval = 24 * 60 * 60;
+
+// Repos being maintained in the background, and the threads doing it:
+static std::mutex gMaintainMutex;
+static std::set<std::string> gMaintaining;
+static std::map<std::string, std::thread> gMaintainThreads;
+
+/**
+ * The last ref advertisement seen for a repo URL,
+ * used to make conditional requests.
+ */
+struct SyncRemoteHead
+{
+    std::string etag;
+    std::string head;
+};
+static std::mutex gRemoteHeadsMutex;
+static std::map<std::string, SyncRemoteHead> gRemoteHeads;
+
+static std::mutex gRepoMutexesMutex;
+static std::map<std::string, std::shared_ptr<std::mutex>> gRepoMutexes;
+
+/**
+ * Holds the lock for a single sync directory.
+ * Different directories can sync at the same time,
+ * but each directory only allows one operation at once.
+ */
+class AutoRepoLock
+{
+public:
+    AutoRepoLock(const std::string &syncDir):
+        mutex_(find(syncDir)),
+        lock_(*mutex_)
+    {}
+
+private:
+    std::shared_ptr<std::mutex> mutex_;
+    std::lock_guard<std::mutex> lock_;
+
+    static std::shared_ptr<std::mutex>
+    find(const std::string &syncDir)
+    {
+        std::lock_guard<std::mutex> lock(gRepoMutexesMutex);
+        auto &out = gRepoMutexes[fileSlashify(syncDir)];
+        if (!out)
+            out.reset(new std::mutex());
+        return out;
+    }
+};
+
+// Past this many changes, a full scan is just as fast:
+constexpr size_t syncJournalLimit = 4096;
+
+/**
+ * Paths changed since the last sync, indexed by sync directory.
+ * A directory only has an entry once it has been fully scanned,
+ * and loses it whenever the journal cannot be trusted.
+ */
+static std::mutex gJournalMutex;
+static std::map<std::string, std::set<std::string>> gJournals;
 
 #define ABC_CHECK_GIT(f) \
     do { \
@@ -50,10 +134,17 @@ syncGitError(int e)
 
 /**
  * Builds a URL for the current git server.
+ * @param failed a URL that did not work.
+ * If this is still the current server, moves on to the next one.
+ * Otherwise, another thread has already done so.
  */
 static Status
-syncUrl(std::string &result, const std::string &syncKey, bool rotate=false)
+syncUrl(std::string &result, const std::string &syncKey,
+        const std::string &failed="")
 {
+    std::lock_guard<std::mutex> lock(gServerMutex);
+
+    const bool rotate = !failed.empty() && failed == syncServerName + syncKey;
     if (rotate || syncServerName.empty())
     {
         auto servers = generalSyncServers();
@@ -68,10 +159,425 @@ syncUrl(std::string &result, const std::string &syncKey, bool rotate=false)
     return Status();
 }
 
+/**
+ * Takes the list of paths changed since the last sync.
+ * Returns false if the directory needs a full scan,
+ * but begins recording changes for next time either way.
+ */
+static bool
+syncJournalTake(std::set<std::string> &result, const std::string &syncDir)
+{
+    std::lock_guard<std::mutex> lock(gJournalMutex);
+
+    auto i = gJournals.find(syncDir);
+    if (gJournals.end() == i)
+    {
+        gJournals[syncDir];
+        return false;
+    }
+
+    result.clear();
+    result.swap(i->second);
+    return true;
+}
+
+/**
+ * Forgets the journal, forcing a full scan on the next sync.
+ */
+static void
+syncJournalReset(const std::string &syncDir)
+{
+    std::lock_guard<std::mutex> lock(gJournalMutex);
+    gJournals.erase(syncDir);
+}
+
+/**
+ * Runs the sync algorithm, only checking the given paths if there are any.
+ */
+static Status
+syncMaster(git_repository *repo, bool journaled,
+           const std::set<std::string> &paths,
+           int &files_changed, int &need_push)
+{
+    if (!journaled)
+    {
+        ABC_CHECK_GIT(sync_master(repo, &files_changed, &need_push));
+        return Status();
+    }
+
+    std::vector<char *> strings;
+    strings.reserve(paths.size());
+    for (const auto &path: paths)
+        strings.push_back(const_cast<char *>(path.c_str()));
+    git_strarray array = {strings.data(), strings.size()};
+
+    ABC_CHECK_GIT(sync_master_paths(repo, &array,
+                                    &files_changed, &need_push));
+    return Status();
+}
+
+/**
+ * Fetches, merges, and pushes a repo.
+ */
+static Status
+syncRepoFull(git_repository *repo, std::string url, const std::string &syncKey,
+             bool journaled, const std::set<std::string> &paths, bool &dirty)
+{
+    if (sync_fetch(repo, url.c_str()) < 0)
+    {
+        ABC_CHECK(syncUrl(url, syncKey, url));
+        ABC_CHECK_GIT(sync_fetch(repo, url.c_str()));
+    }
+
+    int files_changed, need_push;
+    ABC_CHECK(syncMaster(repo, journaled, paths, files_changed, need_push));
+
+    if (need_push)
+        ABC_CHECK_GIT(sync_push(repo, url.c_str()));
+
+    // If this fails, the app has been shut down, leaving us for dead.
+    // We will crash anyhow, but this at least makes it official:
+    assert(gContext);
+
+    dirty = !!files_changed;
+    return Status();
+}
+
+/**
+ * Finds the master branch in a smart-HTTP ref advertisement.
+ * Sets the result to blank if the repo has no master branch yet.
+ */
+static Status
+syncParseHead(std::string &result, const std::string &body)
+{
+    std::string out;
+    bool service = false;
+    size_t i = 0;
+    while (i < body.size())
+    {
+        // Each packet starts with a 4-digit hex length:
+        if (body.size() < i + 4 ||
+                !std::all_of(body.begin() + i, body.begin() + i + 4, ::isxdigit))
+            return ABC_ERROR(ABC_CC_ParseError, "Bad ref advertisement");
+        const size_t length = strtoul(body.substr(i, 4).c_str(), nullptr, 16);
+        if (!length)
+        {
+            i += 4;
+            continue;
+        }
+        if (length < 4 || body.size() < i + length)
+            return ABC_ERROR(ABC_CC_ParseError, "Bad ref advertisement");
+        const auto line = body.substr(i + 4, length - 4);
+        i += length;
+
+        // The header line:
+        if (!line.empty() && '#' == line[0])
+        {
+            service = 0 == line.compare(0, 25, "# service=git-upload-pack");
+            continue;
+        }
+        if (!service)
+            return ABC_ERROR(ABC_CC_ParseError, "Not a smart-HTTP server");
+
+        // Refs look like "<sha> <name>\0<capabilities>\n":
+        if (line.size() < 42 || ' ' != line[40])
+            return ABC_ERROR(ABC_CC_ParseError, "Bad ref advertisement");
+        const auto end = line.find_first_of(std::string("\0\n", 2), 41);
+        if (line.substr(41, end - 41) == "refs/heads/master")
+            out = line.substr(0, 40);
+    }
+    if (!service)
+        return ABC_ERROR(ABC_CC_ParseError, "Not a smart-HTTP server");
+
+    result = out;
+    return Status();
+}
+
+/**
+ * Asks the server for its master branch, without doing a full fetch.
+ * Uses the cached ETag where the server provides one.
+ */
+static Status
+syncRemoteHead(std::string &result, const std::string &url)
+{
+    SyncRemoteHead cached;
+    {
+        std::lock_guard<std::mutex> lock(gRemoteHeadsMutex);
+        auto i = gRemoteHeads.find(url);
+        if (gRemoteHeads.end() != i)
+            cached = i->second;
+    }
+
+    HttpRequest request;
+    if (!cached.etag.empty())
+        request.header("If-None-Match", cached.etag);
+    HttpReply reply;
+    ABC_CHECK(request.get(reply, url + "/info/refs?service=git-upload-pack"));
+    if (304 == reply.code && !cached.etag.empty())
+    {
+        result = cached.head;
+        return Status();
+    }
+    ABC_CHECK(reply.codeOk());
+
+    std::string head;
+    ABC_CHECK(syncParseHead(head, reply.body));
+    auto etag = reply.headers.find("etag");
+    if (reply.headers.end() != etag)
+    {
+        std::lock_guard<std::mutex> lock(gRemoteHeadsMutex);
+        gRemoteHeads[url] = SyncRemoteHead{etag->second, head};
+    }
+
+    result = head;
+    return Status();
+}
+
+/**
+ * Returns true if the server's master branch matches ours,
+ * meaning there is nothing to fetch or push.
+ * Any problems just mean we need a full sync.
+ */
+static bool
+syncRemoteUnchanged(git_repository *repo, const std::string &url)
+{
+    std::string remote;
+    if (!syncRemoteHead(remote, url).log())
+        return false;
+
+    std::string local;
+    git_oid id;
+    int e = git_reference_name_to_id(&id, repo, "refs/heads/master");
+    if (GIT_ENOTFOUND == e)
+    {
+        giterr_clear();
+    }
+    else if (e < 0)
+    {
+        ABC_DebugLog("%s", syncGitError(e).c_str());
+        return false;
+    }
+    else
+    {
+        char hex[GIT_OID_HEXSZ + 1];
+        local = git_oid_tostr(hex, sizeof(hex), &id);
+    }
+
+    return remote == local;
+}
+
+void
+syncJournalTouch(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(gJournalMutex);
+
+    for (auto i = gJournals.begin(); i != gJournals.end(); )
+    {
+        const auto &dir = i->first;
+        if (dir.size() < path.size() &&
+                0 == path.compare(0, dir.size(), dir))
+        {
+            // The path is inside the sync directory:
+            auto &paths = i->second;
+            paths.insert(path.substr(dir.size()));
+            if (syncJournalLimit < paths.size())
+                i = gJournals.erase(i);
+            else
+                ++i;
+        }
+        else if (0 == dir.compare(0, fileSlashify(path).size(),
+                                  fileSlashify(path)))
+        {
+            // The path contains the whole sync directory:
+            i = gJournals.erase(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+/**
+ * Adds up the files in a repo's object database.
+ * @param kind the name of the directory being scanned,
+ * or blank for the top-level objects directory.
+ */
+static void
+syncCountObjects(SyncRepoStats &result, const std::string &dir,
+                 const std::string &kind)
+{
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return;
+
+    struct dirent *de;
+    while (nullptr != (de = readdir(d)))
+    {
+        const std::string name = de->d_name;
+        if ("." == name || ".." == name)
+            continue;
+
+        const auto path = dir + name;
+        struct stat statbuf;
+        if (stat(path.c_str(), &statbuf))
+            continue;
+
+        if (S_ISDIR(statbuf.st_mode))
+        {
+            if (kind.empty())
+                syncCountObjects(result, path + '/', name);
+            continue;
+        }
+
+        result.bytes += statbuf.st_size;
+        if ("pack" == kind)
+        {
+            if (5 < name.size() && !name.compare(name.size() - 5, 5, ".pack"))
+                ++result.packs;
+        }
+        else if (2 == kind.size())
+        {
+            // The two-digit fan-out directories hold loose objects:
+            ++result.looseObjects;
+        }
+    }
+    closedir(d);
+}
+
+/**
+ * Measures a repo. The caller must hold the repo lock.
+ */
+static Status
+syncMeasure(SyncRepoStats &result, const std::string &syncDir)
+{
+    result = SyncRepoStats();
+    syncCountObjects(result, fileSlashify(syncDir) + ".git/objects/", "");
+
+    // Every sync starts by opening the repo and loading master:
+    const auto start = std::chrono::steady_clock::now();
+    AutoFree<git_repository, git_repository_free> repo;
+    ABC_CHECK_GIT(git_repository_open(&repo.get(), syncDir.c_str()));
+    git_oid id;
+    if (!git_reference_name_to_id(&id, repo, "refs/heads/master"))
+    {
+        AutoFree<git_commit, git_commit_free> commit;
+        ABC_CHECK_GIT(git_commit_lookup(&commit.get(), repo, &id));
+    }
+    giterr_clear();
+    result.openMicroseconds =
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+    return Status();
+}
+
+/**
+ * Repacks a repo. The caller must hold the repo lock.
+ */
+static Status
+syncRepack(const std::string &syncDir,
+           SyncRepoStats &before, SyncRepoStats &after)
+{
+    ABC_CHECK(syncMeasure(before, syncDir));
+    {
+        AutoFree<git_repository, git_repository_free> repo;
+        ABC_CHECK_GIT(git_repository_open(&repo.get(), syncDir.c_str()));
+        ABC_CHECK_GIT(sync_repack(repo));
+    }
+    ABC_CHECK(syncMeasure(after, syncDir));
+
+    ABC_DebugLog("Repacked %s: %zu loose objects, %zu packs, %llu bytes, "
+                 "%ldus to open -> %zu loose objects, %zu packs, %llu bytes, "
+                 "%ldus to open",
+                 syncDir.c_str(),
+                 before.looseObjects, before.packs,
+                 static_cast<unsigned long long>(before.bytes),
+                 before.openMicroseconds,
+                 after.looseObjects, after.packs,
+                 static_cast<unsigned long long>(after.bytes),
+                 after.openMicroseconds);
+    return Status();
+}
+
+/**
+ * Returns true if the repo has not been checked in a while.
+ */
+static bool
+syncMaintainDue(const std::string &syncDir)
+{
+    const auto marker = fileSlashify(syncDir) + ".git/abc-maintenance";
+    time_t last;
+    return !fileTime(last, marker) ||
+           last + syncMaintainInterval <= time(nullptr);
+}
+
+/**
+ * Repacks a repo if it has not been checked in a while,
+ * and enough objects have piled up since last time.
+ * The caller must hold the repo lock.
+ */
+static Status
+syncMaintainIfDue(const std::string &syncDir)
+{
+    if (!syncMaintainDue(syncDir))
+        return Status();
+    const auto marker = fileSlashify(syncDir) + ".git/abc-maintenance";
+
+    // Touch the marker directly, since `fileSave` would journal it:
+    FILE *fp = fopen(marker.c_str(), "w");
+    if (!fp)
+        return ABC_ERROR(ABC_CC_SysError, "Cannot write " + marker);
+    fclose(fp);
+
+    SyncRepoStats stats;
+    ABC_CHECK(syncMeasure(stats, syncDir));
+    if (stats.looseObjects < syncLooseLimit && stats.packs <= syncPackLimit)
+        return Status();
+
+    SyncRepoStats before, after;
+    ABC_CHECK(syncRepack(syncDir, before, after));
+    return Status();
+}
+
+/**
+ * Starts maintenance on a background thread if the repo is due,
+ * so the sync that triggered it doesn't have to wait.
+ * Does nothing if the last round is still running.
+ */
+static void
+syncMaintainStart(const std::string &syncDir)
+{
+    if (!syncMaintainDue(syncDir))
+        return;
+
+    const auto dir = fileSlashify(syncDir);
+    std::lock_guard<std::mutex> lock(gMaintainMutex);
+    if (gMaintaining.count(dir))
+        return;
+
+    // Any earlier thread for this repo has finished by now:
+    auto &thread = gMaintainThreads[dir];
+    if (thread.joinable())
+        thread.join();
+
+    gMaintaining.insert(dir);
+    thread = std::thread([dir]()
+    {
+        {
+            AutoRepoLock lock(dir);
+            syncMaintainIfDue(dir).log();
+        }
+
+        std::lock_guard<std::mutex> lock(gMaintainMutex);
+        gMaintaining.erase(dir);
+    });
+}
+
 Status
 syncInit(const char *szCaCertPath)
 {
-    AutoSyncLock lock(gSyncMutex);
+    std::lock_guard<std::mutex> lock(gLibraryMutex);
 
     if (gbInitialized)
         return ABC_ERROR(ABC_CC_Reinitialization,
@@ -85,6 +591,7 @@ syncInit(const char *szCaCertPath)
                                        nullptr));
 
     // Choose a random server to start with:
+    std::lock_guard<std::mutex> serverLock(gServerMutex);
     syncServerIndex = time(nullptr);
 
     return Status();
@@ -93,7 +600,17 @@ syncInit(const char *szCaCertPath)
 void
 syncTerminate()
 {
-    AutoSyncLock lock(gSyncMutex);
+    // Let background maintenance finish before shutting git down:
+    std::map<std::string, std::thread> threads;
+    {
+        std::lock_guard<std::mutex> lock(gMaintainMutex);
+        threads.swap(gMaintainThreads);
+    }
+    for (auto &thread: threads)
+        if (thread.second.joinable())
+            thread.second.join();
+
+    std::lock_guard<std::mutex> lock(gLibraryMutex);
 
     if (gbInitialized)
     {
@@ -105,7 +622,7 @@ syncTerminate()
 Status
 syncMakeRepo(const std::string &syncDir)
 {
-    AutoSyncLock lock(gSyncMutex);
+    AutoRepoLock lock(syncDir);
 
     git_repository_init_options opts = GIT_REPOSITORY_INIT_OPTIONS_INIT;
     opts.flags |= GIT_REPOSITORY_INIT_MKDIR;
@@ -117,11 +634,15 @@ syncMakeRepo(const std::string &syncDir)
     return Status();
 }
 
+static Status
+syncRepoNoMaintain(const std::string &syncDir, const std::string &syncKey,
+                   bool &dirty);
+
 Status
 syncEnsureRepo(const std::string &syncDir, const std::string &tempDir,
                const std::string &syncKey)
 {
-    AutoSyncLock lock(gSyncMutex);
+    AutoRepoLock lock(syncDir);
 
     if (!fileExists(syncDir))
     {
@@ -129,42 +650,133 @@ syncEnsureRepo(const std::string &syncDir, const std::string &tempDir,
             ABC_CHECK(fileDelete(tempDir));
         ABC_CHECK(syncMakeRepo(tempDir));
         bool dirty = false;
-        ABC_CHECK(syncRepo(tempDir, syncKey, dirty));
+        ABC_CHECK(syncRepoNoMaintain(tempDir, syncKey, dirty));
+        syncJournalReset(fileSlashify(tempDir));
         if (rename(tempDir.c_str(), syncDir.c_str()))
             return ABC_ERROR(ABC_CC_SysError, "rename failed");
+        syncJournalReset(fileSlashify(syncDir));
+
+        // Maintenance must not start until the repo is in its final place:
+        syncMaintainStart(syncDir);
     }
 
     return Status();
 }
 
-Status
-syncRepo(const std::string &syncDir, const std::string &syncKey, bool &dirty)
+/**
+ * Does the actual work of `syncRepo`. The caller must hold the repo lock.
+ */
+static Status
+syncRepoLocked(const std::string &syncDir, const std::string &syncKey,
+               bool &dirty)
 {
-    AutoSyncLock lock(gSyncMutex);
-
     AutoFree<git_repository, git_repository_free> repo;
     ABC_CHECK_GIT(git_repository_open(&repo.get(), syncDir.c_str()));
 
     std::string url;
     ABC_CHECK(syncUrl(url, syncKey));
-    if (sync_fetch(repo, url.c_str()) < 0)
+
+    // Find out what has changed locally:
+    const auto journalDir = fileSlashify(syncDir);
+    std::set<std::string> paths;
+    const bool journaled = syncJournalTake(paths, journalDir);
+
+    // If neither side has changed, there is nothing to do:
+    if (journaled && paths.empty() && syncRemoteUnchanged(repo, url))
     {
-        ABC_CHECK(syncUrl(url, syncKey, true));
-        ABC_CHECK_GIT(sync_fetch(repo, url.c_str()));
+        ++gSyncSkipped;
+        dirty = false;
+        return Status();
     }
+    ++gSyncFull;
 
-    int files_changed, need_push;
-    ABC_CHECK_GIT(sync_master(repo, &files_changed, &need_push));
+    Status s = syncRepoFull(repo, url, syncKey, journaled, paths, dirty);
+    if (!s)
+    {
+        syncJournalReset(journalDir);
+        return s.at(ABC_HERE());
+    }
 
-    if (need_push)
-        ABC_CHECK_GIT(sync_push(repo, url.c_str()));
+    return Status();
+}
 
-    // If this fails, the app has been shut down, leaving us for dead.
-    // We will crash anyhow, but this at least makes it official:
-    assert(gContext);
+/**
+ * Syncs a repo without starting any background maintenance,
+ * for repos that are about to move.
+ */
+static Status
+syncRepoNoMaintain(const std::string &syncDir, const std::string &syncKey,
+                   bool &dirty)
+{
+    // Queued saves need to be on disk before the commit picks them up.
+    // A failed write only affects that file, so the sync can go ahead:
+    fileFlush().log();
 
-    dirty = !!files_changed;
+    AutoRepoLock lock(syncDir);
+    ABC_CHECK(syncRepoLocked(syncDir, syncKey, dirty));
+
+    return Status();
+}
+
+Status
+syncRepo(const std::string &syncDir, const std::string &syncKey, bool &dirty)
+{
+    ABC_CHECK(syncRepoNoMaintain(syncDir, syncKey, dirty));
+
+    // The sync itself worked, so maintenance can happen in the background:
+    syncMaintainStart(syncDir);
+
+    return Status();
+}
+
+SyncStats
+syncStats()
+{
+    SyncStats out;
+    out.skipped = gSyncSkipped;
+    out.full = gSyncFull;
+    return out;
+}
+
+Status
+syncRepoStats(SyncRepoStats &result, const std::string &syncDir)
+{
+    AutoRepoLock lock(syncDir);
+
+    ABC_CHECK(syncMeasure(result, syncDir));
+    return Status();
+}
+
+Status
+syncMaintain(const std::string &syncDir,
+             SyncRepoStats &before, SyncRepoStats &after)
+{
+    AutoRepoLock lock(syncDir);
+
+    ABC_CHECK(syncRepack(syncDir, before, after));
     return Status();
 }
 
+std::vector<Status>
+syncRunAll(const std::vector<SyncTask> &tasks)
+{
+    std::vector<Status> out(tasks.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+    {
+        for (size_t i = next++; i < tasks.size(); i = next++)
+            out[i] = tasks[i]();
+    };
+
+    // The calling thread does its share of the work, too:
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < std::min(syncMaxThreads, tasks.size()); ++i)
+        threads.emplace_back(worker);
+    worker();
+    for (auto &thread: threads)
+        thread.join();
+
+    return out;
+}
+
 } // namespace abcd
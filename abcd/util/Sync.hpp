@@ -13,6 +13,9 @@
 #define ABC_Sync_h
 
 #include "Status.hpp"
+#include <stdint.h>
+#include <functional>
+#include <vector>
 
 #define SYNC_KEY_LENGTH 20
 
@@ -51,15 +54,100 @@ syncEnsureRepo(const std::string &syncDir, const std::string &tempDir,
 
 /**
  * Synchronizes the directory with the server.
+ * This is safe to call from multiple threads,
+ * and syncs on different directories will run in parallel.
  * New files in the folder will go up to the server,
  * and new files on the server will come down to the directory.
  * If there is a conflict, the server's file will win.
+ *
+ * When no local files have changed since the last sync,
+ * this first compares the server's master branch with ours,
+ * and skips the fetch and merge if they match.
+ *
+ * Successful syncs also start a background repack every so often,
+ * since each sync otherwise leaves behind more loose objects and packs.
  * @param dirty set to true if the sync has modified the filesystem,
  * or false otherwise.
  */
 Status
 syncRepo(const std::string &syncDir, const std::string &syncKey, bool &dirty);
 
+/**
+ * Counts how often `syncRepo` could skip the fetch and merge entirely,
+ * versus how often it had to do the full sync.
+ */
+struct SyncStats
+{
+    unsigned long skipped = 0;
+    unsigned long full = 0;
+};
+
+/**
+ * Returns the sync counters since the program started.
+ */
+SyncStats
+syncStats();
+
+/**
+ * The on-disk footprint of a sync repo.
+ */
+struct SyncRepoStats
+{
+    size_t looseObjects = 0;
+    size_t packs = 0;
+    uint64_t bytes = 0;
+
+    /** Time taken to open the repo and load the master commit. */
+    long openMicroseconds = 0;
+};
+
+/**
+ * Measures a sync repo's object database.
+ */
+Status
+syncRepoStats(SyncRepoStats &result, const std::string &syncDir);
+
+/**
+ * Packs everything reachable in a sync repo into a single packfile,
+ * deleting loose objects, older packs, and anything unreachable.
+ *
+ * `syncRepo` already does this on its own,
+ * at most once a day and only once enough objects pile up,
+ * so calling this directly is only useful for testing and measurement.
+ */
+Status
+syncMaintain(const std::string &syncDir,
+             SyncRepoStats &before, SyncRepoStats &after);
+
+/**
+ * A unit of work for `syncRunAll`, typically a `syncRepo` call
+ * plus whatever reloading the result calls for.
+ */
+typedef std::function<Status ()> SyncTask;
+
+/**
+ * Runs several sync tasks at once on a small pool of threads,
+ * so the network round-trips for each repo can overlap.
+ * Each repo has its own lock, so tasks must not share directories.
+ * @return the outcome of each task, in the same order as the tasks.
+ */
+std::vector<Status>
+syncRunAll(const std::vector<SyncTask> &tasks);
+
+/**
+ * Records that a file or directory has been written or deleted.
+ * If the path lies within a sync directory,
+ * the next sync will check it for changes.
+ *
+ * As long as every write goes through here,
+ * syncs only need to look at the recorded paths.
+ * Otherwise, each sync would need to scan the entire directory.
+ * The journal lives in memory, so the first sync after startup
+ * (or after a crash) always does a full scan.
+ */
+void
+syncJournalTouch(const std::string &path);
+
 } // namespace abcd
 
 #endif
@@ -13,8 +13,10 @@
 #include "../util/Debug.hpp"
 #include "../util/FileIO.hpp"
 #include <bitcoin/bitcoin.hpp>
+#include <openssl/crypto.h>
 #include <dirent.h>
 #include <time.h>
+#include <algorithm>
 
 namespace abcd {
 
@@ -99,17 +101,12 @@ AddressJson::unpack(AddressMeta &result)
     return Status();
 }
 
-static bc::hd_private_key
-mainBranch(const Wallet &wallet)
-{
-    return bc::hd_private_key(wallet.bitcoinKey()).
-           generate_private_key(0).
-           generate_private_key(0);
-}
-
 AddressDb::AddressDb(Wallet &wallet):
     wallet_(wallet),
-    dir_(wallet.paths.addressesDir())
+    dir_(wallet.paths.addressesDir()),
+    gapLimit_(defaultGapLimit),
+    firstGap_(0),
+    lastUsed_(0)
 {
 }
 
@@ -120,8 +117,13 @@ AddressDb::load()
 
     addresses_.clear();
     files_.clear();
+    recyclable_.clear();
+    present_.clear();
+    firstGap_ = 0;
+    lastUsed_ = 0;
 
     // Open the directory:
+    AddressSet loaded;
     DIR *dir = opendir(dir_.c_str());
     if (dir)
     {
@@ -140,14 +142,14 @@ AddressDb::load()
                 if (path(address) != dir_ + de->d_name)
                     ABC_DebugLog("Filename %s does not match address", de->d_name);
 
-                addresses_[address.address] = address;
+                insertInternal(address);
                 files_[address.address] = json;
-
-                wallet_.cache.addresses.insert(address.address);
+                loaded.insert(address.address);
             }
         }
         closedir(dir);
     }
+    wallet_.cache.addresses.insert(loaded);
 
     ABC_CHECK(stockpile());
     return Status();
@@ -161,7 +163,9 @@ AddressDb::save(const AddressMeta &address)
     auto i = addresses_.find(address.address);
     if (i == addresses_.end())
         return ABC_ERROR(ABC_CC_NoAvailableAddress, "No address: " + address.address);
-    addresses_[address.address] = address;
+    if (i->second.index != address.index)
+        return ABC_ERROR(ABC_CC_Error, "Address index mismatch: " + address.address);
+    insertInternal(address);
 
     AddressJson json(files_[address.address]);
     if (!json)
@@ -200,16 +204,21 @@ AddressDb::list() const
 }
 
 KeyTable
-AddressDb::keyTable()
+AddressDb::keyTable(const AddressSet &addresses)
 {
     std::lock_guard<std::mutex> lock(mutex_);
 
-    auto m00 = mainBranch(wallet_);
+    const auto &m00 = mainBranch();
     KeyTable out;
-    for (const auto &i: addresses_)
+    for (const auto &address: addresses)
     {
-        out[i.first] = bc::secret_to_wif(
-                           m00.generate_private_key(i.second.index).private_key());
+        auto i = addresses_.find(address);
+        if (addresses_.end() == i)
+            continue;
+
+        auto secret = m00.generate_private_key(i->second.index).private_key();
+        out[address] = bc::secret_to_wif(secret);
+        OPENSSL_cleanse(secret.data(), secret.size());
     }
 
     return out;
@@ -241,20 +250,13 @@ AddressDb::getNew(AddressMeta &result)
 {
     std::lock_guard<std::mutex> lock(mutex_);
 
-    // Use a set to find the lowest available index:
-    std::set<size_t> indices;
-    for (auto &address: addresses_)
-        if (address.second.recyclable)
-            indices.insert(address.second.index);
-
     // The stockpile should prevent this from ever happening:
-    if (indices.empty())
+    if (recyclable_.empty())
         return ABC_ERROR(ABC_CC_NoAvailableAddress, "Address stockpile depleted!");
-    size_t index = *indices.begin();
+    size_t index = *recyclable_.begin();
 
     // Verify that we can still re-derive the address:
-    auto i = addresses_.find(mainBranch(wallet_).generate_private_key(index).
-                             address().encoded());
+    auto i = addresses_.find(derivedAddress(index));
     if (addresses_.end() == i)
         return ABC_ERROR(ABC_CC_Error,
                          "Address corruption at index " + std::to_string(index));
@@ -263,6 +265,19 @@ AddressDb::getNew(AddressMeta &result)
     return Status();
 }
 
+Status
+AddressDb::gapLimitSet(size_t gapLimit)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (!gapLimit)
+        return ABC_ERROR(ABC_CC_Error, "The gap limit must be at least 1");
+    gapLimit_ = gapLimit;
+
+    ABC_CHECK(stockpile());
+    return Status();
+}
+
 Status
 AddressDb::recycleSet(const std::string &address, bool recycle)
 {
@@ -297,46 +312,116 @@ AddressDb::stockpile()
 {
     ABC_CHECK(fileEnsureDir(dir_));
 
-    // Build a list of used indices:
-    std::map<size_t, bool> indices;
-    for (const auto &i: addresses_)
-        indices[i.second.index] = i.second.recyclable;
-
-    // Check for gaps:
-    size_t lastUsed = 0;
-    for (size_t i = 0; i < addresses_.size() || i < lastUsed + 5; ++i)
+    // Skip past the addresses already on disk,
+    // which is just a bitmap scan, so loads don't re-derive them:
+    while (firstGap_ < present_.size() && present_[firstGap_])
+        ++firstGap_;
+
+    // Everything below `firstGap_` is known to be present,
+    // so only the tail of the range needs checking:
+    const size_t end = std::max(present_.size(), lastUsed_ + gapLimit_);
+    if (end <= firstGap_)
+        return Status();
+
+    // Derive only the missing addresses:
+    std::list<AddressMeta> created;
+    const auto now = time(nullptr);
+    for (size_t i = firstGap_; i < end; ++i)
     {
-        auto index = indices.find(i);
-        if (index == indices.end())
-        {
-            // Create the missing address:
-            auto m00n = mainBranch(wallet_).generate_private_key(i);
-            if (m00n.valid())
-            {
-                AddressMeta address;
-                address.index = i;
-                address.address = m00n.address().encoded();
-                address.recyclable = true;
-                address.time = time(nullptr);
-                addresses_[address.address] = address;
-
-                AddressJson json;
-                ABC_CHECK(json.pack(address));
-                ABC_CHECK(json.save(path(address), wallet_.dataKey()));
-                files_[address.address] = json;
+        if (i < present_.size() && present_[i])
+            continue;
+
+        const auto encoded = derivedAddress(i);
+        if (encoded.empty())
+            continue;
+
+        AddressMeta address;
+        address.index = i;
+        address.address = encoded;
+        address.recyclable = true;
+        address.time = now;
+        created.push_back(address);
+    }
 
-                wallet_.cache.addresses.insert(address.address);
-            }
-        }
-        else if (!index->second)
-        {
-            lastUsed = i;
-        }
+    // Write them out as a batch:
+    Status s;
+    AddressSet inserted;
+    for (const auto &address: created)
+    {
+        AddressJson json;
+        s = json.pack(address);
+        if (s)
+            s = json.saveLater(path(address), wallet_.dataKey());
+        if (!s)
+            break;
+        files_[address.address] = json;
+
+        insertInternal(address);
+        inserted.insert(address.address);
     }
+    wallet_.cache.addresses.insert(inserted);
+    ABC_CHECK(s);
 
+    // Only now is the whole range filled in:
+    firstGap_ = end;
     return Status();
 }
 
+void
+AddressDb::insertInternal(const AddressMeta &address)
+{
+    addresses_[address.address] = address;
+
+    if (present_.size() <= address.index)
+        present_.resize(address.index + 1, false);
+    present_[address.index] = true;
+
+    if (address.recyclable)
+    {
+        recyclable_.insert(address.index);
+    }
+    else
+    {
+        recyclable_.erase(address.index);
+        lastUsed_ = std::max(lastUsed_, address.index);
+    }
+}
+
+const bc::hd_private_key &
+AddressDb::mainBranch()
+{
+    if (!m00_)
+    {
+        m00_.reset(new bc::hd_private_key(
+                       bc::hd_private_key(wallet_.bitcoinKey()).
+                       generate_private_key(0).
+                       generate_private_key(0)));
+    }
+    return *m00_;
+}
+
+void
+AddressDb::derive(size_t begin, size_t end)
+{
+    const auto &m00 = mainBranch();
+    for (size_t i = begin; i < end; ++i)
+    {
+        if (derived_.count(i))
+            continue;
+
+        // Only the public half is needed to find the address:
+        auto m00n = m00.generate_public_key(i);
+        derived_[i] = m00n.valid() ? m00n.address().encoded() : "";
+    }
+}
+
+std::string
+AddressDb::derivedAddress(size_t index)
+{
+    derive(index, index + 1);
+    return derived_[index];
+}
+
 std::string
 AddressDb::path(const AddressMeta &address)
 {
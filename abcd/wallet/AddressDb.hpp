@@ -11,9 +11,13 @@
 #include "Metadata.hpp"
 #include "../bitcoin/Typedefs.hpp"
 #include "../json/JsonPtr.hpp"
+#include <bitcoin/bitcoin.hpp>
 #include <list>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <set>
+#include <vector>
 
 namespace abcd {
 
@@ -37,6 +41,11 @@ struct AddressMeta
 class AddressDb
 {
 public:
+    /**
+     * The number of unused addresses to keep ready past the last used one.
+     */
+    static constexpr size_t defaultGapLimit = 5;
+
     AddressDb(Wallet &wallet);
 
     /**
@@ -64,10 +73,12 @@ public:
     list() const;
 
     /**
-     * Returns the private keys for the wallet's addresses.
+     * Returns the private keys for the requested addresses.
+     * Only the keys that are actually requested get derived,
+     * and addresses that aren't in the wallet are skipped.
      */
     KeyTable
-    keyTable();
+    keyTable(const AddressSet &addresses);
 
     /**
      * Returns true if the database contains the given address.
@@ -87,6 +98,14 @@ public:
     Status
     getNew(AddressMeta &result);
 
+    /**
+     * Changes the number of spare addresses kept past the last used one,
+     * creating more addresses if the limit has grown.
+     * The limit only lives in memory, so it resets on the next load.
+     */
+    Status
+    gapLimitSet(size_t gapLimit);
+
     /**
      * Sets the recycle bit on the address.
      */
@@ -107,6 +126,37 @@ private:
     std::map<std::string, AddressMeta> addresses_;
     std::map<std::string, JsonPtr> files_;
 
+    // Stockpile bookkeeping:
+    size_t gapLimit_;
+    std::set<size_t> recyclable_; // Free indices, lowest first
+    std::vector<bool> present_; // Bitmap of indices in the database
+    size_t firstGap_; // Everything below this index is present
+    size_t lastUsed_; // Only grows, which can only over-stockpile
+
+    // Derivation cache:
+    std::unique_ptr<bc::hd_private_key> m00_;
+    std::map<size_t, std::string> derived_;
+
+    /**
+     * Returns the wallet's main key branch, deriving it on first use.
+     */
+    const bc::hd_private_key &
+    mainBranch();
+
+    /**
+     * Derives the addresses for a range of indices in one pass,
+     * remembering them for later calls.
+     */
+    void
+    derive(size_t begin, size_t end);
+
+    /**
+     * Returns the address at the given index,
+     * or an empty string if the index is not derivable.
+     */
+    std::string
+    derivedAddress(size_t index);
+
     /**
      * Ensures that there are no gaps in the address list,
      * and at there are several extra addresses ready to go.
@@ -114,6 +164,12 @@ private:
     Status
     stockpile();
 
+    /**
+     * Adds or updates an address, keeping the bookkeeping in sync.
+     */
+    void
+    insertInternal(const AddressMeta &address);
+
     std::string
     path(const AddressMeta &address);
 };
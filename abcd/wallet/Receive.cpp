@@ -67,6 +67,7 @@ onReceive(Wallet &wallet, const TxInfo &info,
         async.szWalletUUID = wallet.id().c_str();
         async.szTxID = info.txid.c_str();
         async.sweepSatoshi = 0;
+        async.pChanges = nullptr;
         fCallback(&async);
     }
     else
@@ -81,6 +82,7 @@ onReceive(Wallet &wallet, const TxInfo &info,
         async.szWalletUUID = wallet.id().c_str();
         async.szTxID = info.txid.c_str();
         async.sweepSatoshi = 0;
+        async.pChanges = nullptr;
         fCallback(&async);
     }
 
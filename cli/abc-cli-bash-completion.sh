@@ -19,6 +19,7 @@ _abc_cli_complete()
     account-encrypt
     account-list
     account-sync
+    account-sync-all
     address-allocate
     address-calculate
     address-list
@@ -56,6 +57,7 @@ _abc_cli_complete()
     plugin-remove
     plugin-set
     repo-clone
+    repo-maintain
     repo-sync
     settings-get
     settings-set-nickname
@@ -11,6 +11,7 @@
 #include "../../abcd/json/JsonBox.hpp"
 #include "../../abcd/login/Login.hpp"
 #include "../../abcd/util/FileIO.hpp"
+#include "../../abcd/util/Sync.hpp"
 #include "../../abcd/util/Util.hpp"
 #include <iostream>
 
@@ -116,3 +117,36 @@ COMMAND(InitLevel::wallet, CliAccountSync, "account-sync",
 
     return Status();
 }
+
+COMMAND(InitLevel::account, CliAccountSyncAll, "account-sync-all",
+        "")
+{
+    if (argc != 0)
+        return ABC_ERROR(ABC_CC_Error, helpString(*this));
+
+    tABC_SyncResult *aResults = nullptr;
+    unsigned count = 0;
+    ABC_CHECK_OLD(ABC_DataSyncAll(session.username.c_str(),
+                                  session.password.c_str(),
+                                  &aResults, &count, &error));
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        const auto &result = aResults[i];
+        std::cout << (result.szWalletUUID ? result.szWalletUUID : "account") <<
+                  ": ";
+        if (ABC_CC_Ok != result.status.code)
+            std::cout << result.status.szDescription << std::endl;
+        else if (result.bDirty)
+            std::cout << "Contents changed" << std::endl;
+        else
+            std::cout << "No changes" << std::endl;
+    }
+    ABC_FreeSyncResults(aResults, count);
+
+    const auto stats = syncStats();
+    std::cout << stats.skipped << " syncs skipped, " <<
+              stats.full << " full syncs" << std::endl;
+
+    return Status();
+}
@@ -50,3 +50,28 @@ COMMAND(InitLevel::context, RepoSync, "repo-sync",
 
     return Status();
 }
+
+static void
+printStats(const char *label, const SyncRepoStats &stats)
+{
+    std::cout << label << ": " <<
+              stats.looseObjects << " loose objects, " <<
+              stats.packs << " packs, " <<
+              stats.bytes << " bytes, " <<
+              stats.openMicroseconds << "us to open" << std::endl;
+}
+
+COMMAND(InitLevel::context, RepoMaintain, "repo-maintain",
+        " <sync-key>")
+{
+    if (argc != 1)
+        return ABC_ERROR(ABC_CC_Error, helpString(*this));
+    const auto key = argv[0];
+
+    SyncRepoStats before, after;
+    ABC_CHECK(syncMaintain(repoPath(key), before, after));
+    printStats("Before", before);
+    printStats("After", after);
+
+    return Status();
+}
@@ -34,6 +34,13 @@ eventCallback(const tABC_AsyncBitCoinInfo *pInfo)
     case ABC_AsyncEventType_BlockHeightChange:
         std::cout << "Block height change" << std::endl;
         break;
+    case ABC_AsyncEventType_WalletChanges:
+        std::cout << "Wallet changes: " <<
+                  pInfo->pChanges->addedCount << " added, " <<
+                  pInfo->pChanges->changedCount << " changed, " <<
+                  pInfo->pChanges->confirmedCount << " confirmed, " <<
+                  "balance " << pInfo->pChanges->balanceDelta << std::endl;
+        break;
     default:
         break;
     }
@@ -10,7 +10,14 @@
 
 #include "sync.h"
 #include <git2/sys/commit.h> /* For git_commit_create_from_ids */
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #define git_check(f) if ((e = f) < 0) goto exit;
 
@@ -20,6 +27,8 @@
 #define SYNC_REF_MASTER                 "refs/heads/master"
 #define SYNC_GIT_NAME                   "wallet"
 #define SYNC_GIT_EMAIL                  "wallet@airbitz.co"
+#define SYNC_PACK_DIR                   "objects/pack/"
+#define SYNC_PRUNE_GRACE                (60 * 60) /* Seconds */
 
 /**
  * Checks out the given branch.
@@ -320,6 +329,401 @@ exit:
     return e;
 }
 
+/**
+ * Creates a git tree object representing the state of the working directory,
+ * assuming that only the listed paths differ from the given base tree.
+ * This avoids visiting any other files in the working directory.
+ */
+static int sync_paths_tree(git_oid *out,
+                           git_repository *repo,
+                           const git_oid *base_tree_id,
+                           const git_strarray *paths)
+{
+    int e = 0;
+    git_tree *base_tree = NULL;
+    git_index *index = NULL;
+    char *full_path = NULL;
+    const char *workdir = git_repository_workdir(repo);
+    size_t workdir_size = strlen(workdir);
+    size_t i;
+
+    git_check(git_tree_lookup(&base_tree, repo, base_tree_id));
+    git_check(git_repository_index(&index, repo));
+    git_check(git_index_read_tree(index, base_tree));
+
+    for (i = 0; i < paths->count; ++i)
+    {
+        const char *path = paths->strings[i];
+        struct stat st;
+
+        free(full_path);
+        full_path = malloc(workdir_size + strlen(path) + 1);
+        if (!full_path)
+        {
+            giterr_set_oom();
+            e = -1;
+            goto exit;
+        }
+        strcpy(full_path, workdir);
+        strcat(full_path, path);
+
+        if (stat(full_path, &st))
+        {
+            // The path is gone, whether it was a file or a directory:
+            git_check(git_index_remove_bypath(index, path));
+            git_check(git_index_remove_directory(index, path, 0));
+        }
+        else if (S_ISDIR(st.st_mode))
+        {
+            // Re-add whatever the directory holds now:
+            git_strarray pathspec = {(char **)&path, 1};
+            git_check(git_index_remove_directory(index, path, 0));
+            git_check(git_index_add_all(index, &pathspec, 0, NULL, NULL));
+        }
+        else
+        {
+            git_check(git_index_add_bypath(index, path));
+        }
+    }
+
+    git_check(git_index_write_tree(out, index));
+    git_check(git_index_write(index));
+
+exit:
+    if (base_tree)      git_tree_free(base_tree);
+    if (index)          git_index_free(index);
+    free(full_path);
+    return e;
+}
+
+/**
+ * A simple hash set of object ids, used to avoid re-walking trees that
+ * many commits have in common.
+ */
+typedef struct
+{
+    git_oid *items;
+    size_t size;
+    size_t used;
+} sync_oidset;
+
+/**
+ * Adds an id to the set.
+ * Returns 1 if the id is new, 0 if it was already present,
+ * or -1 if memory runs out.
+ */
+static int sync_oidset_insert(sync_oidset *set, const git_oid *id)
+{
+    size_t i;
+
+    // Keep the table at most half full:
+    if (set->size <= 2 * set->used)
+    {
+        sync_oidset old = *set;
+        set->size = old.size ? 2 * old.size : 1024;
+        set->used = 0;
+        set->items = calloc(set->size, sizeof(git_oid));
+        if (!set->items)
+        {
+            *set = old;
+            giterr_set_oom();
+            return -1;
+        }
+        for (i = 0; i < old.size; ++i)
+            if (!git_oid_iszero(&old.items[i]))
+                sync_oidset_insert(set, &old.items[i]);
+        free(old.items);
+    }
+
+    // Object ids are already well-mixed, so use the first bytes as the hash:
+    i = (id->id[0] | id->id[1] << 8 | id->id[2] << 16) & (set->size - 1);
+    while (!git_oid_iszero(&set->items[i]))
+    {
+        if (!git_oid_cmp(&set->items[i], id))
+            return 0;
+        i = (i + 1) & (set->size - 1);
+    }
+    git_oid_cpy(&set->items[i], id);
+    ++set->used;
+    return 1;
+}
+
+/**
+ * Adds a tree and everything it contains to a packfile.
+ */
+static int sync_pack_tree(git_packbuilder *pb,
+                          sync_oidset *seen,
+                          git_repository *repo,
+                          const git_oid *tree_id)
+{
+    int e = 0;
+    git_tree *tree = NULL;
+    size_t i;
+
+    e = sync_oidset_insert(seen, tree_id);
+    if (e <= 0)
+        return e;
+
+    git_check(git_packbuilder_insert(pb, tree_id, NULL));
+    git_check(git_tree_lookup(&tree, repo, tree_id));
+    for (i = 0; i < git_tree_entrycount(tree); ++i)
+    {
+        const git_tree_entry *entry = git_tree_entry_byindex(tree, i);
+        if (GIT_OBJ_TREE == git_tree_entry_type(entry))
+        {
+            git_check(sync_pack_tree(pb, seen, repo, git_tree_entry_id(entry)));
+        }
+        else
+        {
+            git_check(git_packbuilder_insert(pb, git_tree_entry_id(entry),
+                git_tree_entry_name(entry)));
+        }
+    }
+
+exit:
+    if (tree)           git_tree_free(tree);
+    return e;
+}
+
+/**
+ * Returns true if the string is a run of hex digits of the given length.
+ */
+static int sync_is_hex(const char *s, size_t size)
+{
+    size_t i;
+    for (i = 0; i < size; ++i)
+        if (!s[i] || !strchr("0123456789abcdef", s[i]))
+            return 0;
+    return !s[size];
+}
+
+/**
+ * Flushes a file or directory to stable storage.
+ */
+static int sync_fsync(const char *path)
+{
+    int e;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        giterr_set_str(GITERR_OS, "Cannot open file for syncing");
+        return -1;
+    }
+
+    e = fsync(fd);
+    close(fd);
+    if (e)
+    {
+        giterr_set_str(GITERR_OS, "Cannot sync file");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Returns true if the file was modified within the grace period,
+ * so a concurrent writer might still be about to reference it.
+ */
+static int sync_is_recent(const char *path,
+                          time_t now)
+{
+    struct stat st;
+    return !stat(path, &st) && now < st.st_mtime + SYNC_PRUNE_GRACE;
+}
+
+/**
+ * Deletes every loose object, and every packfile except the one named.
+ * Files younger than the grace period are left alone.
+ */
+static int sync_prune(git_repository *repo,
+                      const char *keep)
+{
+    int e = 0;
+    time_t now = time(NULL);
+    const char *gitdir = git_repository_path(repo);
+    size_t path_size = strlen(gitdir) + 512;
+    char *path = NULL;
+    DIR *objects = NULL;
+    DIR *dir = NULL;
+    struct dirent *de;
+
+    path = malloc(path_size);
+    if (!path)
+    {
+        giterr_set_oom();
+        e = -1;
+        goto exit;
+    }
+
+    // Loose objects live in two-digit fan-out directories:
+    snprintf(path, path_size, "%sobjects", gitdir);
+    objects = opendir(path);
+    while (objects && NULL != (de = readdir(objects)))
+    {
+        char fanout[3];
+        if (!sync_is_hex(de->d_name, 2))
+            continue;
+        memcpy(fanout, de->d_name, sizeof(fanout));
+
+        snprintf(path, path_size, "%sobjects/%s", gitdir, fanout);
+        dir = opendir(path);
+        while (dir && NULL != (de = readdir(dir)))
+        {
+            if (!sync_is_hex(de->d_name, GIT_OID_HEXSZ - 2))
+                continue;
+            snprintf(path, path_size, "%sobjects/%s/%s", gitdir, fanout,
+                de->d_name);
+            if (!sync_is_recent(path, now))
+                unlink(path);
+        }
+        if (dir)
+        {
+            closedir(dir);
+            dir = NULL;
+        }
+        snprintf(path, path_size, "%sobjects/%s", gitdir, fanout);
+        rmdir(path);
+    }
+
+    // Old packs:
+    snprintf(path, path_size, "%s" SYNC_PACK_DIR, gitdir);
+    dir = opendir(path);
+    while (dir && NULL != (de = readdir(dir)))
+    {
+        const char *ext = strrchr(de->d_name, '.');
+        if (strncmp(de->d_name, "pack-", 5) || !ext ||
+            (strcmp(ext, ".pack") && strcmp(ext, ".idx")) ||
+            !strncmp(de->d_name, keep, strlen(keep)))
+            continue;
+        snprintf(path, path_size, "%s" SYNC_PACK_DIR "%s", gitdir, de->d_name);
+        if (!sync_is_recent(path, now))
+            unlink(path);
+    }
+
+exit:
+    if (objects)        closedir(objects);
+    if (dir)            closedir(dir);
+    free(path);
+    return e;
+}
+
+/**
+ * Empties the reflog for the named reference.
+ */
+static int sync_clear_reflog(git_repository *repo,
+                             const char *name)
+{
+    int e = 0;
+    git_reflog *reflog = NULL;
+
+    git_check(git_reflog_read(&reflog, repo, name));
+    while (git_reflog_entrycount(reflog))
+    {
+        git_check(git_reflog_drop(reflog, 0, 0));
+    }
+    git_check(git_reflog_write(reflog));
+
+exit:
+    if (reflog)         git_reflog_free(reflog);
+    return e;
+}
+
+/**
+ * Packs every object reachable from the sync branches into a single
+ * packfile, then deletes the loose objects, old packs, and reflogs.
+ */
+int sync_repack(git_repository *repo)
+{
+    int e = 0;
+    git_packbuilder *pb = NULL;
+    git_revwalk *walk = NULL;
+    git_commit *commit = NULL;
+    git_odb *odb = NULL;
+    char *pack_dir = NULL;
+    sync_oidset seen = {NULL, 0, 0};
+    const char *refs[] = {SYNC_REF_MASTER, SYNC_REF_REMOTE};
+    const char *gitdir = git_repository_path(repo);
+    char keep[5 + GIT_OID_HEXSZ + 1] = "pack-";
+    char *path = NULL;
+    size_t path_size;
+    git_oid id;
+    size_t i;
+
+    // Gather everything reachable from the branches:
+    git_check(git_packbuilder_new(&pb, repo));
+    git_check(git_revwalk_new(&walk, repo));
+    for (i = 0; i < sizeof(refs) / sizeof(refs[0]); ++i)
+    {
+        memset(&id, 0, sizeof(id));
+        git_check(sync_lookup_soft(&id, repo, refs[i]));
+        if (!git_oid_iszero(&id))
+        {
+            git_check(git_revwalk_push(walk, &id));
+        }
+    }
+    while (!(e = git_revwalk_next(&id, walk)))
+    {
+        git_check(git_commit_lookup(&commit, repo, &id));
+        git_check(git_packbuilder_insert(pb, &id, NULL));
+        git_check(sync_pack_tree(pb, &seen, repo, git_commit_tree_id(commit)));
+        git_commit_free(commit);
+        commit = NULL;
+    }
+    if (e != GIT_ITEROVER)
+        goto exit;
+    e = 0;
+    if (!git_packbuilder_object_count(pb))
+        goto exit;
+
+    // Write the new pack before deleting anything:
+    pack_dir = malloc(strlen(gitdir) + sizeof(SYNC_PACK_DIR));
+    if (!pack_dir)
+    {
+        giterr_set_oom();
+        e = -1;
+        goto exit;
+    }
+    strcpy(pack_dir, gitdir);
+    strcat(pack_dir, SYNC_PACK_DIR);
+    git_check(git_packbuilder_write(pb, pack_dir, 0, NULL, NULL));
+    git_oid_fmt(keep + 5, git_packbuilder_hash(pb));
+    keep[sizeof(keep) - 1] = 0;
+
+    // The new pack must survive a crash before the old objects go:
+    path_size = strlen(pack_dir) + sizeof(keep) + sizeof(".pack");
+    path = malloc(path_size);
+    if (!path)
+    {
+        giterr_set_oom();
+        e = -1;
+        goto exit;
+    }
+    snprintf(path, path_size, "%s%s.pack", pack_dir, keep);
+    git_check(sync_fsync(path));
+    snprintf(path, path_size, "%s%s.idx", pack_dir, keep);
+    git_check(sync_fsync(path));
+    git_check(sync_fsync(pack_dir));
+
+    // Everything else is now redundant or unreachable:
+    git_check(sync_prune(repo, keep));
+    git_check(sync_clear_reflog(repo, "HEAD"));
+    git_check(sync_clear_reflog(repo, SYNC_REF_MASTER));
+    git_check(sync_clear_reflog(repo, SYNC_REF_REMOTE));
+
+    git_check(git_repository_odb(&odb, repo));
+    git_check(git_odb_refresh(odb));
+
+exit:
+    if (pb)             git_packbuilder_free(pb);
+    if (walk)           git_revwalk_free(walk);
+    if (commit)         git_commit_free(commit);
+    if (odb)            git_odb_free(odb);
+    free(pack_dir);
+    free(path);
+    free(seen.items);
+    return e;
+}
+
 /**
  * Fetches the contents of the server into the "incoming" branch.
  */
@@ -347,6 +751,18 @@ exit:
 int sync_master(git_repository *repo,
                 int *files_changed,
                 int *need_push)
+{
+    return sync_master_paths(repo, NULL, files_changed, need_push);
+}
+
+/**
+ * Updates the master branch, only checking the listed paths for local
+ * changes.
+ */
+int sync_master_paths(git_repository *repo,
+                      const git_strarray *paths,
+                      int *files_changed,
+                      int *need_push)
 {
     int e = 0;
     git_oid master_id = {{0}};
@@ -355,6 +771,7 @@ int sync_master(git_repository *repo,
     int master_dirty = 0;
     int remote_dirty = 0;
     int local_dirty = 0;
+    git_oid local_tree = {{0}};
 
     // Find the relevant commit objects:
     git_check(sync_lookup_soft(&master_id, repo, SYNC_REF_MASTER));
@@ -371,21 +788,30 @@ int sync_master(git_repository *repo,
     // Figure out what needs syncing:
     master_dirty = git_oid_cmp(&master_id, &base_id);
     remote_dirty = git_oid_cmp(&remote_id, &base_id);
-    git_check(sync_local_dirty(&local_dirty, repo, &master_id));
+    if (paths && !git_repository_is_bare(repo))
+    {
+        git_oid master_tree;
+        git_check(sync_get_tree(&master_tree, repo, &master_id));
+        git_check(sync_paths_tree(&local_tree, repo, &master_tree, paths));
+        local_dirty = !!git_oid_cmp(&local_tree, &master_tree);
+    }
+    else
+    {
+        git_check(sync_local_dirty(&local_dirty, repo, &master_id));
+        if (local_dirty)
+        {
+            git_check(sync_workdir_tree(&local_tree, repo));
+        }
+    }
 
     if (remote_dirty)
     {
         if (master_dirty || local_dirty)
         {
             // 3-way merge:
-            git_oid local_tree;
             git_oid base_tree;
             git_oid remote_tree;
-            if (local_dirty)
-            {
-                git_check(sync_workdir_tree(&local_tree, repo));
-            }
-            else
+            if (!local_dirty)
             {
                 git_check(sync_get_tree(&local_tree, repo, &master_id));
             }
@@ -423,8 +849,6 @@ int sync_master(git_repository *repo,
     else if (local_dirty)
     {
         // Commit local changes:
-        git_oid local_tree;
-        git_check(sync_workdir_tree(&local_tree, repo));
         if (git_oid_iszero(&master_id))
         {
             const git_oid *parents[] = {NULL};
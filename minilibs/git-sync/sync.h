@@ -34,6 +34,28 @@ int sync_master(git_repository *repo,
                 int *files_changed,
                 int *need_push);
 
+/**
+ * Like `sync_master`, but only checks the listed paths for local changes,
+ * instead of scanning the entire working directory.
+ * The caller must know that no other paths have changed since the last sync.
+ * @param paths workdir-relative files or directories that may have changed.
+ * Passing NULL scans the whole working directory, just like `sync_master`.
+ */
+int sync_master_paths(git_repository *repo,
+                      const git_strarray *paths,
+                      int *files_changed,
+                      int *need_push);
+
+/**
+ * Packs all the objects reachable from the sync branches into a single
+ * packfile. Loose objects, older packs, unreachable objects, and reflogs
+ * are all deleted in the process, once the new pack is on stable storage.
+ * Loose objects and packs modified within the last hour are kept,
+ * in case another writer is still using them.
+ * Nothing else may use the repository while this runs.
+ */
+int sync_repack(git_repository *repo);
+
 /**
  * Pushes the master branch to the server.
  */
@@ -52,6 +52,22 @@ exit:
     return e;
 }
 
+static int do_sync_paths(git_repository *repo, const char *server,
+                         char **paths, size_t count)
+{
+    int e = 0;
+    int dirty, need_push;
+    git_strarray array = {paths, count};
+
+    CHECK(sync_fetch(repo, server));
+    CHECK(sync_master_paths(repo, &array, &dirty, &need_push));
+    if (need_push)
+        CHECK(sync_push(repo, server));
+
+exit:
+    return e;
+}
+
 int main(int argc, char *argv[])
 {
     int e = 0;
@@ -102,11 +118,32 @@ int main(int argc, char *argv[])
     CHECK(do_sync(repo_b, SERVER));
     CHECK(do_sync(repo_a, SERVER));
 
+    // Journaled changes, including a deleted directory:
+    {
+        char *paths_a[] = {"d.txt", "sub"};
+        char *paths_b[] = {"e.txt"};
+        CHECK(create_file(REPO_A "/d.txt", "a\n"));
+        CHECK(remove(REPO_A "/sub/b.txt"));
+        CHECK(remove(REPO_A "/sub/c.txt"));
+        CHECK(remove(REPO_A "/sub"));
+        CHECK(create_file(REPO_B "/e.txt", "b\n"));
+        CHECK(do_sync_paths(repo_a, SERVER, paths_a, 2));
+        CHECK(do_sync_paths(repo_b, SERVER, paths_b, 1));
+        CHECK(do_sync_paths(repo_a, SERVER, NULL, 0));
+    }
+
+    // Repacking should not disturb later syncs:
+    CHECK(sync_repack(repo_a));
+    CHECK(create_file(REPO_A "/f.txt", "a\n"));
+    CHECK(do_sync(repo_a, SERVER));
+    CHECK(do_sync(repo_b, SERVER));
+
     // When this is done, the two subdirs should match exactly:
     // b.txt = b
     // c.txt = a
-    // sub/b.txt = b
-    // sub/c.txt = a
+    // d.txt = a
+    // e.txt = b
+    // f.txt = a
 
     // TODO: Verify this in code
 
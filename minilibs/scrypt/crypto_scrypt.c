@@ -28,197 +28,404 @@
  */
 
 #include "crypto_scrypt.h"
-#include "sysendian.h"
+#include "crypto_scrypt_smix.h"
+#include <sys/mman.h>
 #include <openssl/evp.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <unistd.h>
 
-static void blkcpy(uint8_t *, uint8_t *, size_t);
-static void blkxor(uint8_t *, uint8_t *, size_t);
-static void salsa20_8(uint8_t[64]);
-static void blockmix_salsa8(uint8_t *, uint8_t *, size_t);
-static uint64_t integerify(uint8_t *, size_t);
-static void smix(uint8_t *, size_t, uint64_t, uint8_t *, uint8_t *);
+#if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#define MAP_ANON MAP_ANONYMOUS
+#endif
 
-static void
-blkcpy(uint8_t * dest, uint8_t * src, size_t len)
-{
-	size_t i;
+/* Lanes only run in parallel while their V arrays fit in this much memory. */
+#define CRYPTO_SCRYPT_PARALLEL_MEMORY	((uint64_t)512 * 1024 * 1024)
 
-	for (i = 0; i < len; i++)
-		dest[i] = src[i];
+/* The most threads a single crypto_scrypt call will use. */
+#define CRYPTO_SCRYPT_MAX_THREADS	16
+
+/* The most idle blocks a context will keep for reuse. */
+#define CRYPTO_SCRYPT_CTX_BLOCKS	4
+
+/**
+ * A chunk of scratch memory, holding the XY and V arrays for every thread
+ * working on one crypto_scrypt call.
+ */
+struct scrypt_block {
+	void * mem;
+	size_t size;
+};
+
+/**
+ * Scratch memory shared between calls.  Blocks in use never add up to more
+ * than max_memory, except when a single call needs more than that on its
+ * own.  Idle blocks are kept for reuse, up to the retain limit.
+ */
+struct crypto_scrypt_ctx {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	size_t max_memory;
+	size_t retain;
+	int flags;
+	size_t in_use;
+	size_t idle;
+	struct scrypt_block idle_blocks[CRYPTO_SCRYPT_CTX_BLOCKS];
+	size_t nidle;
+};
+
+/* Calling through a volatile pointer stops the compiler eliding the wipe. */
+static void * (* const volatile memset_wipe)(void *, int, size_t) = memset;
+
+/**
+ * One thread's share of the p independent SMix lanes.  Each thread has its
+ * own V and XY scratch space, and handles lanes first, first + step, ...
+ */
+struct smix_lanes {
+	crypto_scrypt_smix_t * smix;
+	uint8_t * B;
+	size_t r;
+	uint64_t N;
+	uint32_t p;
+	uint32_t first;
+	uint32_t step;
+	void * V;
+	void * XY;
+};
+
+/**
+ * cpu_has_sse2():
+ * Return nonzero if the running CPU can execute the SSE2 code.
+ */
+#ifdef CRYPTO_SCRYPT_HAVE_SSE2
+static int
+cpu_has_sse2(void)
+{
+#if defined(__GNUC__)
+	return (__builtin_cpu_supports("sse2"));
+#else
+	/* The compiler was told it could use SSE2, so assume it works. */
+	return (1);
+#endif
 }
+#endif
 
-static void
-blkxor(uint8_t * dest, uint8_t * src, size_t len)
+/**
+ * select_smix(impl):
+ * Return the smix function for the given implementation, or NULL if it is
+ * not available on this machine.
+ */
+static crypto_scrypt_smix_t *
+select_smix(crypto_scrypt_impl impl)
 {
-	size_t i;
 
-	for (i = 0; i < len; i++)
-		dest[i] ^= src[i];
+	switch (impl) {
+	case CRYPTO_SCRYPT_AUTO:
+#ifdef CRYPTO_SCRYPT_HAVE_SSE2
+		if (cpu_has_sse2())
+			return (crypto_scrypt_smix_sse2);
+#endif
+		return (crypto_scrypt_smix);
+	case CRYPTO_SCRYPT_REF:
+		return (crypto_scrypt_smix_ref);
+	case CRYPTO_SCRYPT_PORTABLE:
+		return (crypto_scrypt_smix);
+	case CRYPTO_SCRYPT_SSE2:
+#ifdef CRYPTO_SCRYPT_HAVE_SSE2
+		if (cpu_has_sse2())
+			return (crypto_scrypt_smix_sse2);
+#endif
+		return (NULL);
+	}
+	return (NULL);
 }
 
 /**
- * salsa20_8(B):
- * Apply the salsa20/8 core to the provided block.
+ * smix_lanes_run(cookie):
+ * Run one thread's share of the SMix lanes.
  */
-static void
-salsa20_8(uint8_t B[64])
+static void *
+smix_lanes_run(void * cookie)
 {
-	uint32_t B32[16];
-	uint32_t x[16];
-	size_t i;
+	struct smix_lanes * L = cookie;
+	uint32_t i;
 
-	/* Convert little-endian values in. */
-	for (i = 0; i < 16; i++)
-		B32[i] = le32dec(&B[i * 4]);
+	/* 2: for i = 0 to p - 1 do */
+	for (i = L->first; i < L->p; i += L->step) {
+		/* 3: B_i <-- MF(B_i, N) */
+		L->smix(&L->B[i * 128 * L->r], L->r, L->N, L->V, L->XY);
+	}
+
+	return (NULL);
+}
 
-	/* Compute x = doubleround^4(B32). */
-	for (i = 0; i < 16; i++)
-		x[i] = B32[i];
-	for (i = 0; i < 8; i += 2) {
-#define R(a,b) (((a) << (b)) | ((a) >> (32 - (b))))
-		/* Operate on columns. */
-		x[ 4] ^= R(x[ 0]+x[12], 7);  x[ 8] ^= R(x[ 4]+x[ 0], 9);
-		x[12] ^= R(x[ 8]+x[ 4],13);  x[ 0] ^= R(x[12]+x[ 8],18);
+/**
+ * lane_size(N, r):
+ * Return the scratch memory one thread needs: XY, padded to keep V aligned,
+ * followed by V.
+ */
+static size_t
+lane_size(uint64_t N, uint32_t r)
+{
 
-		x[ 9] ^= R(x[ 5]+x[ 1], 7);  x[13] ^= R(x[ 9]+x[ 5], 9);
-		x[ 1] ^= R(x[13]+x[ 9],13);  x[ 5] ^= R(x[ 1]+x[13],18);
+	size_t xy = (256 * (size_t)(r) + 64 + 127) / 128 * 128;
 
-		x[14] ^= R(x[10]+x[ 6], 7);  x[ 2] ^= R(x[14]+x[10], 9);
-		x[ 6] ^= R(x[ 2]+x[14],13);  x[10] ^= R(x[ 6]+x[ 2],18);
+	return (xy + 128 * (size_t)(r) * N);
+}
 
-		x[ 3] ^= R(x[15]+x[11], 7);  x[ 7] ^= R(x[ 3]+x[15], 9);
-		x[11] ^= R(x[ 7]+x[ 3],13);  x[15] ^= R(x[11]+x[ 7],18);
+/**
+ * smix_threads(N, r, p, budget):
+ * Return the number of threads to spread the p lanes over, limited by
+ * the number of CPUs and by the total scratch memory allowed.
+ */
+static uint32_t
+smix_threads(uint64_t N, uint32_t r, uint32_t p, uint64_t budget)
+{
+	uint64_t threads = p;
+	uint64_t memory = lane_size(N, r);
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (cpus > 0 && (uint64_t)(cpus) < threads)
+		threads = cpus;
+	if (budget / memory < threads)
+		threads = budget / memory;
+	if (CRYPTO_SCRYPT_MAX_THREADS < threads)
+		threads = CRYPTO_SCRYPT_MAX_THREADS;
+	if (threads < 1)
+		threads = 1;
+
+	return ((uint32_t)(threads));
+}
 
-		/* Operate on rows. */
-		x[ 1] ^= R(x[ 0]+x[ 3], 7);  x[ 2] ^= R(x[ 1]+x[ 0], 9);
-		x[ 3] ^= R(x[ 2]+x[ 1],13);  x[ 0] ^= R(x[ 3]+x[ 2],18);
+uint32_t
+crypto_scrypt_parallelism(uint64_t N, uint32_t r, uint32_t p)
+{
 
-		x[ 6] ^= R(x[ 5]+x[ 4], 7);  x[ 7] ^= R(x[ 6]+x[ 5], 9);
-		x[ 4] ^= R(x[ 7]+x[ 6],13);  x[ 5] ^= R(x[ 4]+x[ 7],18);
+	return (smix_threads(N, r, p, CRYPTO_SCRYPT_PARALLEL_MEMORY));
+}
 
-		x[11] ^= R(x[10]+x[ 9], 7);  x[ 8] ^= R(x[11]+x[10], 9);
-		x[ 9] ^= R(x[ 8]+x[11],13);  x[10] ^= R(x[ 9]+x[ 8],18);
+/**
+ * block_map(size, flags):
+ * Map a fresh block of anonymous memory, or return NULL on failure.
+ */
+static void *
+block_map(size_t size, int flags)
+{
+	int mflags = MAP_PRIVATE | MAP_ANON;
+	int populated = 0;
+	uint8_t * mem;
+	size_t i;
 
-		x[12] ^= R(x[15]+x[14], 7);  x[13] ^= R(x[12]+x[15], 9);
-		x[14] ^= R(x[13]+x[12],13);  x[15] ^= R(x[14]+x[13],18);
-#undef R
+#ifdef MAP_POPULATE
+	/* Huge pages must be requested before the memory is faulted in. */
+	if ((flags & CRYPTO_SCRYPT_POPULATE) &&
+	    !(flags & CRYPTO_SCRYPT_HUGEPAGES)) {
+		mflags |= MAP_POPULATE;
+		populated = 1;
 	}
+#endif
+	mem = mmap(NULL, size, PROT_READ | PROT_WRITE, mflags, -1, 0);
+	if (mem == MAP_FAILED)
+		return (NULL);
+
+#ifdef MADV_HUGEPAGE
+	if (flags & CRYPTO_SCRYPT_HUGEPAGES)
+		(void)madvise(mem, size, MADV_HUGEPAGE);
+#endif
 
-	/* Compute B32 = B32 + x. */
-	for (i = 0; i < 16; i++)
-		B32[i] += x[i];
+	/* Fault the pages in now, unless MAP_POPULATE already did. */
+	if ((flags & CRYPTO_SCRYPT_POPULATE) && !populated) {
+		for (i = 0; i < size; i += 4096)
+			mem[i] = 0;
+	}
 
-	/* Convert little-endian values out. */
-	for (i = 0; i < 16; i++)
-		le32enc(&B[4 * i], B32[i]);
+	return (mem);
 }
 
 /**
- * blockmix_salsa8(B, Y, r):
- * Compute B = BlockMix_{salsa20/8, r}(B).  The input B must be 128r bytes in
- * length; the temporary space Y must also be the same size.
+ * block_acquire(ctx, size, block):
+ * Get a block of at least size bytes, waiting for other calls to finish
+ * if it would take the context over its memory limit.  Return 0 on
+ * success or -1 on error.
  */
-static void
-blockmix_salsa8(uint8_t * B, uint8_t * Y, size_t r)
+static int
+block_acquire(crypto_scrypt_ctx * ctx, size_t size,
+    struct scrypt_block * block)
 {
-	uint8_t X[64];
+	size_t best;
 	size_t i;
 
-	/* 1: X <-- B_{2r - 1} */
-	blkcpy(X, &B[(2 * r - 1) * 64], 64);
+	pthread_mutex_lock(&ctx->lock);
 
-	/* 2: for i = 0 to 2r - 1 do */
-	for (i = 0; i < 2 * r; i++) {
-		/* 3: X <-- H(X \xor B_i) */
-		blkxor(X, &B[i * 64], 64);
-		salsa20_8(X);
+	/* Wait for room, unless nothing else is running. */
+	while (ctx->in_use && ctx->in_use + size > ctx->max_memory)
+		pthread_cond_wait(&ctx->cond, &ctx->lock);
 
-		/* 4: Y_i <-- X */
-		blkcpy(&Y[i * 64], X, 64);
+	/* Reuse the smallest idle block that fits. */
+	best = ctx->nidle;
+	for (i = 0; i < ctx->nidle; i++) {
+		if (ctx->idle_blocks[i].size >= size && (best == ctx->nidle ||
+		    ctx->idle_blocks[i].size < ctx->idle_blocks[best].size))
+			best = i;
+	}
+	if (best < ctx->nidle) {
+		*block = ctx->idle_blocks[best];
+		ctx->idle_blocks[best] = ctx->idle_blocks[--ctx->nidle];
+		ctx->idle -= block->size;
+		ctx->in_use += block->size;
+		pthread_mutex_unlock(&ctx->lock);
+		return (0);
 	}
 
-	/* 6: B' <-- (Y_0, Y_2 ... Y_{2r-2}, Y_1, Y_3 ... Y_{2r-1}) */
-	for (i = 0; i < r; i++)
-		blkcpy(&B[i * 64], &Y[(i * 2) * 64], 64);
-	for (i = 0; i < r; i++)
-		blkcpy(&B[(i + r) * 64], &Y[(i * 2 + 1) * 64], 64);
+	/* Drop idle blocks until the new one fits under the limit. */
+	while (ctx->nidle && ctx->idle + ctx->in_use + size > ctx->max_memory) {
+		--ctx->nidle;
+		ctx->idle -= ctx->idle_blocks[ctx->nidle].size;
+		munmap(ctx->idle_blocks[ctx->nidle].mem,
+		    ctx->idle_blocks[ctx->nidle].size);
+	}
+	ctx->in_use += size;
+	pthread_mutex_unlock(&ctx->lock);
+
+	/* Map the new block outside the lock. */
+	block->size = size;
+	if ((block->mem = block_map(size, ctx->flags)) == NULL) {
+		pthread_mutex_lock(&ctx->lock);
+		ctx->in_use -= size;
+		pthread_cond_broadcast(&ctx->cond);
+		pthread_mutex_unlock(&ctx->lock);
+		errno = ENOMEM;
+		return (-1);
+	}
+
+	return (0);
 }
 
 /**
- * integerify(B, r):
- * Return the result of parsing B_{2r-1} as a little-endian integer.
+ * block_release(ctx, block, used):
+ * Wipe the first used bytes of the block, then keep it for reuse or
+ * unmap it.
  */
-static uint64_t
-integerify(uint8_t * B, size_t r)
+static void
+block_release(crypto_scrypt_ctx * ctx, struct scrypt_block * block,
+    size_t used)
 {
-	uint8_t * X = &B[(2 * r - 1) * 64];
+	int keep = 0;
+
+	memset_wipe(block->mem, 0, used);
+
+	pthread_mutex_lock(&ctx->lock);
+	ctx->in_use -= block->size;
+	if (ctx->nidle < CRYPTO_SCRYPT_CTX_BLOCKS &&
+	    ctx->idle + block->size <= ctx->retain) {
+		ctx->idle_blocks[ctx->nidle++] = *block;
+		ctx->idle += block->size;
+		keep = 1;
+	}
+	pthread_cond_broadcast(&ctx->cond);
+	pthread_mutex_unlock(&ctx->lock);
 
-	return (le64dec(X));
+	if (!keep)
+		munmap(block->mem, block->size);
 }
 
-/**
- * smix(B, r, N, V, XY):
- * Compute B = SMix_r(B, N).  The input B must be 128r bytes in length; the
- * temporary storage V must be 128rN bytes in length; the temporary storage
- * XY must be 256r bytes in length.  The value N must be a power of 2.
- */
-static void
-smix(uint8_t * B, size_t r, uint64_t N, uint8_t * V, uint8_t * XY)
+crypto_scrypt_ctx *
+crypto_scrypt_ctx_new(size_t max_memory, size_t retain, int flags)
 {
-	uint8_t * X = XY;
-	uint8_t * Y = &XY[128 * r];
-	uint64_t i;
-	uint64_t j;
+	crypto_scrypt_ctx * ctx;
 
-	/* 1: X <-- B */
-	blkcpy(X, B, 128 * r);
+	if ((ctx = malloc(sizeof(crypto_scrypt_ctx))) == NULL)
+		return (NULL);
+	if (pthread_mutex_init(&ctx->lock, NULL))
+		goto err1;
+	if (pthread_cond_init(&ctx->cond, NULL))
+		goto err2;
+	ctx->max_memory = max_memory;
+	ctx->retain = retain;
+	ctx->flags = flags;
+	ctx->in_use = 0;
+	ctx->idle = 0;
+	ctx->nidle = 0;
 
-	/* 2: for i = 0 to N - 1 do */
-	for (i = 0; i < N; i++) {
-		/* 3: V_i <-- X */
-		blkcpy(&V[i * (128 * r)], X, 128 * r);
+	return (ctx);
 
-		/* 4: X <-- H(X) */
-		blockmix_salsa8(X, Y, r);
-	}
+err2:
+	pthread_mutex_destroy(&ctx->lock);
+err1:
+	free(ctx);
+	return (NULL);
+}
 
-	/* 6: for i = 0 to N - 1 do */
-	for (i = 0; i < N; i++) {
-		/* 7: j <-- Integerify(X) mod N */
-		j = integerify(X, r) & (N - 1);
+void
+crypto_scrypt_ctx_free(crypto_scrypt_ctx * ctx)
+{
+	size_t i;
 
-		/* 8: X <-- H(X \xor V_j) */
-		blkxor(X, &V[j * (128 * r)], 128 * r);
-		blockmix_salsa8(X, Y, r);
-	}
+	if (ctx == NULL)
+		return;
 
-	/* 10: B' <-- X */
-	blkcpy(B, X, 128 * r);
+	for (i = 0; i < ctx->nidle; i++)
+		munmap(ctx->idle_blocks[i].mem, ctx->idle_blocks[i].size);
+	pthread_cond_destroy(&ctx->cond);
+	pthread_mutex_destroy(&ctx->lock);
+	free(ctx);
+}
+
+int
+crypto_scrypt_supported(crypto_scrypt_impl impl)
+{
+
+	return (select_smix(impl) != NULL);
 }
 
-/**
- * crypto_scrypt(passwd, passwdlen, salt, saltlen, N, r, p, buf, buflen):
- * Compute scrypt(passwd[0 .. passwdlen - 1], salt[0 .. saltlen - 1], N, r,
- * p, buflen) and write the result into buf.  The parameters r, p, and buflen
- * must satisfy r * p < 2^30 and buflen <= (2^32 - 1) * 32.  The parameter N
- * must be a power of 2.
- *
- * Return 0 on success; or -1 on error.
- */
 int
 crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
     const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
     uint8_t * buf, size_t buflen)
 {
+
+	return (crypto_scrypt_ctx_run(NULL, CRYPTO_SCRYPT_AUTO, passwd,
+	    passwdlen, salt, saltlen, N, r, p, buf, buflen));
+}
+
+int
+crypto_scrypt_impl_run(crypto_scrypt_impl impl,
+    const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen)
+{
+
+	return (crypto_scrypt_ctx_run(NULL, impl, passwd, passwdlen,
+	    salt, saltlen, N, r, p, buf, buflen));
+}
+
+int
+crypto_scrypt_ctx_run(crypto_scrypt_ctx * ctx, crypto_scrypt_impl impl,
+    const uint8_t * passwd, size_t passwdlen,
+    const uint8_t * salt, size_t saltlen, uint64_t N, uint32_t r, uint32_t p,
+    uint8_t * buf, size_t buflen)
+{
+	crypto_scrypt_smix_t * smix;
+	struct smix_lanes lanes[CRYPTO_SCRYPT_MAX_THREADS];
+	pthread_t tids[CRYPTO_SCRYPT_MAX_THREADS];
+	int started[CRYPTO_SCRYPT_MAX_THREADS];
+	struct scrypt_block block;
+	void * B0;
 	uint8_t * B;
-	uint8_t * V;
-	uint8_t * XY;
-	uint32_t i;
+	size_t lane;
+	uint32_t threads;
+	uint32_t t;
+	int rc = -1;
+
+	/* Pick the implementation. */
+	if ((smix = select_smix(impl)) == NULL) {
+		errno = ENOTSUP;
+		goto err0;
+	}
 
 	/* Sanity-check parameters. */
 #if SIZE_MAX > UINT32_MAX
@@ -231,36 +438,70 @@ crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
 		errno = EFBIG;
 		goto err0;
 	}
-	if (((N & (N - 1)) != 0) || (N == 0)) {
+	if (((N & (N - 1)) != 0) || (N < 2)) {
 		errno = EINVAL;
 		goto err0;
 	}
 	if ((r > SIZE_MAX / 128 / p) ||
 #if SIZE_MAX / 256 <= UINT32_MAX
-	    (r > SIZE_MAX / 256) ||
+	    (r > (SIZE_MAX - 128) / 256) ||
 #endif
-	    (N > SIZE_MAX / 128 / r)) {
+	    (N > (SIZE_MAX - 256 * (size_t)(r) - 128) / 128 / r)) {
 		errno = ENOMEM;
 		goto err0;
 	}
 
-	/* Allocate memory. */
-	if ((B = malloc(128 * r * p)) == NULL)
+	/* Allocate memory, aligned for the vector code. */
+	if ((errno = posix_memalign(&B0, 64, 128 * r * p)) != 0)
 		goto err0;
-	if ((XY = malloc(256 * r)) == NULL)
-		goto err1;
-	if ((V = malloc((unsigned long)((uint64_t) 128 * r * (uint64_t) N))) == NULL)
-		goto err2;
+	B = (uint8_t *)(B0);
+
+	/* Each thread needs its own scratch space, all in one block. */
+	lane = lane_size(N, r);
+	threads = smix_threads(N, r, p, ctx ? ctx->max_memory :
+	    CRYPTO_SCRYPT_PARALLEL_MEMORY);
+	if (ctx) {
+		if (block_acquire(ctx, lane * threads, &block))
+			goto err1;
+	} else {
+		block.size = lane * threads;
+		if ((errno = posix_memalign(&block.mem, 64, block.size)) != 0)
+			goto err1;
+	}
+	for (t = 0; t < threads; t++) {
+		lanes[t].smix = smix;
+		lanes[t].B = B;
+		lanes[t].r = r;
+		lanes[t].N = N;
+		lanes[t].p = p;
+		lanes[t].first = t;
+		lanes[t].step = threads;
+		lanes[t].XY = (uint8_t *)(block.mem) + t * lane;
+		lanes[t].V = (uint8_t *)(block.mem) + t * lane +
+		    (lane - 128 * (size_t)(r) * N);
+	}
 
 	/* 1: (B_0 ... B_{p-1}) <-- PBKDF2(P, S, 1, p * MFLen) */
 	if (!PKCS5_PBKDF2_HMAC((char *)passwd, passwdlen, salt, saltlen,
 		1, EVP_sha256(), p * 128 * r, B))
 		goto err2;
 
-	/* 2: for i = 0 to p - 1 do */
-	for (i = 0; i < p; i++) {
-		/* 3: B_i <-- MF(B_i, N) */
-		smix(&B[i * 128 * r], r, N, V, XY);
+	/*
+	 * 2: for i = 0 to p - 1 do
+	 * 3:     B_i <-- MF(B_i, N)
+	 * The lanes are independent, so spread them over several threads.
+	 * If a thread cannot be started, its lanes run here instead.
+	 */
+	for (t = 1; t < threads; t++) {
+		started[t] = !pthread_create(&tids[t], NULL,
+		    smix_lanes_run, &lanes[t]);
+	}
+	smix_lanes_run(&lanes[0]);
+	for (t = 1; t < threads; t++) {
+		if (started[t])
+			pthread_join(tids[t], NULL);
+		else
+			smix_lanes_run(&lanes[t]);
 	}
 
 	/* 5: DK <-- PBKDF2(P, B, 1, dkLen) */
@@ -268,19 +509,18 @@ crypto_scrypt(const uint8_t * passwd, size_t passwdlen,
 		1, EVP_sha256(), buflen, buf))
 		goto err2;
 
-	/* Free memory. */
-	free(V);
-	free(XY);
-	free(B);
-
 	/* Success! */
-	return (0);
+	rc = 0;
 
 err2:
-	free(XY);
+	/* Free memory. */
+	if (ctx)
+		block_release(ctx, &block, block.size);
+	else
+		free(block.mem);
 err1:
-	free(B);
+	memset_wipe(B0, 0, 128 * r * p);
+	free(B0);
 err0:
-	/* Failure! */
-	return (-1);
+	return (rc);
 }
@@ -48,6 +48,79 @@ extern "C" {
 int crypto_scrypt(const uint8_t *, size_t, const uint8_t *, size_t, uint64_t,
     uint32_t, uint32_t, uint8_t *, size_t);
 
+/**
+ * crypto_scrypt_parallelism(N, r, p):
+ * Return the number of threads crypto_scrypt will use to compute the p
+ * independent lanes, based on the CPU count and the memory each lane needs.
+ */
+uint32_t crypto_scrypt_parallelism(uint64_t, uint32_t, uint32_t);
+
+/**
+ * The available implementations of the scrypt core.  They all produce
+ * identical results, so these are only useful for testing and benchmarks.
+ */
+typedef enum {
+	CRYPTO_SCRYPT_AUTO = 0,	/* The fastest one this CPU supports. */
+	CRYPTO_SCRYPT_REF,	/* The original byte-at-a-time code. */
+	CRYPTO_SCRYPT_PORTABLE,	/* Plain C, working on 32-bit words. */
+	CRYPTO_SCRYPT_SSE2	/* x86 SSE2 vector code. */
+} crypto_scrypt_impl;
+
+/**
+ * crypto_scrypt_supported(impl):
+ * Return nonzero if the given implementation can run on this machine.
+ */
+int crypto_scrypt_supported(crypto_scrypt_impl);
+
+/**
+ * crypto_scrypt_impl_run(impl, passwd, passwdlen, salt, saltlen, N, r, p,
+ *     buf, buflen):
+ * Same as crypto_scrypt, but using the given implementation.  Fails with
+ * errno set to ENOTSUP if the implementation is not available.
+ */
+int crypto_scrypt_impl_run(crypto_scrypt_impl, const uint8_t *, size_t,
+    const uint8_t *, size_t, uint64_t, uint32_t, uint32_t, uint8_t *, size_t);
+
+/**
+ * A scrypt context holds scratch memory for reuse across calls, so repeated
+ * derivations skip the cost of mapping and faulting in the large V array.
+ * It also caps the memory used by derivations running at the same time.
+ * A context may be shared between threads.  Its memory is wiped after
+ * every call.
+ */
+typedef struct crypto_scrypt_ctx crypto_scrypt_ctx;
+
+/* Ask the kernel for transparent huge pages, where supported. */
+#define CRYPTO_SCRYPT_HUGEPAGES	1
+
+/* Fault new memory in when it is mapped, rather than on first use. */
+#define CRYPTO_SCRYPT_POPULATE	2
+
+/**
+ * crypto_scrypt_ctx_new(max_memory, retain, flags):
+ * Create a context.  Calls wait while their scratch memory would push the
+ * total in use past max_memory, and spread their lanes over fewer threads
+ * to stay within it.  Up to retain bytes of idle memory are kept for reuse.
+ * Return NULL on error.
+ */
+crypto_scrypt_ctx * crypto_scrypt_ctx_new(size_t, size_t, int);
+
+/**
+ * crypto_scrypt_ctx_free(ctx):
+ * Free a context and its memory.  No calls may be using it.
+ */
+void crypto_scrypt_ctx_free(crypto_scrypt_ctx *);
+
+/**
+ * crypto_scrypt_ctx_run(ctx, impl, passwd, passwdlen, salt, saltlen, N, r,
+ *     p, buf, buflen):
+ * Same as crypto_scrypt_impl_run, but taking scratch memory from the
+ * context.  A NULL context allocates fresh memory for the call.
+ */
+int crypto_scrypt_ctx_run(crypto_scrypt_ctx *, crypto_scrypt_impl,
+    const uint8_t *, size_t, const uint8_t *, size_t, uint64_t, uint32_t,
+    uint32_t, uint8_t *, size_t);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,8 +24,10 @@
 #include "../abcd/bitcoin/WatcherBridge.hpp"
 #include "../abcd/crypto/Encoding.hpp"
 #include "../abcd/crypto/Random.hpp"
+#include "../abcd/crypto/ScryptCache.hpp"
 #include "../abcd/exchange/ExchangeCache.hpp"
 #include "../abcd/http/Http.hpp"
+#include "../abcd/http/HttpRequest.hpp"
 #include "../abcd/http/Uri.hpp"
 #include "../abcd/login/AccountRequest.hpp"
 #include "../abcd/login/Bitid.hpp"
@@ -148,6 +150,8 @@ void ABC_Terminate()
         ABC_ClearKeyCache(NULL);
         gContext.reset();
 
+        httpTerminate();
+        fileTerminate().log();
         syncTerminate();
 
         debugTerminate();
@@ -1001,7 +1005,8 @@ exit:
 /**
  * Clear cached keys.
  *
- * This function clears any keys that might be cached.
+ * This function clears any keys that might be cached,
+ * including recent scrypt results.
  *
  * @param pError    A pointer to the location to store the error if there is one
  */
@@ -1009,7 +1014,9 @@ tABC_CC ABC_ClearKeyCache(tABC_Error *pError)
 {
     ABC_PROLOG();
 
+    fileFlush().log(); // Failure is fine
     cacheLogout();
+    scryptCacheClear();
 
 exit:
     return cc;
@@ -1177,6 +1184,23 @@ exit:
     return cc;
 }
 
+tABC_CC ABC_WalletGapLimitSet(const char *szUserName,
+                              const char *szPassword,
+                              const char *szWalletUUID,
+                              unsigned int gapLimit,
+                              tABC_Error *pError)
+{
+    ABC_PROLOG();
+
+    {
+        ABC_GET_WALLET();
+        ABC_CHECK_NEW(wallet->addresses.gapLimitSet(gapLimit));
+    }
+
+exit:
+    return cc;
+}
+
 tABC_CC ABC_WalletArchived(const char *szUserName,
                            const char *szWalletUUID,
                            bool *pResult,
@@ -1638,6 +1662,38 @@ exit:
     return cc;
 }
 
+/**
+ * Converts an array of Satoshi amounts to the given currency,
+ * all at the same exchange rate.
+ * This is much cheaper than converting the amounts one at a time.
+ *
+ * @param szUserName  UserName for the account (unused, may be null)
+ * @param szPassword  Password for the account (unused, may be null)
+ * @param aSatoshi    Amounts in Satoshi
+ * @param aCurrency   Array with room for `count` converted amounts
+ * @param count       Number of amounts to convert
+ * @param currencyNum Currency ISO 4217 num
+ * @param pError      A pointer to the location to store the error if there is one
+ */
+tABC_CC ABC_SatoshiToCurrencyArray(const char *szUserName,
+                                   const char *szPassword,
+                                   const int64_t *aSatoshi,
+                                   double *aCurrency,
+                                   unsigned int count,
+                                   int currencyNum,
+                                   tABC_Error *pError)
+{
+    ABC_PROLOG_QUIET();
+    ABC_CHECK_NULL(aSatoshi);
+    ABC_CHECK_NULL(aCurrency);
+
+    ABC_CHECK_NEW(gContext->exchangeCache.satoshiToCurrency(aCurrency, aSatoshi,
+                  count, static_cast<Currency>(currencyNum)));
+
+exit:
+    return cc;
+}
+
 /**
  * Parses a Bitcoin amount string to an integer.
  * @param the amount to parse, in bitcoins
@@ -1934,6 +1990,22 @@ exit:
     return cc;
 }
 
+tABC_CC ABC_SpendSetCoinPolicy(void *pSpend,
+                               tABC_SpendCoinPolicy policy,
+                               tABC_Error *pError)
+{
+    ABC_PROLOG();
+    ABC_CHECK_NULL(pSpend);
+
+    {
+        auto *spend = static_cast<Spend *>(pSpend);
+        ABC_CHECK_NEW(spend->coinPolicySet(policy));
+    }
+
+exit:
+    return cc;
+}
+
 tABC_CC ABC_SpendGetFee(void *pSpend,
                         uint64_t *pFee,
                         tABC_Error *pError)
@@ -2747,6 +2819,59 @@ void ABC_FreeAccountSettings(tABC_AccountSettings *pSettings)
     accountSettingsFree(pSettings);
 }
 
+/**
+ * Syncs a single wallet, along with any fee payments it owes.
+ * Archived wallets are skipped once their addresses have been checked.
+ */
+static Status
+walletSync(bool &dirty, Wallet &wallet)
+{
+    airbitzFeeAutoSend(wallet).log();
+
+    bool isArchived = false;
+    ABC_CHECK(wallet.account.wallets.archived(isArchived, wallet.id()));
+
+    // If wallet has been fully loaded in the past and is now archived, do not launch the
+    // watchers.
+    if (wallet.cache.addressCheckDoneGet() && isArchived)
+    {
+        ABC_DebugLog("Skipping sync for archived and address checked wallet");
+        dirty = false;
+        return Status();
+    }
+
+    ABC_CHECK(wallet.sync(dirty));
+    return Status();
+}
+
+/**
+ * Syncs the account data, then refreshes the general info
+ * and checks whether the password has changed on another device.
+ */
+static Status
+accountSync(bool &dirty, bool &passwordChanged, Account &account)
+{
+    ABC_CHECK(account.sync(dirty));
+
+    // Non-critical general information update:
+    generalUpdate().log();
+
+    // Has the password changed?
+    passwordChanged = false;
+    AuthJson authJson;
+    LoginJson loginJson;
+    ABC_CHECK(authJson.loginSet(account.login));
+    auto s = loginServerLogin(loginJson, authJson);
+    if (s)
+        ABC_CHECK(loginJson.save(account.login.paths, account.login.dataKey()));
+    else if (s.value() == ABC_CC_InvalidOTP)
+        return s.at(ABC_HERE());
+    else if (s.value() == ABC_CC_BadPassword)
+        passwordChanged = true;
+
+    return Status();
+}
+
 tABC_CC ABC_DataSyncAccount(const char *szUserName,
                             const char *szPassword,
                             bool *pbDirty,
@@ -2760,34 +2885,11 @@ tABC_CC ABC_DataSyncAccount(const char *szUserName,
     {
         ABC_GET_ACCOUNT();
 
-        // Sync the account data:
         bool dirty = false;
-        ABC_CHECK_NEW(account->sync(dirty));
+        bool passwordChanged = false;
+        ABC_CHECK_NEW(accountSync(dirty, passwordChanged, *account));
         *pbDirty = dirty;
-
-        // Non-critical general information update:
-        generalUpdate().log();
-
-        // Has the password changed?
-        AuthJson authJson;
-        LoginJson loginJson;
-        ABC_CHECK_NEW(authJson.loginSet(account->login));
-        auto s = loginServerLogin(loginJson, authJson);
-        if (s)
-        {
-            ABC_CHECK_NEW(loginJson.save(account->login.paths,
-                                         account->login.dataKey()));
-        }
-        else if (s.value() == ABC_CC_InvalidOTP)
-        {
-            ABC_RET_ERROR(s.value(), s.message().c_str());
-        }
-        else if (s.value() == ABC_CC_BadPassword)
-        {
-            *pbPasswordChanged = true;
-            goto exit;
-        }
-        *pbPasswordChanged = false;
+        *pbPasswordChanged = passwordChanged;
     }
 
 exit:
@@ -2806,27 +2908,88 @@ tABC_CC ABC_DataSyncWallet(const char *szUserName,
     {
         ABC_GET_WALLET();
 
-        airbitzFeeAutoSend(*wallet).log();
+        bool dirty = false;
+        ABC_CHECK_NEW(walletSync(dirty, *wallet));
+        *pbDirty = dirty;
+    }
 
-        bool isArchived = false;
-        ABC_CHECK_NEW(wallet->account.wallets.archived(isArchived, szWalletUUID));
+exit:
+    return cc;
+}
 
-        // If wallet has been fully loaded in the past and is now archived, do not launch the
-        // watchers.
-        if (wallet->cache.addressCheckDoneGet() && isArchived)
-            ABC_DebugLog("Skipping ABC_DataSyncWallet for archived and address checked wallet");
-        else
+tABC_CC ABC_DataSyncAll(const char *szUserName,
+                        const char *szPassword,
+                        tABC_SyncResult **paResults,
+                        unsigned int *pCount,
+                        tABC_Error *pError)
+{
+    ABC_PROLOG();
+    ABC_CHECK_NULL(paResults);
+    ABC_CHECK_NULL(pCount);
+
+    {
+        ABC_GET_ACCOUNT();
+
+        const auto ids = account->wallets.list();
+        std::vector<std::string> walletIds(ids.begin(), ids.end());
+        const size_t count = 1 + walletIds.size();
+
+        // One task for the account, then one for each wallet:
+        std::unique_ptr<bool[]> dirty(new bool[count]());
+        bool passwordChanged = false;
+        std::vector<SyncTask> tasks;
+        tasks.push_back([&]() -> Status
+        {
+            ABC_CHECK(accountSync(dirty[0], passwordChanged, *account));
+            return Status();
+        });
+        for (size_t i = 0; i < walletIds.size(); ++i)
         {
-            bool dirty = false;
-            ABC_CHECK_NEW(wallet->sync(dirty));
-            *pbDirty = dirty;
+            tasks.push_back([&, i]() -> Status
+            {
+                std::shared_ptr<Wallet> wallet;
+                ABC_CHECK(cacheWallet(wallet, szUserName, walletIds[i].c_str()));
+                ABC_CHECK(walletSync(dirty[1 + i], *wallet));
+                return Status();
+            });
         }
+        const auto statuses = syncRunAll(tasks);
+
+        tABC_SyncResult *aResults;
+        ABC_ARRAY_NEW(aResults, count, tABC_SyncResult);
+        for (size_t i = 0; i < count; ++i)
+        {
+            aResults[i].szWalletUUID = i ?
+                                       stringCopy(walletIds[i - 1]) : nullptr;
+            aResults[i].bDirty = dirty[i];
+            aResults[i].bPasswordChanged = i ? false : passwordChanged;
+            statuses[i].toError(aResults[i].status, ABC_HERE());
+        }
+        *paResults = aResults;
+        *pCount = count;
     }
 
 exit:
     return cc;
 }
 
+/**
+ * Frees the results returned from ABC_DataSyncAll.
+ */
+void ABC_FreeSyncResults(tABC_SyncResult *aResults,
+                         unsigned int count)
+{
+    // Cannot use ABC_PROLOG - no pError
+    ABC_DebugLog("%s called", __FUNCTION__);
+
+    if (aResults)
+    {
+        for (unsigned i = 0; i < count; ++i)
+            ABC_FREE_STR(aResults[i].szWalletUUID);
+        ABC_FREE(aResults);
+    }
+}
+
 /**
  * Start the watcher for a wallet
  *
@@ -3117,6 +3280,46 @@ exit:
     return cc;
 }
 
+tABC_CC ABC_PluginDataGetMany(const char *szUserName,
+                              const char *szPassword,
+                              const char *szPlugin,
+                              const char **aszKeys,
+                              unsigned int keyCount,
+                              char ***paszData,
+                              tABC_Error *pError)
+{
+    ABC_PROLOG();
+    ABC_CHECK_NULL(szPlugin);
+    ABC_CHECK_NULL(paszData);
+    ABC_CHECK_ASSERT(aszKeys || !keyCount, ABC_CC_NULLPtr, "NULL pointer");
+
+    {
+        ABC_GET_ACCOUNT();
+
+        std::list<std::string> keys;
+        for (unsigned int i = 0; i < keyCount; ++i)
+        {
+            ABC_CHECK_NULL(aszKeys[i]);
+            keys.push_back(aszKeys[i]);
+        }
+
+        std::map<std::string, std::string> data;
+        ABC_CHECK_NEW(pluginDataGetMany(*account, szPlugin, keys, data));
+
+        ABC_ARRAY_NEW(*paszData, keyCount, char *);
+        unsigned int i = 0;
+        for (const auto &key: keys)
+        {
+            auto value = data.find(key);
+            (*paszData)[i++] = data.end() != value ?
+                               stringCopy(value->second) : nullptr;
+        }
+    }
+
+exit:
+    return cc;
+}
+
 tABC_CC ABC_PluginDataSet(const char *szUserName,
                           const char *szPassword,
                           const char *szPlugin,
@@ -3233,6 +3436,41 @@ tABC_CC ABC_Version(char **szVersion, tABC_Error *pError)
     return cc;
 }
 
+/**
+ * Streams a wallet's transactions through the requested exporter.
+ * @param count The number of transactions written.
+ */
+static Status
+exportStream(size_t &count, Wallet &wallet, tABC_ExportFormat format,
+             int64_t startTime, int64_t endTime, ExportSink sink)
+{
+    count = 0;
+    auto source = [&](const ExportVisitor &visitor) -> Status
+    {
+        return txInfoEach(wallet, startTime, endTime,
+                          [&](const tABC_TxInfo &info) -> Status
+        {
+            ++count;
+            return visitor(info);
+        });
+    };
+
+    ExportWriter out(sink);
+    switch (format)
+    {
+    case ABC_ExportFormat_Csv:
+        ABC_CHECK(exportCsv(out, source));
+        break;
+    case ABC_ExportFormat_QBO:
+        ABC_CHECK(exportQbo(out, source));
+        break;
+    default:
+        return ABC_ERROR(ABC_CC_Error, "Unknown export format");
+    }
+
+    return Status();
+}
+
 tABC_CC ABC_CsvExport(const char *szUserName, /* DEPRECATED */
                       const char *szPassword, /* DEPRECATED */
                       const char *szWalletUUID,
@@ -3241,22 +3479,22 @@ tABC_CC ABC_CsvExport(const char *szUserName, /* DEPRECATED */
                       char **szCsvData,
                       tABC_Error *pError)
 {
-    tABC_TxInfo **paTransactions = nullptr;
-    unsigned int count = 0;
     ABC_PROLOG();
+    ABC_CHECK_NULL(szCsvData);
 
     {
         ABC_GET_WALLET();
 
-        ABC_CHECK_RET(ABC_TxGetTransactions(*wallet, startTime, endTime,
-                                            &paTransactions, &count, pError));
+        std::string out;
+        size_t count;
+        ABC_CHECK_NEW(exportStream(count, *wallet, ABC_ExportFormat_Csv,
+                                   startTime, endTime, exportSinkString(out)));
         ABC_CHECK_ASSERT(0 != count, ABC_CC_NoTransaction, "No transactions to export");
 
-        ABC_CHECK_RET(ABC_ExportFormatCsv(paTransactions, count, szCsvData, pError));
+        *szCsvData = stringCopy(out);
     }
 
 exit:
-    ABC_FreeTransactions(paTransactions, count);
     return cc;
 }
 
@@ -3268,24 +3506,76 @@ tABC_CC ABC_QBOExport(const char *szUserName, /* DEPRECATED */
                       char **szQBOData,
                       tABC_Error *pError)
 {
-    tABC_TxInfo **paTransactions = nullptr;
-    unsigned int count = 0;
     ABC_PROLOG();
+    ABC_CHECK_NULL(szQBOData);
 
     {
         ABC_GET_WALLET();
 
-        ABC_CHECK_RET(ABC_TxGetTransactions(*wallet, startTime, endTime,
-                                            &paTransactions, &count, pError));
+        std::string out;
+        size_t count;
+        ABC_CHECK_NEW(exportStream(count, *wallet, ABC_ExportFormat_QBO,
+                                   startTime, endTime, exportSinkString(out)));
         ABC_CHECK_ASSERT(0 != count, ABC_CC_NoTransaction, "No transactions to export");
 
-        std::string out;
-        ABC_CHECK_NEW(exportFormatQBO(out, paTransactions, count));
         *szQBOData = stringCopy(out);
     }
 
 exit:
-    ABC_FreeTransactions(paTransactions, count);
+    return cc;
+}
+
+tABC_CC ABC_ExportToFd(const char *szUserName,
+                       const char *szWalletUUID,
+                       tABC_ExportFormat format,
+                       int64_t startTime,
+                       int64_t endTime,
+                       int fd,
+                       tABC_Error *pError)
+{
+    ABC_PROLOG();
+
+    {
+        ABC_GET_WALLET();
+
+        size_t count;
+        ABC_CHECK_NEW(exportStream(count, *wallet, format,
+                                   startTime, endTime, exportSinkFd(fd)));
+    }
+
+exit:
+    return cc;
+}
+
+tABC_CC ABC_ExportToCallback(const char *szUserName,
+                             const char *szWalletUUID,
+                             tABC_ExportFormat format,
+                             int64_t startTime,
+                             int64_t endTime,
+                             tABC_ExportCallback fCallback,
+                             void *pContext,
+                             tABC_Error *pError)
+{
+    ABC_PROLOG();
+    ABC_CHECK_NULL(fCallback);
+
+    {
+        ABC_GET_WALLET();
+
+        auto sink = [fCallback, pContext](const char *data, size_t size)
+                    -> Status
+        {
+            if (!fCallback(data, size, pContext))
+                return ABC_ERROR(ABC_CC_Error, "Export cancelled");
+            return Status();
+        };
+
+        size_t count;
+        ABC_CHECK_NEW(exportStream(count, *wallet, format,
+                                   startTime, endTime, sink));
+    }
+
+exit:
     return cc;
 }
 
@@ -37,6 +37,7 @@
 #define ABC_h
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /** The maximum buffer length for default strings in the system */
@@ -195,6 +196,7 @@ typedef enum eABC_AsyncEventType
     ABC_AsyncEventType_AddressCheckDone,
     ABC_AsyncEventType_IncomingSweep,
     ABC_AsyncEventType_TransactionUpdate,
+    ABC_AsyncEventType_WalletChanges,
 } tABC_AsyncEventType;
 
 /**
@@ -208,6 +210,48 @@ typedef enum eABC_SpendFeeLevel
     ABC_SpendFeeLevelCustom,
 } tABC_SpendFeeLevel;
 
+/**
+ * What spends optimize for when choosing coins.
+ */
+typedef enum eABC_SpendCoinPolicy
+{
+    /** Pay the lowest fee, avoiding change where possible. */
+    ABC_SpendCoinPolicyMinimizeFee = 0,
+    /** Spend as few coins as possible, linking fewer addresses. */
+    ABC_SpendCoinPolicyPrivacy,
+    /** Use up small coins, which is best done while fees are low. */
+    ABC_SpendCoinPolicyConsolidate,
+} tABC_SpendCoinPolicy;
+
+/**
+ * AirBitz Core Wallet Changes Structure
+ *
+ * Describes how a wallet's transactions and balance have changed
+ * since the previous `ABC_AsyncEventType_WalletChanges` event,
+ * so the GUI can update its transaction list incrementally.
+ *
+ */
+typedef struct sABC_WalletChanges
+{
+    /** Transactions that have appeared in the wallet. */
+    const char **aszAddedTxIDs;
+    unsigned int addedCount;
+
+    /** Transactions whose height or safety status has changed. */
+    const char **aszChangedTxIDs;
+    unsigned int changedCount;
+
+    /** Transactions that have gone from unconfirmed to confirmed. */
+    const char **aszConfirmedTxIDs;
+    unsigned int confirmedCount;
+
+    /** The current wallet balance, in satoshis. */
+    int64_t balance;
+
+    /** The change in balance since the last event, in satoshis. */
+    int64_t balanceDelta;
+} tABC_WalletChanges;
+
 /**
  * AirBitz Core Asynchronous Structure
  *
@@ -234,6 +278,12 @@ typedef struct sABC_AsyncBitCoinInfo
 
     /** The amount swept, if this is a sweep. */
     int64_t sweepSatoshi;
+
+    /**
+     * For `ABC_AsyncEventType_WalletChanges` events, the changes.
+     * This is only valid for the duration of the callback.
+     */
+    const tABC_WalletChanges *pChanges;
 } tABC_AsyncBitCoinInfo;
 
 /**
@@ -381,6 +431,24 @@ typedef struct sABC_PasswordRule
     bool bPassed;
 } tABC_PasswordRule;
 
+/**
+ * The outcome of syncing one repo, as reported by ABC_DataSyncAll.
+ */
+typedef struct sABC_SyncResult
+{
+    /** The wallet that was synced, or NULL for the account itself. */
+    char *szWalletUUID;
+    /** True if the sync brought down new data. */
+    bool bDirty;
+    /**
+     * True if the account password has changed on another device.
+     * Only ever set for the account itself.
+     */
+    bool bPasswordChanged;
+    /** The success or failure of this particular sync. */
+    tABC_Error status;
+} tABC_SyncResult;
+
 /**
  * All the fields that can be found in a URI, bitcoin address, or private key.
  */
@@ -499,6 +567,22 @@ typedef struct sABC_AccountSettings
  */
 typedef void (*tABC_BitCoin_Event_Callback)(const tABC_AsyncBitCoinInfo *pInfo);
 
+/**
+ * Transaction export formats.
+ */
+typedef enum eABC_ExportFormat
+{
+    ABC_ExportFormat_Csv = 0,
+    ABC_ExportFormat_QBO,
+} tABC_ExportFormat;
+
+/**
+ * Receives exported data as it is produced.
+ * Return false to abort the export.
+ */
+typedef bool (*tABC_ExportCallback)(const char *pData, size_t size,
+                                    void *pContext);
+
 /* === Library lifetime: === */
 
 /**
@@ -1036,6 +1120,20 @@ tABC_CC ABC_PluginDataGet(const char *szUserName,
                           char **pszData,
                           tABC_Error *pError);
 
+/**
+ * Retreives several items from the plugin key/value store in one call.
+ * @param aszKeys The keys to look up.
+ * @param paszData Receives an array of values, one for each key.
+ * Keys that do not exist get a NULL entry.
+ */
+tABC_CC ABC_PluginDataGetMany(const char *szUserName,
+                              const char *szPassword,
+                              const char *szPlugin,
+                              const char **aszKeys,
+                              unsigned int keyCount,
+                              char ***paszData,
+                              tABC_Error *pError);
+
 /**
  * Saves an item to the plugin key/value store.
  */
@@ -1117,6 +1215,14 @@ tABC_CC ABC_CurrencyToSatoshi(const char *szUserName,
                               int64_t *pSatoshi,
                               tABC_Error *pError);
 
+tABC_CC ABC_SatoshiToCurrencyArray(const char *szUserName,
+                                   const char *szPassword,
+                                   const int64_t *aSatoshi,
+                                   double *aCurrency,
+                                   unsigned int count,
+                                   int currencyNum,
+                                   tABC_Error *pError);
+
 /* === Wallet data: === */
 tABC_CC ABC_CreateWallet(const char *szUserName,
                          const char *szPassword,
@@ -1162,6 +1268,21 @@ tABC_CC ABC_RenameWallet(const char *szUserName,
                          const char *szNewWalletName,
                          tABC_Error *pError);
 
+/**
+ * Sets how many unused addresses the wallet keeps ready
+ * past the last one that has received money.
+ * Raising the limit creates the extra addresses right away.
+ * The limit is not saved. It lasts until the wallet is unloaded,
+ * such as on logout, and then goes back to the default of 5,
+ * so the GUI must set it again each time the wallet loads.
+ * @param gapLimit the number of spare addresses, at least 1.
+ */
+tABC_CC ABC_WalletGapLimitSet(const char *szUserName,
+                              const char *szPassword,
+                              const char *szWalletUUID,
+                              unsigned int gapLimit,
+                              tABC_Error *pError);
+
 tABC_CC ABC_ExportWalletSeed(const char *szUserName,
                              const char *szPassword,
                              const char *szUUID,
@@ -1193,12 +1314,55 @@ tABC_CC ABC_QBOExport(const char *szUserName,
                       char **szQBOData,
                       tABC_Error *pError);
 
+/**
+ * Writes the wallet's transactions, oldest first, to an open file descriptor.
+ * Records are produced one at a time and written through a small buffer,
+ * so memory use stays flat no matter how long the history is.
+ * The caller keeps ownership of the file descriptor.
+ */
+tABC_CC ABC_ExportToFd(const char *szUserName,
+                       const char *szWalletUUID,
+                       tABC_ExportFormat format,
+                       int64_t startTime,
+                       int64_t endTime,
+                       int fd,
+                       tABC_Error *pError);
+
+/**
+ * Same as ABC_ExportToFd, but hands the output to a callback.
+ */
+tABC_CC ABC_ExportToCallback(const char *szUserName,
+                             const char *szWalletUUID,
+                             tABC_ExportFormat format,
+                             int64_t startTime,
+                             int64_t endTime,
+                             tABC_ExportCallback fCallback,
+                             void *pContext,
+                             tABC_Error *pError);
+
 tABC_CC ABC_DataSyncWallet(const char *szUserName,
                            const char *szPassword,
                            const char *szWalletUUID,
                            bool *pbDirty,
                            tABC_Error *pError);
 
+/**
+ * Syncs the account and all its wallets at once,
+ * running several repos in parallel.
+ * The account comes first in the results, followed by the wallets.
+ * A failure in one repo does not stop the others,
+ * so check the status of each result.
+ * Like ABC_DataSyncAccount, this also checks for password changes.
+ */
+tABC_CC ABC_DataSyncAll(const char *szUserName,
+                        const char *szPassword,
+                        tABC_SyncResult **paResults,
+                        unsigned int *pCount,
+                        tABC_Error *pError);
+
+void ABC_FreeSyncResults(tABC_SyncResult *aResults,
+                         unsigned int count);
+
 /* === Receiving: === */
 tABC_CC ABC_CreateReceiveRequest(const char *szUserName,
                                  const char *szPassword,
@@ -1283,6 +1447,14 @@ tABC_CC ABC_SpendSetFee(void *pSpend,
                         uint64_t customFeeSatoshi,
                         tABC_Error *pError);
 
+/**
+ * Change what the current spend optimizes for when choosing coins.
+ * The default is ABC_SpendCoinPolicyMinimizeFee.
+ */
+tABC_CC ABC_SpendSetCoinPolicy(void *pSpend,
+                               tABC_SpendCoinPolicy policy,
+                               tABC_Error *pError);
+
 /**
  * Calculate the fee needed to perform this spend.
  * @return ABC_CC_InsufficientFunds if the source doesn't have enough money.
@@ -10,6 +10,9 @@
 #include "../abcd/bitcoin/cache/Cache.hpp"
 #include "../abcd/wallet/Wallet.hpp"
 #include "../abcd/util/Util.hpp"
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 namespace abcd {
 
@@ -19,8 +22,26 @@ static void     ABC_TxStrTable(const char *needle, int *table);
 static int      ABC_TxStrStr(const char *haystack, const char *needle,
                              tABC_Error *pError);
 
+/**
+ * Finds the best-effort creation time for a transaction.
+ */
+static time_t
+txInfoTime(Wallet &self, const std::string &ntxid, const TxStatus &status,
+           time_t now)
+{
+    time_t timestamp = now;
+    if (status.height)
+        self.cache.blocks.headerTime(timestamp, status.height);
+
+    TxMeta meta;
+    if (self.txs.get(meta, ntxid))
+        return std::min(timestamp, meta.timeCreation);
+    return timestamp;
+}
+
 tABC_TxInfo *
-makeTxInfo(Wallet &self, const TxInfo &info, const TxStatus &status)
+makeTxInfo(Wallet &self, const TxInfo &info, const TxStatus &status,
+           time_t now)
 {
     auto out = structAlloc<tABC_TxInfo>();
 
@@ -42,23 +63,17 @@ makeTxInfo(Wallet &self, const TxInfo &info, const TxStatus &status)
         out->aOutputs[i++] = txo;
     }
 
-    // Best-effort timestamp:
-    time_t timestamp = time(nullptr);
-    if (status.height)
-        self.cache.blocks.headerTime(timestamp, status.height);
-
     // Details:
+    out->timeCreation = txInfoTime(self, info.ntxid, status, now);
     TxMeta meta;
     if (self.txs.get(meta, info.ntxid))
     {
-        out->timeCreation = std::min(timestamp, meta.timeCreation);
         out->airbitzFeeWanted = meta.airbitzFeeWanted;
         out->airbitzFeeSent = meta.airbitzFeeSent;
         out->pDetails = meta.metadata.toDetails();
     }
     else
     {
-        out->timeCreation = timestamp;
         out->airbitzFeeWanted = 0;
         out->airbitzFeeSent = 0;
         out->pDetails = Metadata().toDetails();
@@ -144,6 +159,56 @@ exit:
     return cc;
 }
 
+Status
+txInfoEach(Wallet &self, int64_t startTime, int64_t endTime,
+           const std::function<Status(const tABC_TxInfo &info)> &f)
+{
+    // First pass: sort the txids by time, discarding everything else.
+    // This only needs the ntxid and height, so skip building the `TxInfo`:
+    struct TxTime
+    {
+        time_t time;
+        std::string txid;
+        TxStatus status;
+    };
+    const auto now = time(nullptr);
+    std::vector<TxTime> order;
+    {
+        const auto txids = self.cache.addresses.txids();
+        order.reserve(txids.size());
+        for (const auto &status: self.cache.txs.statusMap(txids))
+        {
+            std::string ntxid;
+            if (!self.cache.txs.ntxid(ntxid, status.first))
+                continue;
+
+            const auto time = txInfoTime(self, ntxid, status.second, now);
+            if ((endTime == ABC_GET_TX_ALL_TIMES) ||
+                    (time >= startTime && time < endTime))
+                order.push_back(TxTime{time, status.first, status.second});
+        }
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const TxTime &a, const TxTime &b)
+    {
+        return a.time < b.time;
+    });
+
+    // Second pass: build the full records one at a time:
+    for (const auto &item: order)
+    {
+        TxInfo info;
+        if (!self.cache.txs.info(info, item.txid))
+            continue;
+
+        std::unique_ptr<tABC_TxInfo, decltype(&ABC_TxFreeTransaction)>
+        out(makeTxInfo(self, info, item.status, now), ABC_TxFreeTransaction);
+        ABC_CHECK(f(*out));
+    }
+
+    return Status();
+}
+
 /**
  * Searches transactions associated with the given wallet.
  *
@@ -9,6 +9,8 @@
 #define SRC_TX_INFO_HPP
 
 #include "../abcd/util/Status.hpp"
+#include <functional>
+#include <time.h>
 
 namespace abcd {
 
@@ -19,9 +21,21 @@ class Wallet;
 /**
  * Converts the modern `TxInfo` structure to the API's `tABC_TxInfo` structure,
  * using information from the wallet's metadatabase.
+ * @param now The creation time to use for unconfirmed transactions
+ * without metadata.
  */
 tABC_TxInfo *
-makeTxInfo(Wallet &self, const TxInfo &info, const TxStatus &status);
+makeTxInfo(Wallet &self, const TxInfo &info, const TxStatus &status,
+           time_t now=time(nullptr));
+
+/**
+ * Visits the wallet's transactions in the given time range, oldest first.
+ * Each `tABC_TxInfo` is built just before the callback runs and freed
+ * just after, so only one full record exists at a time.
+ */
+Status
+txInfoEach(Wallet &self, int64_t startTime, int64_t endTime,
+           const std::function<Status(const tABC_TxInfo &info)> &f);
 
 tABC_CC ABC_TxGetTransactions(Wallet &self,
                               int64_t startTime,
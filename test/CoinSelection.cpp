@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Helpers.hpp"
+#include "../abcd/spend/CoinSelection.hpp"
+#include "../minilibs/catch/catch.hpp"
+#include <iostream>
+
+static abcd::CoinSelectionParams
+testParams(uint64_t target, abcd::CoinPolicy policy)
+{
+    abcd::CoinSelectionParams out;
+    out.target = target;
+    out.baseSize = 10;
+    out.inputSize = 100;
+    out.changeSize = 30;
+    out.dustLimit = 500;
+    out.fee = [](size_t size)
+    {
+        return static_cast<uint64_t>(size);
+    };
+    out.policy = policy;
+    out.budget = std::chrono::seconds(1);
+    return out;
+}
+
+static uint64_t
+selectedTotal(const abcd::CoinSelection &selection,
+              const std::vector<uint64_t> &values)
+{
+    uint64_t out = 0;
+    for (auto i: selection.chosen)
+        out += values[i];
+    return out;
+}
+
+TEST_CASE("Coin selection", "[spend][coins]")
+{
+    const std::vector<uint64_t> values =
+    {
+        50000, 20000, 10000, 7000, 5000, 3110, 2000, 1000, 50
+    };
+    const abcd::CoinIndex coins(values);
+    abcd::CoinSelection selection;
+
+    SECTION("index")
+    {
+        REQUIRE(values.size() == coins.size());
+        REQUIRE(50000 == coins.value(0));
+        REQUIRE(0 == coins.position(0));
+        REQUIRE(50 == coins.value(coins.size() - 1));
+        REQUIRE(4 == coins.countAbove(5000));
+        REQUIRE(1050 == coins.remaining(coins.size() - 2));
+    }
+    SECTION("exact match avoids change")
+    {
+        // 7000 + 3110 pays 9900 plus the 210-satoshi fee for two inputs:
+        auto params = testParams(9900, abcd::CoinPolicy::minimizeFee);
+        REQUIRE(abcd::coinSelect(selection, coins, params));
+        REQUIRE(selection.chosen == std::vector<size_t>({3, 5}));
+        REQUIRE(210 == selection.fee);
+        REQUIRE(0 == selection.change);
+    }
+    SECTION("zero budget skips the exact match")
+    {
+        auto params = testParams(9900, abcd::CoinPolicy::minimizeFee);
+        params.budget = std::chrono::steady_clock::duration::zero();
+        REQUIRE(abcd::coinSelect(selection, coins, params));
+        REQUIRE(selection.change);
+    }
+    SECTION("falls back to change")
+    {
+        auto params = testParams(60000, abcd::CoinPolicy::minimizeFee);
+        REQUIRE(abcd::coinSelect(selection, coins, params));
+        REQUIRE(selectedTotal(selection, values) ==
+                params.target + selection.fee + selection.change);
+        REQUIRE(selection.change);
+    }
+    SECTION("privacy uses few coins")
+    {
+        auto params = testParams(15000, abcd::CoinPolicy::privacy);
+        REQUIRE(abcd::coinSelect(selection, coins, params));
+        REQUIRE(1 == selection.chosen.size());
+        REQUIRE(1 == selection.chosen[0]);
+    }
+    SECTION("consolidate uses small coins")
+    {
+        auto params = testParams(5000, abcd::CoinPolicy::consolidate);
+        REQUIRE(abcd::coinSelect(selection, coins, params));
+        REQUIRE(selection.chosen == std::vector<size_t>({5, 6, 7}));
+        REQUIRE(selectedTotal(selection, values) ==
+                params.target + selection.fee + selection.change);
+    }
+    SECTION("insufficient funds")
+    {
+        auto params = testParams(100000, abcd::CoinPolicy::minimizeFee);
+        REQUIRE_FALSE(abcd::coinSelect(selection, coins, params));
+    }
+}
+
+TEST_CASE("Coin selection benchmark", "[.][spend][coins][benchmark]")
+{
+    for (size_t size: {10000, 50000})
+    {
+        // A merchant wallet, with many small payments and a few large ones:
+        std::vector<uint64_t> values(size);
+        uint64_t seed = 1;
+        for (auto &value: values)
+        {
+            seed = seed * 6364136223846793005u + 1442695040888963407u;
+            value = 5000 + (seed >> 33) % 2000000;
+            if (!(seed >> 60))
+                value *= 100;
+        }
+
+        BenchmarkTimer timer;
+        const abcd::CoinIndex coins(values);
+        timer.report(size == 10000 ? "index 10k" : "index 50k");
+
+        for (auto policy:
+                {
+                    abcd::CoinPolicy::minimizeFee, abcd::CoinPolicy::privacy,
+                    abcd::CoinPolicy::consolidate
+                })
+        {
+            auto params = testParams(12345678, policy);
+            params.fee = [](size_t size)
+            {
+                return static_cast<uint64_t>(size * 50);
+            };
+            params.budget = std::chrono::milliseconds(50);
+
+            abcd::CoinSelection selection;
+            timer.restart();
+            REQUIRE(abcd::coinSelect(selection, coins, params));
+            timer.report("select");
+            std::cout << "  inputs: " << selection.chosen.size() <<
+                      ", fee: " << selection.fee <<
+                      ", change: " << selection.change << std::endl;
+            REQUIRE(selectedTotal(selection, values) ==
+                    params.target + selection.fee + selection.change);
+        }
+    }
+}
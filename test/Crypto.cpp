@@ -62,3 +62,27 @@ TEST_CASE("Encryption round-trip", "[crypto][encryption]")
     CHECK(box.decrypt(data, key));
     CHECK(abcd::toString(data) == payload);
 }
+
+TEST_CASE("Encryption round-trip, large", "[crypto][encryption]")
+{
+    abcd::DataChunk key;
+    abcd::base16Decode(key, keyHex);
+
+    // Spans several internal processing chunks:
+    abcd::DataChunk payload(200001);
+    for (size_t i = 0; i < payload.size(); ++i)
+        payload[i] = i * 7;
+
+    abcd::DataChunk nonce;
+    abcd::DataChunk cyphertext;
+    REQUIRE(abcd::cryptoEncryptPackage(cyphertext, nonce, payload, key));
+
+    abcd::DataChunk data;
+    CHECK(abcd::cryptoDecryptPackage(data, cyphertext, key, nonce));
+    CHECK(data == payload);
+
+    cyphertext[cyphertext.size() / 2] ^= 1;
+    const auto s = abcd::cryptoDecryptPackage(data, cyphertext, key, nonce);
+    CHECK(!s);
+    CHECK(s.value() == ABC_CC_DecryptFailure);
+}
@@ -5,6 +5,7 @@
  * See the LICENSE file for more information.
  */
 
+#include "Helpers.hpp"
 #include "../abcd/crypto/Encoding.hpp"
 #include "../minilibs/catch/catch.hpp"
 
@@ -51,6 +52,47 @@ TEST_CASE("Bad base16 strings", "[crypto][base16]")
     REQUIRE_FALSE(abcd::base16Decode(result, "0="));
 }
 
+TEST_CASE("Long base16 strings", "[crypto][base16]")
+{
+    // Long enough to use the vectorized code, with a ragged tail:
+    abcd::DataChunk data(37);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = 7 * i;
+    const auto text = abcd::base16Encode(data);
+    REQUIRE(text ==
+            "00070e151c232a31383f464d545b626970777e858c939aa1a8afb6bdc4cbd2d9"
+            "e0e7eef5fc");
+
+    abcd::DataChunk result;
+    REQUIRE(abcd::base16Decode(result, text));
+    REQUIRE(result == data);
+
+    // Upper case is fine:
+    std::string upper(text);
+    for (auto &c: upper)
+        c = toupper(c);
+    REQUIRE(abcd::base16Decode(result, upper));
+    REQUIRE(result == data);
+
+    // Illegal characters, in both the fast and slow sections:
+    upper[3] = 'g';
+    REQUIRE_FALSE(abcd::base16Decode(result, upper));
+    upper[3] = '0';
+    upper[upper.size() - 1] = ' ';
+    REQUIRE_FALSE(abcd::base16Decode(result, upper));
+}
+
+TEST_CASE("Decoding base16 into a buffer", "[crypto][base16]")
+{
+    abcd::DataArray<3> result;
+    REQUIRE(3 == abcd::base16DecodeSize("666f6f"));
+    REQUIRE(abcd::base16Decode(result.data(), result.size(), "666f6f"));
+    REQUIRE(abcd::toString(result) == "foo");
+
+    // Wrong size:
+    REQUIRE_FALSE(abcd::base16Decode(result.data(), result.size(), "666f"));
+}
+
 TEST_CASE("RFC 4648 base32 test vectors", "[crypto][base32]")
 {
     struct TestCase
@@ -140,6 +182,17 @@ TEST_CASE("Unusual base64 characters", "[crypto][base64]")
     REQUIRE(0xff == result[1]);
 }
 
+TEST_CASE("Decoding base64 into a buffer", "[crypto][base64]")
+{
+    abcd::DataArray<5> result;
+    REQUIRE(5 == abcd::base64DecodeSize("Zm9vYmE="));
+    REQUIRE(abcd::base64Decode(result.data(), result.size(), "Zm9vYmE="));
+    REQUIRE(abcd::toString(result) == "fooba");
+
+    // Wrong size:
+    REQUIRE_FALSE(abcd::base64Decode(result.data(), result.size(), "Zm9vYg=="));
+}
+
 TEST_CASE("Bad base64 strings", "[crypto][base64]")
 {
     abcd::DataChunk result;
@@ -151,3 +204,34 @@ TEST_CASE("Bad base64 strings", "[crypto][base64]")
     REQUIRE_FALSE(abcd::base64Decode(result, "AAAA===="));
     REQUIRE_FALSE(abcd::base64Decode(result, "A==="));
 }
+
+TEST_CASE("Bad base64 characters", "[crypto][base64]")
+{
+    abcd::DataChunk result;
+    REQUIRE_FALSE(abcd::base64Decode(result, "Zm9v=mFy"));
+    REQUIRE_FALSE(abcd::base64Decode(result, "Zm9vY=E="));
+    REQUIRE_FALSE(abcd::base64Decode(result, "Zm9vYm-="));
+    REQUIRE_FALSE(abcd::base64Decode(result, "Zm9vY==="));
+}
+
+TEST_CASE("Encoding benchmark", "[.][crypto][benchmark]")
+{
+    abcd::DataChunk data(1 << 24);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = i * 2654435761u >> 24;
+
+    abcd::DataChunk result;
+    BenchmarkTimer timer;
+    const auto hex = abcd::base16Encode(data);
+    timer.reportRate("base16 encode", data.size());
+    REQUIRE(abcd::base16Decode(result, hex));
+    timer.reportRate("base16 decode", data.size());
+    REQUIRE(result == data);
+
+    timer.restart();
+    const auto text = abcd::base64Encode(data);
+    timer.reportRate("base64 encode", data.size());
+    REQUIRE(abcd::base64Decode(result.data(), result.size(), text));
+    timer.reportRate("base64 decode", data.size());
+    REQUIRE(result == data);
+}
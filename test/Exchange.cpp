@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Helpers.hpp"
+#include "HttpStub.hpp"
+#include "../abcd/exchange/ExchangeCache.hpp"
+#include "../abcd/exchange/ExchangeSource.hpp"
+#include "../abcd/http/Http.hpp"
+#include "../abcd/util/FileIO.hpp"
+#include "../minilibs/catch/catch.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static const char bitstampReply[] = "{\"last\": \"612.50\"}";
+static const char bitfinexReply[] = "{\"last_price\": \"611.00\"}";
+static const char coinbaseReply[] =
+    "{\"btc_to_usd\": \"610.00\", \"btc_to_eur\": \"550.00\"}";
+
+/**
+ * Writes out a cache file holding fresh USD and EUR rates.
+ */
+static std::string
+cacheFile(const std::string &dir)
+{
+    const auto now = std::to_string(time(nullptr));
+    const auto path = dir + "exchange.json";
+    const auto data = "{\"rates\": ["
+                      "{\"code\": \"USD\", \"rate\": 500, \"timestamp\": " +
+                      now + "}, "
+                      "{\"code\": \"EUR\", \"rate\": 400, \"timestamp\": " +
+                      now + "}]}";
+    REQUIRE(abcd::fileSave(data, path));
+    return path;
+}
+
+TEST_CASE("Exchange rate conversions", "[exchange]")
+{
+    TempDir dir;
+    abcd::ExchangeCache cache(cacheFile(dir.path()));
+
+    SECTION("single amounts")
+    {
+        double currency;
+        REQUIRE(cache.satoshiToCurrency(currency, 200000000,
+                                        abcd::Currency::USD));
+        REQUIRE(Approx(1000) == currency);
+
+        int64_t satoshi;
+        REQUIRE(cache.currencyToSatoshi(satoshi, 200, abcd::Currency::EUR));
+        REQUIRE(50000000 == satoshi);
+
+        REQUIRE_FALSE(cache.satoshiToCurrency(currency, 1,
+                                              abcd::Currency::CAD));
+    }
+    SECTION("batches")
+    {
+        const int64_t in[] = {100000000, 50000000, 0};
+        double out[3];
+        REQUIRE(cache.satoshiToCurrency(out, in, 3, abcd::Currency::EUR));
+        REQUIRE(Approx(400) == out[0]);
+        REQUIRE(Approx(200) == out[1]);
+        REQUIRE(0 == out[2]);
+    }
+}
+
+TEST_CASE("Exchange sources", "[exchange]")
+{
+    REQUIRE(abcd::httpInit());
+    StubServer server(bitstampReply);
+    abcd::ExchangeRates rates;
+
+    SECTION("fetch")
+    {
+        REQUIRE(abcd::exchangeSourceFetch(rates, "Bitstamp", server.url()));
+        REQUIRE(1 == rates.size());
+        REQUIRE(612.50 == rates[abcd::Currency::USD]);
+    }
+    SECTION("fetch asynchronously")
+    {
+        std::condition_variable cv;
+        std::mutex mutex;
+        bool done = false;
+        abcd::Status status;
+
+        auto callback = [&](abcd::Status s, abcd::ExchangeRates &result)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            status = s;
+            rates = result;
+            done = true;
+            cv.notify_all();
+        };
+        REQUIRE(abcd::exchangeSourceFetchAsync("Bitstamp", 10, callback,
+                                               server.url()));
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]()
+        {
+            return done;
+        });
+        REQUIRE(status);
+        REQUIRE(612.50 == rates[abcd::Currency::USD]);
+    }
+    SECTION("bad replies")
+    {
+        REQUIRE_FALSE(abcd::exchangeSourceFetch(rates, "Bitfinex", server.url()));
+        REQUIRE_FALSE(abcd::exchangeSourceFetch(rates, "Nowhere", server.url()));
+    }
+}
+
+TEST_CASE("Exchange rate updates", "[exchange]")
+{
+    REQUIRE(abcd::httpInit());
+    TempDir dir;
+    const abcd::Currencies usd{abcd::Currency::USD};
+    double currency;
+
+    SECTION("higher priority wins")
+    {
+        StubServer slow(bitstampReply, std::chrono::milliseconds(300));
+        StubServer fast(bitfinexReply);
+        abcd::ExchangeCache cache(dir.path() + "exchange.json",
+        {{"Bitstamp", slow.url()}, {"Bitfinex", fast.url()}});
+
+        REQUIRE(cache.update(usd, {"Bitstamp", "Bitfinex"}));
+        REQUIRE(cache.satoshiToCurrency(currency, 100000000,
+                                        abcd::Currency::USD));
+        REQUIRE(Approx(612.50) == currency);
+    }
+    SECTION("settled results return early")
+    {
+        StubServer fast(bitstampReply);
+        StubServer slow(bitfinexReply, std::chrono::milliseconds(1000));
+        abcd::ExchangeCache cache(dir.path() + "exchange.json",
+        {{"Bitstamp", fast.url()}, {"Bitfinex", slow.url()}});
+
+        const auto start = std::chrono::steady_clock::now();
+        REQUIRE(cache.update(usd, {"Bitstamp", "Bitfinex"}));
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        REQUIRE(elapsed < std::chrono::milliseconds(500));
+        REQUIRE(cache.satoshiToCurrency(currency, 100000000,
+                                        abcd::Currency::USD));
+        REQUIRE(Approx(612.50) == currency);
+
+        // Let the slow request finish before the server goes away:
+        std::this_thread::sleep_for(std::chrono::milliseconds(1500));
+    }
+    SECTION("late replies reach the next update")
+    {
+        std::unique_ptr<StubServer> fast(new StubServer(bitstampReply));
+        std::unique_ptr<StubServer> slow(
+            new StubServer(coinbaseReply, std::chrono::milliseconds(300)));
+        abcd::ExchangeCache cache(dir.path() + "exchange.json",
+        {{"Bitstamp", fast->url()}, {"Coinbase", slow->url()}});
+        const abcd::ExchangeSources sources{"Bitstamp", "Coinbase"};
+
+        REQUIRE(cache.update(usd, sources));
+        REQUIRE_FALSE(cache.satoshiToCurrency(currency, 100000000,
+                                              abcd::Currency::EUR));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+
+        // With the servers gone, only the late reply can supply this:
+        fast.reset();
+        slow.reset();
+        REQUIRE(cache.update({abcd::Currency::EUR}, sources));
+        REQUIRE(cache.satoshiToCurrency(currency, 100000000,
+                                        abcd::Currency::EUR));
+        REQUIRE(Approx(550) == currency);
+    }
+}
+
+TEST_CASE("Exchange conversion benchmark", "[.][exchange][benchmark]")
+{
+    TempDir dir;
+    abcd::ExchangeCache cache(cacheFile(dir.path()));
+
+    const size_t count = 1000000;
+    std::vector<int64_t> in(count, 12345678);
+    std::vector<double> out(count);
+
+    for (unsigned threadCount: {1, 4})
+    {
+        std::atomic<bool> ok(true);
+        auto worker = [&]()
+        {
+            double currency;
+            for (size_t i = 0; i < count / threadCount; ++i)
+                if (!cache.satoshiToCurrency(currency, in[i],
+                                             abcd::Currency::USD))
+                    ok = false;
+        };
+
+        BenchmarkTimer timer;
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < threadCount; ++i)
+            threads.emplace_back(worker);
+        for (auto &thread: threads)
+            thread.join();
+        timer.report(std::to_string(threadCount) + " thread(s)", count,
+                     "conversion");
+        REQUIRE(ok);
+    }
+
+    BenchmarkTimer timer;
+    REQUIRE(cache.satoshiToCurrency(out.data(), in.data(), count,
+                                    abcd::Currency::USD));
+    timer.report("batch", count, "conversion");
+}
+
+TEST_CASE("Exchange source benchmark", "[.][exchange][benchmark]")
+{
+    REQUIRE(abcd::httpInit());
+    StubServer slow(bitstampReply, std::chrono::milliseconds(500));
+    StubServer fast(bitfinexReply, std::chrono::milliseconds(20));
+
+    // One source after another, stopping at the first success:
+    BenchmarkTimer timer;
+    abcd::ExchangeRates rates;
+    REQUIRE(abcd::exchangeSourceFetch(rates, "Bitstamp", slow.url()));
+    timer.report("slow source first, in order");
+
+    // Both at once, taking whichever answers first:
+    std::condition_variable cv;
+    std::mutex mutex;
+    int ok = 0;
+    auto callback = [&](abcd::Status s, abcd::ExchangeRates &result)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (s)
+            ++ok;
+        cv.notify_all();
+    };
+
+    timer.restart();
+    REQUIRE(abcd::exchangeSourceFetchAsync("Bitstamp", 10, callback,
+                                           slow.url()));
+    REQUIRE(abcd::exchangeSourceFetchAsync("Bitfinex", 10, callback,
+                                           fast.url()));
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]()
+        {
+            return 0 < ok;
+        });
+    }
+    timer.report("slow source first, concurrently");
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]()
+        {
+            return 2 == ok;
+        });
+    }
+
+    // The cache waits for a slow source that outranks the fast one,
+    // but not for one it outranks:
+    TempDir dir;
+    const abcd::ExchangeMirrors mirrors
+    {
+        {"Bitstamp", slow.url()}, {"Bitfinex", fast.url()}
+    };
+    abcd::ExchangeCache slowFirst(dir.path() + "slow.json", mirrors);
+    abcd::ExchangeCache fastFirst(dir.path() + "fast.json", mirrors);
+
+    timer.restart();
+    REQUIRE(slowFirst.update({abcd::Currency::USD}, {"Bitstamp", "Bitfinex"}));
+    timer.report("slow source first, cache update");
+    REQUIRE(fastFirst.update({abcd::Currency::USD}, {"Bitfinex", "Bitstamp"}));
+    timer.report("fast source first, cache update");
+
+    // Let the slow request finish before the servers go away:
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+}
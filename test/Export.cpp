@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "../abcd/Export.hpp"
+#include "../minilibs/catch/catch.hpp"
+#include <string.h>
+#include <sstream>
+#include <vector>
+
+/**
+ * A tiny wallet history, built without a real wallet behind it.
+ */
+class ExportFixture
+{
+public:
+    ExportFixture()
+    {
+        received_ = makeInfo("txid-received", 1454000000, 123456789, 1234,
+                             "Alice & Co", "Income:Salary",
+                             "first, \"quoted\"", 600.25);
+        receivedIo_[0] = tABC_TxOutput{true, 123458023,
+                                       "1SenderAddress"};
+        receivedIo_[1] = tABC_TxOutput{false, 123456789,
+                                       "1ReceiveAddress"};
+        receivedIos_[0] = &receivedIo_[0];
+        receivedIos_[1] = &receivedIo_[1];
+        received_.countOutputs = 2;
+        received_.aOutputs = receivedIos_;
+
+        sent_ = makeInfo("txid-sent", 1455000000, -12345678, 5678,
+                         "Bob", "Expense:Food", "<lunch>", -50.5);
+        sent_.pDetails = &sentDetails_;
+    }
+
+    /**
+     * Feeds the fixture transactions to the visitor, oldest first.
+     */
+    abcd::ExportSource
+    source()
+    {
+        return [this](const abcd::ExportVisitor &visitor) -> abcd::Status
+        {
+            const auto s = visitor(received_);
+            if (!s)
+                return s;
+            return visitor(sent_);
+        };
+    }
+
+private:
+    tABC_TxDetails receivedDetails_;
+    tABC_TxDetails sentDetails_;
+    tABC_TxOutput receivedIo_[2];
+    tABC_TxOutput *receivedIos_[2];
+    tABC_TxInfo received_;
+    tABC_TxInfo sent_;
+
+    tABC_TxInfo
+    makeInfo(const char *txid, int64_t time, int64_t amount, int64_t fee,
+             const char *name, const char *category, const char *notes,
+             double currency)
+    {
+        auto &details = 0 < amount ? receivedDetails_ : sentDetails_;
+        details = tABC_TxDetails();
+        details.amountSatoshi = amount;
+        details.amountFeesMinersSatoshi = fee;
+        details.amountCurrency = currency;
+        details.szName = const_cast<char *>(name);
+        details.szCategory = const_cast<char *>(category);
+        details.szNotes = const_cast<char *>(notes);
+
+        tABC_TxInfo out = tABC_TxInfo();
+        out.szID = txid;
+        out.timeCreation = time;
+        out.balance = amount;
+        out.minerFee = fee;
+        out.pDetails = &details;
+        return out;
+    }
+};
+
+static std::vector<std::string>
+exportLines(const std::string &text)
+{
+    std::vector<std::string> out;
+    std::istringstream stream(text);
+    std::string line;
+    while (std::getline(stream, line))
+        out.push_back(line);
+    return out;
+}
+
+TEST_CASE("CSV export", "[export]")
+{
+    ExportFixture fixture;
+    std::string result;
+    abcd::ExportWriter out(abcd::exportSinkString(result));
+    REQUIRE(abcd::exportCsv(out, fixture.source()));
+
+    const auto lines = exportLines(result);
+    REQUIRE(3 == lines.size());
+    REQUIRE(lines[0] == "DATE,TIME,PAYEE_PAYER_NAME,AMT_BTC,USD,CATEGORY,"
+            "NOTES,AMT_BTC_FEES_AB,AMT_BTC_FEES_MINERS,IN_ADDRESSES,"
+            "OUT_ADDRESSES,TXID,VER");
+
+    // The date and time columns depend on the local time zone:
+    const auto received = lines[1].substr(lines[1].find("\"Alice"));
+    REQUIRE(received == "\"Alice & Co\",\"1.23456789\",\"600.25\","
+            "\"Income:Salary\",\"first, \"\"quoted\"\"\",\"0\","
+            "\"0.00001234\",\"1SenderAddress:1.23458023\","
+            "\"1ReceiveAddress:1.23456789\",\"txid-received\",1");
+
+    const auto sent = lines[2].substr(lines[2].find("\"Bob"));
+    REQUIRE(sent == "\"Bob\",\"-0.12345678\",\"-50.50\",\"Expense:Food\","
+            "\"<lunch>\",\"0\",\"0.00005678\",\"\",\"\",\"txid-sent\",1");
+}
+
+TEST_CASE("QBO export", "[export]")
+{
+    ExportFixture fixture;
+    std::string result;
+    abcd::ExportWriter out(abcd::exportSinkString(result));
+    REQUIRE(abcd::exportQbo(out, fixture.source()));
+
+    REQUIRE(0 == result.find("OFXHEADER:100\n"));
+    const auto footer = result.size() - strlen("</OFX>\n");
+    REQUIRE(footer == result.rfind("</OFX>\n"));
+
+    // One statement per transaction, in order:
+    const auto received = result.find("<STMTTRN>\n"
+                                      "  <TRNTYPE>CREDIT\n");
+    const auto sent = result.find("<STMTTRN>\n"
+                                  "  <TRNTYPE>DEBIT\n");
+    REQUIRE(std::string::npos != received);
+    REQUIRE(std::string::npos != sent);
+    REQUIRE(received < sent);
+
+    REQUIRE(std::string::npos != result.find("  <TRNAMT>1234567.89\n"
+                                             "  <FITID>txid-received\n"
+                                             "  <NAME>Alice &amp; Co\n"));
+    REQUIRE(std::string::npos != result.find("  <TRNAMT>-123456.78\n"
+                                             "  <FITID>txid-sent\n"
+                                             "  <NAME>Bob\n"));
+    REQUIRE(std::string::npos != result.find("memo=\"&lt;lunch&gt;\""));
+}
+
+TEST_CASE("Export buffering", "[export]")
+{
+    ExportFixture fixture;
+    std::string expected;
+    abcd::ExportWriter out(abcd::exportSinkString(expected));
+    REQUIRE(abcd::exportCsv(out, fixture.source()));
+
+    SECTION("small buffers produce the same output")
+    {
+        std::string result;
+        size_t chunks = 0;
+        abcd::ExportWriter small([&](const char *data, size_t size)
+                                 -> abcd::Status
+        {
+            ++chunks;
+            result.append(data, size);
+            return abcd::Status();
+        }, 16);
+        REQUIRE(abcd::exportCsv(small, fixture.source()));
+        REQUIRE(result == expected);
+        REQUIRE(1 < chunks);
+    }
+
+    SECTION("sink errors stop the export")
+    {
+        abcd::ExportWriter failing([](const char *data, size_t size)
+                                   -> abcd::Status
+        {
+            return abcd::Status(ABC_CC_FileWriteError, "Disk full",
+                                abcd::ABC_HERE());
+        }, 16);
+        const auto s = abcd::exportCsv(failing, fixture.source());
+        REQUIRE(!s);
+        REQUIRE(ABC_CC_FileWriteError == s.value());
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Helpers.hpp"
+#include "../abcd/util/FileIO.hpp"
+#include "../minilibs/catch/catch.hpp"
+
+TEST_CASE("Queued file saves", "[util][file]")
+{
+    TempDir temp;
+    const auto &dir = temp.path();
+    const auto path = dir + "file.json";
+
+    const std::string first = "first";
+    const std::string second = "second";
+    abcd::DataChunk data;
+
+    SECTION("reads see queued data")
+    {
+        REQUIRE(abcd::fileSaveLater(first, path));
+        REQUIRE(abcd::fileSaveLater(second, path));
+        REQUIRE(abcd::fileExists(path));
+        REQUIRE(abcd::fileLoad(data, path));
+        REQUIRE(std::string(data.begin(), data.end()) == second);
+    }
+    SECTION("flush writes to disk")
+    {
+        REQUIRE(abcd::fileSaveLater(first, path));
+        REQUIRE(abcd::fileFlush());
+        REQUIRE(abcd::fileExists(path));
+        REQUIRE(!abcd::fileExists(path + ".tmp"));
+    }
+    SECTION("direct saves replace queued ones")
+    {
+        REQUIRE(abcd::fileSaveLater(first, path));
+        REQUIRE(abcd::fileSave(second, path));
+        REQUIRE(abcd::fileFlush());
+        REQUIRE(abcd::fileLoad(data, path));
+        REQUIRE(std::string(data.begin(), data.end()) == second);
+    }
+    SECTION("deletes cancel queued saves")
+    {
+        REQUIRE(abcd::fileSaveLater(first, path));
+        REQUIRE(abcd::fileDelete(path));
+        REQUIRE(!abcd::fileExists(path));
+        REQUIRE(abcd::fileFlush());
+        REQUIRE(!abcd::fileExists(path));
+    }
+    SECTION("failed writes stay queued")
+    {
+        const auto missing = dir + "missing/file.json";
+        REQUIRE(abcd::fileSaveLater(first, missing));
+        REQUIRE_FALSE(abcd::fileFlush());
+        REQUIRE(abcd::fileLoad(data, missing));
+        REQUIRE(std::string(data.begin(), data.end()) == first);
+
+        REQUIRE(abcd::fileEnsureDir(dir + "missing/"));
+        REQUIRE(abcd::fileFlush());
+        REQUIRE(!abcd::fileExists(missing + ".tmp"));
+        REQUIRE(abcd::fileLoad(data, missing));
+        REQUIRE(std::string(data.begin(), data.end()) == first);
+    }
+    SECTION("queued saves update the file time")
+    {
+        time_t before = time(nullptr);
+        REQUIRE(abcd::fileSaveLater(first, path));
+        time_t saved;
+        REQUIRE(abcd::fileTime(saved, path));
+        REQUIRE(before <= saved);
+        REQUIRE(abcd::fileTerminate());
+        REQUIRE(abcd::fileExists(path));
+    }
+}
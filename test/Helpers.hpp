@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef TEST_HELPERS_HPP
+#define TEST_HELPERS_HPP
+
+#include "../abcd/util/FileIO.hpp"
+#include "../minilibs/catch/catch.hpp"
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+/**
+ * A scratch directory, deleted along with its contents at the end.
+ */
+class TempDir
+{
+public:
+    ~TempDir()
+    {
+        abcd::fileDelete(path_).log();
+    }
+
+    TempDir()
+    {
+        char dirTemplate[] = "/tmp/abc-test-XXXXXX";
+        REQUIRE(mkdtemp(dirTemplate));
+        path_ = abcd::fileSlashify(dirTemplate);
+    }
+
+    /**
+     * The directory path, with a trailing slash.
+     */
+    const std::string &path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+/**
+ * Times the steps of a benchmark, printing each one as it finishes.
+ */
+class BenchmarkTimer
+{
+public:
+    BenchmarkTimer():
+        start_(std::chrono::steady_clock::now())
+    {}
+
+    /**
+     * Restarts the clock, for steps that should not count.
+     */
+    void
+    restart()
+    {
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Prints the time since the last report,
+     * divided over `count` repetitions, then restarts the clock.
+     */
+    void
+    report(const std::string &name, size_t count=1, const char *per="")
+    {
+        const auto ns = elapsedNs() / (count ? count : 1);
+        std::cout << name << ": ";
+        if (ns < 10000)
+            std::cout << ns << "ns";
+        else if (ns < 10000000)
+            std::cout << ns / 1000 << "us";
+        else
+            std::cout << ns / 1000000 << "ms";
+        if (*per)
+            std::cout << " per " << per;
+        std::cout << std::endl;
+        restart();
+    }
+
+    /**
+     * Prints the throughput since the last report, then restarts the clock.
+     */
+    void
+    reportRate(const std::string &name, size_t bytes)
+    {
+        const auto ns = elapsedNs();
+        std::cout << name << ": " << bytes * 1000 / (ns ? ns : 1) <<
+                  "MB/s" << std::endl;
+        restart();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+
+    unsigned long long
+    elapsedNs() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now() - start_).count();
+    }
+};
+
+#endif
@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "Helpers.hpp"
+#include "HttpStub.hpp"
+#include "../abcd/http/Http.hpp"
+#include "../abcd/http/HttpRequest.hpp"
+#include "../minilibs/catch/catch.hpp"
+#include <condition_variable>
+#include <mutex>
+
+TEST_CASE("HTTP handle pool", "[http]")
+{
+    REQUIRE(abcd::httpInit());
+
+    SECTION("handles are reused")
+    {
+        auto handle = abcd::httpHandleTake();
+        REQUIRE(handle);
+        abcd::httpHandleGive(handle);
+        REQUIRE(handle == abcd::httpHandleTake());
+        abcd::httpHandleGive(handle);
+    }
+    SECTION("requests work")
+    {
+        StubServer server;
+        for (int i = 0; i < 3; ++i)
+        {
+            abcd::HttpReply reply;
+            REQUIRE(abcd::HttpRequest().get(reply, server.url()));
+            REQUIRE(reply.codeOk());
+            REQUIRE("ok" == reply.body);
+        }
+    }
+    SECTION("asynchronous requests")
+    {
+        StubServer server;
+        std::condition_variable cv;
+        std::mutex mutex;
+        int done = 0;
+        int ok = 0;
+
+        const int count = 20;
+        for (int i = 0; i < count; ++i)
+        {
+            auto callback = [&](abcd::Status s, abcd::HttpReply &reply)
+            {
+                // Notify under the lock, since the waiter owns the cv:
+                std::lock_guard<std::mutex> lock(mutex);
+                ++done;
+                if (s && reply.codeOk() && "ok" == reply.body)
+                    ++ok;
+                cv.notify_all();
+            };
+            REQUIRE(abcd::HttpRequest().getAsync(server.url(), callback));
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]()
+        {
+            return count == done;
+        });
+        REQUIRE(count == ok);
+    }
+    SECTION("shutting down")
+    {
+        StubServer slow("ok", std::chrono::milliseconds(2000));
+        abcd::Status status;
+        bool done = false;
+        auto callback = [&](abcd::Status s, abcd::HttpReply &reply)
+        {
+            status = s;
+            done = true;
+        };
+        REQUIRE(abcd::HttpRequest().getAsync(slow.url(), callback));
+
+        // In-flight requests fail, rather than leaving their callers hanging:
+        abcd::httpTerminate();
+        REQUIRE(done);
+        REQUIRE_FALSE(status);
+
+        // The thread comes back for the next request:
+        StubServer server;
+        std::condition_variable cv;
+        std::mutex mutex;
+        bool ok = false;
+        auto restarted = [&](abcd::Status s, abcd::HttpReply &reply)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ok = s && "ok" == reply.body;
+            cv.notify_all();
+        };
+        REQUIRE(abcd::HttpRequest().getAsync(server.url(), restarted));
+
+        std::unique_lock<std::mutex> lock(mutex);
+        REQUIRE(cv.wait_for(lock, std::chrono::seconds(5), [&]()
+        {
+            return ok;
+        }));
+        abcd::httpTerminate();
+    }
+}
+
+TEST_CASE("HTTP pool benchmark", "[.][http][benchmark]")
+{
+    const int count = 500;
+
+    REQUIRE(abcd::httpInit());
+    StubServer server;
+
+    // A fresh handle per request, which is what we used to do:
+    BenchmarkTimer timer;
+    for (int i = 0; i < count; ++i)
+    {
+        std::string body;
+        auto handle = curl_easy_init();
+        REQUIRE(handle);
+        curl_easy_setopt(handle, CURLOPT_URL, server.url().c_str());
+        curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(handle, CURLOPT_WRITEDATA, &body);
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION,
+                         static_cast<size_t (*)(char *, size_t, size_t, void *)>(
+                             [](char *data, size_t size, size_t n, void *user)
+        {
+            static_cast<std::string *>(user)->append(data, size * n);
+            return size * n;
+        }));
+        REQUIRE(CURLE_OK == curl_easy_perform(handle));
+        curl_easy_cleanup(handle);
+    }
+    timer.report("fresh handles", count, "request");
+
+    for (int i = 0; i < count; ++i)
+    {
+        abcd::HttpReply reply;
+        REQUIRE(abcd::HttpRequest().get(reply, server.url()));
+    }
+    timer.report("pooled handles", count, "request");
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#ifndef TEST_HTTP_STUB_HPP
+#define TEST_HTTP_STUB_HPP
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+/**
+ * A tiny keep-alive HTTP server on the loopback interface,
+ * answering every request with the same reply after a fixed delay.
+ */
+class StubServer
+{
+public:
+    ~StubServer()
+    {
+        shutdown(listener_, SHUT_RDWR);
+        close(listener_);
+        thread_.join();
+    }
+
+    StubServer(const std::string &body="ok",
+               std::chrono::milliseconds delay=std::chrono::milliseconds(0))
+    {
+        response_ = "HTTP/1.1 200 OK\r\nContent-Length: " +
+                    std::to_string(body.size()) + "\r\n\r\n" + body;
+        listener_ = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t size = sizeof(address);
+        bind(listener_, reinterpret_cast<sockaddr *>(&address), size);
+        listen(listener_, 64);
+        getsockname(listener_, reinterpret_cast<sockaddr *>(&address), &size);
+        url_ = "http://127.0.0.1:" + std::to_string(ntohs(address.sin_port)) +
+               "/";
+        thread_ = std::thread(&StubServer::serve, listener_, response_, delay);
+    }
+
+    const std::string &url() const { return url_; }
+
+private:
+    int listener_;
+    std::string url_;
+    std::string response_;
+    std::thread thread_;
+
+    static void
+    serve(int listener, std::string response, std::chrono::milliseconds delay)
+    {
+        int connection;
+        while (0 <= (connection = accept(listener, nullptr, nullptr)))
+            std::thread(&StubServer::reply, connection, response, delay).detach();
+    }
+
+    static void
+    reply(int connection, std::string response,
+          std::chrono::milliseconds delay)
+    {
+        std::string request;
+        char buffer[1024];
+        ssize_t size;
+        while (0 < (size = read(connection, buffer, sizeof(buffer))))
+        {
+            request.append(buffer, size);
+            for (auto end = request.find("\r\n\r\n");
+                    std::string::npos != end; end = request.find("\r\n\r\n"))
+            {
+                request.erase(0, end + 4);
+                std::this_thread::sleep_for(delay);
+                if (write(connection, response.data(), response.size()) < 0)
+                    break;
+            }
+        }
+        close(connection);
+    }
+};
+
+#endif
@@ -5,9 +5,32 @@
  * See the LICENSE file for more information.
  */
 
+#include "Helpers.hpp"
 #include "../abcd/json/JsonArray.hpp"
+#include "../abcd/json/JsonCodec.hpp"
 #include "../abcd/json/JsonObject.hpp"
 #include "../minilibs/catch/catch.hpp"
+#include <string.h>
+
+struct CodecTestJson
+{
+    bool boolean = true;
+    int64_t integer = 42;
+    std::vector<int64_t> list;
+    double number = 6.28;
+    std::string string = "default";
+    abcd::JsonRaw value;
+
+    static const abcd::JsonSchema<CodecTestJson> schema;
+};
+
+ABC_JSON_SCHEMA(CodecTestJson,
+                ABC_JSON_FIELD(CodecTestJson, boolean, "boolean"),
+                ABC_JSON_FIELD(CodecTestJson, integer, "integer"),
+                ABC_JSON_FIELD(CodecTestJson, list, "list"),
+                ABC_JSON_FIELD(CodecTestJson, number, "number"),
+                ABC_JSON_FIELD_OPTIONAL(CodecTestJson, string, "string"),
+                ABC_JSON_FIELD(CodecTestJson, value, "value"));
 
 TEST_CASE("JsonPtr lifetime", "[util][json]")
 {
@@ -144,3 +167,173 @@ TEST_CASE("JsonPtr encoding", "[util][json]")
         REQUIRE("null" == json.encode());
     }
 }
+
+TEST_CASE("JsonCodec decoding", "[util][json]")
+{
+    CodecTestJson test;
+
+    SECTION("defaults")
+    {
+        REQUIRE(abcd::jsonDecode(test, std::string("{}")));
+        REQUIRE(test.boolean == true);
+        REQUIRE(test.integer == 42);
+        REQUIRE(test.list.empty());
+        REQUIRE(test.number == 6.28);
+        REQUIRE(test.string == "default");
+        REQUIRE(test.value.empty());
+    }
+    SECTION("values")
+    {
+        std::string text = "{ \"value\": { \"a\": [1, \"}\"] }, "
+                           "\"string\": \"\\u00e9\\n\", \"number\": 1.1, "
+                           "\"integer\": -9223372036854775808, "
+                           "\"list\": [1, 2, 3], \"boolean\": false }";
+        REQUIRE(abcd::jsonDecode(test, text));
+        REQUIRE(test.boolean == false);
+        REQUIRE(test.integer == INT64_MIN);
+        REQUIRE(test.list == std::vector<int64_t>({1, 2, 3}));
+        REQUIRE(test.number == 1.1);
+        REQUIRE(test.string == "\xc3\xa9\n");
+        REQUIRE(test.value.str() == "{ \"a\": [1, \"}\"] }");
+    }
+    SECTION("wrong types fall back")
+    {
+        REQUIRE(abcd::jsonDecode(test, std::string(
+                    "{\"boolean\": 1, \"integer\": 1.5, \"number\": 2, "
+                    "\"string\": null, \"list\": [1, \"x\", 3], \"extra\": {}}")));
+        REQUIRE(test.boolean == true);
+        REQUIRE(test.integer == 42);
+        REQUIRE(test.number == 2);
+        REQUIRE(test.string == "default");
+        REQUIRE(test.list == std::vector<int64_t>({1, 3}));
+    }
+    SECTION("bad documents")
+    {
+        REQUIRE_FALSE(abcd::jsonDecode(test, std::string("")));
+        REQUIRE_FALSE(abcd::jsonDecode(test, std::string("[]")));
+        REQUIRE_FALSE(abcd::jsonDecode(test, std::string("{} {}")));
+        REQUIRE_FALSE(abcd::jsonDecode(test, std::string("{\"integer\": 1,}")));
+        REQUIRE_FALSE(abcd::jsonDecode(test, std::string(
+                          "{\"integer\": 9223372036854775808}")));
+        REQUIRE_FALSE(abcd::jsonDecode(test, std::string(
+                          "{\"string\": \"\\u0000\"}")));
+        REQUIRE_FALSE(abcd::jsonDecode(test, std::string(
+                          "{\"string\": \"\xff\"}")));
+        REQUIRE_FALSE(abcd::jsonDecode(test, std::string(2049, '[')));
+    }
+}
+
+TEST_CASE("JsonCodec encoding", "[util][json]")
+{
+    CodecTestJson test;
+    test.list = {1, -2};
+    test.number = 1e100;
+    test.string = "\"\\\x01\xc3\xa9";
+
+    abcd::JsonPtr value(json_real(0.5));
+    const auto text = value.encode();
+    test.value = abcd::JsonRaw(text.data(), text.data() + text.size());
+
+    abcd::JsonObject json;
+    REQUIRE(json.set("boolean", test.boolean));
+    REQUIRE(json.set("integer", json_int_t(test.integer)));
+    abcd::JsonArray list;
+    REQUIRE(list.append(json_integer(1)));
+    REQUIRE(list.append(json_integer(-2)));
+    REQUIRE(json.set("list", list));
+    REQUIRE(json.set("number", test.number));
+    REQUIRE(json.set("string", test.string));
+    REQUIRE(json.set("value", value));
+
+    SECTION("matches jansson")
+    {
+        REQUIRE(abcd::jsonEncode(test) == json.encode());
+        REQUIRE(abcd::jsonEncode(test, true) == json.encode(true));
+    }
+    SECTION("round trip")
+    {
+        CodecTestJson copy;
+        auto encoded = abcd::jsonEncode(test);
+        REQUIRE(abcd::jsonDecode(copy, encoded));
+        REQUIRE(abcd::jsonEncode(copy) == encoded);
+    }
+    SECTION("optional fields")
+    {
+        test.string = "default";
+        REQUIRE(std::string::npos == abcd::jsonEncode(test).find("string"));
+    }
+}
+
+TEST_CASE("JsonCodec benchmark", "[.][util][json][benchmark]")
+{
+    struct BenchJson:
+        public abcd::JsonObject
+    {
+        ABC_JSON_CONSTRUCTORS(BenchJson, JsonObject)
+
+        ABC_JSON_BOOLEAN(boolean, "boolean", true)
+        ABC_JSON_INTEGER(integer, "integer", 42)
+        ABC_JSON_NUMBER (number,  "number",  6.28)
+        ABC_JSON_STRING (string,  "string",  "default")
+    };
+
+    std::vector<CodecTestJson> records(2000);
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        records[i].integer = i;
+        records[i].string = std::string(64, 'a' + i % 26);
+    }
+    const auto text = abcd::jsonEncode(records);
+    const unsigned rounds = 20;
+
+    int64_t sum = 0;
+    BenchmarkTimer timer;
+    for (unsigned round = 0; round < rounds; ++round)
+    {
+        abcd::JsonArray array;
+        REQUIRE(array.decode(text));
+        for (size_t i = 0; i < array.size(); ++i)
+        {
+            BenchJson json(array[i]);
+            sum += json.integer() + strlen(json.string());
+        }
+    }
+    timer.report("JsonObject", rounds, "decode");
+
+    int64_t codecSum = 0;
+    for (unsigned round = 0; round < rounds; ++round)
+    {
+        std::vector<CodecTestJson> decoded;
+        REQUIRE(abcd::jsonDecode(decoded, text));
+        for (const auto &json: decoded)
+            codecSum += json.integer + json.string.size();
+    }
+    timer.report("JsonCodec", rounds, "decode");
+    REQUIRE(sum == codecSum);
+
+    // Serializing the same records back out:
+    size_t size = 0;
+    timer.restart();
+    for (unsigned round = 0; round < rounds; ++round)
+    {
+        abcd::JsonArray array;
+        for (const auto &record: records)
+        {
+            BenchJson json;
+            REQUIRE(json.booleanSet(record.boolean));
+            REQUIRE(json.integerSet(record.integer));
+            REQUIRE(json.numberSet(record.number));
+            REQUIRE(json.stringSet(record.string));
+            REQUIRE(array.append(json));
+        }
+        size += array.encode().size();
+    }
+    timer.report("JsonObject", rounds, "encode");
+
+    size_t codecSize = 0;
+    for (unsigned round = 0; round < rounds; ++round)
+        codecSize += abcd::jsonEncode(records).size();
+    timer.report("JsonCodec", rounds, "encode");
+    REQUIRE(0 < codecSize);
+    REQUIRE(0 < size);
+}
@@ -5,9 +5,12 @@
  * See the LICENSE file for more information.
  */
 
+#include "Helpers.hpp"
 #include "../abcd/crypto/Scrypt.hpp"
+#include "../abcd/crypto/ScryptCache.hpp"
 #include "../abcd/crypto/Encoding.hpp"
 #include "../minilibs/catch/catch.hpp"
+#include "../minilibs/scrypt/crypto_scrypt.h"
 
 TEST_CASE("Scrypt RFC test vectors", "[crypto][scrypt]")
 {
@@ -76,3 +79,149 @@ TEST_CASE("Scrypt RFC test vectors", "[crypto][scrypt]")
         CHECK(abcd::base16Encode(out) == test.result);
     }
 }
+
+TEST_CASE("Scrypt implementations agree", "[crypto][scrypt]")
+{
+    struct TestCase
+    {
+        std::string password;
+        std::string salt;
+        uint64_t N;
+        uint32_t r;
+        uint32_t p;
+        size_t dklen;
+        const char *result;
+    };
+    TestCase cases[] =
+    {
+        {
+            "", "", 16, 1, 1, 64,
+            "77d6576238657b203b19ca42c18a0497"
+            "f16b4844e3074ae8dfdffa3fede21442"
+            "fcd0069ded0948f8326a753a0fc81f17"
+            "e8d3e0fb2e0d3628cf35e20c38d18906"
+        },
+        {
+            "airbitz", "salt", 64, 3, 2, 48, // Odd r, several lanes
+            "a88782d6638c3e19767bc9524e5b2915"
+            "d2b485582bf0dbf66b0e5fa158afccb6"
+            "2daec58fac2fe12d8a2d83900db75383"
+        },
+        {
+            "x", "y", 2, 1, 3, 32, // Smallest possible N
+            "15771a7a176ec4ff1f417e88b477d5be"
+            "4e2b5ced97de85e395a4edf69db73723"
+        }
+    };
+    crypto_scrypt_impl impls[] =
+    {
+        CRYPTO_SCRYPT_REF,
+        CRYPTO_SCRYPT_PORTABLE,
+        CRYPTO_SCRYPT_SSE2,
+        CRYPTO_SCRYPT_AUTO
+    };
+
+    for (auto impl: impls)
+    {
+        if (!crypto_scrypt_supported(impl))
+            continue;
+
+        for (auto &test: cases)
+        {
+            abcd::DataChunk out(test.dklen);
+            CHECK(0 == crypto_scrypt_impl_run(impl,
+                                              abcd::DataSlice(test.password).data(),
+                                              test.password.size(),
+                                              abcd::DataSlice(test.salt).data(),
+                                              test.salt.size(),
+                                              test.N, test.r, test.p,
+                                              out.data(), out.size()));
+            CHECK(abcd::base16Encode(out) == test.result);
+        }
+    }
+}
+
+TEST_CASE("Scrypt futures", "[crypto][scrypt]")
+{
+    abcd::ScryptSnrp snrp =
+    {
+        abcd::DataChunk{'b', 'i', 't', 'z'}, 16, 2, 4
+    };
+
+    // Two derivations at once must match the serial results:
+    abcd::ScryptFuture a(snrp, std::string("air"));
+    abcd::ScryptFuture b(abcd::usernameSnrp(), std::string("air"));
+    abcd::DataChunk outA, outB, expectedA, expectedB;
+    CHECK(snrp.hash(expectedA, std::string("air")));
+    CHECK(abcd::usernameSnrp().hash(expectedB, std::string("air")));
+    CHECK(a.get(outA));
+    CHECK(b.get(outB));
+    CHECK(outA == expectedA);
+    CHECK(outB == expectedB);
+}
+
+TEST_CASE("Scrypt cache", "[crypto][scrypt]")
+{
+    abcd::ScryptSnrp snrp =
+    {
+        abcd::DataChunk{'b', 'i', 't', 'z'}, 16, 2, 1
+    };
+    abcd::DataChunk first, cached, cleared, timed;
+    unsigned long totalTime;
+
+    CHECK(snrp.hash(first, std::string("air"), nullptr, 64));
+    CHECK(snrp.hash(cached, std::string("air"), nullptr, 64));
+    CHECK(first == cached);
+    CHECK(abcd::base16Encode(first) ==
+          "a7baec15cc38090b1ec207421105acbd"
+          "ad4e046be2ac04c3ecf5c01710691496"
+          "92040affcee0b7bd0798dd284ae26268"
+          "b17933839588c9bf1bd2d62baddf3fbb");
+
+    // Different sizes and inputs must not collide:
+    abcd::DataChunk shorter, other;
+    CHECK(snrp.hash(shorter, std::string("air"), nullptr, 32));
+    CHECK(shorter.size() == 32);
+    CHECK(abcd::DataChunk(first.begin(), first.begin() + 32) == shorter);
+    CHECK(snrp.hash(other, std::string("bitz"), nullptr, 64));
+    CHECK(other != first);
+
+    abcd::scryptCacheClear();
+    CHECK(snrp.hash(cleared, std::string("air"), nullptr, 64));
+    CHECK(snrp.hash(timed, std::string("air"), &totalTime, 64));
+    CHECK(cleared == first);
+    CHECK(timed == first);
+}
+
+TEST_CASE("Scrypt benchmark", "[.][crypto][scrypt][benchmark]")
+{
+    // The login parameters, which dominate the wall time of a login:
+    const auto &snrp = abcd::usernameSnrp();
+    const std::string password = "benchmark";
+    const char *names[] = {"auto", "reference", "portable", "sse2"};
+    crypto_scrypt_impl impls[] =
+    {
+        CRYPTO_SCRYPT_AUTO,
+        CRYPTO_SCRYPT_REF,
+        CRYPTO_SCRYPT_PORTABLE,
+        CRYPTO_SCRYPT_SSE2
+    };
+
+    for (auto impl: impls)
+    {
+        if (!crypto_scrypt_supported(impl))
+            continue;
+
+        const int rounds = 10;
+        abcd::DataChunk out(abcd::scryptDefaultSize);
+        BenchmarkTimer timer;
+        for (int i = 0; i < rounds; ++i)
+            REQUIRE(0 == crypto_scrypt_impl_run(impl,
+                                                abcd::DataSlice(password).data(),
+                                                password.size(),
+                                                snrp.salt.data(), snrp.salt.size(),
+                                                snrp.n, snrp.r, snrp.p,
+                                                out.data(), out.size()));
+        timer.report(std::string("scrypt ") + names[impl], rounds, "hash");
+    }
+}
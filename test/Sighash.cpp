@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2016, Airbitz, Inc.
+ * All rights reserved.
+ *
+ * See the LICENSE file for more information.
+ */
+
+#include "../abcd/bitcoin/Sighash.hpp"
+#include "../abcd/bitcoin/Utility.hpp"
+#include "../abcd/spend/Outputs.hpp"
+#include "../minilibs/catch/catch.hpp"
+
+TEST_CASE("Signature hashes match libbitcoin", "[bitcoin][sighash]")
+{
+    bc::script_type fromScript;
+    REQUIRE(abcd::outputScriptForAddress(fromScript,
+                                         "1QLbz7JHiBTspS962RLKV8GndWFwi5j6Qr"));
+
+    // Old signatures should not affect the hash:
+    bc::script_type oldScript;
+    oldScript.push_operation(abcd::makePushOperation(bc::data_chunk{0xff}));
+
+    bc::hash_digest fakeTxid{{0x01}};
+    bc::transaction_type tx{1, 0, {}, {{1000, fromScript}, {2000, fromScript}}};
+    for (uint32_t i = 0; i < 300; ++i)
+        tx.inputs.push_back({{fakeTxid, i}, oldScript, 0xffffffff - i});
+
+    const abcd::SighashCache sighashes(tx);
+    for (size_t i = 0; i < tx.inputs.size(); ++i)
+    {
+        const auto expected = bc::script_type::generate_signature_hash(
+                                  tx, i, fromScript, bc::sighash::all);
+        REQUIRE(expected == sighashes.hash(i, fromScript));
+    }
+    REQUIRE(bc::null_hash == sighashes.hash(tx.inputs.size(), fromScript));
+}